@@ -0,0 +1,428 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "efex-common.h"
+#include "efex-payloads.h"
+#include "efex-protocol.h"
+#include "efex-usb.h"
+#include "libefex.h"
+
+#define BENCH_MAX_LIST (16)
+#define BENCH_DEFAULT_ITERATIONS (10)
+
+enum bench_op_t {
+	BENCH_FEL_READ = 0,
+	BENCH_FEL_WRITE,
+	BENCH_FEL_READL,
+	BENCH_FEL_WRITEL,
+	BENCH_FES_DOWN,
+	BENCH_FES_UP,
+	BENCH_FES_VERIFY,
+	BENCH_OP_COUNT,
+};
+
+// What each operation needs: the device mode, whether transfer and chunk sizes apply to it
+static const struct {
+	const char *name;
+	uint16_t mode;
+	int sized;
+	int chunked;
+} bench_ops[BENCH_OP_COUNT] = {
+		[BENCH_FEL_READ] = {"fel_read", DEVICE_MODE_FEL, 1, 1},
+		[BENCH_FEL_WRITE] = {"fel_write", DEVICE_MODE_FEL, 1, 1},
+		[BENCH_FEL_READL] = {"fel_readl", DEVICE_MODE_FEL, 0, 0},
+		[BENCH_FEL_WRITEL] = {"fel_writel", DEVICE_MODE_FEL, 0, 0},
+		[BENCH_FES_DOWN] = {"fes_down", DEVICE_MODE_SRV, 1, 1},
+		[BENCH_FES_UP] = {"fes_up", DEVICE_MODE_SRV, 1, 1},
+		[BENCH_FES_VERIFY] = {"fes_verify", DEVICE_MODE_SRV, 1, 0},
+};
+
+struct bench_t {
+	struct sunxi_efex_ctx_t ctx;
+	uint32_t addr;   // FEL memory under test
+	uint32_t sector; // FES flash sector under test
+	unsigned int iterations;
+	int json;
+	int rows;         // results printed so far
+	uint64_t *samples; // per-iteration latency, iterations entries
+};
+
+struct bench_result_t {
+	uint64_t total_us;
+	uint64_t bytes;
+	uint64_t transfers;
+	uint64_t lat_us[6]; // min, p50, p90, p99, p999, max
+};
+
+static void print_usage(void) {
+	fprintf(stderr, "usage:\n"
+					"    efex-bench [options]                                - Benchmark the attached device\n"
+					"Runs the FEL operations on a device in FEL mode and the FES ones on a device in FES mode.\n"
+					"[options]\n"
+					"     -o ops                                              - Operations, comma separated (default all safe ones):\n"
+					"                                                           fel_read, fel_write, fel_readl, fel_writel,\n"
+					"                                                           fes_down, fes_up, fes_verify\n"
+					"     -S sizes                                            - Transfer sizes (default 4K,64K,1M)\n"
+					"     -C sizes                                            - Chunk sizes, 0 for the default (default 0)\n"
+					"     -n count                                            - Iterations per measurement (default 10)\n"
+					"     -a address                                          - FEL memory to use (default: data start address)\n"
+					"     -f sector                                           - FES flash sector to use (default 0)\n"
+					"     -w                                                  - Allow fes_down, which overwrites flash at the sector\n"
+					"     -p payloads [arm, aarch64, riscv]                   - Payloads for fel_readl/fel_writel\n"
+					"     -q depth                                            - URBs kept in flight per transfer\n"
+					"     -B backend [auto, libusb, winusb, sim]              - USB backend\n"
+					"     -P file                                             - Replay a recording instead of using a device\n"
+					"     -j                                                  - JSON output instead of CSV\n");
+}
+
+// Sizes take a K, M or G suffix
+static int parse_size(const char *s, uint64_t *out) {
+	char *end = NULL;
+	errno = 0;
+	uint64_t v = strtoull(s, &end, 0);
+	if (errno != 0 || end == s)
+		return EFEX_ERR_INVALID_PARAM;
+	switch (*end) {
+		case 'G':
+		case 'g':
+			v <<= 10;
+			/* fall through */
+		case 'M':
+		case 'm':
+			v <<= 10;
+			/* fall through */
+		case 'K':
+		case 'k':
+			v <<= 10;
+			end++;
+			break;
+		default:
+			break;
+	}
+	if (*end != '\0')
+		return EFEX_ERR_INVALID_PARAM;
+	*out = v;
+	return EFEX_ERR_SUCCESS;
+}
+
+static int parse_size_list(const char *s, uint64_t *list, size_t *count) {
+	char tmp[256];
+	if (strlen(s) >= sizeof(tmp))
+		return EFEX_ERR_INVALID_PARAM;
+	strcpy(tmp, s);
+
+	*count = 0;
+	for (char *tok = strtok(tmp, ","); tok; tok = strtok(NULL, ",")) {
+		if (*count == BENCH_MAX_LIST || parse_size(tok, &list[*count]) != EFEX_ERR_SUCCESS)
+			return EFEX_ERR_INVALID_PARAM;
+		(*count)++;
+	}
+	return *count ? EFEX_ERR_SUCCESS : EFEX_ERR_INVALID_PARAM;
+}
+
+static int parse_ops(const char *s, int *ops) {
+	char tmp[256];
+	if (strlen(s) >= sizeof(tmp))
+		return EFEX_ERR_INVALID_PARAM;
+	strcpy(tmp, s);
+
+	memset(ops, 0, sizeof(int) * BENCH_OP_COUNT);
+	for (char *tok = strtok(tmp, ","); tok; tok = strtok(NULL, ",")) {
+		int found = 0;
+		for (int i = 0; i < BENCH_OP_COUNT; i++) {
+			if (strcmp(tok, bench_ops[i].name) == 0) {
+				ops[i] = 1;
+				found = 1;
+			}
+		}
+		if (!found)
+			return EFEX_ERR_INVALID_PARAM;
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+static enum sunxi_efex_fel_payloads_arch parse_arch(const char *s) {
+	if (strcmp(s, "arm") == 0)
+		return ARCH_ARM32;
+	if (strcmp(s, "aarch64") == 0)
+		return ARCH_AARCH64;
+	if (strcmp(s, "riscv") == 0)
+		return ARCH_RISCV;
+	fprintf(stderr, "Unknown payload arch '%s', defaulting to riscv\n", s);
+	return ARCH_RISCV;
+}
+
+static int parse_backend(const char *s, enum usb_backend_type *backend) {
+	if (strcmp(s, "auto") == 0)
+		*backend = USB_BACKEND_AUTO;
+	else if (strcmp(s, "libusb") == 0)
+		*backend = USB_BACKEND_LIBUSB;
+	else if (strcmp(s, "winusb") == 0)
+		*backend = USB_BACKEND_WINUSB;
+	else if (strcmp(s, "sim") == 0)
+		*backend = USB_BACKEND_SIM;
+	else
+		return EFEX_ERR_INVALID_PARAM;
+	return EFEX_ERR_SUCCESS;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+	const uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+	return x < y ? -1 : x > y;
+}
+
+// Nearest-rank percentile of sorted samples, permille to reach p99.9
+static uint64_t percentile(const uint64_t *sorted, const unsigned int n, const unsigned int permille) {
+	size_t rank = ((size_t) n * permille + 999) / 1000;
+	if (rank == 0)
+		rank = 1;
+	return sorted[rank - 1];
+}
+
+static int bench_once(struct bench_t *b, const enum bench_op_t op, char *buf, const uint64_t size) {
+	struct sunxi_efex_ctx_t *ctx = &b->ctx;
+	uint32_t val = 0;
+	struct sunxi_fes_verify_resp_t verify = {0};
+
+	switch (op) {
+		case BENCH_FEL_READ:
+			return sunxi_efex_fel_read(ctx, b->addr, buf, (ssize_t) size);
+		case BENCH_FEL_WRITE:
+			return sunxi_efex_fel_write(ctx, b->addr, buf, (ssize_t) size);
+		case BENCH_FEL_READL:
+			return sunxi_efex_fel_payloads_readl(ctx, b->addr, &val);
+		case BENCH_FEL_WRITEL:
+			return sunxi_efex_fel_payloads_writel(ctx, 0x12345678, b->addr);
+		case BENCH_FES_DOWN:
+			return sunxi_efex_fes_down(ctx, buf, (ssize_t) size, b->sector, SUNXI_EFEX_TAG_NONE);
+		case BENCH_FES_UP:
+			return sunxi_efex_fes_up(ctx, buf, (ssize_t) size, b->sector, SUNXI_EFEX_TAG_NONE);
+		case BENCH_FES_VERIFY:
+			return sunxi_efex_fes_verify_value(ctx, b->sector, size, &verify);
+		default:
+			return EFEX_ERR_INVALID_PARAM;
+	}
+}
+
+// One warm-up run, then the timed iterations; transfers are counted from the statistics
+static int bench_measure(struct bench_t *b, const enum bench_op_t op, char *buf, const uint64_t size,
+                         struct bench_result_t *r) {
+	int ret = bench_once(b, op, buf, size);
+	if (ret != EFEX_ERR_SUCCESS)
+		return ret;
+
+	sunxi_efex_stats_reset(&b->ctx);
+	memset(r, 0, sizeof(*r));
+	for (unsigned int i = 0; i < b->iterations; i++) {
+		const uint64_t start = sunxi_efex_time_us();
+		ret = bench_once(b, op, buf, size);
+		b->samples[i] = sunxi_efex_time_us() - start;
+		if (ret != EFEX_ERR_SUCCESS)
+			return ret;
+		r->total_us += b->samples[i];
+	}
+
+	struct sunxi_efex_stats_t stats;
+	if (sunxi_efex_stats_get(&b->ctx, &stats) == EFEX_ERR_SUCCESS) {
+		for (size_t i = 0; i < SUNXI_EFEX_STATS_CMDS && stats.cmds[i].cmd; i++)
+			r->transfers += stats.cmds[i].transfers[SUNXI_EFEX_DIR_OUT] + stats.cmds[i].transfers[SUNXI_EFEX_DIR_IN];
+	}
+
+	qsort(b->samples, b->iterations, sizeof(b->samples[0]), cmp_u64);
+	static const unsigned int ranks[] = {0, 500, 900, 990, 999, 1000};
+	for (size_t i = 0; i < sizeof(ranks) / sizeof(ranks[0]); i++)
+		r->lat_us[i] = percentile(b->samples, b->iterations, ranks[i]);
+	r->bytes = (bench_ops[op].sized ? size : 4) * b->iterations;
+	return EFEX_ERR_SUCCESS;
+}
+
+static void bench_print(struct bench_t *b, const enum bench_op_t op, const uint64_t size, const uint64_t chunk,
+                        const struct bench_result_t *r, const int ret) {
+	const double mbps = r->total_us ? (double) r->bytes / (double) r->total_us : 0.0;
+	const double xfers = (double) r->transfers / (double) b->iterations;
+	const char *status = ret == EFEX_ERR_SUCCESS ? "ok" : sunxi_efex_strerror(ret);
+
+	if (b->json) {
+		printf("%s\n    {\"op\": \"%s\", \"size\": %llu, \"chunk\": %llu, \"iterations\": %u, \"status\": \"%s\", "
+		       "\"mb_per_s\": %.3f, \"lat_us\": {\"min\": %llu, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, "
+		       "\"p999\": %llu, \"max\": %llu}, \"transfers_per_op\": %.2f}",
+		       b->rows ? "," : "", bench_ops[op].name, (unsigned long long) size, (unsigned long long) chunk,
+		       b->iterations, status, mbps, (unsigned long long) r->lat_us[0], (unsigned long long) r->lat_us[1],
+		       (unsigned long long) r->lat_us[2], (unsigned long long) r->lat_us[3], (unsigned long long) r->lat_us[4],
+		       (unsigned long long) r->lat_us[5], xfers);
+	} else {
+		printf("%s,%llu,%llu,%u,%s,%.3f,%llu,%llu,%llu,%llu,%llu,%llu,%.2f\n", bench_ops[op].name,
+		       (unsigned long long) size, (unsigned long long) chunk, b->iterations, status, mbps,
+		       (unsigned long long) r->lat_us[0], (unsigned long long) r->lat_us[1], (unsigned long long) r->lat_us[2],
+		       (unsigned long long) r->lat_us[3], (unsigned long long) r->lat_us[4], (unsigned long long) r->lat_us[5],
+		       xfers);
+	}
+	fflush(stdout);
+	b->rows++;
+}
+
+// Sweeps sizes and chunk sizes of one operation; a failed measurement is reported and the sweep goes on
+static int bench_op(struct bench_t *b, const enum bench_op_t op, const uint64_t *sizes, const size_t nsizes,
+                    const uint64_t *chunks, const size_t nchunks, char *buf) {
+	const size_t ns = bench_ops[op].sized ? nsizes : 1;
+	const size_t nc = bench_ops[op].chunked ? nchunks : 1;
+	int failed = 0;
+
+	for (size_t c = 0; c < nc; c++) {
+		const uint64_t chunk = bench_ops[op].chunked ? chunks[c] : 0;
+		const int chunk_ret =
+				chunk > UINT32_MAX ? EFEX_ERR_INVALID_PARAM : sunxi_efex_set_chunk_size(&b->ctx, (uint32_t) chunk);
+		for (size_t s = 0; s < ns; s++) {
+			const uint64_t size = bench_ops[op].sized ? sizes[s] : 4;
+			struct bench_result_t r = {0};
+			const int ret = chunk_ret != EFEX_ERR_SUCCESS ? chunk_ret : bench_measure(b, op, buf, size, &r);
+			bench_print(b, op, size, chunk, &r, ret);
+			if (ret != EFEX_ERR_SUCCESS)
+				failed = 1;
+		}
+	}
+	sunxi_efex_set_chunk_size(&b->ctx, 0);
+	return failed;
+}
+
+int main(const int argc, char **argv) {
+	struct bench_t b = {0};
+	uint64_t sizes[BENCH_MAX_LIST] = {4 * 1024, 64 * 1024, 1024 * 1024};
+	uint64_t chunks[BENCH_MAX_LIST] = {0};
+	size_t nsizes = 3, nchunks = 1;
+	int ops[BENCH_OP_COUNT] = {1, 1, 1, 1, 0, 1, 1};
+	int ops_given = 0, allow_write = 0, use_payloads = 0, queue_depth = 0, has_addr = 0;
+	const char *backend_name = "auto";
+	int ret = EFEX_ERR_SUCCESS;
+
+	b.iterations = BENCH_DEFAULT_ITERATIONS;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "-j") == 0) {
+			b.json = 1;
+			continue;
+		}
+		if (strcmp(argv[i], "-w") == 0) {
+			allow_write = 1;
+			continue;
+		}
+		if (strcmp(argv[i], "-h") == 0 || i == argc - 1) {
+			print_usage();
+			return 1;
+		}
+		const char *val = argv[++i];
+		uint64_t v = 0;
+		if (strcmp(argv[i - 1], "-o") == 0) {
+			ret = parse_ops(val, ops);
+			ops_given = 1;
+		} else if (strcmp(argv[i - 1], "-S") == 0) {
+			ret = parse_size_list(val, sizes, &nsizes);
+		} else if (strcmp(argv[i - 1], "-C") == 0) {
+			ret = parse_size_list(val, chunks, &nchunks);
+		} else if (strcmp(argv[i - 1], "-n") == 0) {
+			ret = parse_size(val, &v);
+			b.iterations = (unsigned int) v;
+			if (ret == EFEX_ERR_SUCCESS && (v == 0 || v > 1000000))
+				ret = EFEX_ERR_INVALID_PARAM;
+		} else if (strcmp(argv[i - 1], "-a") == 0) {
+			ret = parse_size(val, &v);
+			b.addr = (uint32_t) v;
+			has_addr = 1;
+		} else if (strcmp(argv[i - 1], "-f") == 0) {
+			ret = parse_size(val, &v);
+			b.sector = (uint32_t) v;
+		} else if (strcmp(argv[i - 1], "-p") == 0) {
+			ret = sunxi_efex_fel_payloads_select(&b.ctx, parse_arch(val));
+			use_payloads = 1;
+		} else if (strcmp(argv[i - 1], "-q") == 0) {
+			queue_depth = atoi(val);
+		} else if (strcmp(argv[i - 1], "-B") == 0) {
+			enum usb_backend_type backend;
+			ret = parse_backend(val, &backend);
+			if (ret == EFEX_ERR_SUCCESS)
+				ret = sunxi_usb_set_backend(&b.ctx, backend);
+			backend_name = val;
+		} else if (strcmp(argv[i - 1], "-P") == 0) {
+			ret = sunxi_usb_replay_configure(val, SUNXI_EFEX_REPLAY_FAST);
+			if (ret == EFEX_ERR_SUCCESS)
+				ret = sunxi_usb_set_backend(&b.ctx, USB_BACKEND_REPLAY);
+			backend_name = "replay";
+		} else {
+			ret = EFEX_ERR_INVALID_PARAM;
+		}
+		if (ret != EFEX_ERR_SUCCESS) {
+			fprintf(stderr, "ERROR: %s: %s %s\n", sunxi_efex_strerror(ret), argv[i - 1], val);
+			return 1;
+		}
+	}
+	if (ops[BENCH_FES_DOWN] && !allow_write) {
+		fprintf(stderr, "ERROR: fes_down overwrites flash, pass -w to allow it\n");
+		return 1;
+	}
+	if (!ops_given)
+		ops[BENCH_FES_DOWN] = allow_write;
+
+	ret = sunxi_scan_usb_device(&b.ctx);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_usb_init(&b.ctx);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_usb_set_queue_depth(&b.ctx, queue_depth);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_init(&b.ctx);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_stats_enable(&b.ctx, 1);
+	if (ret != EFEX_ERR_SUCCESS) {
+		fprintf(stderr, "ERROR: %s\n", sunxi_efex_strerror(ret));
+		sunxi_usb_exit(&b.ctx);
+		return 2;
+	}
+	if (!has_addr)
+		b.addr = b.ctx.resp.data_start_address;
+
+	uint64_t max_size = 4;
+	for (size_t i = 0; i < nsizes; i++)
+		max_size = sizes[i] > max_size ? sizes[i] : max_size;
+	char *buf = max_size <= SIZE_MAX ? sunxi_efex_buffer_alloc(&b.ctx, (size_t) max_size) : NULL;
+	b.samples = calloc(b.iterations, sizeof(*b.samples));
+	if (!buf || !b.samples) {
+		fprintf(stderr, "ERROR: %s\n", sunxi_efex_strerror(EFEX_ERR_MEMORY));
+		sunxi_efex_buffer_free(&b.ctx, buf);
+		free(b.samples);
+		sunxi_usb_exit(&b.ctx);
+		return 3;
+	}
+	for (uint64_t i = 0; i < max_size; i++)
+		buf[i] = (char) (i * 131 + 7);
+
+	if (b.json) {
+		printf("{\"chip_id\": \"0x%08x\", \"mode\": \"0x%04x\", \"backend\": \"%s\", \"results\": [",
+		       b.ctx.resp.id, b.ctx.resp.mode, backend_name);
+	} else {
+		printf("op,size,chunk,iterations,status,mb_per_s,lat_min_us,lat_p50_us,lat_p90_us,lat_p99_us,lat_p999_us,"
+		       "lat_max_us,transfers_per_op\n");
+	}
+
+	int failed = 0;
+	for (int op = 0; op < BENCH_OP_COUNT; op++) {
+		if (!ops[op] || bench_ops[op].mode != b.ctx.resp.mode)
+			continue;
+		if ((op == BENCH_FEL_READL || op == BENCH_FEL_WRITEL) && !use_payloads) {
+			if (ops_given)
+				fprintf(stderr, "Skipping %s: select payloads with -p\n", bench_ops[op].name);
+			continue;
+		}
+		failed |= bench_op(&b, (enum bench_op_t) op, sizes, nsizes, chunks, nchunks, buf);
+	}
+
+	if (b.json)
+		printf("\n]}\n");
+	if (b.rows == 0)
+		fprintf(stderr, "No selected operation applies to a device in mode 0x%04x\n", b.ctx.resp.mode);
+
+	sunxi_efex_buffer_free(&b.ctx, buf);
+	free(b.samples);
+	sunxi_usb_exit(&b.ctx);
+	return failed ? 5 : 0;
+}
@@ -109,18 +109,72 @@ static void print_usage(void) {
 					"    efex read <address> <length> <file>                 - Read memory to file\n"
 					"    efex write <address> <file>                         - Write file to memory\n"
 					"    efex exec <address>                                 - Call function address\n"
+					"    efex fill <address> <length> <byte>                 - Fill memory on the device CPU (needs -p)\n"
+					"    efex copy <dst> <src> <length>                      - Copy memory on the device CPU (needs -p)\n"
+					"    efex crc <address> <length>                         - CRC32 of memory on the device CPU (needs -p)\n"
 					"[options]\n"
-					"     -p payloads [arm, aarch64, e907]\n");
+					"     -p payloads [arm, aarch64, e907]\n"
+					"     -q depth                                            - URBs kept in flight per transfer\n"
+					"     -c size|auto                                        - Bytes per transaction, or auto-tune\n"
+					"     -t ms                                               - Base timeout per transfer\n"
+					"     -r retries                                          - Retries per failed chunk\n"
+					"     -s                                                  - Print transfer statistics\n"
+					"     -V                                                  - Verify writes with a device-side CRC32\n"
+					"     -T file                                             - Write a transfer trace (.json: Chrome trace)\n"
+					"     -B backend [auto, libusb, winusb, sim]              - USB backend, sim for a simulated device\n"
+					"     -R file                                             - Record all transfers to a file\n"
+					"     -P file                                             - Replay a recording instead of using a device\n"
+					"     -S format [holes, simg]                             - Sparse read: zero blocks as file holes,\n"
+					"                                                           or an Android sparse image\n"
+					"     -M file                                             - Write the block map of a read\n");
+}
+
+static void print_stats(const struct sunxi_efex_ctx_t *ctx) {
+	static const char *phases[SUNXI_EFEX_PHASE_COUNT] = {"request", "data", "status"};
+	struct sunxi_efex_stats_t stats;
+	if (sunxi_efex_stats_get(ctx, &stats) != EFEX_ERR_SUCCESS)
+		return;
+
+	fprintf(stderr, "%-8s %8s %10s %14s %10s %14s\n", "cmd", "issued", "xfers out", "bytes out", "xfers in",
+	        "bytes in");
+	for (size_t i = 0; i < SUNXI_EFEX_STATS_CMDS && stats.cmds[i].cmd; i++) {
+		const struct sunxi_efex_cmd_stats_t *c = &stats.cmds[i];
+		fprintf(stderr, "0x%04x   %8llu %10llu %14llu %10llu %14llu\n", c->cmd, (unsigned long long) c->issued,
+		        (unsigned long long) c->transfers[SUNXI_EFEX_DIR_OUT], (unsigned long long) c->bytes[SUNXI_EFEX_DIR_OUT],
+		        (unsigned long long) c->transfers[SUNXI_EFEX_DIR_IN], (unsigned long long) c->bytes[SUNXI_EFEX_DIR_IN]);
+	}
+
+	fprintf(stderr, "%-8s %8s %10s %10s %10s %10s %10s\n", "phase", "count", "total ms", "avg us", "p50 us",
+	        "p99 us", "max us");
+	for (int i = 0; i < SUNXI_EFEX_PHASE_COUNT; i++) {
+		const struct sunxi_efex_histogram_t *h = &stats.phases[i];
+		fprintf(stderr, "%-8s %8llu %10.1f %10llu %10llu %10llu %10llu\n", phases[i], (unsigned long long) h->count,
+		        (double) h->total_us / 1000.0, (unsigned long long) (h->count ? h->total_us / h->count : 0),
+		        (unsigned long long) sunxi_efex_histogram_percentile(h, 50),
+		        (unsigned long long) sunxi_efex_histogram_percentile(h, 99), (unsigned long long) h->max_us);
+	}
+	fprintf(stderr, "retries %llu, timeouts %llu, errors %llu\n", (unsigned long long) stats.retries,
+	        (unsigned long long) stats.timeouts, (unsigned long long) stats.errors);
+}
+
+static void write_trace(const struct sunxi_efex_ctx_t *ctx, const char *path) {
+	const size_t n = strlen(path);
+	const enum sunxi_efex_trace_format_t format =
+			n > 5 && strcmp(path + n - 5, ".json") == 0 ? SUNXI_EFEX_TRACE_CHROME : SUNXI_EFEX_TRACE_BINARY;
+	const int ret = sunxi_efex_trace_export(ctx, path, format);
+	if (ret != EFEX_ERR_SUCCESS)
+		fprintf(stderr, "ERROR: Failed to write trace: %s\n", sunxi_efex_strerror(ret));
 }
 
 static int parse_u32(const char *s, uint32_t *out) {
 	if (!s)
 		return EFEX_ERR_INVALID_PARAM;
 	errno = 0;
-	const unsigned long long v = strtoull(s, NULL, 0); // auto-detect base (0x for hex)
-	if (errno != 0)
+	char *end = NULL;
+	const unsigned long long v = strtoull(s, &end, 0); // auto-detect base (0x for hex)
+	if (errno != 0 || end == s || *end != '\0')
 		return EFEX_ERR_INVALID_PARAM;
-	if (v > 0xFFFFFFFFULL)
+	if (v > 0xFFFFFFFFULL || strchr(s, '-'))
 		return EFEX_ERR_INVALID_PARAM;
 	*out = (uint32_t) v;
 	return EFEX_ERR_SUCCESS;
@@ -172,6 +226,30 @@ static enum sunxi_efex_fel_payloads_arch parse_arch(const char *s) {
 	return ARCH_RISCV;
 }
 
+static int parse_backend(const char *s, enum usb_backend_type *backend) {
+	if (strcmp(s, "auto") == 0)
+		*backend = USB_BACKEND_AUTO;
+	else if (strcmp(s, "libusb") == 0)
+		*backend = USB_BACKEND_LIBUSB;
+	else if (strcmp(s, "winusb") == 0)
+		*backend = USB_BACKEND_WINUSB;
+	else if (strcmp(s, "sim") == 0)
+		*backend = USB_BACKEND_SIM;
+	else
+		return EFEX_ERR_INVALID_PARAM;
+	return EFEX_ERR_SUCCESS;
+}
+
+static int parse_sparse(const char *s, enum sunxi_efex_sparse_format_t *format) {
+	if (strcmp(s, "holes") == 0)
+		*format = SUNXI_EFEX_SPARSE_HOLES;
+	else if (strcmp(s, "simg") == 0)
+		*format = SUNXI_EFEX_SPARSE_SIMG;
+	else
+		return EFEX_ERR_INVALID_PARAM;
+	return EFEX_ERR_SUCCESS;
+}
+
 int main(const int argc, char **argv) {
 	if (argc < 2) {
 		print_usage();
@@ -186,24 +264,96 @@ int main(const int argc, char **argv) {
 		return 1;
 	}
 
+	// Setup context and device
+	struct sunxi_efex_ctx_t ctx = {0};
+	int ret = EFEX_ERR_SUCCESS;
+
 	int use_payloads = 0;
-	for (int i = 1; i < argc - 1; ++i) {
+	int queue_depth = 0;
+	const char *chunk_arg = NULL;
+	struct sunxi_efex_policy_t policy;
+	int use_policy = 0;
+	int use_stats = 0;
+	int use_verify = 0;
+	const char *trace_path = NULL;
+	struct sunxi_efex_recorder_t *recorder = NULL;
+	enum sunxi_efex_sparse_format_t sparse_format = SUNXI_EFEX_SPARSE_HOLES;
+	int use_sparse = 0;
+	const char *map_path = NULL;
+	sunxi_efex_policy_init(&policy);
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "-s") == 0) {
+			use_stats = 1;
+			continue;
+		}
+		if (strcmp(argv[i], "-V") == 0) {
+			use_verify = 1;
+			continue;
+		}
+		// Every other option takes a value
+		if (i == argc - 1)
+			break;
 		if (strcmp(argv[i], "-p") == 0) {
 			use_payloads = 1;
 			arch = parse_arch(argv[i + 1]);
-			// Init payloads per selection
-			int ret = sunxi_efex_fel_payloads_init(arch);
+			// Payloads are chosen per context
+			ret = sunxi_efex_fel_payloads_select(&ctx, arch);
 			if (ret != EFEX_ERR_SUCCESS) {
 				fprintf(stderr, "ERROR: Failed to initialize payloads: %s\n", sunxi_efex_strerror(ret));
 				return 1;
 			}
+		} else if (strcmp(argv[i], "-q") == 0) {
+			uint32_t depth = 0;
+			if (parse_u32(argv[i + 1], &depth) != EFEX_ERR_SUCCESS || depth > SUNXI_USB_MAX_QUEUE_DEPTH) {
+				fprintf(stderr, "ERROR: Invalid queue depth '%s'\n", argv[i + 1]);
+				return 1;
+			}
+			queue_depth = (int) depth;
+		} else if (strcmp(argv[i], "-c") == 0) {
+			chunk_arg = argv[i + 1];
+		} else if (strcmp(argv[i], "-t") == 0) {
+			policy.timeout_ms = (uint32_t) strtoul(argv[i + 1], NULL, 0);
+			use_policy = 1;
+		} else if (strcmp(argv[i], "-r") == 0) {
+			policy.max_retries = (uint32_t) strtoul(argv[i + 1], NULL, 0);
+			use_policy = 1;
+		} else if (strcmp(argv[i], "-T") == 0) {
+			trace_path = argv[i + 1];
+		} else if (strcmp(argv[i], "-B") == 0) {
+			enum usb_backend_type backend;
+			ret = parse_backend(argv[i + 1], &backend);
+			if (ret == EFEX_ERR_SUCCESS)
+				ret = sunxi_usb_set_backend(&ctx, backend);
+			if (ret != EFEX_ERR_SUCCESS) {
+				fprintf(stderr, "ERROR: Unsupported backend '%s'\n", argv[i + 1]);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "-S") == 0) {
+			if (parse_sparse(argv[i + 1], &sparse_format) != EFEX_ERR_SUCCESS) {
+				fprintf(stderr, "ERROR: Unsupported sparse format '%s'\n", argv[i + 1]);
+				return 1;
+			}
+			use_sparse = 1;
+		} else if (strcmp(argv[i], "-M") == 0) {
+			map_path = argv[i + 1];
+		} else if (strcmp(argv[i], "-R") == 0) {
+			ret = sunxi_efex_record_open(argv[i + 1], 0, &recorder);
+			if (ret != EFEX_ERR_SUCCESS) {
+				fprintf(stderr, "ERROR: %s: %s\n", sunxi_efex_strerror(ret), argv[i + 1]);
+				return 1;
+			}
+			sunxi_efex_record_attach(&ctx, recorder);
+		} else if (strcmp(argv[i], "-P") == 0) {
+			ret = sunxi_usb_replay_configure(argv[i + 1], SUNXI_EFEX_REPLAY_FAST);
+			if (ret == EFEX_ERR_SUCCESS)
+				ret = sunxi_usb_set_backend(&ctx, USB_BACKEND_REPLAY);
+			if (ret != EFEX_ERR_SUCCESS) {
+				fprintf(stderr, "ERROR: %s: %s\n", sunxi_efex_strerror(ret), argv[i + 1]);
+				return 1;
+			}
 		}
 	}
 
-	// Setup context and device
-	struct sunxi_efex_ctx_t ctx = {0};
-	int ret = EFEX_ERR_SUCCESS;
-
 	ret = sunxi_scan_usb_device(&ctx);
 	if (ret != EFEX_ERR_SUCCESS) {
 		fprintf(stderr, "ERROR: %s\n", sunxi_efex_strerror(ret));
@@ -217,6 +367,22 @@ int main(const int argc, char **argv) {
 		return 3;
 	}
 
+	ret = sunxi_usb_set_queue_depth(&ctx, queue_depth);
+	if (ret != EFEX_ERR_SUCCESS) {
+		fprintf(stderr, "ERROR: Invalid queue depth: %s\n", sunxi_efex_strerror(ret));
+		sunxi_usb_exit(&ctx);
+		return 1;
+	}
+
+	if (use_policy)
+		sunxi_efex_set_policy(&ctx, &policy);
+	if (use_stats)
+		sunxi_efex_stats_enable(&ctx, 1);
+	if (use_verify)
+		sunxi_efex_fel_set_verify(&ctx, 1);
+	if (trace_path)
+		sunxi_efex_trace_enable(&ctx, 1 << 16, 16);
+
 	ret = sunxi_efex_init(&ctx);
 	if (ret != EFEX_ERR_SUCCESS) {
 		fprintf(stderr, "ERROR: %s\n", sunxi_efex_strerror(ret));
@@ -224,6 +390,23 @@ int main(const int argc, char **argv) {
 		return 4;
 	}
 
+	if (chunk_arg) {
+		size_t chunk_size = 0;
+		if (strcmp(chunk_arg, "auto") == 0) {
+			ret = sunxi_efex_set_chunk_auto(&ctx, 1);
+		} else {
+			ret = parse_size(chunk_arg, &chunk_size);
+			if (ret == EFEX_ERR_SUCCESS)
+				ret = chunk_size > UINT32_MAX ? EFEX_ERR_INVALID_PARAM
+				                              : sunxi_efex_set_chunk_size(&ctx, (uint32_t) chunk_size);
+		}
+		if (ret != EFEX_ERR_SUCCESS) {
+			fprintf(stderr, "ERROR: Invalid chunk size: %s\n", sunxi_efex_strerror(ret));
+			sunxi_usb_exit(&ctx);
+			return 1;
+		}
+	}
+
 	int exit_code = 0;
 
 	const char *cmd = argv[1];
@@ -255,7 +438,7 @@ int main(const int argc, char **argv) {
 			goto cleanup;
 		}
 		const size_t chunk = 4096;
-		unsigned char *buf = (unsigned char *) malloc(chunk);
+		unsigned char *buf = (unsigned char *) sunxi_efex_buffer_alloc(&ctx, chunk);
 		if (!buf) {
 			fprintf(stderr, "ERROR: %s\n", sunxi_efex_strerror(EFEX_ERR_MEMORY));
 			exit_code = 1;
@@ -269,7 +452,7 @@ int main(const int argc, char **argv) {
 			ret = sunxi_efex_fel_read(&ctx, cur, (char *) buf, (ssize_t) n);
 			if (ret != EFEX_ERR_SUCCESS) {
 				fprintf(stderr, "ERROR: %s\n", sunxi_efex_strerror(ret));
-				free(buf);
+				sunxi_efex_buffer_free(&ctx, buf);
 				exit_code = 5;
 				goto cleanup;
 			}
@@ -277,7 +460,7 @@ int main(const int argc, char **argv) {
 			cur += (uint32_t) n;
 			remaining -= n;
 		}
-		free(buf);
+		sunxi_efex_buffer_free(&ctx, buf);
 	} else if (strcmp(cmd, "dump") == 0) {
 		if (argc < 4) {
 			print_usage();
@@ -302,7 +485,7 @@ int main(const int argc, char **argv) {
 		_setmode(_fileno(stdout), _O_BINARY);
 #endif
 		const size_t chunk = 65536;
-		unsigned char *buf = (unsigned char *) malloc(chunk);
+		unsigned char *buf = (unsigned char *) sunxi_efex_buffer_alloc(&ctx, chunk);
 		if (!buf) {
 			fprintf(stderr, "ERROR: %s\n", sunxi_efex_strerror(EFEX_ERR_MEMORY));
 			exit_code = 1;
@@ -315,7 +498,7 @@ int main(const int argc, char **argv) {
 			ret = sunxi_efex_fel_read(&ctx, cur, (char *) buf, (ssize_t) n);
 			if (ret != EFEX_ERR_SUCCESS) {
 				fprintf(stderr, "ERROR: %s\n", sunxi_efex_strerror(ret));
-				free(buf);
+				sunxi_efex_buffer_free(&ctx, buf);
 				exit_code = 5;
 				goto cleanup;
 			}
@@ -323,7 +506,7 @@ int main(const int argc, char **argv) {
 			cur += (uint32_t) n;
 			remaining -= n;
 		}
-		free(buf);
+		sunxi_efex_buffer_free(&ctx, buf);
 	} else if (strcmp(cmd, "read32") == 0) {
 		if (argc < 3) {
 			print_usage();
@@ -403,42 +586,43 @@ int main(const int argc, char **argv) {
 			goto cleanup;
 		}
 		const char *file = argv[4];
-		FILE *fp = fopen(file, "wb");
-		if (!fp) {
-			fprintf(stderr, "ERROR: %s: '%s'\n", sunxi_efex_strerror(EFEX_ERR_FILE_OPEN), file);
-			exit_code = 1;
-			goto cleanup;
-		}
-		const size_t chunk = 65536;
-		unsigned char *buf = (unsigned char *) malloc(chunk);
-		if (!buf) {
-			fprintf(stderr, "ERROR: %s\n", sunxi_efex_strerror(EFEX_ERR_MEMORY));
-			fclose(fp);
-			exit_code = 1;
-			goto cleanup;
-		}
-		size_t remaining = length;
-		uint32_t cur = addr;
-		progress_start(length);
-		while (remaining > 0) {
-			size_t n = remaining < chunk ? remaining : chunk;
-			progress_update(n);
-			// payloads version only has readl/writel, no read/write functions
-			ret = sunxi_efex_fel_read(&ctx, cur, (char *) buf, (ssize_t) n);
+		int close_ret;
+		if (use_sparse || map_path) {
+			// Uniform blocks become holes or FILL chunks rather than data
+			struct sunxi_efex_sparse_sink_t *sparse = malloc(sizeof(*sparse));
+			ret = sparse ? sunxi_efex_sparse_sink_open(sparse, file, sparse_format, map_path) : EFEX_ERR_MEMORY;
 			if (ret != EFEX_ERR_SUCCESS) {
-				fprintf(stderr, "ERROR: %s\n", sunxi_efex_strerror(ret));
-				free(buf);
-				fclose(fp);
-				exit_code = 5;
+				fprintf(stderr, "ERROR: %s: '%s'\n", sunxi_efex_strerror(ret), file);
+				free(sparse);
+				exit_code = 1;
 				goto cleanup;
 			}
-			fwrite(buf, 1, n, fp);
-			cur += (uint32_t) n;
-			remaining -= n;
+			progress_start(length);
+			ret = sunxi_efex_fel_read_stream(&ctx, addr, length, sunxi_efex_sparse_sink_write, sparse,
+			                                 progress_update);
+			close_ret = sunxi_efex_sparse_sink_close(sparse);
+			free(sparse);
+		} else {
+			// The file is written on a separate thread while the next chunks are read
+			struct sunxi_efex_file_sink_t sink;
+			ret = sunxi_efex_file_sink_open(&sink, file, 0);
+			if (ret != EFEX_ERR_SUCCESS) {
+				fprintf(stderr, "ERROR: %s: '%s'\n", sunxi_efex_strerror(ret), file);
+				exit_code = 1;
+				goto cleanup;
+			}
+			progress_start(length);
+			ret = sunxi_efex_fel_read_stream(&ctx, addr, length, sunxi_efex_file_sink_write, &sink, progress_update);
+			close_ret = sunxi_efex_file_sink_close(&sink);
+		}
+		if (ret == EFEX_ERR_SUCCESS)
+			ret = close_ret;
+		if (ret != EFEX_ERR_SUCCESS) {
+			fprintf(stderr, "ERROR: %s\n", sunxi_efex_strerror(ret));
+			exit_code = 5;
+			goto cleanup;
 		}
 		progress_stop();
-		free(buf);
-		fclose(fp);
 	} else if (strcmp(cmd, "write") == 0) {
 		if (argc < 4) {
 			print_usage();
@@ -453,49 +637,27 @@ int main(const int argc, char **argv) {
 			exit_code = 1;
 			goto cleanup;
 		}
-		FILE *fp = fopen(file, "rb");
-		if (!fp) {
-			fprintf(stderr, "ERROR: %s: '%s'\n", sunxi_efex_strerror(EFEX_ERR_FILE_OPEN), file);
-			exit_code = 1;
-			goto cleanup;
+		// Sent straight from the mapped file, no copy through a read buffer
+		struct sunxi_efex_image_t img;
+		ret = sunxi_efex_image_open(&img, file);
+		if (ret == EFEX_ERR_SUCCESS && img.size > UINT32_MAX) {
+			sunxi_efex_image_close(&img);
+			ret = EFEX_ERR_FILE_SIZE;
 		}
-		// Get file size
-		fseek(fp, 0, SEEK_END);
-		const long file_size = ftell(fp);
-		fseek(fp, 0, SEEK_SET);
-		if (file_size <= 0) {
-			fprintf(stderr, "ERROR: %s: '%s'\n", sunxi_efex_strerror(EFEX_ERR_FILE_SIZE), file);
-			fclose(fp);
+		if (ret != EFEX_ERR_SUCCESS) {
+			fprintf(stderr, "ERROR: %s: '%s'\n", sunxi_efex_strerror(ret), file);
 			exit_code = 1;
 			goto cleanup;
 		}
-		const size_t chunk = 65536;
-		unsigned char *buf = (unsigned char *) malloc(chunk);
-		if (!buf) {
-			fprintf(stderr, "ERROR: %s\n", sunxi_efex_strerror(EFEX_ERR_MEMORY));
-			fclose(fp);
-			exit_code = 1;
+		progress_start((ssize_t) img.size);
+		ret = sunxi_efex_fel_write_cb(&ctx, addr, img.data, (ssize_t) img.size, progress_update);
+		sunxi_efex_image_close(&img);
+		if (ret != EFEX_ERR_SUCCESS) {
+			fprintf(stderr, "ERROR: %s\n", sunxi_efex_strerror(ret));
+			exit_code = 5;
 			goto cleanup;
 		}
-		size_t offset = 0;
-		size_t nread;
-		progress_start(file_size);
-		while ((nread = fread(buf, 1, chunk, fp)) > 0) {
-			progress_update(nread);
-			// payloads version only has readl/writel, no read/write functions
-			ret = sunxi_efex_fel_write(&ctx, addr + (uint32_t) offset, (const char *) buf, (ssize_t) nread);
-			if (ret != EFEX_ERR_SUCCESS) {
-				fprintf(stderr, "ERROR: %s\n", sunxi_efex_strerror(ret));
-				free(buf);
-				fclose(fp);
-				exit_code = 5;
-				goto cleanup;
-			}
-			offset += nread;
-		}
 		progress_stop();
-		free(buf);
-		fclose(fp);
 	} else if (strcmp(cmd, "exec") == 0) {
 		if (argc < 3) {
 			print_usage();
@@ -516,13 +678,76 @@ int main(const int argc, char **argv) {
 			exit_code = 5;
 			goto cleanup;
 		}
-	} else {
+	} else if (strcmp(cmd, "fill") == 0 || strcmp(cmd, "copy") == 0) {
+		if (argc < 5) {
+			print_usage();
+			exit_code = 1;
+			goto cleanup;
+		}
+		uint32_t args[3] = {0};
+		for (int i = 0; i < 3; i++) {
+			const int parse_ret = parse_u32(argv[2 + i], &args[i]);
+			if (parse_ret != EFEX_ERR_SUCCESS) {
+				fprintf(stderr, "Invalid argument '%s': %s\n", argv[2 + i], sunxi_efex_strerror(parse_ret));
+				exit_code = 1;
+				goto cleanup;
+			}
+		}
+		// Runs on the device, only the payload crosses USB
+		if (strcmp(cmd, "fill") == 0) {
+			ret = sunxi_efex_fel_memset(&ctx, args[0], (uint8_t) args[2], args[1]);
+		} else {
+			ret = sunxi_efex_fel_memcpy(&ctx, args[0], args[1], args[2]);
+		}
+		if (ret != EFEX_ERR_SUCCESS) {
+			fprintf(stderr, "ERROR: %s\n", sunxi_efex_strerror(ret));
+			exit_code = 5;
+			goto cleanup;
+		}
+	} else if (strcmp(cmd, "crc") == 0) {
+		if (argc < 4) {
+			print_usage();
+			exit_code = 1;
+			goto cleanup;
+		}
+		uint32_t args[2] = {0};
+		for (int i = 0; i < 2; i++) {
+			const int parse_ret = parse_u32(argv[2 + i], &args[i]);
+			if (parse_ret != EFEX_ERR_SUCCESS) {
+				fprintf(stderr, "Invalid argument '%s': %s\n", argv[2 + i], sunxi_efex_strerror(parse_ret));
+				exit_code = 1;
+				goto cleanup;
+			}
+		}
+		uint32_t crc = 0;
+		ret = sunxi_efex_fel_crc32(&ctx, args[0], args[1], &crc);
+		if (ret != EFEX_ERR_SUCCESS) {
+			fprintf(stderr, "ERROR: %s\n", sunxi_efex_strerror(ret));
+			exit_code = 5;
+			goto cleanup;
+		}
+		printf("0x%08x\n", crc);
+} else {
 		print_usage();
 		exit_code = 1;
 	}
 
 cleanup:
+	if (use_stats)
+		print_stats(&ctx);
+	if (trace_path)
+		write_trace(&ctx, trace_path);
+	if (use_policy && policy.stats.retries)
+		fprintf(stderr, "Retried %llu chunk(s): %llu recovered, %llu failed, %llu timeout(s)\n",
+		        (unsigned long long) policy.stats.retries, (unsigned long long) policy.stats.recovered,
+		        (unsigned long long) policy.stats.failed, (unsigned long long) policy.stats.timeouts);
 	sunxi_usb_exit(&ctx);
+	if (recorder) {
+		sunxi_efex_record_attach(&ctx, NULL);
+		ret = sunxi_efex_record_close(recorder);
+		if (ret != EFEX_ERR_SUCCESS)
+			fprintf(stderr, "ERROR: Recording incomplete: %s\n", sunxi_efex_strerror(ret));
+	}
 	if (progress)
 		free(progress);
 	return exit_code;
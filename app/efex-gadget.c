@@ -0,0 +1,291 @@
+/*
+ * efex-gadget: a FunctionFS gadget that behaves like a Sunxi device in FEL or FES mode, backed by
+ * the simulated device model. Bound to dummy_hcd it enumerates as 1f3a:efe8 on the local machine,
+ * so efex-cli, fes_flash and the libusb backend run unmodified over the real kernel USB stack.
+ *
+ * Setup, as root (the UDC is bound once the gadget has written its descriptors):
+ *
+ *   modprobe dummy_hcd && modprobe libcomposite
+ *   cd /sys/kernel/config/usb_gadget && mkdir efex && cd efex
+ *   echo 0x1f3a > idVendor && echo 0xefe8 > idProduct
+ *   mkdir configs/c.1 functions/ffs.efex && ln -s functions/ffs.efex configs/c.1/
+ *   mkdir -p /dev/ffs-efex && mount -t functionfs efex /dev/ffs-efex
+ *   efex-gadget /dev/ffs-efex &
+ *   echo dummy_udc.0 > UDC
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <linux/usb/ch9.h>
+#include <linux/usb/functionfs.h>
+
+#include "efex-common.h"
+#include "efex-sim.h"
+#include "efex-thread.h"
+#include "ending.h"
+#include "libefex.h"
+
+#define GADGET_MAX_XFER (1024 * 1024)
+#define GADGET_DRAM_BASE (0x40000000)
+#define GADGET_INTERFACE "EFEX"
+
+struct gadget_descs {
+	struct usb_interface_descriptor intf;
+	struct usb_endpoint_descriptor_no_audio sink;
+	struct usb_endpoint_descriptor_no_audio source;
+} __attribute__((packed));
+
+#define GADGET_DESCS(max_packet)                                                                                       \
+	{                                                                                                                  \
+		.intf = {                                                                                                      \
+				.bLength = sizeof(struct usb_interface_descriptor),                                                    \
+				.bDescriptorType = USB_DT_INTERFACE,                                                                   \
+				.bNumEndpoints = 2,                                                                                    \
+				.bInterfaceClass = USB_CLASS_VENDOR_SPEC,                                                              \
+				.bInterfaceSubClass = 0xff,                                                                            \
+				.bInterfaceProtocol = 0xff,                                                                            \
+				.iInterface = 1,                                                                                       \
+		},                                                                                                             \
+		.sink = {                                                                                                      \
+				.bLength = USB_DT_ENDPOINT_SIZE,                                                                       \
+				.bDescriptorType = USB_DT_ENDPOINT,                                                                    \
+				.bEndpointAddress = 1 | USB_DIR_OUT,                                                                   \
+				.bmAttributes = USB_ENDPOINT_XFER_BULK,                                                                \
+				.wMaxPacketSize = cpu_to_le16(max_packet),                                                             \
+		},                                                                                                             \
+		.source = {                                                                                                    \
+				.bLength = USB_DT_ENDPOINT_SIZE,                                                                       \
+				.bDescriptorType = USB_DT_ENDPOINT,                                                                    \
+				.bEndpointAddress = 2 | USB_DIR_IN,                                                                    \
+				.bmAttributes = USB_ENDPOINT_XFER_BULK,                                                                \
+				.wMaxPacketSize = cpu_to_le16(max_packet),                                                             \
+		},                                                                                                             \
+	}
+
+static const struct {
+	struct usb_functionfs_descs_head_v2 header;
+	__le32 fs_count;
+	__le32 hs_count;
+	struct gadget_descs fs;
+	struct gadget_descs hs;
+} __attribute__((packed)) descriptors = {
+		.header = {
+				.magic = cpu_to_le32(FUNCTIONFS_DESCRIPTORS_MAGIC_V2),
+				.length = cpu_to_le32(sizeof(descriptors)),
+				.flags = cpu_to_le32(FUNCTIONFS_HAS_FS_DESC | FUNCTIONFS_HAS_HS_DESC),
+		},
+		.fs_count = cpu_to_le32(3),
+		.hs_count = cpu_to_le32(3),
+		.fs = GADGET_DESCS(64),
+		.hs = GADGET_DESCS(512),
+};
+
+static const struct {
+	struct usb_functionfs_strings_head header;
+	struct {
+		__le16 code;
+		const char str[sizeof(GADGET_INTERFACE)];
+	} __attribute__((packed)) lang0;
+} __attribute__((packed)) strings = {
+		.header = {
+				.magic = cpu_to_le32(FUNCTIONFS_STRINGS_MAGIC),
+				.length = cpu_to_le32(sizeof(strings)),
+				.str_count = cpu_to_le32(1),
+				.lang_count = cpu_to_le32(1),
+		},
+		.lang0 = {cpu_to_le16(0x0409), GADGET_INTERFACE},
+};
+
+static volatile sig_atomic_t gadget_stop;
+static sunxi_efex_atomic_t gadget_enabled;
+
+static void gadget_signal(int sig) {
+	(void) sig;
+	gadget_stop = 1;
+}
+
+static void print_usage(void) {
+	fprintf(stderr, "usage:\n"
+					"    efex-gadget [options] <functionfs mount point>\n"
+					"[options]\n"
+					"     -m fel|fes                                          - Mode the device starts in (default fel)\n"
+					"     -f file                                             - Flash image file, created if missing\n"
+					"     -s size                                             - Flash size in bytes\n"
+					"     -c id                                               - Chip ID reported to the host\n"
+					"Executing code at or above 0x40000000 (DRAM) switches the device to FES mode.\n");
+}
+
+// FES1 runs from SRAM and returns to FEL; what gets run from DRAM is U-Boot, which comes up in FES
+static int gadget_exec(struct sunxi_efex_sim_t *sim, const uint32_t addr, void *arg) {
+	(void) arg;
+	if (addr >= GADGET_DRAM_BASE) {
+		printf("Exec 0x%08x: switching to FES mode\n", addr);
+		sunxi_efex_sim_set_mode(sim, DEVICE_MODE_SRV);
+	} else {
+		printf("Exec 0x%08x\n", addr);
+	}
+	return 0;
+}
+
+static int gadget_open_ep(const char *dir, const char *name) {
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	const int fd = open(path, O_RDWR);
+	if (fd < 0)
+		fprintf(stderr, "ERROR: %s: %s\n", path, strerror(errno));
+	return fd;
+}
+
+// ep0 carries the function's lifecycle; class requests are not part of the protocol and get stalled
+static void *gadget_ep0_thread(void *arg) {
+	const int ep0 = *(const int *) arg;
+	struct usb_functionfs_event events[4];
+
+	for (;;) {
+		const ssize_t n = read(ep0, events, sizeof(events));
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "ERROR: ep0: %s\n", strerror(errno));
+			return NULL;
+		}
+		for (size_t i = 0; i < (size_t) n / sizeof(events[0]); i++) {
+			switch (events[i].type) {
+				case FUNCTIONFS_ENABLE:
+					printf("Host connected\n");
+					sunxi_efex_atomic_store(&gadget_enabled, 1);
+					break;
+				case FUNCTIONFS_DISABLE:
+				case FUNCTIONFS_UNBIND:
+				case FUNCTIONFS_SUSPEND:
+					sunxi_efex_atomic_store(&gadget_enabled, 0);
+					break;
+				case FUNCTIONFS_SETUP:
+					if (events[i].u.setup.bRequestType & USB_DIR_IN)
+						(void) !write(ep0, NULL, 0);
+					else
+						(void) !read(ep0, NULL, 0);
+					break;
+				default:
+					break;
+			}
+		}
+	}
+}
+
+// Moves whatever the device model is ready for; a failed transfer drops the transaction as a stall would
+static int gadget_serve(struct sunxi_efex_sim_t *sim, const int ep_out, const int ep_in, char *buf) {
+	int in;
+	size_t n = sunxi_efex_sim_next(sim, &in);
+	if (n > GADGET_MAX_XFER)
+		n = GADGET_MAX_XFER;
+
+	if (in) {
+		if (sunxi_efex_sim_in(sim, buf, n) != EFEX_ERR_SUCCESS)
+			return -1;
+		return write(ep_in, buf, n) == (ssize_t) n ? 0 : -1;
+	}
+
+	const ssize_t got = read(ep_out, buf, n);
+	if (got <= 0)
+		return -1;
+	return sunxi_efex_sim_out(sim, buf, (size_t) got) == EFEX_ERR_SUCCESS ? 0 : -1;
+}
+
+int main(const int argc, char **argv) {
+	struct sunxi_efex_sim_config_t config;
+	const char *dir = NULL;
+
+	sunxi_efex_sim_config_init(&config);
+	config.on_exec = gadget_exec;
+	for (int i = 1; i < argc; i++) {
+		if (argv[i][0] != '-') {
+			dir = argv[i];
+			continue;
+		}
+		if (i == argc - 1)
+			break;
+		if (strcmp(argv[i], "-m") == 0)
+			config.mode = strcmp(argv[++i], "fes") == 0 ? DEVICE_MODE_SRV : DEVICE_MODE_FEL;
+		else if (strcmp(argv[i], "-f") == 0)
+			config.flash_path = argv[++i];
+		else if (strcmp(argv[i], "-s") == 0)
+			config.flash_size = strtoull(argv[++i], NULL, 0);
+		else if (strcmp(argv[i], "-c") == 0)
+			config.chip_id = (uint32_t) strtoul(argv[++i], NULL, 0);
+	}
+	if (!dir) {
+		print_usage();
+		return 1;
+	}
+
+	int ep0 = gadget_open_ep(dir, "ep0");
+	if (ep0 < 0)
+		return 2;
+	if (write(ep0, &descriptors, sizeof(descriptors)) != sizeof(descriptors) ||
+	    write(ep0, &strings, sizeof(strings)) != sizeof(strings)) {
+		fprintf(stderr, "ERROR: Failed to write descriptors: %s\n", strerror(errno));
+		close(ep0);
+		return 2;
+	}
+	// Endpoint files exist once the descriptors are in
+	const int ep_out = gadget_open_ep(dir, "ep1");
+	const int ep_in = gadget_open_ep(dir, "ep2");
+	if (ep_out < 0 || ep_in < 0) {
+		close(ep0);
+		return 2;
+	}
+
+	struct sunxi_efex_sim_t *sim = NULL;
+	char *buf = malloc(GADGET_MAX_XFER);
+	int ret = buf ? sunxi_efex_sim_create(&config, &sim) : EFEX_ERR_MEMORY;
+	if (ret != EFEX_ERR_SUCCESS) {
+		fprintf(stderr, "ERROR: %s\n", sunxi_efex_strerror(ret));
+		free(buf);
+		return 3;
+	}
+
+	// Interrupt the data transfers in this thread, not ep0 handling
+	struct sigaction sa = {.sa_handler = gadget_signal};
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	sigset_t mask, old;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &mask, &old);
+	sunxi_efex_thread_t ep0_thread;
+	ret = sunxi_efex_thread_create(&ep0_thread, gadget_ep0_thread, &ep0);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (ret != 0) {
+		fprintf(stderr, "ERROR: Failed to start ep0 thread\n");
+		sunxi_efex_sim_destroy(sim);
+		free(buf);
+		return 3;
+	}
+
+	printf("Serving a simulated %s device (chip 0x%08x), bind the gadget to a UDC now\n",
+	       config.mode == DEVICE_MODE_SRV ? "FES" : "FEL", config.chip_id);
+	while (!gadget_stop) {
+		if (!sunxi_efex_atomic_load(&gadget_enabled)) {
+			sunxi_efex_sleep_ms(10);
+			continue;
+		}
+		if (gadget_serve(sim, ep_out, ep_in, buf) != 0)
+			sunxi_efex_sim_reset(sim);
+	}
+
+	// Flushes the flash image; ep0 handling ends with the process
+	sunxi_efex_sim_destroy(sim);
+	free(buf);
+	close(ep_in);
+	close(ep_out);
+	return 0;
+}
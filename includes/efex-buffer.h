@@ -0,0 +1,66 @@
+#ifndef LIBEFEX_EFEX_BUFFER_H
+#define LIBEFEX_EFEX_BUFFER_H
+
+#ifdef __cplusplus
+extern "C" {
+
+#endif
+
+#include <stddef.h>
+
+#include "efex-protocol.h"
+
+/**
+ * @brief Allocate a transfer buffer from the context's buffer pool.
+ *
+ * The buffer is allocated from device memory shared with the kernel (libusb_dev_mem_alloc) when the
+ * backend supports it, so usbfs transfers it without its bounce copy. Otherwise it falls back to plain
+ * heap memory. Freed buffers are kept in the pool and reused by later allocations of the same or a
+ * smaller size.
+ *
+ * Buffers passed to sunxi_efex_fes_down/up and sunxi_efex_fel_read/write go to the USB backend
+ * as they are, so a pool buffer reaches the kernel without any copy on the way.
+ *
+ * The context must have been initialized with sunxi_usb_init(). All pool buffers become invalid
+ * after sunxi_usb_exit(). The pool is not thread-safe.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[in] len Size of the buffer in bytes.
+ * @return Pointer to the buffer, or NULL on failure.
+ */
+void *sunxi_efex_buffer_alloc(struct sunxi_efex_ctx_t *ctx, size_t len);
+
+/**
+ * @brief Return a buffer to the context's buffer pool.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[in] buf Buffer returned by sunxi_efex_buffer_alloc(), NULL is ignored.
+ */
+void sunxi_efex_buffer_free(struct sunxi_efex_ctx_t *ctx, void *buf);
+
+/**
+ * @brief Check whether a memory range lies in a device-memory pool buffer.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[in] buf Start of the range.
+ * @param[in] len Length of the range in bytes.
+ * @return 1 if the whole range is inside one device-memory buffer of the pool, 0 otherwise
+ *         (including pool buffers that fell back to heap memory).
+ */
+int sunxi_efex_buffer_is_dma(const struct sunxi_efex_ctx_t *ctx, const void *buf, size_t len);
+
+/**
+ * @brief Release every buffer of the context's buffer pool.
+ *
+ * Called by sunxi_usb_exit() before the device is closed, since device memory cannot outlive
+ * its handle.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ */
+void sunxi_efex_buffer_pool_release(struct sunxi_efex_ctx_t *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //LIBEFEX_EFEX_BUFFER_H
@@ -0,0 +1,127 @@
+#ifndef LIBEFEX_EFEX_CHUNK_H
+#define LIBEFEX_EFEX_CHUNK_H
+
+#ifdef __cplusplus
+extern "C" {
+
+#endif
+
+#include <stdint.h>
+
+#include "efex-protocol.h"
+
+/**
+ * @brief Smallest chunk size, also the granularity of every chunk size (one flash sector)
+ */
+#define SUNXI_EFEX_CHUNK_SIZE_MIN (512)
+
+/**
+ * @brief Largest chunk size accepted by sunxi_efex_set_chunk_size() and the probe
+ */
+#define SUNXI_EFEX_CHUNK_SIZE_MAX (4 * 1024 * 1024)
+
+/**
+ * @brief Lower bound the auto-tuner never shrinks below
+ */
+#define SUNXI_EFEX_CHUNK_TUNE_FLOOR (16 * 1024)
+
+/**
+ * @brief Command types with their own chunk size when auto-tuning
+ */
+enum sunxi_efex_chunk_class_t {
+	SUNXI_EFEX_CHUNK_FEL_READ = 0, /**< sunxi_efex_fel_read and variants */
+	SUNXI_EFEX_CHUNK_FEL_WRITE,    /**< sunxi_efex_fel_write and variants */
+	SUNXI_EFEX_CHUNK_FES_DOWN,     /**< sunxi_efex_fes_down */
+	SUNXI_EFEX_CHUNK_FES_UP,       /**< sunxi_efex_fes_up and the storage-specific up commands */
+	SUNXI_EFEX_CHUNK_CLASS_COUNT,
+};
+
+/**
+ * @brief Set a fixed chunk size for FEL read/write and FES up/down transfers.
+ *
+ * Each chunk is one protocol transaction, so larger chunks mean fewer round trips. The device
+ * must accept the size; sunxi_efex_probe_chunk_size() finds the largest one it does.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[in] chunk_size Chunk size in bytes, a multiple of SUNXI_EFEX_CHUNK_SIZE_MIN up to
+ *                       SUNXI_EFEX_CHUNK_SIZE_MAX, or 0 for the default EFEX_CODE_MAX_SIZE.
+ * @return EFEX_ERR_SUCCESS on success, or an error code on failure.
+ */
+int sunxi_efex_set_chunk_size(struct sunxi_efex_ctx_t *ctx, uint32_t chunk_size);
+
+/**
+ * @brief Enable or disable chunk size auto-tuning.
+ *
+ * Every command type starts at the current chunk size. After each window of transfers the tuner
+ * compares the measured throughput with the previous window and keeps doubling the chunk while
+ * throughput improves. When the first doubling does not pay off, or the chunk is already at the
+ * limit, it is halved instead for as long as that helps. Sizes stay between
+ * SUNXI_EFEX_CHUNK_TUNE_FLOOR and the largest size the device accepts (EFEX_CODE_MAX_SIZE unless
+ * raised by sunxi_efex_probe_chunk_size()). A settled size is re-explored the same way from time
+ * to time, so the tuner follows a link that gets slower as well as one that gets faster.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[in] enable Non-zero to enable auto-tuning, 0 to go back to the fixed chunk size.
+ * @return EFEX_ERR_SUCCESS on success, or an error code on failure.
+ */
+int sunxi_efex_set_chunk_auto(struct sunxi_efex_ctx_t *ctx, int enable);
+
+/**
+ * @brief Probe the largest chunk the device accepts in one transaction.
+ *
+ * Issues single-chunk reads of growing size (doubling from EFEX_CODE_MAX_SIZE) until the device
+ * rejects one or max is reached: FEL reads of memory at addr in FEL mode, FES flash reads of
+ * sector addr in FES mode. After a rejected size the device is re-verified before returning.
+ * The result becomes the upper bound of the auto-tuner.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[in] addr Memory address (FEL) or flash sector (FES) that is safe to read.
+ * @param[in] max Largest size to try, a multiple of SUNXI_EFEX_CHUNK_SIZE_MIN.
+ * @param[out] accepted Receives the largest accepted size, may be NULL.
+ * @return EFEX_ERR_SUCCESS on success, or an error code if the device stopped responding.
+ */
+int sunxi_efex_probe_chunk_size(struct sunxi_efex_ctx_t *ctx, uint32_t addr, uint32_t max, uint32_t *accepted);
+
+/**
+ * @brief Get the chunk size to use for the next transfer of a command type.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[in] cls Command type.
+ * @return Chunk size in bytes.
+ */
+uint32_t sunxi_efex_chunk_size(const struct sunxi_efex_ctx_t *ctx, enum sunxi_efex_chunk_class_t cls);
+
+/**
+ * @brief Feed one completed chunk into the auto-tuner.
+ *
+ * Does nothing when auto-tuning is disabled.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[in] cls Command type.
+ * @param[in] len Bytes transferred.
+ * @param[in] usec Time taken in microseconds.
+ */
+void sunxi_efex_chunk_update(const struct sunxi_efex_ctx_t *ctx, enum sunxi_efex_chunk_class_t cls, uint32_t len,
+                             uint64_t usec);
+
+/**
+ * @brief Free the auto-tuner state of a context.
+ *
+ * Called from sunxi_efex_ctx_release().
+ *
+ * @param[in] ctx Pointer to the context structure.
+ */
+void sunxi_efex_chunk_release(struct sunxi_efex_ctx_t *ctx);
+
+/**
+ * @brief Monotonic clock in microseconds, for measuring transfers.
+ *
+ * @return Microseconds since an arbitrary starting point.
+ */
+uint64_t sunxi_efex_time_us(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //LIBEFEX_EFEX_CHUNK_H
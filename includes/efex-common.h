@@ -85,6 +85,43 @@ const char *sunxi_efex_get_device_mode_str(const struct sunxi_efex_ctx_t *ctx);
  */
 int sunxi_efex_init(struct sunxi_efex_ctx_t *ctx);
 
+/**
+ * @brief Release the per-context state allocated by the library
+ *
+ * Frees the transfer buffer pool and the chunk size auto-tuner. sunxi_usb_exit() calls this
+ * before closing the device; it is safe to call more than once.
+ *
+ * @param ctx Pointer to the EFEX context structure
+ */
+void sunxi_efex_ctx_release(struct sunxi_efex_ctx_t *ctx);
+
+/**
+ * @brief Set the progress callback of a context
+ *
+ * The FEL and FES transfer loops call it after every chunk the device has confirmed, with the
+ * size of that chunk in bytes, from the thread running the transfer. Unlike the callbacks of
+ * sunxi_efex_fel_read_cb() it receives the context and a caller argument, so several contexts
+ * can report through one function.
+ *
+ * @param ctx Pointer to the EFEX context structure
+ * @param on_progress Callback, NULL to disable
+ * @param arg Passed to the callback
+ * @return EFEX_ERR_SUCCESS on success, or an error code on failure
+ */
+int sunxi_efex_set_progress(struct sunxi_efex_ctx_t *ctx,
+                            void (*on_progress)(const struct sunxi_efex_ctx_t *ctx, size_t done, void *arg),
+                            void *arg);
+
+/**
+ * @brief Report transferred bytes to the progress callback of a context
+ *
+ * Used by the transfer loops; does nothing when no callback is set.
+ *
+ * @param ctx Pointer to the EFEX context structure
+ * @param done Bytes confirmed since the previous report
+ */
+void sunxi_efex_progress(const struct sunxi_efex_ctx_t *ctx, size_t done);
+
 /**
  * @brief Get error message string for a given error code
  *
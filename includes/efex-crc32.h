@@ -0,0 +1,39 @@
+#ifndef LIBEFEX_EFEX_CRC32_H
+#define LIBEFEX_EFEX_CRC32_H
+
+#ifdef __cplusplus
+extern "C" {
+
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Continues a CRC32 over more data.
+ *
+ * The CRC is the reflected 0xEDB88320 one of zlib, PNG and the FES verify command. Like zlib's
+ * crc32(), start with 0 and pass the previous result to continue, so data can be checksummed
+ * piece by piece as it is sent:
+ *
+ *   uint32_t crc = 0;
+ *   crc = sunxi_efex_crc32(crc, first, first_len);
+ *   crc = sunxi_efex_crc32(crc, second, second_len);
+ *
+ * Runs at several GB/s: folded with PCLMULQDQ on x86 CPUs that have it, with the CRC32
+ * instructions on ARMv8 builds that target them (e.g. -march=armv8-a+crc), slice-by-16 otherwise.
+ * That is far faster than USB, so checksumming each chunk of a transfer as it goes costs next to
+ * nothing compared with a separate pass over the image.
+ *
+ * @param crc CRC of the data so far, 0 for none.
+ * @param buf Data to add.
+ * @param len Size of the data in bytes.
+ * @return The CRC32 of the data so far followed by buf.
+ */
+uint32_t sunxi_efex_crc32(uint32_t crc, const void *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBEFEX_EFEX_CRC32_H
@@ -7,6 +7,7 @@ extern "C" {
 #endif
 
 #include "efex-protocol.h"
+#include "efex-stream.h"
 
 /**
  * @brief Execute a command at the given address.
@@ -19,6 +20,37 @@ extern "C" {
  */
 int sunxi_efex_fel_exec(const struct sunxi_efex_ctx_t *ctx, const uint32_t addr);
 
+/**
+ * @brief Enable or disable pipelined FEL transfers.
+ *
+ * In pipelined mode every chunk of sunxi_efex_fel_read/write (and the _cb variants) is
+ * sent as one chain of all nine USB phases (AWUC, request, AWUS, AWUC, data, AWUS, AWUC,
+ * status, AWUS), and the next chunk is queued before the previous one is checked. This
+ * removes the per-transfer round trips that dominate FEL uploads. Backends without chain
+ * support run the chain synchronously.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[in] enable Non-zero to enable pipelined mode, 0 to use blocking transfers.
+ * @return EFEX_ERR_SUCCESS on success, or an error code on failure.
+ */
+int sunxi_efex_fel_set_pipeline(struct sunxi_efex_ctx_t *ctx, int enable);
+
+/**
+ * @brief Enable or disable verified FEL writes.
+ *
+ * In verified mode sunxi_efex_fel_write and sunxi_efex_fel_write_cb check the data once it is
+ * on the device: the CRC32 payload checksums it there, and the result is compared with the CRC
+ * the host computed on a thread while the data was being sent. A mismatch is reported as
+ * EFEX_ERR_CRC_MISMATCH. Verifying an upload this way costs milliseconds instead of the time of
+ * reading it back. The part of a write that lies in the memory the payloads run from is read
+ * back instead, as are whole writes when the payloads of the context have no CRC32 support.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[in] enable Non-zero to verify writes, 0 to trust the transfer status.
+ * @return EFEX_ERR_SUCCESS on success, or an error code on failure.
+ */
+int sunxi_efex_fel_set_verify(struct sunxi_efex_ctx_t *ctx, int enable);
+
 /**
  * @brief Read a block of memory from the specified address.
  *
@@ -43,6 +75,18 @@ int sunxi_efex_fel_read(const struct sunxi_efex_ctx_t *ctx, uint32_t addr, char
  */
 int sunxi_efex_fel_write(const struct sunxi_efex_ctx_t *ctx, uint32_t addr, const char *buf, ssize_t len);
 
+/**
+ * @brief Write a block of memory, skipping the check of verified mode.
+ *
+ * Used by the payloads, which verified writes run themselves.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[in] addr The memory address to which data will be written.
+ * @param[in] buf Pointer to the buffer containing the data to be written.
+ * @param[in] len The number of bytes to write to the memory.
+ */
+int sunxi_efex_fel_write_unverified(const struct sunxi_efex_ctx_t *ctx, uint32_t addr, const char *buf, ssize_t len);
+
 /**
  * @brief Read a block of memory from the specified address.
  *
@@ -57,6 +101,24 @@ int sunxi_efex_fel_write(const struct sunxi_efex_ctx_t *ctx, uint32_t addr, cons
 int sunxi_efex_fel_read_cb(const struct sunxi_efex_ctx_t *ctx, uint32_t addr, const char *buf, ssize_t len,
 						   void (*callback)(ssize_t done));
 
+/**
+ * @brief Read a block of memory into a writer callback instead of a buffer.
+ *
+ * Goes through the ring of efex-stream.h: the calling thread reads from the device while a helper
+ * thread hands what was read to the writer, so the writer (typically sunxi_efex_file_sink_write())
+ * never holds up the USB transfers and only a few chunks are in memory at a time.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[in] addr The memory address from which data will be read.
+ * @param[in] len The number of bytes to read, addr + len must not pass the 4 GiB address space.
+ * @param[in] writer Called with the data in order.
+ * @param[in] user Passed to writer.
+ * @param[in] callback Called with the number of bytes read after each chunk, may be NULL.
+ * @return EFEX_ERR_SUCCESS on success, the writer's error, or another error code on failure.
+ */
+int sunxi_efex_fel_read_stream(const struct sunxi_efex_ctx_t *ctx, uint32_t addr, uint64_t len,
+                               sunxi_efex_stream_writer_t writer, void *user, void (*callback)(ssize_t done));
+
 /**
  * @brief Write a block of memory to the specified address.
  *
@@ -9,6 +9,8 @@ extern "C" {
 #endif
 
 #include "efex-common.h"
+#include "efex-sparse.h"
+#include "efex-stream.h"
 
 /**
  * @brief FES transfer data type enum
@@ -136,6 +138,149 @@ int sunxi_efex_fes_down(const struct sunxi_efex_ctx_t *ctx, const char *buf, con
 int sunxi_efex_fes_up(const struct sunxi_efex_ctx_t *ctx, const char *buf, const ssize_t len, uint32_t addr,
                       enum sunxi_fes_data_type_t type);
 
+/**
+ * @brief Send data to FES (download), keeping a CRC32 of what was sent
+ *
+ * Each chunk is added to the CRC as soon as it is sent, so the CRC is ready when the
+ * download completes and can be compared with the media_crc of sunxi_efex_fes_verify_value()
+ * without another pass over the data.
+ *
+ * @param ctx Context pointer
+ * @param buf Data buffer
+ * @param len Data length
+ * @param addr Target address
+ * @param type Data type
+ * @param crc In: CRC32 of the data sent before, 0 to start one; out: CRC32 including buf
+ * @return 0 on success, negative value on failure
+ */
+int sunxi_efex_fes_down_crc(const struct sunxi_efex_ctx_t *ctx, const char *buf, const ssize_t len, uint32_t addr,
+                            enum sunxi_fes_data_type_t type, uint32_t *crc);
+
+/**
+ * @brief Receive data from FES (upload), keeping a CRC32 of what was received
+ *
+ * @param ctx Context pointer
+ * @param buf Data buffer
+ * @param len Data length
+ * @param addr Source address
+ * @param type Data type
+ * @param crc In: CRC32 of the data received before, 0 to start one; out: CRC32 including buf
+ * @return 0 on success, negative value on failure
+ */
+int sunxi_efex_fes_up_crc(const struct sunxi_efex_ctx_t *ctx, const char *buf, const ssize_t len, uint32_t addr,
+                          enum sunxi_fes_data_type_t type, uint32_t *crc);
+
+/**
+ * @brief Send data to FES (download) from a reader callback instead of a buffer
+ *
+ * The data goes through the ring of efex-stream.h: a helper thread runs the reader while the
+ * calling thread sends the slots already filled, so the reads overlap the USB transfers and only
+ * a few chunks of the data are in memory at a time. The last chunk of the download carries
+ * SUNXI_EFEX_TRANS_FINISH_TAG as with sunxi_efex_fes_down().
+ *
+ * @param ctx Context pointer
+ * @param reader Called for the data in order until total_len bytes are supplied
+ * @param user Passed to reader
+ * @param total_len Data length
+ * @param addr Target address
+ * @param type Data type
+ * @param crc In: CRC32 of the data sent before, 0 to start one; out: CRC32 including the data sent.
+ *            May be NULL.
+ * @return 0 on success, the reader's error, EFEX_ERR_FILE_READ if the data ended early,
+ *         or another negative value on failure
+ */
+int sunxi_efex_fes_down_stream(const struct sunxi_efex_ctx_t *ctx, sunxi_efex_stream_reader_t reader, void *user,
+                               uint64_t total_len, uint32_t addr, enum sunxi_fes_data_type_t type, uint32_t *crc);
+
+/**
+ * @brief Send data to FES (download), leaving out the blocks the target already holds
+ *
+ * The data is classified in SUNXI_EFEX_SPARSE_BLOCK blocks; runs of at least SUNXI_EFEX_SPARSE_MIN_SKIP
+ * bytes that match blank are not sent, the address just moves past them. Use it where the target
+ * is known to read as blank, such as flash erased beforehand. The finish tag goes on the last chunk
+ * actually sent; when the data ends in a skipped run, one block of the blank pattern is written at
+ * its end to carry the tag.
+ *
+ * @param ctx Context pointer
+ * @param buf Data buffer, typically a struct sunxi_efex_image_t
+ * @param len Data length
+ * @param addr Target address
+ * @param type Data type
+ * @param blank What the target holds where nothing is written; SUNXI_EFEX_SPARSE_DATA sends everything
+ * @param crc In: CRC32 of the data sent before, 0 to start one; out: CRC32 including buf, skipped
+ *            blocks included. May be NULL.
+ * @param skipped Receives the number of bytes not sent, may be NULL
+ * @return 0 on success, negative value on failure
+ */
+int sunxi_efex_fes_down_sparse(const struct sunxi_efex_ctx_t *ctx, const char *buf, uint64_t len, uint32_t addr,
+                               enum sunxi_fes_data_type_t type, enum sunxi_efex_sparse_fill_t blank, uint32_t *crc,
+                               uint64_t *skipped);
+
+/**
+ * @brief Send an Android sparse image (.simg) to FES, expanded on the fly
+ *
+ * RAW chunks go out as with sunxi_efex_fes_down_sparse(). DONT_CARE chunks are never sent, and FILL
+ * chunks whose pattern matches blank are skipped like blank runs; other FILL patterns are expanded
+ * a SUNXI_EFEX_SPARSE_FILL_SIZE buffer at a time. The address covers the expanded image, whose size
+ * is sunxi_efex_simg_size().
+ *
+ * @param ctx Context pointer
+ * @param data The sparse file, typically a struct sunxi_efex_image_t
+ * @param size Its size in bytes
+ * @param addr Target address
+ * @param type Data type
+ * @param blank What the target holds where nothing is written, see sunxi_efex_fes_down_sparse()
+ * @param crc Receives the CRC32 of the expanded image, DONT_CARE counted as blank (zeros for
+ *            SUNXI_EFEX_SPARSE_DATA), to compare with sunxi_efex_fes_verify_value(). CRC32 chunks of the
+ *            image are checked along the way when it is requested. May be NULL.
+ * @param skipped Receives the number of bytes not sent, may be NULL
+ * @return 0 on success, EFEX_ERR_FILE_FORMAT for a corrupt image, EFEX_ERR_CRC_MISMATCH if a CRC32
+ *         chunk does not match, or another negative value on failure
+ */
+int sunxi_efex_fes_down_simg(const struct sunxi_efex_ctx_t *ctx, const char *data, uint64_t size, uint32_t addr,
+                             enum sunxi_fes_data_type_t type, enum sunxi_efex_sparse_fill_t blank, uint32_t *crc,
+                             uint64_t *skipped);
+
+/**
+ * @brief Receive data from FES (upload) into a writer callback instead of a buffer
+ *
+ * The mirror of sunxi_efex_fes_down_stream(): the calling thread receives into the ring while a
+ * helper thread hands the slots already received to the writer, so a slow disk does not hold up
+ * the USB transfers. With sunxi_efex_file_sink_write() as writer the data goes to a file.
+ *
+ * @param ctx Context pointer
+ * @param writer Called with the data in order
+ * @param user Passed to writer
+ * @param total_len Data length
+ * @param addr Source address
+ * @param type Data type
+ * @param crc In: CRC32 of the data received before, 0 to start one; out: CRC32 including the data
+ *            received. May be NULL.
+ * @return 0 on success, the writer's error, or another negative value on failure
+ */
+int sunxi_efex_fes_up_stream(const struct sunxi_efex_ctx_t *ctx, sunxi_efex_stream_writer_t writer, void *user,
+                             uint64_t total_len, uint32_t addr, enum sunxi_fes_data_type_t type, uint32_t *crc);
+
+/**
+ * @brief sunxi_efex_fes_up_stream() from raw NAND, byte-addressed as sunxi_efex_fes_nand_up()
+ */
+int sunxi_efex_fes_nand_up_stream(const struct sunxi_efex_ctx_t *ctx, sunxi_efex_stream_writer_t writer, void *user,
+                                  uint64_t total_len, uint32_t addr, enum sunxi_fes_data_type_t type, uint32_t *crc);
+
+/**
+ * @brief sunxi_efex_fes_up_stream() from SPI NAND, byte-addressed as sunxi_efex_fes_spinand_up()
+ */
+int sunxi_efex_fes_spinand_up_stream(const struct sunxi_efex_ctx_t *ctx, sunxi_efex_stream_writer_t writer,
+                                     void *user, uint64_t total_len, uint32_t addr, enum sunxi_fes_data_type_t type,
+                                     uint32_t *crc);
+
+/**
+ * @brief sunxi_efex_fes_up_stream() from SPI NOR, byte-addressed as sunxi_efex_fes_spinor_up()
+ */
+int sunxi_efex_fes_spinor_up_stream(const struct sunxi_efex_ctx_t *ctx, sunxi_efex_stream_writer_t writer,
+                                    void *user, uint64_t total_len, uint32_t addr, enum sunxi_fes_data_type_t type,
+                                    uint32_t *crc);
+
 /**
  * @brief Receive data from raw NAND via FES (upload)
  *
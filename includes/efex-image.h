@@ -0,0 +1,56 @@
+#ifndef LIBEFEX_EFEX_IMAGE_H
+#define LIBEFEX_EFEX_IMAGE_H
+
+#ifdef __cplusplus
+extern "C" {
+
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Bytes the kernel is asked to read ahead when an image is opened
+ */
+#define SUNXI_EFEX_IMAGE_PREFETCH (16 * 1024 * 1024)
+
+/**
+ * @brief A firmware file opened with sunxi_efex_image_open()
+ */
+struct sunxi_efex_image_t {
+	char *data;    /**< Contents of the file, writes to it never reach the file */
+	uint64_t size; /**< Size of the file in bytes */
+	int mapped;    /**< 1 if data maps the file, 0 if it is a heap copy */
+};
+
+/**
+ * @brief Opens a firmware file for download.
+ *
+ * The file is mapped into memory copy-on-write, so its contents can go to sunxi_efex_fes_down()
+ * or sunxi_efex_fel_write() straight from the page cache without being read into a buffer first.
+ * Processes and contexts that open the same file share one copy of it in memory, and only pages
+ * that are written to, such as a patched header, get a private copy.
+ *
+ * The mapping is marked for sequential access and its first SUNXI_EFEX_IMAGE_PREFETCH bytes are
+ * read ahead, so the first transfers do not wait for the disk. Files that cannot be mapped are
+ * read into heap memory instead.
+ *
+ * @param img Receives the image.
+ * @param path Path of the file.
+ * @return EFEX_ERR_SUCCESS on success, EFEX_ERR_FILE_OPEN, EFEX_ERR_FILE_SIZE for an empty file or one
+ *         larger than the address space, EFEX_ERR_FILE_READ or EFEX_ERR_MEMORY on failure
+ */
+int sunxi_efex_image_open(struct sunxi_efex_image_t *img, const char *path);
+
+/**
+ * @brief Releases an image, its data is no longer valid afterwards.
+ *
+ * @param img The image, closing one that was not opened or closing it twice does nothing.
+ */
+void sunxi_efex_image_close(struct sunxi_efex_image_t *img);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBEFEX_EFEX_IMAGE_H
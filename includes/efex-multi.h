@@ -0,0 +1,124 @@
+#ifndef LIBEFEX_EFEX_MULTI_H
+#define LIBEFEX_EFEX_MULTI_H
+
+#ifdef __cplusplus
+extern "C" {
+
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "efex-fes.h"
+#include "efex-protocol.h"
+
+struct sunxi_scanned_device_t;
+
+/**
+ * @brief Largest number of worker threads a multi-device run starts
+ */
+#define SUNXI_EFEX_MULTI_MAX_WORKERS (64)
+
+/**
+ * @brief Job run on every device of a multi-device run
+ */
+enum sunxi_efex_multi_job_type_t {
+	SUNXI_EFEX_MULTI_FEL_BOOT = 0,  /**< Write data to addr in FEL mode and execute it */
+	SUNXI_EFEX_MULTI_FES_FLASH = 1, /**< Download data to addr in FES mode with fes_type */
+	SUNXI_EFEX_MULTI_DUMP = 2,      /**< Read len bytes from addr, FEL memory or FES storage with fes_type */
+	SUNXI_EFEX_MULTI_CUSTOM = 3,    /**< Call run */
+};
+
+/**
+ * @brief State of one device of a multi-device run
+ */
+enum sunxi_efex_multi_state_t {
+	SUNXI_EFEX_MULTI_PENDING = 0, /**< Waiting for a worker */
+	SUNXI_EFEX_MULTI_RUNNING = 1, /**< Job in progress */
+	SUNXI_EFEX_MULTI_DONE = 2,    /**< Job completed */
+	SUNXI_EFEX_MULTI_FAILED = 3,  /**< Job failed, see result */
+};
+
+/**
+ * @brief Progress and result of one device of a multi-device run
+ *
+ * Updated by the worker that owns the device; callbacks receive it while it is consistent.
+ */
+struct sunxi_efex_multi_device_t {
+	uint8_t bus;                         /**< USB bus number */
+	uint8_t port;                        /**< USB port number */
+	enum sunxi_efex_multi_state_t state; /**< Where the job is */
+	int result;                          /**< EFEX_ERR_SUCCESS, or the error the job failed with */
+	uint32_t mode;                       /**< Device mode reported by sunxi_efex_init(), 0 before */
+	uint64_t done;                       /**< Bytes transferred so far */
+	uint64_t total;                      /**< Bytes the job transfers, 0 if unknown (custom jobs) */
+	uint64_t elapsed_us;                 /**< Time from opening the device to the end of the job */
+	char *dump;                          /**< Data read by a dump job, freed by sunxi_efex_multi_free() */
+	void *user;                          /**< Free for the callbacks, left untouched by the library */
+};
+
+/**
+ * @brief Job description of a multi-device run
+ *
+ * The data buffer is shared read-only by all workers.
+ */
+struct sunxi_efex_multi_job_t {
+	enum sunxi_efex_multi_job_type_t type; /**< What to run */
+	uint32_t addr;                         /**< Load/exec address, FES start address or dump source */
+	const char *data;                      /**< Image for boot and flash jobs */
+	size_t len;                            /**< Length of data, or bytes to dump */
+	enum sunxi_fes_data_type_t fes_type;   /**< Data type tag of FES flash and FES dump jobs */
+	/**
+	 * @brief Configure a freshly initialized context before the job runs, may be NULL
+	 *
+	 * The place to select payloads, attach a policy or set chunk size and queue depth.
+	 * A non-zero return fails the device with that error.
+	 */
+	int (*setup)(struct sunxi_efex_ctx_t *ctx, struct sunxi_efex_multi_device_t *dev, void *arg);
+	/**
+	 * @brief Job body of SUNXI_EFEX_MULTI_CUSTOM, may report progress through sunxi_efex_progress()
+	 */
+	int (*run)(struct sunxi_efex_ctx_t *ctx, struct sunxi_efex_multi_device_t *dev, void *arg);
+	/**
+	 * @brief Called whenever a device made progress or changed state, may be NULL
+	 *
+	 * Calls are serialized across workers, so the callback needs no locking of its own, but
+	 * it holds up every worker while it runs.
+	 */
+	void (*on_progress)(const struct sunxi_efex_multi_device_t *dev, void *arg);
+	void *arg; /**< Passed to the callbacks */
+};
+
+/**
+ * @brief Run a job on several devices in parallel.
+ *
+ * Every target is opened, initialized and driven by its own context on a pool of worker
+ * threads; a device that is slow or hangs only holds up its own worker. Blocks until every
+ * device is done.
+ *
+ * @param[in] job Job to run on every device.
+ * @param[in] targets Devices to run on, NULL for every device found by sunxi_scan_usb_devices().
+ * @param[in] target_count Number of targets, ignored when targets is NULL.
+ * @param[in] workers Number of worker threads, 0 for one per device (capped to SUNXI_EFEX_MULTI_MAX_WORKERS).
+ * @param[out] devices Receives the per-device results, free with sunxi_efex_multi_free().
+ * @param[out] count Receives the number of devices.
+ * @return EFEX_ERR_SUCCESS if the job succeeded on every device, the error of the first failed
+ *         device otherwise, or an error code if the run could not start (no results then).
+ */
+int sunxi_efex_multi_run(const struct sunxi_efex_multi_job_t *job, const struct sunxi_scanned_device_t *targets,
+                         size_t target_count, int workers, struct sunxi_efex_multi_device_t **devices,
+                         size_t *count);
+
+/**
+ * @brief Free the results of sunxi_efex_multi_run().
+ *
+ * @param[in] devices Result array.
+ * @param[in] count Number of entries.
+ */
+void sunxi_efex_multi_free(struct sunxi_efex_multi_device_t *devices, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //LIBEFEX_EFEX_MULTI_H
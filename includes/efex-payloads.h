@@ -6,6 +6,7 @@ extern "C" {
 
 #endif
 
+#include <stddef.h>
 #include <stdint.h>
 #include "compiler.h"
 #include "efex-common.h"
@@ -69,6 +70,76 @@ struct payloads_ops {
 	 * @return EFEX_ERR_SUCCESS on success, or an error code from enum sunxi_efex_error_t on failure
 	 */
 	int (*writel)(const struct sunxi_efex_ctx_t *ctx, uint32_t value, uint32_t addr);
+
+	/**
+	 * @brief Function to read several 32-bit values in one payload run.
+	 *
+	 * @param ctx Pointer to the context structure containing relevant state.
+	 * @param addrs Memory addresses to read, in order.
+	 * @param vals Receives the values read.
+	 * @param count Number of addresses, at most SUNXI_EFEX_PAYLOAD_BATCH_MAX.
+	 * @return EFEX_ERR_SUCCESS on success, or an error code from enum sunxi_efex_error_t on failure
+	 */
+	int (*readl_batch)(const struct sunxi_efex_ctx_t *ctx, const uint32_t *addrs, uint32_t *vals, size_t count);
+
+	/**
+	 * @brief Function to write several 32-bit values in one payload run.
+	 *
+	 * @param ctx Pointer to the context structure containing relevant state.
+	 * @param addrs Memory addresses to write, in order.
+	 * @param vals Values to write.
+	 * @param count Number of addresses, at most SUNXI_EFEX_PAYLOAD_BATCH_MAX.
+	 * @return EFEX_ERR_SUCCESS on success, or an error code from enum sunxi_efex_error_t on failure
+	 */
+	int (*writel_batch)(const struct sunxi_efex_ctx_t *ctx, const uint32_t *addrs, const uint32_t *vals, size_t count);
+
+	/**
+	 * @brief Function to run a register sequence program with the interpreter payload.
+	 *
+	 * @param ctx Pointer to the context structure containing relevant state.
+	 * @param program Little-endian program words, the size in bytes of the operations followed by the operations
+	 *                of a struct sunxi_efex_seq_t and a SUNXI_EFEX_SEQ_END.
+	 * @param program_len Size of the program in bytes.
+	 * @param result Receives the completed operation count followed by the values read, little-endian.
+	 * @param result_len Size of the result in bytes.
+	 * @return EFEX_ERR_SUCCESS on success, or an error code from enum sunxi_efex_error_t on failure
+	 */
+	int (*seq)(const struct sunxi_efex_ctx_t *ctx, const uint32_t *program, size_t program_len, uint32_t *result,
+	           size_t result_len);
+
+	/**
+	 * @brief Function to fill device memory on the device CPU.
+	 *
+	 * @param ctx Pointer to the context structure containing relevant state.
+	 * @param addr Start of the memory to fill.
+	 * @param pattern Fill byte repeated in all four bytes of the word.
+	 * @param len Number of bytes to fill.
+	 * @return EFEX_ERR_SUCCESS on success, or an error code from enum sunxi_efex_error_t on failure
+	 */
+	int (*fill)(const struct sunxi_efex_ctx_t *ctx, uint32_t addr, uint32_t pattern, uint32_t len);
+
+	/**
+	 * @brief Function to copy device memory forwards on the device CPU.
+	 *
+	 * @param ctx Pointer to the context structure containing relevant state.
+	 * @param dst Destination address.
+	 * @param src Source address.
+	 * @param len Number of bytes to copy.
+	 * @return EFEX_ERR_SUCCESS on success, or an error code from enum sunxi_efex_error_t on failure
+	 */
+	int (*copy)(const struct sunxi_efex_ctx_t *ctx, uint32_t dst, uint32_t src, uint32_t len);
+
+	/**
+	 * @brief Function to compute the CRC32 of device memory on the device CPU.
+	 *
+	 * @param ctx Pointer to the context structure containing relevant state.
+	 * @param addr Start of the memory to checksum.
+	 * @param len Number of bytes to checksum.
+	 * @param crc_in CRC of the data before addr, 0 to start a new one, as with zlib's crc32().
+	 * @param crc Receives the CRC32 of the data.
+	 * @return EFEX_ERR_SUCCESS on success, or an error code from enum sunxi_efex_error_t on failure
+	 */
+	int (*crc32)(const struct sunxi_efex_ctx_t *ctx, uint32_t addr, uint32_t len, uint32_t crc_in, uint32_t *crc);
 };
 
 /**
@@ -84,6 +155,37 @@ struct payloads_ops {
  */
 #define WARP_INST(x) (x)
 
+/**
+ * @brief Device memory kept for each resident payload, code followed by its parameters
+ */
+#define SUNXI_EFEX_PAYLOAD_SLOT_SIZE (128)
+
+/**
+ * @brief Payloads kept resident at once, in consecutive slots from the data start address
+ */
+#define SUNXI_EFEX_PAYLOAD_SLOTS (2)
+
+/**
+ * @brief Device memory behind the slots for a payload with bulk parameters, such as a batch
+ */
+#define SUNXI_EFEX_PAYLOAD_AREA_SIZE (4096)
+
+/**
+ * @brief Registers accessed per payload run by the batch functions; longer batches take several runs
+ */
+#define SUNXI_EFEX_PAYLOAD_BATCH_MAX (256)
+
+/**
+ * @brief Bytes filled, copied or checksummed per payload run, keeping each run well inside the USB timeout
+ */
+#define SUNXI_EFEX_PAYLOAD_MEM_CHUNK (16 * 1024 * 1024)
+
+/**
+ * @brief Device memory from the data start address that payload runs may overwrite, slots and area
+ */
+#define SUNXI_EFEX_PAYLOAD_FOOTPRINT                                                                                   \
+	(SUNXI_EFEX_PAYLOAD_SLOTS * SUNXI_EFEX_PAYLOAD_SLOT_SIZE + SUNXI_EFEX_PAYLOAD_AREA_SIZE)
+
 /**
  * @brief Initializes the payloads for the given architecture.
  *
@@ -91,12 +193,28 @@ struct payloads_ops {
  * It will configure the correct operations to interact with the hardware, such as reading
  * or writing to memory based on the chosen architecture.
  *
+ * This sets the process-wide default, used by contexts that did not select their own payloads
+ * with sunxi_efex_fel_payloads_select(). Boards of different architectures driven from one
+ * process need the per-context selection.
+ *
  * @param arch The architecture type to initialize payloads for.
  *             This can be an enum value representing a specific architecture (e.g., ARM, RISC-V).
  * @return EFEX_ERR_SUCCESS on success, or an error code from enum sunxi_efex_error_t on failure
  */
 int sunxi_efex_fel_payloads_init(enum sunxi_efex_fel_payloads_arch arch);
 
+/**
+ * @brief Selects the payloads of a context.
+ *
+ * Takes precedence over the default set by sunxi_efex_fel_payloads_init(), so each context
+ * can drive a board of its own architecture.
+ *
+ * @param ctx The context to select the payloads for.
+ * @param arch The architecture type of the device behind the context.
+ * @return EFEX_ERR_SUCCESS on success, or an error code from enum sunxi_efex_error_t on failure
+ */
+int sunxi_efex_fel_payloads_select(struct sunxi_efex_ctx_t *ctx, enum sunxi_efex_fel_payloads_arch arch);
+
 /**
  * @brief Retrieves the current payload operations.
  *
@@ -107,10 +225,18 @@ int sunxi_efex_fel_payloads_init(enum sunxi_efex_fel_payloads_arch arch);
  */
 struct payloads_ops *sunxi_efex_fel_get_current_payload();
 
+/**
+ * @brief Retrieves the payload operations used for a context.
+ *
+ * @param ctx The context to look up, may be NULL for the process default.
+ * @return The payloads selected for the context, the process default otherwise, or NULL if neither is set.
+ */
+const struct payloads_ops *sunxi_efex_fel_get_payload(const struct sunxi_efex_ctx_t *ctx);
+
 /**
  * @brief Reads a 32-bit value from the specified address.
  *
- * This function uses the current payloads to read a 32-bit value from the specified memory address.
+ * This function uses the payloads of the context to read a 32-bit value from the specified memory address.
  * It interacts with the hardware through a low-level interface to fetch the value stored at the address.
  *
  * @param ctx The context structure that holds the necessary information for the operation.
@@ -125,7 +251,7 @@ int sunxi_efex_fel_payloads_readl(const struct sunxi_efex_ctx_t *ctx, uint32_t a
 /**
  * @brief Writes a 32-bit value to the specified address.
  *
- * This function writes a 32-bit value to the specified memory address using the current payloads.
+ * This function writes a 32-bit value to the specified memory address using the payloads of the context.
  * It interacts with the hardware to store the value at the given address.
  *
  * @param ctx The context structure that holds the necessary information for the operation.
@@ -135,6 +261,144 @@ int sunxi_efex_fel_payloads_readl(const struct sunxi_efex_ctx_t *ctx, uint32_t a
  */
 int sunxi_efex_fel_payloads_writel(const struct sunxi_efex_ctx_t *ctx, uint32_t value, uint32_t addr);
 
+/**
+ * @brief Reads several 32-bit values with as few payload runs as possible.
+ *
+ * The accesses happen in array order on the device, SUNXI_EFEX_PAYLOAD_BATCH_MAX per payload run,
+ * each run costing one FEL write, one exec and one FEL read whatever its length. Meant for register
+ * sequences such as clock and DRAM controller bring-up.
+ *
+ * @param ctx The context structure that holds the necessary information for the operation.
+ * @param addrs The addresses to read from.
+ * @param vals Receives the values read, count entries.
+ * @param count Number of addresses.
+ * @return EFEX_ERR_SUCCESS on success, or an error code from enum sunxi_efex_error_t on failure
+ */
+int sunxi_efex_fel_payloads_readl_batch(const struct sunxi_efex_ctx_t *ctx, const uint32_t *addrs, uint32_t *vals,
+                                        size_t count);
+
+/**
+ * @brief Writes several 32-bit values with as few payload runs as possible.
+ *
+ * The writes happen in array order on the device, SUNXI_EFEX_PAYLOAD_BATCH_MAX per payload run,
+ * each run costing one FEL write and one exec.
+ *
+ * @param ctx The context structure that holds the necessary information for the operation.
+ * @param addrs The addresses to write to.
+ * @param vals The values to write, count entries.
+ * @param count Number of addresses.
+ * @return EFEX_ERR_SUCCESS on success, or an error code from enum sunxi_efex_error_t on failure
+ */
+int sunxi_efex_fel_payloads_writel_batch(const struct sunxi_efex_ctx_t *ctx, const uint32_t *addrs,
+                                         const uint32_t *vals, size_t count);
+
+/**
+ * @brief Fills device memory with a byte, using the device CPU.
+ *
+ * Only the payload and its parameters cross USB, so clearing or patterning large amounts of DRAM
+ * costs one exec per SUNXI_EFEX_PAYLOAD_MEM_CHUNK instead of as much USB traffic as memory filled.
+ * DRAM has to be initialized beforehand, e.g. by FES1. The range may not overlap the memory
+ * above the data start address where the payloads themselves run.
+ *
+ * @param ctx The context structure that holds the necessary information for the operation.
+ * @param addr Start of the memory to fill.
+ * @param value Fill byte.
+ * @param len Number of bytes to fill.
+ * @return EFEX_ERR_SUCCESS on success, or an error code from enum sunxi_efex_error_t on failure
+ */
+int sunxi_efex_fel_memset(const struct sunxi_efex_ctx_t *ctx, uint32_t addr, uint8_t value, uint32_t len);
+
+/**
+ * @brief Copies device memory, using the device CPU.
+ *
+ * Like memcpy(), the ranges may not overlap; neither may overlap the memory above the data start
+ * address where the payloads run.
+ *
+ * @param ctx The context structure that holds the necessary information for the operation.
+ * @param dst Destination address.
+ * @param src Source address.
+ * @param len Number of bytes to copy.
+ * @return EFEX_ERR_SUCCESS on success, or an error code from enum sunxi_efex_error_t on failure
+ */
+int sunxi_efex_fel_memcpy(const struct sunxi_efex_ctx_t *ctx, uint32_t dst, uint32_t src, uint32_t len);
+
+/**
+ * @brief Computes the CRC32 of device memory, using the device CPU.
+ *
+ * The CRC is the one of zlib's crc32() and sunxi_efex_crc32(), so it can be compared with the CRC of
+ * the data the host sent. Only the payload crosses USB, checking a write this way costs milliseconds
+ * where reading the data back costs as long as the write did. The range may not overlap the memory
+ * above the data start address where the payloads run.
+ *
+ * @param ctx The context structure that holds the necessary information for the operation.
+ * @param addr Start of the memory to checksum.
+ * @param len Number of bytes to checksum.
+ * @param crc Receives the CRC32 of the memory.
+ * @return EFEX_ERR_SUCCESS on success, or an error code from enum sunxi_efex_error_t on failure
+ */
+int sunxi_efex_fel_crc32(const struct sunxi_efex_ctx_t *ctx, uint32_t addr, uint32_t len, uint32_t *crc);
+
+/**
+ * @brief Runs a payload whose parameters follow its code, uploading the code only if it is not resident.
+ *
+ * The payload is placed in a slot above the data start address, or in the area behind the slots
+ * when code, parameters and result take more than SUNXI_EFEX_PAYLOAD_SLOT_SIZE bytes. When the same code is already in
+ * a slot from an earlier call only the parameters are written, otherwise code and parameters go
+ * in one write. The payload is then executed and result_len bytes following the parameters are
+ * read back. Used by the architecture payloads.
+ *
+ * @param ctx The context structure that holds the necessary information for the operation.
+ * @param code Payload code, at most SUNXI_EFEX_PAYLOAD_AREA_SIZE bytes with parameters and result.
+ * @param code_len Size of the code in bytes, a multiple of 4.
+ * @param params Parameter words the code loads, placed right after it.
+ * @param params_len Size of the parameters in bytes.
+ * @param result Receives the words the code stores after its parameters, may be NULL.
+ * @param result_len Size of the result in bytes.
+ * @return EFEX_ERR_SUCCESS on success, or an error code from enum sunxi_efex_error_t on failure
+ */
+int sunxi_efex_fel_payloads_run(const struct sunxi_efex_ctx_t *ctx, const uint32_t *code, size_t code_len,
+                                const void *params, size_t params_len, void *result, size_t result_len);
+
+/**
+ * @brief Forgets the payloads resident on the device.
+ *
+ * Called by sunxi_efex_init(), as a device that was just verified may have been reset.
+ * Allocates the tracking state of a context in FEL mode.
+ *
+ * @param ctx The context structure.
+ */
+void sunxi_efex_fel_payloads_reset(struct sunxi_efex_ctx_t *ctx);
+
+/**
+ * @brief Drops the resident payloads that overlap a memory range written by the host.
+ *
+ * Also called for the stores of writel, writel_batch and register sequences, which run on the
+ * device but may hit the payload area all the same.
+ *
+ * @param ctx The context structure.
+ * @param addr Start of the written range.
+ * @param len Length of the written range.
+ */
+void sunxi_efex_fel_payloads_invalidate(const struct sunxi_efex_ctx_t *ctx, uint32_t addr, uint64_t len);
+
+/**
+ * @brief Checks whether an address is the entry of a resident payload.
+ *
+ * Executing any other code may overwrite the payloads, so sunxi_efex_fel_exec() drops them.
+ *
+ * @param ctx The context structure.
+ * @param addr Address about to be executed.
+ * @return Non-zero if a payload is resident at addr.
+ */
+int sunxi_efex_fel_payloads_resident(const struct sunxi_efex_ctx_t *ctx, uint32_t addr);
+
+/**
+ * @brief Frees the payload tracking state of a context, called by sunxi_efex_ctx_release().
+ *
+ * @param ctx The context structure.
+ */
+void sunxi_efex_fel_payloads_release(struct sunxi_efex_ctx_t *ctx);
+
 
 #ifdef __cplusplus
 }
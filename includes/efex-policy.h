@@ -0,0 +1,135 @@
+#ifndef LIBEFEX_EFEX_POLICY_H
+#define LIBEFEX_EFEX_POLICY_H
+
+#ifdef __cplusplus
+extern "C" {
+
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "efex-protocol.h"
+
+/**
+ * @brief Number of per-command timeout overrides a policy holds
+ */
+#define SUNXI_EFEX_POLICY_CMD_TIMEOUTS (8)
+
+/**
+ * @brief Timeout used for reading leftover IN data while recovering, in milliseconds
+ */
+#define SUNXI_EFEX_POLICY_DRAIN_TIMEOUT (100)
+
+/**
+ * @brief Timeout override for one command
+ */
+struct sunxi_efex_cmd_timeout_t {
+	uint32_t cmd;        /**< enum sunxi_efex_cmd_t value, 0 marks an unused entry */
+	uint32_t timeout_ms; /**< Base timeout of every transfer of this command */
+};
+
+/**
+ * @brief Counters updated by the library whenever the policy is applied
+ */
+struct sunxi_efex_policy_stats_t {
+	uint64_t retries;     /**< Chunks issued again after a failure */
+	uint64_t recovered;   /**< Chunks that succeeded after at least one retry */
+	uint64_t failed;      /**< Chunks given up on */
+	uint64_t timeouts;    /**< Failures that were timeouts */
+	uint64_t clear_halts; /**< Endpoint halts cleared during recovery */
+};
+
+/**
+ * @brief Per-context timeout, retry and recovery policy
+ *
+ * Owned by the caller and attached with sunxi_efex_set_policy(); it must outlive the attachment.
+ * Initialize it with sunxi_efex_policy_init() and adjust the fields. The library only writes to
+ * `stats`.
+ */
+struct sunxi_efex_policy_t {
+	uint32_t timeout_ms;         /**< Base timeout of every transfer, 0 for DEFAULT_USB_TIMEOUT */
+	uint32_t timeout_per_mib_ms; /**< Added to the timeout of a transfer per MiB of data */
+	struct sunxi_efex_cmd_timeout_t cmd_timeouts[SUNXI_EFEX_POLICY_CMD_TIMEOUTS]; /**< Overrides of timeout_ms */
+	uint32_t max_retries;        /**< Times a failed FEL/FES chunk is issued again, 0 disables retries */
+	uint32_t retry_delay_ms;     /**< Pause after recovery before the chunk is issued again */
+	/**
+	 * @brief Called before every retry, may be NULL
+	 *
+	 * @param ctx Context the chunk failed on
+	 * @param cmd Command of the chunk
+	 * @param addr Address of the chunk
+	 * @param attempt Number of the retry about to be made, starting at 1
+	 * @param error Error the chunk failed with
+	 * @param arg The policy's arg field
+	 */
+	void (*on_retry)(const struct sunxi_efex_ctx_t *ctx, uint32_t cmd, uint32_t addr, uint32_t attempt, int error,
+	                 void *arg);
+	void *arg;                              /**< Passed to on_retry */
+	struct sunxi_efex_policy_stats_t stats; /**< Updated by the library */
+};
+
+/**
+ * @brief Initialize a policy with the library defaults.
+ *
+ * The defaults match a context without policy: DEFAULT_USB_TIMEOUT for every transfer and no
+ * retries.
+ *
+ * @param[out] policy Policy to initialize.
+ */
+void sunxi_efex_policy_init(struct sunxi_efex_policy_t *policy);
+
+/**
+ * @brief Attach a policy to a context.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[in] policy Policy to attach, or NULL to go back to the defaults.
+ * @return EFEX_ERR_SUCCESS on success, or an error code on failure.
+ */
+int sunxi_efex_set_policy(struct sunxi_efex_ctx_t *ctx, struct sunxi_efex_policy_t *policy);
+
+/**
+ * @brief Timeout of a transfer under the context's policy.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[in] cmd Command the transfer belongs to, 0 when not known.
+ * @param[in] len Data phase length in bytes, 0 for protocol headers only.
+ * @return Timeout in milliseconds.
+ */
+uint32_t sunxi_efex_policy_timeout(const struct sunxi_efex_ctx_t *ctx, uint32_t cmd, size_t len);
+
+/**
+ * @brief Account for the outcome of a chunk and decide whether to retry it.
+ *
+ * On a retryable failure within the retry budget the endpoints are recovered (see
+ * sunxi_efex_recover()), on_retry is called and the retry delay is waited. Successes after a
+ * retry and final failures are counted too.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[in] cmd Command of the chunk.
+ * @param[in] addr Address of the chunk.
+ * @param[in] attempt Retries already made for this chunk.
+ * @param[in] error Result of the chunk.
+ * @return 1 if the chunk should be issued again, 0 otherwise.
+ */
+int sunxi_efex_policy_check(const struct sunxi_efex_ctx_t *ctx, uint32_t cmd, uint32_t addr, uint32_t attempt,
+                            int error);
+
+/**
+ * @brief Bring the endpoints back to a usable state after a failed transfer.
+ *
+ * Clears a halt on both bulk endpoints and reads away whatever the device still had queued on
+ * the IN endpoint, so the next transaction starts with a fresh AWUC/AWUS exchange. A device
+ * that was left waiting for OUT data cannot be resynchronized from the host; the next
+ * transaction then fails its AWUS check and counts as another attempt.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @return EFEX_ERR_SUCCESS on success, or an error code on failure.
+ */
+int sunxi_efex_recover(const struct sunxi_efex_ctx_t *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //LIBEFEX_EFEX_POLICY_H
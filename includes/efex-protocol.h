@@ -52,10 +52,11 @@ enum sunxi_efex_error_t {
 	EFEX_ERR_CRC_MISMATCH = -51, /**< CRC mismatch error */
 
 	/* File Operation Errors */
-	EFEX_ERR_FILE_OPEN = -60,  /**< Failed to open file */
-	EFEX_ERR_FILE_READ = -61,  /**< Failed to read file */
-	EFEX_ERR_FILE_WRITE = -62, /**< Failed to write file */
-	EFEX_ERR_FILE_SIZE = -63,  /**< File size error */
+	EFEX_ERR_FILE_OPEN = -60,   /**< Failed to open file */
+	EFEX_ERR_FILE_READ = -61,   /**< Failed to read file */
+	EFEX_ERR_FILE_WRITE = -62,  /**< Failed to write file */
+	EFEX_ERR_FILE_SIZE = -63,   /**< File size error */
+	EFEX_ERR_FILE_FORMAT = -64, /**< Unrecognized or corrupt file contents */
 };
 
 
@@ -245,6 +246,16 @@ struct sunxi_efex_device_resp_t {
 	uint8_t reserved[8];
 };
 
+struct sunxi_efex_buffer_pool_t;
+struct sunxi_efex_chunk_tuner_t;
+struct sunxi_efex_payload_cache_t;
+struct sunxi_efex_policy_t;
+struct sunxi_efex_stats_t;
+struct sunxi_efex_trace_t;
+struct sunxi_efex_recorder_t;
+struct usb_backend_ops;
+struct payloads_ops;
+
 struct sunxi_efex_ctx_t {
 	void *hdl;
 	void *usb_context;
@@ -252,6 +263,22 @@ struct sunxi_efex_ctx_t {
 	int epout;
 	int epin;
 	struct sunxi_efex_device_resp_t resp;
+	int queue_depth; /* URBs kept in flight per data phase, 0 or 1 for synchronous transfers */
+	int fel_pipeline; /* Queue all USB phases of FEL read/write chunks at once */
+	int fel_verify; /* Check FEL writes with the CRC32 payload, see sunxi_efex_fel_set_verify */
+	struct sunxi_efex_buffer_pool_t *buffer_pool; /* Transfer buffers from sunxi_efex_buffer_alloc, released by sunxi_usb_exit */
+	uint32_t chunk_size; /* Bytes per FEL/FES transaction, 0 for EFEX_CODE_MAX_SIZE */
+	uint32_t chunk_limit; /* Largest chunk the device accepted when probed, 0 if not probed */
+	struct sunxi_efex_chunk_tuner_t *chunk_tuner; /* Per command type auto-tuning state, NULL when disabled */
+	struct sunxi_efex_policy_t *policy; /* Caller-owned timeout and retry policy, NULL for the defaults */
+	const struct usb_backend_ops *usb_ops; /* Backend the device is opened with, bound on first scan */
+	const struct payloads_ops *payload; /* FEL payloads of this context, NULL for the process default */
+	void (*on_progress)(const struct sunxi_efex_ctx_t *ctx, size_t done, void *arg); /* Per confirmed chunk, optional */
+	void *progress_arg; /* Passed to on_progress */
+	struct sunxi_efex_stats_t *stats; /* Transfer statistics, NULL unless enabled with sunxi_efex_stats_enable */
+	struct sunxi_efex_trace_t *trace; /* Transaction trace ring, NULL unless enabled with sunxi_efex_trace_enable */
+	struct sunxi_efex_recorder_t *record; /* Caller-owned transfer recorder, NULL unless attached, kept by sunxi_usb_exit */
+	struct sunxi_efex_payload_cache_t *payload_cache; /* FEL payloads resident on the device, set up by sunxi_efex_init */
 };
 
 
@@ -0,0 +1,134 @@
+#ifndef LIBEFEX_EFEX_RECORD_H
+#define LIBEFEX_EFEX_RECORD_H
+
+#ifdef __cplusplus
+extern "C" {
+
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "efex-protocol.h"
+
+/*
+ * A recorder captures every bulk transfer a context makes, payload, result and duration, into a
+ * file. The replay backend (USB_BACKEND_REPLAY) then stands in for the device and serves the
+ * recorded responses, so a session can be rerun deterministically without the board.
+ */
+
+/**
+ * @brief Magic at the start of a recording, "EFXR"
+ */
+#define SUNXI_EFEX_RECORD_MAGIC (0x52584645)
+#define SUNXI_EFEX_RECORD_VERSION (1)
+
+/**
+ * @brief Recorder flags
+ */
+enum sunxi_efex_record_flags_t {
+	/** Do not store host-to-device payloads; replay then only checks transfer lengths */
+	SUNXI_EFEX_RECORD_NO_OUT_DATA = 0x1,
+};
+
+/**
+ * @brief How fast the replay backend serves transfers
+ */
+enum sunxi_efex_replay_speed_t {
+	SUNXI_EFEX_REPLAY_FAST = 0,     /**< As fast as possible, only host-side time remains */
+	SUNXI_EFEX_REPLAY_RECORDED = 1, /**< Every transfer takes as long as it did on the device */
+};
+
+/**
+ * @brief Header of a recording
+ *
+ * Followed by one struct sunxi_efex_record_xfer_t per transfer, each followed by len bytes of
+ * payload when data is set. All fields are little-endian.
+ */
+struct sunxi_efex_record_file_t {
+	uint32_t magic;   /**< SUNXI_EFEX_RECORD_MAGIC */
+	uint16_t version; /**< SUNXI_EFEX_RECORD_VERSION */
+	uint16_t flags;   /**< enum sunxi_efex_record_flags_t the recording was made with */
+};
+
+/**
+ * @brief One recorded bulk transfer
+ */
+struct sunxi_efex_record_xfer_t {
+	uint64_t ts_us;  /**< Start, microseconds since the recorder was opened */
+	uint64_t len;    /**< Transfer length */
+	uint32_t dur_us; /**< Time the transfer took */
+	int32_t status;  /**< Result of the transfer */
+	uint8_t ep;      /**< Endpoint address, bit 7 set for IN */
+	uint8_t data;    /**< 1 if len bytes of payload follow */
+	uint16_t reserved;
+};
+
+struct sunxi_efex_recorder_t;
+
+/**
+ * @brief Create a recording file.
+ *
+ * @param[in] path Output file.
+ * @param[in] flags enum sunxi_efex_record_flags_t values.
+ * @param[out] rec Receives the recorder.
+ * @return EFEX_ERR_SUCCESS on success, or an error code on failure.
+ */
+int sunxi_efex_record_open(const char *path, uint32_t flags, struct sunxi_efex_recorder_t **rec);
+
+/**
+ * @brief Record the transfers of a context from now on.
+ *
+ * The context does not own the recorder: it stays attached across sunxi_usb_exit() and a new
+ * scan, so a session that reconnects to the device is recorded as one stream. A recorder takes
+ * the transfers of one context at a time. While recording, transfer chains run one transfer
+ * after the other.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[in] rec Recorder, NULL to stop recording.
+ * @return EFEX_ERR_SUCCESS on success, or an error code on failure.
+ */
+int sunxi_efex_record_attach(struct sunxi_efex_ctx_t *ctx, struct sunxi_efex_recorder_t *rec);
+
+/**
+ * @brief Flush and close a recording. Detach it from its context first.
+ *
+ * @param[in] rec Recorder, may be NULL.
+ * @return EFEX_ERR_SUCCESS on success, EFEX_ERR_FILE_WRITE if any part of the recording was lost.
+ */
+int sunxi_efex_record_close(struct sunxi_efex_recorder_t *rec);
+
+/**
+ * @brief Record one bulk transfer. Used by the USB layer.
+ *
+ * @param[in] rec Recorder.
+ * @param[in] ep Endpoint address.
+ * @param[in] buf Payload.
+ * @param[in] len Transfer length.
+ * @param[in] start Start time from sunxi_efex_time_us().
+ * @param[in] usec Time the transfer took.
+ * @param[in] status Result of the transfer.
+ */
+void sunxi_efex_record_xfer(struct sunxi_efex_recorder_t *rec, int ep, const void *buf, size_t len, uint64_t start,
+                            uint64_t usec, int status);
+
+/**
+ * @brief Set the recording the replay backend (USB_BACKEND_REPLAY) serves.
+ *
+ * The backend presents one device on bus 0, port 1 while the recording has transfers left.
+ * Reopening the device continues where the previous session stopped, matching recordings that
+ * span a reconnect. A transfer that does not match the recording, in direction, length or
+ * stored payload, fails with EFEX_ERR_USB_TRANSFER and so do all later ones.
+ *
+ * @param[in] path Recording, NULL to close the current one.
+ * @param[in] speed How fast to serve transfers.
+ * @return EFEX_ERR_SUCCESS on success, EFEX_ERR_FILE_OPEN or EFEX_ERR_FILE_READ if the recording
+ *         cannot be used, or another error code on failure.
+ */
+int sunxi_usb_replay_configure(const char *path, enum sunxi_efex_replay_speed_t speed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //LIBEFEX_EFEX_RECORD_H
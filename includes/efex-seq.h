@@ -0,0 +1,144 @@
+#ifndef LIBEFEX_EFEX_SEQ_H
+#define LIBEFEX_EFEX_SEQ_H
+
+#ifdef __cplusplus
+extern "C" {
+
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "efex-protocol.h"
+
+/*
+ * A register sequence is a short program of writes, reads, read-modify-writes, polls and delays
+ * that an interpreter payload runs on the device. The whole sequence costs one FEL write, one exec
+ * and one FEL read, where polling from the host takes a USB round trip per iteration.
+ */
+
+/**
+ * @brief Operations a sequence holds at most, with the interpreter they fill the payload area
+ */
+#define SUNXI_EFEX_SEQ_MAX_OPS (128)
+
+/**
+ * @brief Operation codes understood by the interpreter payloads
+ */
+enum sunxi_efex_seq_opcode_t {
+	SUNXI_EFEX_SEQ_END = 0,    /**< End of the sequence */
+	SUNXI_EFEX_SEQ_WRITE = 1,  /**< *addr = arg[0] */
+	SUNXI_EFEX_SEQ_READ = 2,   /**< Store *addr in the next read slot */
+	SUNXI_EFEX_SEQ_MODIFY = 3, /**< *addr = (*addr & ~arg[0]) | arg[1] */
+	SUNXI_EFEX_SEQ_POLL = 4,   /**< Read addr until (*addr & arg[0]) == arg[1], at most arg[2] times */
+	SUNXI_EFEX_SEQ_DELAY = 5,  /**< Spin for arg[0] loop iterations */
+};
+
+/**
+ * @brief One operation, sent to the device as five little-endian words
+ */
+struct sunxi_efex_seq_op_t {
+	uint32_t op;     /**< enum sunxi_efex_seq_opcode_t */
+	uint32_t addr;   /**< Register address, unused by SUNXI_EFEX_SEQ_DELAY */
+	uint32_t arg[3]; /**< Operands, see enum sunxi_efex_seq_opcode_t */
+};
+
+/**
+ * @brief A sequence being built, initialize with sunxi_efex_seq_init()
+ */
+struct sunxi_efex_seq_t {
+	struct sunxi_efex_seq_op_t ops[SUNXI_EFEX_SEQ_MAX_OPS];
+	size_t count; /**< Operations added */
+	size_t reads; /**< SUNXI_EFEX_SEQ_READ operations among them */
+	int error;    /**< First error of the builder calls, reported again by sunxi_efex_fel_seq_run() */
+};
+
+/**
+ * @brief Empties a sequence.
+ *
+ * @param seq The sequence.
+ */
+void sunxi_efex_seq_init(struct sunxi_efex_seq_t *seq);
+
+/**
+ * @brief Appends a 32-bit register write.
+ *
+ * The builder calls fail with EFEX_ERR_INVALID_PARAM once the sequence is full. The error sticks
+ * to the sequence, so a chain of calls can be checked once when the sequence is run.
+ *
+ * @param seq The sequence.
+ * @param addr Register address.
+ * @param value Value to write.
+ * @return EFEX_ERR_SUCCESS on success, or an error code from enum sunxi_efex_error_t on failure
+ */
+int sunxi_efex_seq_write(struct sunxi_efex_seq_t *seq, uint32_t addr, uint32_t value);
+
+/**
+ * @brief Appends a 32-bit register read, its value is returned by sunxi_efex_fel_seq_run().
+ *
+ * @param seq The sequence.
+ * @param addr Register address.
+ * @return EFEX_ERR_SUCCESS on success, or an error code from enum sunxi_efex_error_t on failure
+ */
+int sunxi_efex_seq_read(struct sunxi_efex_seq_t *seq, uint32_t addr);
+
+/**
+ * @brief Appends a read-modify-write that clears and then sets bits of a register.
+ *
+ * @param seq The sequence.
+ * @param addr Register address.
+ * @param clear Bits to clear.
+ * @param set Bits to set.
+ * @return EFEX_ERR_SUCCESS on success, or an error code from enum sunxi_efex_error_t on failure
+ */
+int sunxi_efex_seq_modify(struct sunxi_efex_seq_t *seq, uint32_t addr, uint32_t clear, uint32_t set);
+
+/**
+ * @brief Appends a wait for register bits to reach a value.
+ *
+ * When the register does not match after tries reads the sequence stops there, and
+ * sunxi_efex_fel_seq_run() reports EFEX_ERR_DEVICE_NOT_READY.
+ *
+ * @param seq The sequence.
+ * @param addr Register address.
+ * @param mask Bits to compare.
+ * @param value Value the masked bits must reach.
+ * @param tries Reads before giving up, at least 1.
+ * @return EFEX_ERR_SUCCESS on success, or an error code from enum sunxi_efex_error_t on failure
+ */
+int sunxi_efex_seq_poll(struct sunxi_efex_seq_t *seq, uint32_t addr, uint32_t mask, uint32_t value, uint32_t tries);
+
+/**
+ * @brief Appends a busy-wait.
+ *
+ * A loop iteration takes a few CPU cycles at whatever clock the boot ROM left the core at, so
+ * delays are approximate; pick generous counts for settling times.
+ *
+ * @param seq The sequence.
+ * @param loops Loop iterations to spin.
+ * @return EFEX_ERR_SUCCESS on success, or an error code from enum sunxi_efex_error_t on failure
+ */
+int sunxi_efex_seq_delay(struct sunxi_efex_seq_t *seq, uint32_t loops);
+
+/**
+ * @brief Runs a sequence on the device with the interpreter payload of the context.
+ *
+ * Requires FEL mode. The sequence is sent with the interpreter in one write, executed once and
+ * its results are read back in one read.
+ *
+ * @param ctx The context structure.
+ * @param seq The sequence to run.
+ * @param reads Receives the values of the SUNXI_EFEX_SEQ_READ operations in order, seq->reads entries;
+ *              may be NULL when the sequence reads nothing.
+ * @param done Receives the number of operations that completed, may be NULL.
+ * @return EFEX_ERR_SUCCESS when all operations completed, EFEX_ERR_DEVICE_NOT_READY when a poll gave up,
+ *         or another error code from enum sunxi_efex_error_t on failure
+ */
+int sunxi_efex_fel_seq_run(const struct sunxi_efex_ctx_t *ctx, const struct sunxi_efex_seq_t *seq, uint32_t *reads,
+                           size_t *done);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBEFEX_EFEX_SEQ_H
@@ -0,0 +1,181 @@
+#ifndef LIBEFEX_EFEX_SIM_H
+#define LIBEFEX_EFEX_SIM_H
+
+#ifdef __cplusplus
+extern "C" {
+
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "efex-protocol.h"
+
+/*
+ * In-memory model of a Sunxi device in FEL or FES mode. It speaks the device side of the
+ * AWUC/AWUS framing and of the FEL and FES commands, and is fed with the bulk transfers a host
+ * would put on the wire. The simulated USB backend (USB_BACKEND_SIM) drives one model per
+ * opened device; anything else that sees the raw transfers can drive it too.
+ */
+
+/**
+ * @brief Chip ID reported by a simulated device unless configured otherwise
+ */
+#define SUNXI_EFEX_SIM_CHIP_ID (0x00185900)
+
+/**
+ * @brief Flash size of a simulated device unless configured otherwise, in bytes
+ */
+#define SUNXI_EFEX_SIM_FLASH_SIZE (1ULL << 30)
+
+/**
+ * @brief Flag of a FES verify response holding a valid checksum
+ */
+#define SUNXI_EFEX_SIM_VERIFY_FLAG (0x6a617603)
+
+struct sunxi_efex_sim_t;
+
+/**
+ * @brief Simulated device configuration
+ */
+struct sunxi_efex_sim_config_t {
+	uint16_t mode;           /**< DEVICE_MODE_FEL or DEVICE_MODE_SRV */
+	uint32_t chip_id;        /**< Reported by EFEX_CMD_VERIFY_DEVICE */
+	uint32_t storage_type;   /**< Reported by EFEX_CMD_FES_QUERY_STORAGE */
+	const char *flash_path;  /**< Flash image file, created if missing; NULL keeps flash in memory */
+	uint64_t flash_size;     /**< Flash size in bytes, 0 for the image size or SUNXI_EFEX_SIM_FLASH_SIZE */
+	uint32_t latency_us;     /**< Added to every bulk transfer by the simulated backend */
+	uint64_t bandwidth;      /**< Bytes per second the simulated backend moves, 0 for unlimited */
+	/**
+	 * @brief Called on EFEX_CMD_FEL_EXEC, may be NULL
+	 *
+	 * The model does not run code; a hook can emulate what the code at addr would do through
+	 * sunxi_efex_sim_mem_read()/sunxi_efex_sim_mem_write(), or switch the device to FES mode.
+	 * A non-zero return is reported to the host as a failed status.
+	 */
+	int (*on_exec)(struct sunxi_efex_sim_t *sim, uint32_t addr, void *arg);
+	void *arg; /**< Passed to on_exec */
+};
+
+/**
+ * @brief Fill a configuration with the defaults: FEL mode, in-memory flash, no latency limits.
+ *
+ * @param[out] config Configuration to fill.
+ */
+void sunxi_efex_sim_config_init(struct sunxi_efex_sim_config_t *config);
+
+/**
+ * @brief Create a simulated device.
+ *
+ * @param[in] config Configuration, copied; flash_path is only used here.
+ * @param[out] sim Receives the device.
+ * @return EFEX_ERR_SUCCESS on success, EFEX_ERR_FILE_OPEN if the flash image cannot be opened,
+ *         or another error code on failure.
+ */
+int sunxi_efex_sim_create(const struct sunxi_efex_sim_config_t *config, struct sunxi_efex_sim_t **sim);
+
+/**
+ * @brief Destroy a simulated device, flushing its flash image.
+ *
+ * @param[in] sim Device, may be NULL.
+ */
+void sunxi_efex_sim_destroy(struct sunxi_efex_sim_t *sim);
+
+/**
+ * @brief Feed a host-to-device bulk transfer to the device.
+ *
+ * Headers must arrive in one transfer each; data phases may be split across any number.
+ *
+ * @param[in] sim Device.
+ * @param[in] buf Data sent by the host.
+ * @param[in] len Length of data.
+ * @return EFEX_ERR_SUCCESS on success, EFEX_ERR_USB_TRANSFER if the device did not expect the
+ *         transfer (a real device stalls then).
+ */
+int sunxi_efex_sim_out(struct sunxi_efex_sim_t *sim, const char *buf, size_t len);
+
+/**
+ * @brief Serve a device-to-host bulk transfer.
+ *
+ * @param[in] sim Device.
+ * @param[out] buf Receives the data.
+ * @param[in] len Length the host asks for.
+ * @return EFEX_ERR_SUCCESS on success, EFEX_ERR_USB_TIMEOUT if the device has nothing to send
+ *         (a real device keeps NAKing then), EFEX_ERR_USB_TRANSFER if it has less than len.
+ */
+int sunxi_efex_sim_in(struct sunxi_efex_sim_t *sim, char *buf, size_t len);
+
+/**
+ * @brief Tell which transfer the device is ready for next.
+ *
+ * For transports that move data on the device's initiative, like a USB gadget, which cannot see
+ * the length the host asked for.
+ *
+ * @param[in] sim Device.
+ * @param[out] in Receives 1 if the device has data for the host, 0 if it waits for host data.
+ * @return Bytes left in the current data or status phase; when waiting for a command, the
+ *         length of the largest command header, which always arrives as a short transfer.
+ */
+size_t sunxi_efex_sim_next(const struct sunxi_efex_sim_t *sim, int *in);
+
+/**
+ * @brief Drop the transaction in progress, as a halt/stall recovery does on real hardware.
+ *
+ * @param[in] sim Device.
+ */
+void sunxi_efex_sim_reset(struct sunxi_efex_sim_t *sim);
+
+/**
+ * @brief Switch the mode the device reports, e.g. from an on_exec hook.
+ *
+ * @param[in] sim Device.
+ * @param[in] mode DEVICE_MODE_FEL or DEVICE_MODE_SRV.
+ */
+void sunxi_efex_sim_set_mode(struct sunxi_efex_sim_t *sim, uint16_t mode);
+
+/**
+ * @brief Read simulated device memory, unwritten memory reads as zero.
+ *
+ * @param[in] sim Device.
+ * @param[in] addr Device address.
+ * @param[out] buf Receives the data.
+ * @param[in] len Bytes to read.
+ */
+void sunxi_efex_sim_mem_read(const struct sunxi_efex_sim_t *sim, uint32_t addr, void *buf, size_t len);
+
+/**
+ * @brief Write simulated device memory.
+ *
+ * @param[in] sim Device.
+ * @param[in] addr Device address.
+ * @param[in] buf Data to write.
+ * @param[in] len Bytes to write.
+ * @return EFEX_ERR_SUCCESS on success, EFEX_ERR_MEMORY if the memory model cannot grow.
+ */
+int sunxi_efex_sim_mem_write(struct sunxi_efex_sim_t *sim, uint32_t addr, const void *buf, size_t len);
+
+/**
+ * @brief Get the configuration a device was created with.
+ *
+ * @param[in] sim Device.
+ * @return Configuration, flash_path is NULL.
+ */
+const struct sunxi_efex_sim_config_t *sunxi_efex_sim_config(const struct sunxi_efex_sim_t *sim);
+
+/**
+ * @brief Configure the devices the simulated USB backend (USB_BACKEND_SIM) presents.
+ *
+ * Devices sit on bus 0, ports 1 to devices, and every open creates a fresh device from the
+ * configuration (sharing the flash image file if one is set). Must not race with scans.
+ *
+ * @param[in] config Configuration, copied; NULL for the defaults.
+ * @param[in] devices Number of devices, 0 for none.
+ * @return EFEX_ERR_SUCCESS on success, or an error code on failure.
+ */
+int sunxi_usb_sim_configure(const struct sunxi_efex_sim_config_t *config, unsigned int devices);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //LIBEFEX_EFEX_SIM_H
@@ -0,0 +1,227 @@
+#ifndef LIBEFEX_EFEX_SPARSE_H
+#define LIBEFEX_EFEX_SPARSE_H
+
+#ifdef __cplusplus
+extern "C" {
+
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Sparse downloads leave out the parts of an image the target already holds. A plain image is
+ * scanned in SUNXI_EFEX_SPARSE_BLOCK blocks for runs of 0x00 or 0xFF; an Android sparse image
+ * (.simg) says so itself with FILL and DONT_CARE chunks. Either way only the rest goes over USB.
+ *
+ * Sparse sinks do the reverse for dumps, writing uniform blocks as file holes or FILL chunks.
+ */
+
+/**
+ * @brief Granularity at which plain images are classified, a multiple of the 512-byte flash sector
+ */
+#define SUNXI_EFEX_SPARSE_BLOCK (4096)
+
+/**
+ * @brief Blank runs shorter than this are sent anyway, one more transaction would cost more than the data
+ */
+#define SUNXI_EFEX_SPARSE_MIN_SKIP (64 * 1024)
+
+/**
+ * @brief Bytes of a FILL chunk expanded at a time when its pattern has to be sent
+ */
+#define SUNXI_EFEX_SPARSE_FILL_SIZE (1024 * 1024)
+
+/**
+ * @brief Contents of a block, and what a target reads as where nothing is written
+ */
+enum sunxi_efex_sparse_fill_t {
+	SUNXI_EFEX_SPARSE_DATA = 0,   /**< Mixed contents; as target state nothing is assumed, only DONT_CARE is skipped */
+	SUNXI_EFEX_SPARSE_ZERO = 1,   /**< All bytes 0x00 */
+	SUNXI_EFEX_SPARSE_ERASED = 2, /**< All bytes 0xFF, as erased NAND or NOR */
+};
+
+/**
+ * @brief Classifies a buffer by its contents.
+ *
+ * Uses SSE2 or NEON where available and stops at the first 256 bytes that rule out both blank
+ * patterns, so data blocks cost little more than their first cache lines.
+ *
+ * @param buf The data.
+ * @param len Its length, 0 classifies as SUNXI_EFEX_SPARSE_DATA.
+ * @return SUNXI_EFEX_SPARSE_ZERO, SUNXI_EFEX_SPARSE_ERASED or SUNXI_EFEX_SPARSE_DATA
+ */
+enum sunxi_efex_sparse_fill_t sunxi_efex_sparse_classify(const void *buf, size_t len);
+
+/**
+ * @brief Tells whether a buffer repeats one 32-bit pattern, such as a FILL chunk would.
+ *
+ * @param buf The data.
+ * @param len Its length, a non-zero multiple of 4.
+ * @param value Receives the pattern in memory byte order, may be NULL.
+ * @return 1 if the buffer is uniform, 0 otherwise
+ */
+int sunxi_efex_sparse_uniform(const void *buf, size_t len, uint32_t *value);
+
+/**
+ * @brief Android sparse image magic, first word of the file
+ */
+#define SUNXI_EFEX_SIMG_MAGIC (0xed26ff3a)
+
+/**
+ * @brief Chunk types of an Android sparse image
+ */
+enum sunxi_efex_simg_chunk_type_t {
+	SUNXI_EFEX_SIMG_RAW = 0xcac1,       /**< Blocks of data follow the header */
+	SUNXI_EFEX_SIMG_FILL = 0xcac2,      /**< Blocks repeat a 32-bit pattern */
+	SUNXI_EFEX_SIMG_DONT_CARE = 0xcac3, /**< Blocks whose contents do not matter */
+	SUNXI_EFEX_SIMG_CRC32 = 0xcac4,     /**< CRC32 of the image up to here, no blocks */
+};
+
+/**
+ * @brief An Android sparse image being walked, set up with sunxi_efex_simg_open()
+ */
+struct sunxi_efex_simg_t {
+	const char *data;      /**< The sparse file */
+	uint64_t size;         /**< Its size in bytes */
+	uint32_t blk_sz;       /**< Block size in bytes */
+	uint32_t total_blks;   /**< Blocks of the expanded image */
+	uint32_t total_chunks; /**< Chunks in the file */
+	uint64_t pos;          /**< File offset of the next chunk header */
+	uint32_t chunk;        /**< Chunks walked */
+	uint32_t blk;          /**< Blocks walked */
+	uint16_t chunk_hdr_sz; /**< Chunk header size from the file header */
+};
+
+/**
+ * @brief One chunk of an Android sparse image
+ */
+struct sunxi_efex_simg_chunk_t {
+	enum sunxi_efex_simg_chunk_type_t type;
+	uint64_t offset;  /**< Byte offset in the expanded image */
+	uint64_t len;     /**< Bytes of the expanded image it covers, 0 for SUNXI_EFEX_SIMG_CRC32 */
+	const char *data; /**< The blocks of SUNXI_EFEX_SIMG_RAW, NULL otherwise */
+	uint32_t value;   /**< Pattern of SUNXI_EFEX_SIMG_FILL in file byte order, CRC of SUNXI_EFEX_SIMG_CRC32 */
+};
+
+/**
+ * @brief Tells whether a buffer starts with an Android sparse image header.
+ *
+ * @param data The file contents, typically a struct sunxi_efex_image_t.
+ * @param size Their size in bytes.
+ * @return 1 for a sparse image, 0 otherwise
+ */
+int sunxi_efex_simg_check(const void *data, uint64_t size);
+
+/**
+ * @brief Parses the header of an Android sparse image.
+ *
+ * The image is walked in place, data must stay valid as long as simg is used.
+ *
+ * @param simg Receives the parser state.
+ * @param data The file contents.
+ * @param size Their size in bytes.
+ * @return EFEX_ERR_SUCCESS on success, EFEX_ERR_FILE_FORMAT if the header is not a supported sparse
+ *         image header
+ */
+int sunxi_efex_simg_open(struct sunxi_efex_simg_t *simg, const void *data, uint64_t size);
+
+/**
+ * @brief Returns the next chunk of an Android sparse image.
+ *
+ * Chunk sizes are checked against the file and the block count of the header, so a truncated or
+ * corrupt image fails here rather than sending garbage.
+ *
+ * @param simg The parser state.
+ * @param chunk Receives the chunk.
+ * @return 1 when a chunk was returned, 0 after the last one, EFEX_ERR_FILE_FORMAT for a corrupt image
+ */
+int sunxi_efex_simg_next(struct sunxi_efex_simg_t *simg, struct sunxi_efex_simg_chunk_t *chunk);
+
+/**
+ * @brief Size of the expanded image in bytes.
+ */
+uint64_t sunxi_efex_simg_size(const struct sunxi_efex_simg_t *simg);
+
+/**
+ * @brief Output formats of a sparse sink
+ */
+enum sunxi_efex_sparse_format_t {
+	SUNXI_EFEX_SPARSE_HOLES = 0, /**< Plain image, zero blocks left as holes the filesystem does not store */
+	SUNXI_EFEX_SPARSE_SIMG = 1,  /**< Android sparse image, uniform blocks as FILL chunks */
+};
+
+/**
+ * @brief A dump being written by sunxi_efex_sparse_sink_write(), set up with sunxi_efex_sparse_sink_open()
+ */
+struct sunxi_efex_sparse_sink_t {
+	FILE *fp;                               /**< Output file */
+	FILE *map;                              /**< Block map, NULL without one */
+	enum sunxi_efex_sparse_format_t format;
+	char block[SUNXI_EFEX_SPARSE_BLOCK];    /**< Partial block carried over between writes */
+	size_t fill;                            /**< Bytes in block */
+	uint64_t size;                          /**< Bytes dumped so far */
+	uint64_t written;                       /**< Bytes stored in the file, headers included */
+	int seek;                               /**< The file position lags behind a hole */
+	uint16_t run_type;                      /**< Chunk type of the current run, 0 before the first block */
+	uint32_t run_value;                     /**< FILL pattern of the current run */
+	uint32_t run_start;                     /**< First block of the current run */
+	uint32_t run_blocks;                    /**< Blocks in the current run */
+	uint64_t run_hdr;                       /**< File offset of the RAW chunk header of the current run */
+	uint32_t blocks;                        /**< Blocks dumped so far */
+	uint32_t chunks;                        /**< Chunks written so far */
+	int error;                              /**< First error, the sink does nothing more after one */
+};
+
+/**
+ * @brief Creates a dump file that only stores the blocks holding data.
+ *
+ * With SUNXI_EFEX_SPARSE_HOLES the file is a plain image, but all-zero blocks are seeked over rather
+ * than written, so on filesystems with sparse files they take no space and tools using SEEK_HOLE
+ * skip them. With SUNXI_EFEX_SPARSE_SIMG the file is an Android sparse image where any block that
+ * repeats a 32-bit pattern, erased 0xFF flash included, becomes part of a FILL chunk; a dump that
+ * is not a multiple of SUNXI_EFEX_SPARSE_BLOCK is padded with zeros to the next block.
+ *
+ * The optional block map is a text file listing the runs of the dump, one per line, as the first
+ * block, the number of blocks and either "data" or "fill" with the pattern in hex. A partial last
+ * block counts as a whole one, so the runs cover the entire dump.
+ *
+ * @param sink Receives the sink.
+ * @param path Path of the dump, created or truncated.
+ * @param format Output format.
+ * @param map_path Path of the block map, NULL for none.
+ * @return EFEX_ERR_SUCCESS on success, EFEX_ERR_FILE_OPEN or EFEX_ERR_FILE_WRITE on failure, with nothing left open
+ */
+int sunxi_efex_sparse_sink_open(struct sunxi_efex_sparse_sink_t *sink, const char *path,
+                                enum sunxi_efex_sparse_format_t format, const char *map_path);
+
+/**
+ * @brief A sunxi_efex_stream_writer_t appending to a sparse sink.
+ *
+ * Blocks are classified with sunxi_efex_sparse_uniform() as they complete, data blocks are written
+ * straight through.
+ *
+ * @param user The struct sunxi_efex_sparse_sink_t.
+ * @param buf Data to write.
+ * @param len Bytes to write.
+ * @return EFEX_ERR_SUCCESS on success, EFEX_ERR_FILE_WRITE or EFEX_ERR_FILE_SIZE on failure
+ */
+int sunxi_efex_sparse_sink_write(void *user, const char *buf, size_t len);
+
+/**
+ * @brief Completes the dump and closes its files.
+ *
+ * Writes out the partial last block and the final sparse image header, or extends a plain image
+ * over a trailing hole.
+ *
+ * @param sink The sink.
+ * @return EFEX_ERR_SUCCESS on success, the first error of the sink otherwise
+ */
+int sunxi_efex_sparse_sink_close(struct sunxi_efex_sparse_sink_t *sink);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBEFEX_EFEX_SPARSE_H
@@ -0,0 +1,160 @@
+#ifndef LIBEFEX_EFEX_STATS_H
+#define LIBEFEX_EFEX_STATS_H
+
+#ifdef __cplusplus
+extern "C" {
+
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "efex-protocol.h"
+
+/**
+ * @brief Number of latency histogram buckets
+ *
+ * Bucket 0 counts latencies below 2 us, bucket i latencies in [2^i, 2^(i+1)) us; the last
+ * bucket also takes everything slower.
+ */
+#define SUNXI_EFEX_STATS_BUCKETS (32)
+
+/**
+ * @brief Number of distinct commands counted per context, later ones share the last slot
+ */
+#define SUNXI_EFEX_STATS_CMDS (24)
+
+/**
+ * @brief Phases of a USB transaction timed separately
+ */
+enum sunxi_efex_stats_phase_t {
+	SUNXI_EFEX_PHASE_REQUEST = 0, /**< AWUC request header, or the FES command block */
+	SUNXI_EFEX_PHASE_DATA,        /**< Data phase; a pipelined FEL chain is timed here as a whole */
+	SUNXI_EFEX_PHASE_STATUS,      /**< AWUS status read */
+	SUNXI_EFEX_PHASE_COUNT,
+};
+
+/**
+ * @brief Transfer direction
+ */
+enum sunxi_efex_stats_dir_t {
+	SUNXI_EFEX_DIR_OUT = 0, /**< Host to device */
+	SUNXI_EFEX_DIR_IN = 1,  /**< Device to host */
+};
+
+/**
+ * @brief Log-bucketed latency histogram
+ */
+struct sunxi_efex_histogram_t {
+	uint64_t count;                             /**< Samples */
+	uint64_t total_us;                          /**< Sum of all samples */
+	uint64_t max_us;                            /**< Slowest sample */
+	uint64_t buckets[SUNXI_EFEX_STATS_BUCKETS]; /**< Samples per power-of-two bucket */
+};
+
+/**
+ * @brief Counters of one command
+ *
+ * Every bulk transfer between issuing the command and issuing the next one is accounted to it,
+ * headers and status included.
+ */
+struct sunxi_efex_cmd_stats_t {
+	uint32_t cmd;          /**< enum sunxi_efex_cmd_t value, 0 marks an unused slot */
+	uint64_t issued;       /**< Times the command was sent */
+	uint64_t transfers[2]; /**< Bulk transfers, indexed by enum sunxi_efex_stats_dir_t */
+	uint64_t bytes[2];     /**< Bytes, indexed by enum sunxi_efex_stats_dir_t */
+};
+
+/**
+ * @brief Transfer statistics of a context
+ */
+struct sunxi_efex_stats_t {
+	struct sunxi_efex_cmd_stats_t cmds[SUNXI_EFEX_STATS_CMDS];    /**< Per-command counters */
+	struct sunxi_efex_histogram_t phases[SUNXI_EFEX_PHASE_COUNT]; /**< Latency per phase */
+	uint64_t retries;                                             /**< Chunks issued again by the retry policy */
+	uint64_t timeouts;                                            /**< Bulk transfers that timed out */
+	uint64_t errors;                                              /**< Bulk transfers that failed otherwise */
+	uint32_t cmd; /**< Command the current transfers are accounted to, internal */
+};
+
+/**
+ * @brief Enable or disable statistics collection.
+ *
+ * Collection is off by default. Enabling starts from zero; disabling drops the counters.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[in] enable Non-zero to collect.
+ * @return EFEX_ERR_SUCCESS on success, or an error code on failure.
+ */
+int sunxi_efex_stats_enable(struct sunxi_efex_ctx_t *ctx, int enable);
+
+/**
+ * @brief Copy the statistics collected so far.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[out] stats Receives the statistics.
+ * @return EFEX_ERR_SUCCESS on success, EFEX_ERR_NOT_SUPPORT if collection is disabled.
+ */
+int sunxi_efex_stats_get(const struct sunxi_efex_ctx_t *ctx, struct sunxi_efex_stats_t *stats);
+
+/**
+ * @brief Reset the statistics to zero, keeping collection enabled.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @return EFEX_ERR_SUCCESS on success, EFEX_ERR_NOT_SUPPORT if collection is disabled.
+ */
+int sunxi_efex_stats_reset(struct sunxi_efex_ctx_t *ctx);
+
+/**
+ * @brief Estimate a latency percentile from a histogram.
+ *
+ * @param[in] hist Histogram.
+ * @param[in] percent Percentile, 0 to 100.
+ * @return Upper bound of the bucket holding the percentile in microseconds, 0 if empty.
+ */
+uint64_t sunxi_efex_histogram_percentile(const struct sunxi_efex_histogram_t *hist, unsigned int percent);
+
+/**
+ * @brief Start accounting transfers to a command. Used by the protocol layer.
+ */
+void sunxi_efex_stats_cmd(const struct sunxi_efex_ctx_t *ctx, uint32_t cmd);
+
+/**
+ * @brief Account one bulk transfer of a phase. Used by the USB layer.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[in] phase Transaction phase.
+ * @param[in] dir Transfer direction.
+ * @param[in] len Bytes transferred.
+ * @param[in] usec Time the transfer took.
+ * @param[in] error Result of the transfer.
+ */
+void sunxi_efex_stats_xfer(const struct sunxi_efex_ctx_t *ctx, enum sunxi_efex_stats_phase_t phase,
+                           enum sunxi_efex_stats_dir_t dir, size_t len, uint64_t usec, int error);
+
+/**
+ * @brief Count one bulk transfer without timing it. Used where transfers are timed in groups.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[in] dir Transfer direction.
+ * @param[in] len Bytes transferred.
+ */
+void sunxi_efex_stats_count(const struct sunxi_efex_ctx_t *ctx, enum sunxi_efex_stats_dir_t dir, size_t len);
+
+/**
+ * @brief Account a retry. Used by the retry policy.
+ */
+void sunxi_efex_stats_retry(const struct sunxi_efex_ctx_t *ctx);
+
+/**
+ * @brief Free the statistics of a context, called by sunxi_efex_ctx_release().
+ *
+ * @param[in] ctx Pointer to the context structure.
+ */
+void sunxi_efex_stats_release(struct sunxi_efex_ctx_t *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //LIBEFEX_EFEX_STATS_H
@@ -0,0 +1,155 @@
+#ifndef LIBEFEX_EFEX_STREAM_H
+#define LIBEFEX_EFEX_STREAM_H
+
+#ifdef __cplusplus
+extern "C" {
+
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "efex-protocol.h"
+
+/*
+ * Streaming transfers move data through a small ring of slots instead of one buffer the size of
+ * the transfer. A helper thread runs the user's reader or writer on one side of the ring while the
+ * calling thread talks to the device on the other, so file I/O overlaps the USB transfers and
+ * memory use stays at SUNXI_EFEX_STREAM_SLOTS * SUNXI_EFEX_STREAM_SLOT_SIZE whatever the size.
+ */
+
+/**
+ * @brief Slots of the ring
+ */
+#define SUNXI_EFEX_STREAM_SLOTS (3)
+
+/**
+ * @brief Bytes per slot, enough for the largest chunk
+ */
+#define SUNXI_EFEX_STREAM_SLOT_SIZE (4 * 1024 * 1024)
+
+/**
+ * @brief Alignment of the slots, enough for O_DIRECT writes
+ */
+#define SUNXI_EFEX_STREAM_ALIGN (4096)
+
+/**
+ * @brief Supplies the data of a streaming download
+ *
+ * Called from the helper thread, one call at a time.
+ *
+ * @param user The user pointer given with the callback
+ * @param buf Buffer to fill
+ * @param len Bytes wanted
+ * @return Bytes placed in buf, 1 to len; 0 if the data ended early, or a negative error code
+ */
+typedef ssize_t (*sunxi_efex_stream_reader_t)(void *user, char *buf, size_t len);
+
+/**
+ * @brief Takes the data of a streaming upload
+ *
+ * Called from the helper thread, one call at a time, with the data in order. buf is aligned to
+ * SUNXI_EFEX_STREAM_ALIGN and len is a multiple of it except for the last call.
+ *
+ * @param user The user pointer given with the callback
+ * @param buf Data received
+ * @param len Bytes in buf, all of which must be consumed
+ * @return EFEX_ERR_SUCCESS, or a negative error code that ends the upload
+ */
+typedef int (*sunxi_efex_stream_writer_t)(void *user, const char *buf, size_t len);
+
+/**
+ * @brief Moves one slot of data to or from the device, on the calling thread
+ *
+ * @param arg The argument given to sunxi_efex_stream_down() or sunxi_efex_stream_up()
+ * @param buf Slot data
+ * @param len Bytes in the slot, at most SUNXI_EFEX_STREAM_SLOT_SIZE
+ * @param last Non-zero for the last slot of the transfer
+ * @return EFEX_ERR_SUCCESS, or a negative error code that ends the transfer
+ */
+typedef int (*sunxi_efex_stream_xfer_t)(void *arg, char *buf, uint32_t len, int last);
+
+/**
+ * @brief Runs a download: reader fills slots on the helper thread, xfer sends them.
+ *
+ * Used by the FEL and FES stream functions. If the helper thread cannot be started, the calling
+ * thread reads each slot before sending it.
+ *
+ * @param reader Called for the data in order until total_len bytes are supplied
+ * @param user Passed to reader
+ * @param total_len Bytes to transfer, not 0
+ * @param xfer Sends a slot
+ * @param arg Passed to xfer
+ * @return EFEX_ERR_SUCCESS, the first error of xfer or reader, or EFEX_ERR_FILE_READ if the data ended early
+ */
+int sunxi_efex_stream_down(sunxi_efex_stream_reader_t reader, void *user, uint64_t total_len,
+                           sunxi_efex_stream_xfer_t xfer, void *arg);
+
+/**
+ * @brief Runs an upload: xfer fills slots, writer drains them on the helper thread.
+ *
+ * Slots already received when xfer fails are still handed to writer. If the helper thread cannot
+ * be started, the calling thread writes each slot out before receiving the next.
+ *
+ * @param writer Called with the data in order
+ * @param user Passed to writer
+ * @param total_len Bytes to transfer, not 0
+ * @param xfer Receives a slot
+ * @param arg Passed to xfer
+ * @return EFEX_ERR_SUCCESS, or the first error of xfer or writer
+ */
+int sunxi_efex_stream_up(sunxi_efex_stream_writer_t writer, void *user, uint64_t total_len,
+                         sunxi_efex_stream_xfer_t xfer, void *arg);
+
+/**
+ * @brief A file written by a streaming upload
+ */
+struct sunxi_efex_file_sink_t {
+#ifdef _WIN32
+	void *handle;
+#else
+	int fd;
+#endif
+	int direct;      /**< Writes currently bypass the page cache */
+	uint64_t offset; /**< Bytes written so far */
+};
+
+/**
+ * @brief Creates or truncates a file for sunxi_efex_file_sink_write().
+ *
+ * With direct set the data bypasses the page cache (O_DIRECT on Linux, F_NOCACHE on macOS), which
+ * keeps a backup of a whole eMMC from pushing everything else out of memory. Where the system or
+ * the file system refuses, and for an unaligned last write, the sink writes through the page
+ * cache instead. direct is ignored on Windows.
+ *
+ * @param sink Receives the sink.
+ * @param path Path of the file.
+ * @param direct Non-zero to bypass the page cache.
+ * @return EFEX_ERR_SUCCESS on success, EFEX_ERR_FILE_OPEN on failure
+ */
+int sunxi_efex_file_sink_open(struct sunxi_efex_file_sink_t *sink, const char *path, int direct);
+
+/**
+ * @brief A sunxi_efex_stream_writer_t appending to the file of a sink.
+ *
+ * @param user The struct sunxi_efex_file_sink_t.
+ * @param buf Data to write.
+ * @param len Bytes to write.
+ * @return EFEX_ERR_SUCCESS on success, EFEX_ERR_FILE_WRITE on failure
+ */
+int sunxi_efex_file_sink_write(void *user, const char *buf, size_t len);
+
+/**
+ * @brief Closes the file of a sink.
+ *
+ * @param sink The sink.
+ * @return EFEX_ERR_SUCCESS on success, EFEX_ERR_FILE_WRITE if the data could not be flushed
+ */
+int sunxi_efex_file_sink_close(struct sunxi_efex_file_sink_t *sink);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBEFEX_EFEX_STREAM_H
@@ -0,0 +1,208 @@
+#ifndef LIBEFEX_EFEX_THREAD_H
+#define LIBEFEX_EFEX_THREAD_H
+
+#ifdef __cplusplus
+extern "C" {
+
+#endif
+
+/*
+ * Minimal threading primitives shared by the library, so the rest of the code does not have to
+ * care whether it runs on Win32 or pthreads. Mutexes can be initialized statically with
+ * SUNXI_EFEX_MUTEX_INIT. Condition variables wait on those mutexes. Thread functions follow the
+ * pthread signature on every platform.
+ * The 64-bit atomics load with acquire and store with release semantics.
+ */
+
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+
+typedef SRWLOCK sunxi_efex_mutex_t;
+#define SUNXI_EFEX_MUTEX_INIT SRWLOCK_INIT
+
+typedef CONDITION_VARIABLE sunxi_efex_cond_t;
+
+typedef HANDLE sunxi_efex_thread_t;
+
+static inline void sunxi_efex_mutex_init(sunxi_efex_mutex_t *m) {
+	InitializeSRWLock(m);
+}
+
+static inline void sunxi_efex_mutex_destroy(sunxi_efex_mutex_t *m) {
+	(void) m;
+}
+
+static inline void sunxi_efex_mutex_lock(sunxi_efex_mutex_t *m) {
+	AcquireSRWLockExclusive(m);
+}
+
+static inline void sunxi_efex_mutex_unlock(sunxi_efex_mutex_t *m) {
+	ReleaseSRWLockExclusive(m);
+}
+
+static inline void sunxi_efex_cond_init(sunxi_efex_cond_t *c) {
+	InitializeConditionVariable(c);
+}
+
+static inline void sunxi_efex_cond_destroy(sunxi_efex_cond_t *c) {
+	(void) c;
+}
+
+static inline void sunxi_efex_cond_wait(sunxi_efex_cond_t *c, sunxi_efex_mutex_t *m) {
+	SleepConditionVariableSRW(c, m, INFINITE, 0);
+}
+
+static inline void sunxi_efex_cond_broadcast(sunxi_efex_cond_t *c) {
+	WakeAllConditionVariable(c);
+}
+
+static inline void sunxi_efex_sleep_ms(const uint32_t ms) {
+	Sleep(ms);
+}
+
+// Sleep has millisecond granularity, shorter waits round up
+static inline void sunxi_efex_sleep_us(const uint64_t us) {
+	Sleep((DWORD) ((us + 999) / 1000));
+}
+
+struct sunxi_efex_thread_start_t {
+	void *(*fn)(void *);
+	void *arg;
+};
+
+static inline DWORD WINAPI sunxi_efex_thread_trampoline(LPVOID param) {
+	struct sunxi_efex_thread_start_t start = *(struct sunxi_efex_thread_start_t *) param;
+	HeapFree(GetProcessHeap(), 0, param);
+	start.fn(start.arg);
+	return 0;
+}
+
+static inline int sunxi_efex_thread_create(sunxi_efex_thread_t *t, void *(*fn)(void *), void *arg) {
+	struct sunxi_efex_thread_start_t *start = HeapAlloc(GetProcessHeap(), 0, sizeof(*start));
+	if (!start)
+		return -1;
+	start->fn = fn;
+	start->arg = arg;
+	*t = CreateThread(NULL, 0, sunxi_efex_thread_trampoline, start, 0, NULL);
+	if (!*t) {
+		HeapFree(GetProcessHeap(), 0, start);
+		return -1;
+	}
+	return 0;
+}
+
+static inline void sunxi_efex_thread_join(sunxi_efex_thread_t t) {
+	WaitForSingleObject(t, INFINITE);
+	CloseHandle(t);
+}
+
+typedef volatile LONG64 sunxi_efex_atomic_t;
+
+static inline uint64_t sunxi_efex_atomic_load(sunxi_efex_atomic_t *a) {
+	return (uint64_t) InterlockedCompareExchange64(a, 0, 0);
+}
+
+static inline void sunxi_efex_atomic_store(sunxi_efex_atomic_t *a, const uint64_t v) {
+	InterlockedExchange64(a, (LONG64) v);
+}
+
+static inline uint64_t sunxi_efex_atomic_fetch_add(sunxi_efex_atomic_t *a, const uint64_t v) {
+	return (uint64_t) InterlockedExchangeAdd64(a, (LONG64) v);
+}
+
+static inline void sunxi_efex_atomic_fence(void) {
+	MemoryBarrier();
+}
+#else
+#include <pthread.h>
+#include <time.h>
+
+typedef pthread_mutex_t sunxi_efex_mutex_t;
+#define SUNXI_EFEX_MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
+
+typedef pthread_cond_t sunxi_efex_cond_t;
+
+typedef pthread_t sunxi_efex_thread_t;
+
+static inline void sunxi_efex_mutex_init(sunxi_efex_mutex_t *m) {
+	pthread_mutex_init(m, NULL);
+}
+
+static inline void sunxi_efex_mutex_destroy(sunxi_efex_mutex_t *m) {
+	pthread_mutex_destroy(m);
+}
+
+static inline void sunxi_efex_mutex_lock(sunxi_efex_mutex_t *m) {
+	pthread_mutex_lock(m);
+}
+
+static inline void sunxi_efex_mutex_unlock(sunxi_efex_mutex_t *m) {
+	pthread_mutex_unlock(m);
+}
+
+static inline void sunxi_efex_cond_init(sunxi_efex_cond_t *c) {
+	pthread_cond_init(c, NULL);
+}
+
+static inline void sunxi_efex_cond_destroy(sunxi_efex_cond_t *c) {
+	pthread_cond_destroy(c);
+}
+
+static inline void sunxi_efex_cond_wait(sunxi_efex_cond_t *c, sunxi_efex_mutex_t *m) {
+	pthread_cond_wait(c, m);
+}
+
+static inline void sunxi_efex_cond_broadcast(sunxi_efex_cond_t *c) {
+	pthread_cond_broadcast(c);
+}
+
+static inline void sunxi_efex_sleep_ms(const uint32_t ms) {
+	const struct timespec ts = {
+			.tv_sec = ms / 1000,
+			.tv_nsec = (long) (ms % 1000) * 1000000L,
+	};
+	nanosleep(&ts, NULL);
+}
+
+static inline void sunxi_efex_sleep_us(const uint64_t us) {
+	const struct timespec ts = {
+			.tv_sec = (time_t) (us / 1000000),
+			.tv_nsec = (long) (us % 1000000) * 1000L,
+	};
+	nanosleep(&ts, NULL);
+}
+
+static inline int sunxi_efex_thread_create(sunxi_efex_thread_t *t, void *(*fn)(void *), void *arg) {
+	return pthread_create(t, NULL, fn, arg) == 0 ? 0 : -1;
+}
+
+static inline void sunxi_efex_thread_join(sunxi_efex_thread_t t) {
+	pthread_join(t, NULL);
+}
+
+typedef uint64_t sunxi_efex_atomic_t;
+
+static inline uint64_t sunxi_efex_atomic_load(sunxi_efex_atomic_t *a) {
+	return __atomic_load_n(a, __ATOMIC_ACQUIRE);
+}
+
+static inline void sunxi_efex_atomic_store(sunxi_efex_atomic_t *a, const uint64_t v) {
+	__atomic_store_n(a, v, __ATOMIC_RELEASE);
+}
+
+static inline uint64_t sunxi_efex_atomic_fetch_add(sunxi_efex_atomic_t *a, const uint64_t v) {
+	return __atomic_fetch_add(a, v, __ATOMIC_ACQ_REL);
+}
+
+static inline void sunxi_efex_atomic_fence(void) {
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //LIBEFEX_EFEX_THREAD_H
@@ -0,0 +1,136 @@
+#ifndef LIBEFEX_EFEX_TRACE_H
+#define LIBEFEX_EFEX_TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "efex-protocol.h"
+
+/**
+ * @brief Records kept when sunxi_efex_trace_enable() is given no capacity
+ */
+#define SUNXI_EFEX_TRACE_DEFAULT_RECORDS (4096)
+
+/**
+ * @brief Largest number of payload bytes kept per record
+ */
+#define SUNXI_EFEX_TRACE_MAX_SNAP (64)
+
+/**
+ * @brief Magic at the start of a binary trace file, "EFXT"
+ */
+#define SUNXI_EFEX_TRACE_MAGIC (0x54584645)
+#define SUNXI_EFEX_TRACE_VERSION (1)
+
+/**
+ * @brief Export formats
+ */
+enum sunxi_efex_trace_format_t {
+	SUNXI_EFEX_TRACE_CHROME = 0, /**< Chrome trace event JSON, for chrome://tracing or Perfetto */
+	SUNXI_EFEX_TRACE_BINARY = 1, /**< Header followed by packed little-endian records */
+};
+
+/**
+ * @brief One bulk transfer
+ *
+ * A binary trace file is a struct sunxi_efex_trace_file_t followed by count of these, all
+ * fields little-endian and only snap_len bytes of data stored, so records vary in size.
+ */
+struct sunxi_efex_trace_record_t {
+	uint64_t ts_us;                           /**< Start, microseconds since the trace was enabled */
+	uint32_t dur_us;                          /**< Duration */
+	uint32_t len;                             /**< Bytes requested */
+	uint32_t cmd;                             /**< Command the transfer belongs to, 0 before the first */
+	int32_t status;                           /**< Result of the transfer, negative EFEX_ERR_* on failure */
+	uint8_t ep;                               /**< Endpoint address, bit 7 set for IN */
+	uint8_t phase;                            /**< enum sunxi_efex_stats_phase_t */
+	uint8_t snap_len;                         /**< Payload bytes stored in data */
+	uint8_t reserved;
+	uint8_t data[SUNXI_EFEX_TRACE_MAX_SNAP]; /**< First bytes of the payload */
+};
+
+/**
+ * @brief Header of a binary trace file
+ */
+struct sunxi_efex_trace_file_t {
+	uint32_t magic;   /**< SUNXI_EFEX_TRACE_MAGIC */
+	uint16_t version; /**< SUNXI_EFEX_TRACE_VERSION */
+	uint16_t snap;    /**< Payload bytes requested per record */
+	uint64_t count;   /**< Records following */
+	uint64_t dropped; /**< Older records overwritten before the export */
+};
+
+/**
+ * @brief Start or stop recording transfers into a ring buffer.
+ *
+ * Recording costs a timestamp and a copy of snap bytes per transfer, and never blocks: once the
+ * ring is full the oldest records are overwritten. The ring may be read and exported from
+ * another thread while the context keeps transferring. Enabling again starts a fresh trace.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[in] records Ring size in records, rounded up to a power of two; 0 disables tracing.
+ * @param[in] snap Payload bytes kept per record, at most SUNXI_EFEX_TRACE_MAX_SNAP.
+ * @return EFEX_ERR_SUCCESS on success, or an error code on failure.
+ */
+int sunxi_efex_trace_enable(struct sunxi_efex_ctx_t *ctx, size_t records, size_t snap);
+
+/**
+ * @brief Copy the records still in the ring, oldest first.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[out] records Receives the records, may be NULL to only count them.
+ * @param[in] max Capacity of records.
+ * @param[out] count Receives the number of records copied, or available when records is NULL.
+ * @return EFEX_ERR_SUCCESS on success, EFEX_ERR_NOT_SUPPORT if tracing is disabled.
+ */
+int sunxi_efex_trace_get(const struct sunxi_efex_ctx_t *ctx, struct sunxi_efex_trace_record_t *records, size_t max,
+                         size_t *count);
+
+/**
+ * @brief Write the records still in the ring to a file.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[in] path Output file.
+ * @param[in] format Output format.
+ * @return EFEX_ERR_SUCCESS on success, EFEX_ERR_NOT_SUPPORT if tracing is disabled, or an error code.
+ */
+int sunxi_efex_trace_export(const struct sunxi_efex_ctx_t *ctx, const char *path,
+                            enum sunxi_efex_trace_format_t format);
+
+/**
+ * @brief Set the command following transfers belong to. Used by the protocol layer.
+ */
+void sunxi_efex_trace_cmd(const struct sunxi_efex_ctx_t *ctx, uint32_t cmd);
+
+/**
+ * @brief Record one bulk transfer. Used by the USB layer.
+ *
+ * @param[in] ctx Pointer to the context structure.
+ * @param[in] phase enum sunxi_efex_stats_phase_t of the transfer.
+ * @param[in] ep Endpoint address.
+ * @param[in] buf Payload, may be NULL.
+ * @param[in] len Bytes transferred.
+ * @param[in] start Start time from sunxi_efex_time_us().
+ * @param[in] usec Time the transfer took.
+ * @param[in] status Result of the transfer.
+ */
+void sunxi_efex_trace_xfer(const struct sunxi_efex_ctx_t *ctx, int phase, int ep, const void *buf, size_t len,
+                           uint64_t start, uint64_t usec, int status);
+
+/**
+ * @brief Free the trace of a context, called by sunxi_efex_ctx_release().
+ *
+ * @param[in] ctx Pointer to the context structure.
+ */
+void sunxi_efex_trace_release(struct sunxi_efex_ctx_t *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //LIBEFEX_EFEX_TRACE_H
@@ -11,7 +11,6 @@ extern "C" {
 #include <efex-common.h>
 #include "efex-protocol.h"
 
-#define DEBUG_USB_TRANSFER 0
 #define DEFAULT_USB_TIMEOUT (60000)
 
 enum sunxi_usb_ids {
@@ -68,6 +67,27 @@ int sunxi_usb_bulk_send(void *handle, int ep, const char *buf, ssize_t len);
  */
 int sunxi_usb_bulk_recv(void *handle, int ep, char *buf, ssize_t len);
 
+/**
+ * @brief Fills an AWUC request header.
+ *
+ * Builds the same header sunxi_send_usb_request() sends, for callers that queue the
+ * transfer themselves (see sunxi_usb_bulk_chain_submit()).
+ *
+ * @param req The request header to fill.
+ * @param type The type of the USB request.
+ * @param length The length of the data phase that follows the header.
+ */
+void sunxi_usb_fill_request(struct sunxi_usb_request_t *req, enum sunxi_efex_usb_request_t type, size_t length);
+
+/**
+ * @brief Checks an AWUS response received from the device.
+ *
+ * @param resp The response to check.
+ * @return The status byte of the response (0 on success), or EFEX_ERR_INVALID_RESPONSE
+ *         if the response magic is wrong.
+ */
+int sunxi_usb_check_response(const struct sunxi_usb_response_t *resp);
+
 /**
  * @brief Sends a USB request to the device.
  *
@@ -125,6 +145,33 @@ int sunxi_usb_write(const struct sunxi_efex_ctx_t *ctx, const void *buf, size_t
  */
 int sunxi_usb_read(const struct sunxi_efex_ctx_t *ctx, const void *data, size_t len);
 
+/**
+ * @brief Writes data to the USB device with an explicit timeout.
+ *
+ * Same as sunxi_usb_write(), which takes the timeout from the context's policy. The timeout
+ * applies to each of the AWUC, data and AWUS phases.
+ *
+ * @param ctx A pointer to the sunxi_fel_ctx_t structure that contains the device context.
+ * @param buf A pointer to the buffer containing the data to be written.
+ * @param len The length of the data to be written, in bytes.
+ * @param timeout The timeout in milliseconds.
+ * @return 0 on success, or a negative error code on failure.
+ */
+int sunxi_usb_write_timeout(const struct sunxi_efex_ctx_t *ctx, const void *buf, size_t len, unsigned int timeout);
+
+/**
+ * @brief Reads data from the USB device with an explicit timeout.
+ *
+ * Read counterpart of sunxi_usb_write_timeout().
+ *
+ * @param ctx A pointer to the sunxi_fel_ctx_t structure that contains the device context.
+ * @param data A pointer to the buffer where the read data will be stored.
+ * @param len The number of bytes to read.
+ * @param timeout The timeout in milliseconds.
+ * @return 0 on success, or a negative error code on failure.
+ */
+int sunxi_usb_read_timeout(const struct sunxi_efex_ctx_t *ctx, const void *data, size_t len, unsigned int timeout);
+
 /**
  * @brief Scans for a USB device matching the specified vendor and product IDs.
  *
@@ -194,7 +241,8 @@ int sunxi_usb_fes_xfer(const struct sunxi_efex_ctx_t *ctx, const enum sunxi_usb_
  * @brief Prints USB data buffer content in hexadecimal and ASCII format
  *
  * This function is used for debugging purposes to print the contents of a given buffer
- * in hexadecimal and readable ASCII character formats to standard output. Each line
+ * in hexadecimal and readable ASCII character formats to standard output. Transfers are not
+ * dumped by the library any more; record them with sunxi_efex_trace_enable() instead. Each line
  * displays 16 bytes of data, including offset, hexadecimal representation, and corresponding
  * ASCII characters (non-printable characters are displayed as '.'). The function first
  * prints a header containing the transfer type and data length.
@@ -207,8 +255,7 @@ int sunxi_usb_fes_xfer(const struct sunxi_efex_ctx_t *ctx, const enum sunxi_usb_
  * @note When buf is NULL, it will output "USB <type> len=0" and "<empty>".
  *       When len is 0 but buf is not NULL, it will still output the header but no data lines.
  *
- * @see sunxi_usb_bulk_send()
- * @see sunxi_usb_bulk_recv()
+ * @see sunxi_efex_trace_enable()
  */
 void sunxi_usb_hex_dump(const void *buf, size_t len, const char *type);
 
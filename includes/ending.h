@@ -32,6 +32,20 @@ extern "C" {
 #error "platform not supported!"
 #endif
 
+/*
+ * strict feature-test macros hide BYTE_ORDER, which would otherwise compare equal to BIG_ENDIAN
+ */
+#if !defined(BYTE_ORDER) || !defined(BIG_ENDIAN)
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__)
+#undef BYTE_ORDER
+#undef BIG_ENDIAN
+#define BYTE_ORDER __BYTE_ORDER__
+#define BIG_ENDIAN __ORDER_BIG_ENDIAN__
+#else
+#error "byte order not known!"
+#endif
+#endif
+
 /*
  * byteorder
  */
@@ -7,11 +7,24 @@ extern "C" {
 #endif
 
 #include "compiler.h"
+#include "efex-buffer.h"
+#include "efex-chunk.h"
 #include "efex-common.h"
+#include "efex-crc32.h"
 #include "efex-fel.h"
 #include "efex-fes.h"
+#include "efex-image.h"
+#include "efex-multi.h"
 #include "efex-payloads.h"
+#include "efex-policy.h"
 #include "efex-protocol.h"
+#include "efex-record.h"
+#include "efex-seq.h"
+#include "efex-sim.h"
+#include "efex-sparse.h"
+#include "efex-stats.h"
+#include "efex-stream.h"
+#include "efex-trace.h"
 #include "efex-usb.h"
 #include "usb_layer.h"
 
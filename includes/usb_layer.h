@@ -3,7 +3,7 @@
  * @brief USB abstraction layer for libefex
  *
  * This file provides an abstraction layer for USB operations, supporting multiple backends
- * (libusb and winusb) on different platforms.
+ * (libusb and winusb) on different platforms, plus simulated devices for testing without hardware.
  */
 
 #ifndef USB_LAYER_H
@@ -17,6 +17,29 @@ extern "C" {
 #include <stddef.h>
 #include "efex-common.h"
 
+/**
+ * @brief Largest single URB issued by the backends, in bytes
+ */
+#define SUNXI_USB_MAX_URB_SIZE (128 * 1024)
+
+/**
+ * @brief Smallest URB the asynchronous engine splits a transfer into, in bytes
+ */
+#define SUNXI_USB_MIN_URB_SIZE (16 * 1024)
+
+/**
+ * @brief High-speed bulk max packet size; asynchronous URBs are kept a multiple of it
+ *
+ * A URB that is not a multiple of the packet size ends in a short packet, which the
+ * device would take as the end of the whole transfer.
+ */
+#define SUNXI_USB_BULK_PACKET_SIZE (512)
+
+/**
+ * @brief Maximum number of URBs the asynchronous engine keeps in flight per endpoint
+ */
+#define SUNXI_USB_MAX_QUEUE_DEPTH (16)
+
 /**
  * @brief USB backend type enumeration
  *
@@ -26,6 +49,8 @@ enum usb_backend_type {
 	USB_BACKEND_AUTO = 0,    /**< Auto-select backend (Windows: winusb, Linux/macOS: libusb) */
 	USB_BACKEND_LIBUSB = 1,   /**< Force use libusb backend */
 	USB_BACKEND_WINUSB = 2,   /**< Force use winusb backend (Windows only) */
+	USB_BACKEND_SIM = 3,      /**< In-process simulated devices, see sunxi_usb_sim_configure() */
+	USB_BACKEND_REPLAY = 4,   /**< Serves a recording, see sunxi_usb_replay_configure() */
 };
 
 /**
@@ -56,6 +81,40 @@ struct sunxi_hotplug_device_t {
 	char *device_path;     /**< Stable backend device path, caller must free through snapshot free API */
 };
 
+/** Maximum number of undelivered hotplug events kept, older ones are dropped first */
+#define SUNXI_HOTPLUG_MAX_EVENTS 1024
+
+/**
+ * @brief Hotplug event type
+ */
+enum sunxi_hotplug_event_type_t {
+	SUNXI_HOTPLUG_ARRIVED = 0, /**< Device appeared */
+	SUNXI_HOTPLUG_LEFT = 1,    /**< Device went away */
+};
+
+/**
+ * @brief Hotplug event
+ *
+ * `device` is a copy of the index entry at the time of the event; its `device_path` is owned
+ * by the event array and released by sunxi_hotplug_free_events.
+ */
+struct sunxi_hotplug_event_t {
+	enum sunxi_hotplug_event_type_t type; /**< What happened */
+	struct sunxi_hotplug_device_t device; /**< Device the event refers to */
+};
+
+/**
+ * @brief One bulk transfer of a pipelined chain
+ *
+ * A chain lists transfers in protocol order. The asynchronous backends queue all of them at
+ * once (ordering is kept per endpoint); the fallback runs them one after another.
+ */
+struct sunxi_usb_chain_xfer_t {
+	int ep;      /**< Endpoint address, the direction is taken from bit 7 */
+	char *buf;   /**< Data to send, or buffer to receive into */
+	ssize_t len; /**< Exact transfer length in bytes */
+};
+
 /**
  * @brief USB backend operations structure
  *
@@ -63,20 +122,36 @@ struct sunxi_hotplug_device_t {
  * these functions to provide USB communication capabilities.
  */
 struct usb_backend_ops {
-	int (*bulk_send)(void *handle, int ep, const char *buf, ssize_t len);   /**< Send bulk data */
-	int (*bulk_recv)(void *handle, int ep, char *buf, ssize_t len);   /**< Receive bulk data */
+	int (*bulk_send)(void *handle, int ep, const char *buf, ssize_t len, unsigned int timeout); /**< Send bulk data */
+	int (*bulk_recv)(void *handle, int ep, char *buf, ssize_t len, unsigned int timeout); /**< Receive bulk data */
 	int (*scan_device)(struct sunxi_efex_ctx_t *ctx);                 /**< Scan for USB device */
 	int (*scan_device_at)(struct sunxi_efex_ctx_t *ctx, uint8_t bus, uint8_t port); /**< Scan for USB device at specific bus/port */
 	int (*scan_devices)(struct sunxi_scanned_device_t **devices, size_t *count); /**< Scan for all USB devices */
 	int (*hotplug_snapshot)(struct sunxi_hotplug_device_t **devices, size_t *count); /**< Read current hotplug device snapshot */
 	int (*init)(struct sunxi_efex_ctx_t *ctx);                       /**< Initialize USB context */
 	int (*exit)(struct sunxi_efex_ctx_t *ctx);                       /**< Cleanup USB context */
+	int (*bulk_send_async)(void *usb_context, void *handle, int ep, const char *buf, ssize_t len, int queue_depth,
+	                       unsigned int timeout); /**< Send bulk data keeping queue_depth URBs in flight, optional */
+	int (*bulk_recv_async)(void *usb_context, void *handle, int ep, char *buf, ssize_t len, int queue_depth,
+	                       unsigned int timeout); /**< Receive bulk data keeping queue_depth URBs in flight, optional */
+	int (*bulk_chain_submit)(void *usb_context, void *handle, const struct sunxi_usb_chain_xfer_t *xfers,
+	                         size_t count, unsigned int timeout,
+	                         void **chain); /**< Queue a chain of transfers at once, optional */
+	int (*bulk_chain_wait)(void *usb_context, void *chain); /**< Wait for and release a queued chain, optional */
+	void *(*dev_mem_alloc)(void *handle, size_t len); /**< Allocate zero-copy device memory, optional */
+	void (*dev_mem_free)(void *handle, void *buf, size_t len); /**< Free memory from dev_mem_alloc, optional */
+	int (*clear_halt)(void *handle, int ep); /**< Clear a halt/stall condition on an endpoint, optional */
+	int (*hotplug_poll)(struct sunxi_hotplug_event_t **events, size_t *count,
+	                    int timeout_ms); /**< Wait for hotplug events, optional */
+	void (*shared_exit)(void); /**< Release library-wide backend state, optional */
 };
 
 /**
  * @brief Send bulk data over USB
  *
- * Sends data to a USB device using the currently selected backend.
+ * Sends data to a USB device using the default backend (see sunxi_efex_set_usb_backend()).
+ * Code holding a context should use sunxi_usb_bulk_send_timeout(), which follows the
+ * backend of the context.
  *
  * @param handle USB device handle
  * @param ep Endpoint address
@@ -86,10 +161,26 @@ struct usb_backend_ops {
  */
 int sunxi_usb_bulk_send(void *handle, int ep, const char *buf, ssize_t len);
 
+/**
+ * @brief Send bulk data over USB with an explicit timeout
+ *
+ * Sends to the device opened by ctx, through the backend of the context. The timeout applies
+ * to each URB the backend issues. Backends that cannot time out transfers ignore it.
+ *
+ * @param ctx EFEX context holding the device handle
+ * @param ep Endpoint address
+ * @param buf Buffer containing data to send
+ * @param len Length of data to send
+ * @param timeout Timeout in milliseconds, 0 for none
+ * @return EFEX_ERR_SUCCESS on success, EFEX_ERR_USB_TIMEOUT on timeout, or another error code on failure
+ */
+int sunxi_usb_bulk_send_timeout(const struct sunxi_efex_ctx_t *ctx, int ep, const char *buf, ssize_t len,
+                                unsigned int timeout);
+
 /**
  * @brief Receive bulk data over USB
  *
- * Receives data from a USB device using the currently selected backend.
+ * Receives data from a USB device using the default backend (see sunxi_efex_set_usb_backend()).
  *
  * @param handle USB device handle
  * @param ep Endpoint address
@@ -99,6 +190,132 @@ int sunxi_usb_bulk_send(void *handle, int ep, const char *buf, ssize_t len);
  */
 int sunxi_usb_bulk_recv(void *handle, int ep, char *buf, ssize_t len);
 
+/**
+ * @brief Receive bulk data over USB with an explicit timeout
+ *
+ * Receive counterpart of sunxi_usb_bulk_send_timeout().
+ *
+ * @param ctx EFEX context holding the device handle
+ * @param ep Endpoint address
+ * @param buf Buffer to store received data
+ * @param len Maximum length of data to receive
+ * @param timeout Timeout in milliseconds, 0 for none
+ * @return EFEX_ERR_SUCCESS on success, EFEX_ERR_USB_TIMEOUT on timeout, or another error code on failure
+ */
+int sunxi_usb_bulk_recv_timeout(const struct sunxi_efex_ctx_t *ctx, int ep, char *buf, ssize_t len,
+                                unsigned int timeout);
+
+/**
+ * @brief Clear a halt condition on an endpoint
+ *
+ * Also resets the data toggle of the endpoint on both sides, which is what a transfer aborted
+ * half-way most often leaves out of step.
+ *
+ * @param ctx EFEX context holding the device handle
+ * @param ep Endpoint address
+ * @return EFEX_ERR_SUCCESS on success, EFEX_ERR_NOT_SUPPORT if the backend cannot do it,
+ *         or another error code on failure
+ */
+int sunxi_usb_clear_halt(const struct sunxi_efex_ctx_t *ctx, int ep);
+
+/**
+ * @brief Send bulk data over USB with several URBs in flight
+ *
+ * Splits the buffer into URBs and keeps up to queue_depth of them submitted at once, so the
+ * host controller never idles between pieces. Falls back to sunxi_usb_bulk_send_timeout() when
+ * queue_depth is 1 or less, or when the backend of the context has no asynchronous engine.
+ *
+ * @param ctx EFEX context holding the device handle
+ * @param ep Endpoint address
+ * @param buf Buffer containing data to send
+ * @param len Length of data to send
+ * @param queue_depth Number of URBs to keep in flight (1 to SUNXI_USB_MAX_QUEUE_DEPTH)
+ * @param timeout Timeout of each URB in milliseconds, 0 for none
+ * @return EFEX_ERR_SUCCESS on success, or an error code on failure
+ */
+int sunxi_usb_bulk_send_async(const struct sunxi_efex_ctx_t *ctx, int ep, const char *buf, ssize_t len,
+                              int queue_depth, unsigned int timeout);
+
+/**
+ * @brief Receive bulk data over USB with several URBs in flight
+ *
+ * Receive counterpart of sunxi_usb_bulk_send_async(). Exactly len bytes are expected;
+ * a short URB in the middle of the transfer is reported as EFEX_ERR_USB_TRANSFER.
+ *
+ * @param ctx EFEX context holding the device handle
+ * @param ep Endpoint address
+ * @param buf Buffer to store received data
+ * @param len Length of data to receive
+ * @param queue_depth Number of URBs to keep in flight (1 to SUNXI_USB_MAX_QUEUE_DEPTH)
+ * @param timeout Timeout of each URB in milliseconds, 0 for none
+ * @return EFEX_ERR_SUCCESS on success, or an error code on failure
+ */
+int sunxi_usb_bulk_recv_async(const struct sunxi_efex_ctx_t *ctx, int ep, char *buf, ssize_t len, int queue_depth,
+                              unsigned int timeout);
+
+/**
+ * @brief Queue a chain of bulk transfers
+ *
+ * Submits every transfer of the chain at once so the device never waits for the host
+ * between protocol phases. Several chains may be in flight; each must be completed with
+ * sunxi_usb_bulk_chain_wait() in submission order. Backends without chain support run the
+ * transfers synchronously here and return a NULL chain.
+ *
+ * @param ctx EFEX context holding the device handle
+ * @param xfers Transfers in protocol order, must stay valid until the chain is waited for
+ * @param count Number of transfers
+ * @param timeout Timeout of each transfer in milliseconds, 0 for none
+ * @param chain Receives the queued chain handle (NULL when nothing is left in flight)
+ * @return EFEX_ERR_SUCCESS on success, or an error code on failure (nothing is in flight then)
+ */
+int sunxi_usb_bulk_chain_submit(const struct sunxi_efex_ctx_t *ctx, const struct sunxi_usb_chain_xfer_t *xfers,
+                                size_t count, unsigned int timeout, void **chain);
+
+/**
+ * @brief Wait for a chain queued by sunxi_usb_bulk_chain_submit() and release it
+ *
+ * @param ctx EFEX context the chain was queued on
+ * @param chain Chain handle, NULL is accepted and returns EFEX_ERR_SUCCESS
+ * @return EFEX_ERR_SUCCESS if every transfer completed in full, or the first error of the chain
+ */
+int sunxi_usb_bulk_chain_wait(const struct sunxi_efex_ctx_t *ctx, void *chain);
+
+/**
+ * @brief Allocate device memory for zero-copy transfers
+ *
+ * Memory shared with the kernel driver of an opened device: transfers from or into it skip the
+ * usbfs bounce copy. Prefer sunxi_efex_buffer_alloc(), which falls back to heap memory.
+ *
+ * @param ctx EFEX context holding an opened device handle
+ * @param len Size in bytes
+ * @return Pointer to the memory, or NULL when the backend or the kernel does not support it
+ */
+void *sunxi_usb_dev_mem_alloc(const struct sunxi_efex_ctx_t *ctx, size_t len);
+
+/**
+ * @brief Free memory returned by sunxi_usb_dev_mem_alloc()
+ *
+ * Must be called before the device handle is closed.
+ *
+ * @param ctx EFEX context the memory was allocated for
+ * @param buf Memory to free
+ * @param len Size passed to sunxi_usb_dev_mem_alloc()
+ */
+void sunxi_usb_dev_mem_free(const struct sunxi_efex_ctx_t *ctx, void *buf, size_t len);
+
+/**
+ * @brief Set the number of URBs kept in flight for data phases of a context
+ *
+ * A depth of 0 or 1 keeps the synchronous one-URB-at-a-time transfers (the default).
+ * Larger values route the data phase of every EFEX transfer on this context through
+ * the asynchronous engine.
+ *
+ * @param ctx EFEX context structure
+ * @param queue_depth Number of URBs to keep in flight (0 to SUNXI_USB_MAX_QUEUE_DEPTH)
+ * @return EFEX_ERR_SUCCESS on success, or EFEX_ERR_INVALID_PARAM if the depth is out of range
+ */
+int sunxi_usb_set_queue_depth(struct sunxi_efex_ctx_t *ctx, int queue_depth);
+
 /**
  * @brief Scan for USB device
  *
@@ -153,10 +370,44 @@ int sunxi_hotplug_snapshot(struct sunxi_hotplug_device_t **devices, size_t *coun
  */
 void sunxi_hotplug_free_snapshot(struct sunxi_hotplug_device_t *devices, size_t count);
 
+/**
+ * @brief Wait for hotplug events
+ *
+ * Returns the arrived/left events queued since the previous call, waiting up to timeout_ms
+ * for at least one. The first call reports every device already present as arrived, so a
+ * caller can build its view from the event stream alone. Events are delivered natively where
+ * the backend supports hotplug notification, otherwise they are derived by re-enumerating.
+ *
+ * @param events Pointer to receive the event array (caller must free with sunxi_hotplug_free_events),
+ *               NULL when nothing happened
+ * @param count Pointer to receive the number of events, 0 on timeout
+ * @param timeout_ms Maximum time to wait in milliseconds, 0 to only collect what is pending;
+ *                   negative values are rejected with EFEX_ERR_INVALID_PARAM, there is no wait forever
+ * @return EFEX_ERR_SUCCESS on success (including timeout), or an error code on failure
+ */
+int sunxi_hotplug_poll(struct sunxi_hotplug_event_t **events, size_t *count, int timeout_ms);
+
+/**
+ * @brief Free an event array returned by sunxi_hotplug_poll
+ *
+ * @param events Event array pointer
+ * @param count Number of entries in the array
+ */
+void sunxi_hotplug_free_events(struct sunxi_hotplug_event_t *events, size_t count);
+
+/**
+ * @brief Release library-wide USB state
+ *
+ * Scanning, snapshots and hotplug polling share one backend context and device index that
+ * live until this is called. Calling it is optional; any later scan starts a fresh one.
+ * Must not race with other scan or hotplug calls.
+ */
+void sunxi_usb_shared_exit(void);
+
 /**
  * @brief Initialize USB context
  *
- * Initializes the USB context using the currently selected backend.
+ * Initializes the USB context using the backend of the context, see sunxi_usb_set_backend().
  *
  * @param ctx EFEX context structure
  * @return EFEX_ERR_SUCCESS on success, or an error code on failure
@@ -166,7 +417,8 @@ int sunxi_usb_init(struct sunxi_efex_ctx_t *ctx);
 /**
  * @brief Cleanup USB context
  *
- * Releases USB resources using the currently selected backend.
+ * Releases USB resources using the backend of the context. The per-context library
+ * state is released first, see sunxi_efex_ctx_release().
  *
  * @param ctx EFEX context structure
  * @return EFEX_ERR_SUCCESS on success, or an error code on failure
@@ -174,9 +426,11 @@ int sunxi_usb_init(struct sunxi_efex_ctx_t *ctx);
 int sunxi_usb_exit(struct sunxi_efex_ctx_t *ctx);
 
 /**
- * @brief Set USB backend type
+ * @brief Set the default USB backend type
  *
- * Sets the USB backend to use for subsequent USB operations.
+ * Sets the USB backend used by contexts that do not select one with sunxi_usb_set_backend(),
+ * and by the context-less scan, hotplug and bulk functions. A context binds to the default
+ * when it first scans for its device; later changes do not affect it.
  * On Windows, both libusb and winusb are available.
  * On Linux/macOS, only libusb is available.
  *
@@ -186,14 +440,27 @@ int sunxi_usb_exit(struct sunxi_efex_ctx_t *ctx);
 int sunxi_efex_set_usb_backend(enum usb_backend_type backend);
 
 /**
- * @brief Get current USB backend type
+ * @brief Get the default USB backend type
  *
- * Returns the currently selected USB backend type.
+ * Returns the default USB backend type set by sunxi_efex_set_usb_backend().
  *
  * @return Current USB backend type
  */
 enum usb_backend_type sunxi_efex_get_usb_backend(void);
 
+/**
+ * @brief Select the USB backend of a context
+ *
+ * Contexts with different backends can be used side by side in one process. Must be called
+ * before the context scans for its device.
+ *
+ * @param ctx EFEX context structure
+ * @param backend USB backend type to use
+ * @return EFEX_ERR_SUCCESS on success, or EFEX_ERR_INVALID_PARAM if the backend is not supported
+ *         or the context already has a device open
+ */
+int sunxi_usb_set_backend(struct sunxi_efex_ctx_t *ctx, enum usb_backend_type backend);
+
 #ifdef __cplusplus
 }
 #endif
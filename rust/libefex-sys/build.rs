@@ -241,13 +241,28 @@ fn build_libefex(
     system_libusb_include: Option<&Vec<PathBuf>>,
 ) {
     let mut c_files = vec![
+        src_dir.join("efex-buffer.c"),
+        src_dir.join("efex-chunk.c"),
         src_dir.join("efex-common.c"),
+        src_dir.join("efex-crc32.c"),
         src_dir.join("efex-fel.c"),
         src_dir.join("efex-fes.c"),
+        src_dir.join("efex-image.c"),
+        src_dir.join("efex-multi.c"),
         src_dir.join("efex-payloads.c"),
+        src_dir.join("efex-policy.c"),
+        src_dir.join("efex-record.c"),
+        src_dir.join("efex-seq.c"),
+        src_dir.join("efex-sim.c"),
+        src_dir.join("efex-sparse.c"),
+        src_dir.join("efex-stats.c"),
+        src_dir.join("efex-stream.c"),
+        src_dir.join("efex-trace.c"),
         src_dir.join("efex-usb.c"),
         src_dir.join("usb/usb_layer.c"),
         src_dir.join("usb/usb_layer_libusb.c"),
+        src_dir.join("usb/usb_layer_replay.c"),
+        src_dir.join("usb/usb_layer_sim.c"),
         src_dir.join("arch/aarch64.c"),
         src_dir.join("arch/arm.c"),
         src_dir.join("arch/riscv.c"),
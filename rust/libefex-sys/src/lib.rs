@@ -2,7 +2,7 @@
 #![allow(non_snake_case)]
 #![allow(dead_code)]
 
-use libc::{c_char, c_int, c_void, size_t};
+use libc::{c_char, c_int, c_uint, c_void, size_t};
 
 // Error code enumeration
 #[repr(C)]
@@ -42,10 +42,11 @@ pub enum sunxi_efex_error_t {
     EFEX_ERR_CRC_MISMATCH = -51, // CRC mismatch error
 
     // File Operation Errors
-    EFEX_ERR_FILE_OPEN = -60,  // Failed to open file
-    EFEX_ERR_FILE_READ = -61,  // Failed to read file
-    EFEX_ERR_FILE_WRITE = -62, // Failed to write file
-    EFEX_ERR_FILE_SIZE = -63,  // File size error
+    EFEX_ERR_FILE_OPEN = -60,   // Failed to open file
+    EFEX_ERR_FILE_READ = -61,   // Failed to read file
+    EFEX_ERR_FILE_WRITE = -62,  // Failed to write file
+    EFEX_ERR_FILE_SIZE = -63,   // File size error
+    EFEX_ERR_FILE_FORMAT = -64, // Unrecognized or corrupt file contents
 }
 
 // Command type enumeration
@@ -235,6 +236,22 @@ pub struct sunxi_efex_ctx_t {
     pub epout: c_int,
     pub epin: c_int,
     pub resp: sunxi_efex_device_resp_t,
+    pub queue_depth: c_int,
+    pub fel_pipeline: c_int,
+    pub fel_verify: c_int,
+    pub buffer_pool: *mut c_void,
+    pub chunk_size: u32,
+    pub chunk_limit: u32,
+    pub chunk_tuner: *mut c_void,
+    pub policy: *mut sunxi_efex_policy_t,
+    pub usb_ops: *const c_void,
+    pub payload: *const c_void,
+    pub on_progress: Option<extern "C" fn(*const sunxi_efex_ctx_t, size_t, *mut c_void)>,
+    pub progress_arg: *mut c_void,
+    pub stats: *mut sunxi_efex_stats_t,
+    pub trace: *mut c_void,
+    pub record: *mut c_void,
+    pub payload_cache: *mut c_void,
 }
 
 // USB request type enumeration
@@ -305,6 +322,8 @@ pub enum usb_backend_type {
     USB_BACKEND_AUTO = 0,
     USB_BACKEND_LIBUSB = 1,
     USB_BACKEND_WINUSB = 2,
+    USB_BACKEND_SIM = 3,
+    USB_BACKEND_REPLAY = 4,
 }
 
 // Scanned device information
@@ -328,6 +347,331 @@ pub struct sunxi_hotplug_device_t {
     pub device_path: *mut c_char,
 }
 
+// Hotplug event type enumeration
+#[repr(C)]
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum sunxi_hotplug_event_type_t {
+    SUNXI_HOTPLUG_ARRIVED = 0,
+    SUNXI_HOTPLUG_LEFT = 1,
+}
+
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct sunxi_hotplug_event_t {
+    pub type_: sunxi_hotplug_event_type_t,
+    pub device: sunxi_hotplug_device_t,
+}
+
+// Multi-device runs
+pub const SUNXI_EFEX_MULTI_MAX_WORKERS: usize = 64;
+
+#[repr(C)]
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum sunxi_efex_multi_job_type_t {
+    SUNXI_EFEX_MULTI_FEL_BOOT = 0,
+    SUNXI_EFEX_MULTI_FES_FLASH = 1,
+    SUNXI_EFEX_MULTI_DUMP = 2,
+    SUNXI_EFEX_MULTI_CUSTOM = 3,
+}
+
+#[repr(C)]
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum sunxi_efex_multi_state_t {
+    SUNXI_EFEX_MULTI_PENDING = 0,
+    SUNXI_EFEX_MULTI_RUNNING = 1,
+    SUNXI_EFEX_MULTI_DONE = 2,
+    SUNXI_EFEX_MULTI_FAILED = 3,
+}
+
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct sunxi_efex_multi_device_t {
+    pub bus: u8,
+    pub port: u8,
+    pub state: sunxi_efex_multi_state_t,
+    pub result: c_int,
+    pub mode: u32,
+    pub done: u64,
+    pub total: u64,
+    pub elapsed_us: u64,
+    pub dump: *mut c_char,
+    pub user: *mut c_void,
+}
+
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct sunxi_efex_multi_job_t {
+    pub type_: sunxi_efex_multi_job_type_t,
+    pub addr: u32,
+    pub data: *const c_char,
+    pub len: size_t,
+    pub fes_type: u32, // sunxi_fes_data_type_t
+    pub setup: Option<
+        extern "C" fn(*mut sunxi_efex_ctx_t, *mut sunxi_efex_multi_device_t, *mut c_void) -> c_int,
+    >,
+    pub run: Option<
+        extern "C" fn(*mut sunxi_efex_ctx_t, *mut sunxi_efex_multi_device_t, *mut c_void) -> c_int,
+    >,
+    pub on_progress: Option<extern "C" fn(*const sunxi_efex_multi_device_t, *mut c_void)>,
+    pub arg: *mut c_void,
+}
+
+// Timeout, retry and recovery policy
+pub const SUNXI_EFEX_POLICY_CMD_TIMEOUTS: usize = 8;
+
+#[repr(C)]
+#[derive(Debug, Copy, Clone, Default)]
+pub struct sunxi_efex_cmd_timeout_t {
+    pub cmd: u32,
+    pub timeout_ms: u32,
+}
+
+#[repr(C)]
+#[derive(Debug, Copy, Clone, Default)]
+pub struct sunxi_efex_policy_stats_t {
+    pub retries: u64,
+    pub recovered: u64,
+    pub failed: u64,
+    pub timeouts: u64,
+    pub clear_halts: u64,
+}
+
+#[repr(C)]
+pub struct sunxi_efex_policy_t {
+    pub timeout_ms: u32,
+    pub timeout_per_mib_ms: u32,
+    pub cmd_timeouts: [sunxi_efex_cmd_timeout_t; SUNXI_EFEX_POLICY_CMD_TIMEOUTS],
+    pub max_retries: u32,
+    pub retry_delay_ms: u32,
+    pub on_retry: Option<extern "C" fn(*const sunxi_efex_ctx_t, u32, u32, u32, c_int, *mut c_void)>,
+    pub arg: *mut c_void,
+    pub stats: sunxi_efex_policy_stats_t,
+}
+
+// Transfer statistics
+pub const SUNXI_EFEX_STATS_BUCKETS: usize = 32;
+pub const SUNXI_EFEX_STATS_CMDS: usize = 24;
+
+pub const SUNXI_EFEX_PHASE_REQUEST: usize = 0;
+pub const SUNXI_EFEX_PHASE_DATA: usize = 1;
+pub const SUNXI_EFEX_PHASE_STATUS: usize = 2;
+pub const SUNXI_EFEX_PHASE_COUNT: usize = 3;
+
+pub const SUNXI_EFEX_DIR_OUT: usize = 0;
+pub const SUNXI_EFEX_DIR_IN: usize = 1;
+
+#[repr(C)]
+#[derive(Debug, Copy, Clone, Default)]
+pub struct sunxi_efex_histogram_t {
+    pub count: u64,
+    pub total_us: u64,
+    pub max_us: u64,
+    pub buckets: [u64; SUNXI_EFEX_STATS_BUCKETS],
+}
+
+#[repr(C)]
+#[derive(Debug, Copy, Clone, Default)]
+pub struct sunxi_efex_cmd_stats_t {
+    pub cmd: u32,
+    pub issued: u64,
+    pub transfers: [u64; 2],
+    pub bytes: [u64; 2],
+}
+
+#[repr(C)]
+#[derive(Debug, Copy, Clone, Default)]
+pub struct sunxi_efex_stats_t {
+    pub cmds: [sunxi_efex_cmd_stats_t; SUNXI_EFEX_STATS_CMDS],
+    pub phases: [sunxi_efex_histogram_t; SUNXI_EFEX_PHASE_COUNT],
+    pub retries: u64,
+    pub timeouts: u64,
+    pub errors: u64,
+    pub cmd: u32,
+}
+
+// Transaction trace
+pub const SUNXI_EFEX_TRACE_DEFAULT_RECORDS: usize = 4096;
+pub const SUNXI_EFEX_TRACE_MAX_SNAP: usize = 64;
+
+#[repr(C)]
+#[derive(PartialEq, Debug, Copy, Clone)]
+pub enum sunxi_efex_trace_format_t {
+    SUNXI_EFEX_TRACE_CHROME = 0,
+    SUNXI_EFEX_TRACE_BINARY = 1,
+}
+
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct sunxi_efex_trace_record_t {
+    pub ts_us: u64,
+    pub dur_us: u32,
+    pub len: u32,
+    pub cmd: u32,
+    pub status: i32,
+    pub ep: u8,
+    pub phase: u8,
+    pub snap_len: u8,
+    pub reserved: u8,
+    pub data: [u8; SUNXI_EFEX_TRACE_MAX_SNAP],
+}
+
+// Transfer recording and replay
+pub const SUNXI_EFEX_RECORD_NO_OUT_DATA: u32 = 0x1;
+
+#[repr(C)]
+#[derive(PartialEq, Debug, Copy, Clone)]
+pub enum sunxi_efex_replay_speed_t {
+    SUNXI_EFEX_REPLAY_FAST = 0,
+    SUNXI_EFEX_REPLAY_RECORDED = 1,
+}
+
+// Register sequences
+pub const SUNXI_EFEX_SEQ_MAX_OPS: usize = 128;
+
+#[repr(C)]
+#[derive(PartialEq, Debug, Copy, Clone)]
+pub enum sunxi_efex_seq_opcode_t {
+    SUNXI_EFEX_SEQ_END = 0,
+    SUNXI_EFEX_SEQ_WRITE = 1,
+    SUNXI_EFEX_SEQ_READ = 2,
+    SUNXI_EFEX_SEQ_MODIFY = 3,
+    SUNXI_EFEX_SEQ_POLL = 4,
+    SUNXI_EFEX_SEQ_DELAY = 5,
+}
+
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct sunxi_efex_seq_op_t {
+    pub op: u32,
+    pub addr: u32,
+    pub arg: [u32; 3],
+}
+
+#[repr(C)]
+#[derive(Copy, Clone)]
+pub struct sunxi_efex_seq_t {
+    pub ops: [sunxi_efex_seq_op_t; SUNXI_EFEX_SEQ_MAX_OPS],
+    pub count: size_t,
+    pub reads: size_t,
+    pub error: c_int,
+}
+
+// Simulated device
+pub const SUNXI_EFEX_SIM_CHIP_ID: u32 = 0x00185900;
+pub const SUNXI_EFEX_SIM_FLASH_SIZE: u64 = 1 << 30;
+pub const SUNXI_EFEX_SIM_VERIFY_FLAG: u32 = 0x6a617603;
+
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct sunxi_efex_sim_config_t {
+    pub mode: u16,
+    pub chip_id: u32,
+    pub storage_type: u32,
+    pub flash_path: *const c_char,
+    pub flash_size: u64,
+    pub latency_us: u32,
+    pub bandwidth: u64,
+    pub on_exec: Option<extern "C" fn(*mut c_void, u32, *mut c_void) -> c_int>,
+    pub arg: *mut c_void,
+}
+
+pub const SUNXI_EFEX_STREAM_SLOTS: usize = 3;
+pub const SUNXI_EFEX_STREAM_SLOT_SIZE: usize = 4 * 1024 * 1024;
+pub const SUNXI_EFEX_STREAM_ALIGN: usize = 4096;
+
+pub type sunxi_efex_stream_reader_t =
+    Option<unsafe extern "C" fn(user: *mut c_void, buf: *mut c_char, len: size_t) -> isize>;
+
+pub type sunxi_efex_stream_writer_t =
+    Option<unsafe extern "C" fn(user: *mut c_void, buf: *const c_char, len: size_t) -> c_int>;
+
+pub const SUNXI_EFEX_IMAGE_PREFETCH: usize = 16 * 1024 * 1024;
+
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct sunxi_efex_image_t {
+    pub data: *mut c_char,
+    pub size: u64,
+    pub mapped: c_int,
+}
+
+pub const SUNXI_EFEX_SPARSE_BLOCK: usize = 4096;
+pub const SUNXI_EFEX_SPARSE_MIN_SKIP: usize = 64 * 1024;
+pub const SUNXI_EFEX_SPARSE_FILL_SIZE: usize = 1024 * 1024;
+
+// Block contents, and what a target reads as where nothing is written
+#[repr(C)]
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum sunxi_efex_sparse_fill_t {
+    SUNXI_EFEX_SPARSE_DATA = 0,   // Mixed contents, nothing assumed of the target
+    SUNXI_EFEX_SPARSE_ZERO = 1,   // All bytes 0x00
+    SUNXI_EFEX_SPARSE_ERASED = 2, // All bytes 0xFF
+}
+
+pub const SUNXI_EFEX_SIMG_MAGIC: u32 = 0xed26ff3a;
+
+// Android sparse image chunk types
+#[repr(C)]
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum sunxi_efex_simg_chunk_type_t {
+    SUNXI_EFEX_SIMG_RAW = 0xcac1,       // Blocks of data follow the header
+    SUNXI_EFEX_SIMG_FILL = 0xcac2,      // Blocks repeat a 32-bit pattern
+    SUNXI_EFEX_SIMG_DONT_CARE = 0xcac3, // Blocks whose contents do not matter
+    SUNXI_EFEX_SIMG_CRC32 = 0xcac4,     // CRC32 of the image up to here
+}
+
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct sunxi_efex_simg_t {
+    pub data: *const c_char,
+    pub size: u64,
+    pub blk_sz: u32,
+    pub total_blks: u32,
+    pub total_chunks: u32,
+    pub pos: u64,
+    pub chunk: u32,
+    pub blk: u32,
+    pub chunk_hdr_sz: u16,
+}
+
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct sunxi_efex_simg_chunk_t {
+    pub typ: sunxi_efex_simg_chunk_type_t,
+    pub offset: u64,
+    pub len: u64,
+    pub data: *const c_char,
+    pub value: u32,
+}
+
+// Output formats of a sparse sink
+#[repr(C)]
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum sunxi_efex_sparse_format_t {
+    SUNXI_EFEX_SPARSE_HOLES = 0, // Plain image, zero blocks left as holes
+    SUNXI_EFEX_SPARSE_SIMG = 1,  // Android sparse image, uniform blocks as FILL chunks
+}
+
+#[repr(C)]
+pub struct sunxi_efex_sparse_sink_t {
+    pub fp: *mut c_void,  // FILE *
+    pub map: *mut c_void, // FILE *, NULL without a block map
+    pub format: sunxi_efex_sparse_format_t,
+    pub block: [c_char; SUNXI_EFEX_SPARSE_BLOCK],
+    pub fill: usize,
+    pub size: u64,
+    pub written: u64,
+    pub seek: c_int,
+    pub run_type: u16,
+    pub run_value: u32,
+    pub run_start: u32,
+    pub run_blocks: u32,
+    pub run_hdr: u64,
+    pub blocks: u32,
+    pub chunks: u32,
+    pub error: c_int,
+}
+
 // Declare C functions
 extern "C" {
     // Common functions
@@ -356,6 +700,16 @@ extern "C" {
 
     pub fn sunxi_hotplug_free_snapshot(devices: *mut sunxi_hotplug_device_t, count: size_t);
 
+    pub fn sunxi_hotplug_poll(
+        events: *mut *mut sunxi_hotplug_event_t,
+        count: *mut size_t,
+        timeout_ms: c_int,
+    ) -> c_int;
+
+    pub fn sunxi_hotplug_free_events(events: *mut sunxi_hotplug_event_t, count: size_t);
+
+    pub fn sunxi_usb_shared_exit();
+
     pub fn sunxi_efex_get_device_mode(ctx: *const sunxi_efex_ctx_t) -> sunxi_verify_device_mode_t;
 
     pub fn sunxi_efex_get_device_mode_str(ctx: *const sunxi_efex_ctx_t) -> *const c_char;
@@ -393,8 +747,36 @@ extern "C" {
 
     pub fn sunxi_usb_init(ctx: *mut sunxi_efex_ctx_t) -> c_int;
 
+    pub fn sunxi_usb_set_queue_depth(ctx: *mut sunxi_efex_ctx_t, queue_depth: c_int) -> c_int;
+
     pub fn sunxi_usb_exit(ctx: *mut sunxi_efex_ctx_t) -> c_int;
 
+    // Transfer buffer pool
+    pub fn sunxi_efex_buffer_alloc(ctx: *mut sunxi_efex_ctx_t, len: size_t) -> *mut c_void;
+
+    pub fn sunxi_efex_buffer_free(ctx: *mut sunxi_efex_ctx_t, buf: *mut c_void);
+
+    pub fn sunxi_efex_buffer_is_dma(ctx: *const sunxi_efex_ctx_t, buf: *const c_void, len: size_t) -> c_int;
+
+    // Timeout, retry and recovery policy
+    pub fn sunxi_efex_policy_init(policy: *mut sunxi_efex_policy_t);
+
+    pub fn sunxi_efex_set_policy(ctx: *mut sunxi_efex_ctx_t, policy: *mut sunxi_efex_policy_t) -> c_int;
+
+    pub fn sunxi_efex_recover(ctx: *const sunxi_efex_ctx_t) -> c_int;
+
+    // Transfer chunk size
+    pub fn sunxi_efex_set_chunk_size(ctx: *mut sunxi_efex_ctx_t, chunk_size: u32) -> c_int;
+
+    pub fn sunxi_efex_set_chunk_auto(ctx: *mut sunxi_efex_ctx_t, enable: c_int) -> c_int;
+
+    pub fn sunxi_efex_probe_chunk_size(
+        ctx: *mut sunxi_efex_ctx_t,
+        addr: u32,
+        max: u32,
+        accepted: *mut u32,
+    ) -> c_int;
+
     pub fn sunxi_usb_fes_xfer(
         ctx: *const sunxi_efex_ctx_t,
         typ: sunxi_usb_fes_xfer_type_t,
@@ -415,6 +797,10 @@ extern "C" {
         len: c_int,
     ) -> c_int;
 
+    pub fn sunxi_efex_fel_set_pipeline(ctx: *mut sunxi_efex_ctx_t, enable: c_int) -> c_int;
+
+    pub fn sunxi_efex_fel_set_verify(ctx: *mut sunxi_efex_ctx_t, enable: c_int) -> c_int;
+
     pub fn sunxi_efex_fel_write(
         ctx: *const sunxi_efex_ctx_t,
         addr: u32,
@@ -483,6 +869,130 @@ extern "C" {
         typ: sunxi_fes_data_type_t,
     ) -> c_int;
 
+    pub fn sunxi_efex_fes_down_crc(
+        ctx: *const sunxi_efex_ctx_t,
+        buf: *const c_char,
+        len: c_int,
+        addr: u32,
+        typ: sunxi_fes_data_type_t,
+        crc: *mut u32,
+    ) -> c_int;
+
+    pub fn sunxi_efex_fes_up_crc(
+        ctx: *const sunxi_efex_ctx_t,
+        buf: *const c_char,
+        len: c_int,
+        addr: u32,
+        typ: sunxi_fes_data_type_t,
+        crc: *mut u32,
+    ) -> c_int;
+
+    pub fn sunxi_efex_fes_down_stream(
+        ctx: *const sunxi_efex_ctx_t,
+        reader: sunxi_efex_stream_reader_t,
+        user: *mut c_void,
+        total_len: u64,
+        addr: u32,
+        typ: sunxi_fes_data_type_t,
+        crc: *mut u32,
+    ) -> c_int;
+
+    pub fn sunxi_efex_fes_up_stream(
+        ctx: *const sunxi_efex_ctx_t,
+        writer: sunxi_efex_stream_writer_t,
+        user: *mut c_void,
+        total_len: u64,
+        addr: u32,
+        typ: sunxi_fes_data_type_t,
+        crc: *mut u32,
+    ) -> c_int;
+
+    pub fn sunxi_efex_fes_nand_up_stream(
+        ctx: *const sunxi_efex_ctx_t,
+        writer: sunxi_efex_stream_writer_t,
+        user: *mut c_void,
+        total_len: u64,
+        addr: u32,
+        typ: sunxi_fes_data_type_t,
+        crc: *mut u32,
+    ) -> c_int;
+
+    pub fn sunxi_efex_fes_spinand_up_stream(
+        ctx: *const sunxi_efex_ctx_t,
+        writer: sunxi_efex_stream_writer_t,
+        user: *mut c_void,
+        total_len: u64,
+        addr: u32,
+        typ: sunxi_fes_data_type_t,
+        crc: *mut u32,
+    ) -> c_int;
+
+    pub fn sunxi_efex_fes_spinor_up_stream(
+        ctx: *const sunxi_efex_ctx_t,
+        writer: sunxi_efex_stream_writer_t,
+        user: *mut c_void,
+        total_len: u64,
+        addr: u32,
+        typ: sunxi_fes_data_type_t,
+        crc: *mut u32,
+    ) -> c_int;
+
+    pub fn sunxi_efex_fel_read_stream(
+        ctx: *const sunxi_efex_ctx_t,
+        addr: u32,
+        len: u64,
+        writer: sunxi_efex_stream_writer_t,
+        user: *mut c_void,
+        callback: Option<extern "C" fn(isize)>,
+    ) -> c_int;
+
+    pub fn sunxi_efex_image_open(img: *mut sunxi_efex_image_t, path: *const c_char) -> c_int;
+
+    pub fn sunxi_efex_image_close(img: *mut sunxi_efex_image_t);
+
+    pub fn sunxi_efex_fes_down_sparse(
+        ctx: *const sunxi_efex_ctx_t,
+        buf: *const c_char,
+        len: u64,
+        addr: u32,
+        typ: sunxi_fes_data_type_t,
+        blank: sunxi_efex_sparse_fill_t,
+        crc: *mut u32,
+        skipped: *mut u64,
+    ) -> c_int;
+
+    pub fn sunxi_efex_fes_down_simg(
+        ctx: *const sunxi_efex_ctx_t,
+        data: *const c_char,
+        size: u64,
+        addr: u32,
+        typ: sunxi_fes_data_type_t,
+        blank: sunxi_efex_sparse_fill_t,
+        crc: *mut u32,
+        skipped: *mut u64,
+    ) -> c_int;
+
+    pub fn sunxi_efex_sparse_classify(buf: *const c_void, len: usize) -> sunxi_efex_sparse_fill_t;
+
+    pub fn sunxi_efex_simg_check(data: *const c_void, size: u64) -> c_int;
+
+    pub fn sunxi_efex_simg_open(simg: *mut sunxi_efex_simg_t, data: *const c_void, size: u64) -> c_int;
+
+    pub fn sunxi_efex_simg_next(simg: *mut sunxi_efex_simg_t, chunk: *mut sunxi_efex_simg_chunk_t) -> c_int;
+
+    pub fn sunxi_efex_simg_size(simg: *const sunxi_efex_simg_t) -> u64;
+
+    pub fn sunxi_efex_sparse_sink_open(
+        sink: *mut sunxi_efex_sparse_sink_t,
+        path: *const c_char,
+        format: sunxi_efex_sparse_format_t,
+        map_path: *const c_char,
+    ) -> c_int;
+
+    pub fn sunxi_efex_sparse_sink_write(user: *mut c_void, buf: *const c_char, len: size_t) -> c_int;
+
+    pub fn sunxi_efex_sparse_sink_close(sink: *mut sunxi_efex_sparse_sink_t) -> c_int;
+
     pub fn sunxi_efex_fes_nand_up(
         ctx: *const sunxi_efex_ctx_t,
         buf: *const c_char,
@@ -535,6 +1045,11 @@ extern "C" {
     // Payloads =====
     pub fn sunxi_efex_fel_payloads_init(arch: sunxi_efex_fel_payloads_arch) -> c_int;
 
+    pub fn sunxi_efex_fel_payloads_select(
+        ctx: *mut sunxi_efex_ctx_t,
+        arch: sunxi_efex_fel_payloads_arch,
+    ) -> c_int;
+
     pub fn sunxi_efex_fel_payloads_readl(
         ctx: *const sunxi_efex_ctx_t,
         addr: u32,
@@ -547,8 +1062,118 @@ extern "C" {
         addr: u32,
     ) -> c_int;
 
+    pub fn sunxi_efex_fel_payloads_readl_batch(
+        ctx: *const sunxi_efex_ctx_t,
+        addrs: *const u32,
+        vals: *mut u32,
+        count: usize,
+    ) -> c_int;
+
+    pub fn sunxi_efex_fel_payloads_writel_batch(
+        ctx: *const sunxi_efex_ctx_t,
+        addrs: *const u32,
+        vals: *const u32,
+        count: usize,
+    ) -> c_int;
+
+    pub fn sunxi_efex_fel_memset(ctx: *const sunxi_efex_ctx_t, addr: u32, value: u8, len: u32) -> c_int;
+
+    pub fn sunxi_efex_fel_memcpy(ctx: *const sunxi_efex_ctx_t, dst: u32, src: u32, len: u32) -> c_int;
+
+    pub fn sunxi_efex_fel_crc32(ctx: *const sunxi_efex_ctx_t, addr: u32, len: u32, crc: *mut u32) -> c_int;
+
+    // Host CRC32
+    pub fn sunxi_efex_crc32(crc: u32, buf: *const c_void, len: usize) -> u32;
+
     // USB backend functions
     pub fn sunxi_efex_set_usb_backend(backend: usb_backend_type) -> c_int;
 
     pub fn sunxi_efex_get_usb_backend() -> usb_backend_type;
+
+    pub fn sunxi_usb_set_backend(ctx: *mut sunxi_efex_ctx_t, backend: usb_backend_type) -> c_int;
+
+    pub fn sunxi_efex_set_progress(
+        ctx: *mut sunxi_efex_ctx_t,
+        on_progress: Option<extern "C" fn(*const sunxi_efex_ctx_t, size_t, *mut c_void)>,
+        arg: *mut c_void,
+    ) -> c_int;
+
+    pub fn sunxi_efex_progress(ctx: *const sunxi_efex_ctx_t, done: size_t);
+
+    // Transfer statistics
+    pub fn sunxi_efex_stats_enable(ctx: *mut sunxi_efex_ctx_t, enable: c_int) -> c_int;
+
+    pub fn sunxi_efex_stats_get(ctx: *const sunxi_efex_ctx_t, stats: *mut sunxi_efex_stats_t) -> c_int;
+
+    pub fn sunxi_efex_stats_reset(ctx: *mut sunxi_efex_ctx_t) -> c_int;
+
+    pub fn sunxi_efex_histogram_percentile(hist: *const sunxi_efex_histogram_t, percent: c_uint) -> u64;
+
+    // Transaction trace
+    pub fn sunxi_efex_trace_enable(ctx: *mut sunxi_efex_ctx_t, records: size_t, snap: size_t) -> c_int;
+
+    pub fn sunxi_efex_trace_get(
+        ctx: *const sunxi_efex_ctx_t,
+        records: *mut sunxi_efex_trace_record_t,
+        max: size_t,
+        count: *mut size_t,
+    ) -> c_int;
+
+    pub fn sunxi_efex_trace_export(
+        ctx: *const sunxi_efex_ctx_t,
+        path: *const c_char,
+        format: sunxi_efex_trace_format_t,
+    ) -> c_int;
+
+    // Transfer recording and replay
+    pub fn sunxi_efex_record_open(path: *const c_char, flags: u32, rec: *mut *mut c_void) -> c_int;
+
+    pub fn sunxi_efex_record_attach(ctx: *mut sunxi_efex_ctx_t, rec: *mut c_void) -> c_int;
+
+    pub fn sunxi_efex_record_close(rec: *mut c_void) -> c_int;
+
+    pub fn sunxi_usb_replay_configure(path: *const c_char, speed: sunxi_efex_replay_speed_t) -> c_int;
+
+    // Register sequences
+    pub fn sunxi_efex_seq_init(seq: *mut sunxi_efex_seq_t);
+
+    pub fn sunxi_efex_seq_write(seq: *mut sunxi_efex_seq_t, addr: u32, value: u32) -> c_int;
+
+    pub fn sunxi_efex_seq_read(seq: *mut sunxi_efex_seq_t, addr: u32) -> c_int;
+
+    pub fn sunxi_efex_seq_modify(seq: *mut sunxi_efex_seq_t, addr: u32, clear: u32, set: u32) -> c_int;
+
+    pub fn sunxi_efex_seq_poll(seq: *mut sunxi_efex_seq_t, addr: u32, mask: u32, value: u32, tries: u32) -> c_int;
+
+    pub fn sunxi_efex_seq_delay(seq: *mut sunxi_efex_seq_t, loops: u32) -> c_int;
+
+    pub fn sunxi_efex_fel_seq_run(
+        ctx: *const sunxi_efex_ctx_t,
+        seq: *const sunxi_efex_seq_t,
+        reads: *mut u32,
+        done: *mut size_t,
+    ) -> c_int;
+
+    // Simulated device
+    pub fn sunxi_efex_sim_config_init(config: *mut sunxi_efex_sim_config_t);
+
+    pub fn sunxi_efex_sim_set_mode(sim: *mut c_void, mode: u16);
+
+    pub fn sunxi_efex_sim_mem_read(sim: *const c_void, addr: u32, buf: *mut c_void, len: size_t);
+
+    pub fn sunxi_efex_sim_mem_write(sim: *mut c_void, addr: u32, buf: *const c_void, len: size_t) -> c_int;
+
+    pub fn sunxi_usb_sim_configure(config: *const sunxi_efex_sim_config_t, devices: c_uint) -> c_int;
+
+    // Multi-device runs =====
+    pub fn sunxi_efex_multi_run(
+        job: *const sunxi_efex_multi_job_t,
+        targets: *const sunxi_scanned_device_t,
+        target_count: size_t,
+        workers: c_int,
+        devices: *mut *mut sunxi_efex_multi_device_t,
+        count: *mut size_t,
+    ) -> c_int;
+
+    pub fn sunxi_efex_multi_free(devices: *mut sunxi_efex_multi_device_t, count: size_t);
 }
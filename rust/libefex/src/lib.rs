@@ -26,6 +26,26 @@ pub struct HotplugDevice {
     pub device_path: Option<String>,
 }
 
+impl HotplugDevice {
+    unsafe fn from_raw(d: &sunxi_hotplug_device_t) -> Self {
+        HotplugDevice {
+            vendor_id: d.vid,
+            product_id: d.pid,
+            bus_id: d.bus_id,
+            usb_device_id: d.usb_device_id,
+            port: (d.port != 0).then_some(d.port),
+            device_path: (!d.device_path.is_null())
+                .then(|| CStr::from_ptr(d.device_path).to_string_lossy().into_owned()),
+        }
+    }
+}
+
+#[derive(Debug, Clone)]
+pub enum HotplugEvent {
+    Arrived(HotplugDevice),
+    Left(HotplugDevice),
+}
+
 #[derive(Error, Debug)]
 pub enum EfexError {
     /// Invalid parameter
@@ -109,6 +129,9 @@ pub enum EfexError {
     /// File size error
     #[error("File size error")]
     FileSize,
+    /// Unrecognized or corrupt file contents
+    #[error("Invalid file format")]
+    FileFormat,
     /// Unknown error
     #[error("Unknown error: {0}")]
     Unknown(i32),
@@ -148,6 +171,7 @@ fn c_error_to_rust(error_code: i32) -> EfexError {
         -61 => EfexError::FileRead,          // EFEX_ERR_FILE_READ
         -62 => EfexError::FileWrite,         // EFEX_ERR_FILE_WRITE
         -63 => EfexError::FileSize,          // EFEX_ERR_FILE_SIZE
+        -64 => EfexError::FileFormat,        // EFEX_ERR_FILE_FORMAT
         _ => EfexError::Unknown(error_code),
     }
 }
@@ -184,14 +208,20 @@ fn c_mode_to_rust(mode: sunxi_verify_device_mode_t) -> DeviceMode {
 pub struct Context {
     ctx: sunxi_efex_ctx_t,
     initialized: bool,
+    policy: Option<Box<sunxi_efex_policy_t>>,
 }
 
+// The C library keeps all device state in the context, so a context may move between threads;
+// it is not Sync, as one context must only be used by one thread at a time.
+unsafe impl Send for Context {}
+
 impl Context {
     /// Create a new context
     pub fn new() -> Self {
         Context {
             ctx: unsafe { std::mem::zeroed() },
             initialized: false,
+            policy: None,
         }
     }
 
@@ -211,6 +241,17 @@ impl Context {
         c_usb_backend_to_rust(backend)
     }
 
+    /// Set the USB backend of this context, before scanning for the device
+    pub fn set_usb_backend(&mut self, backend: UsbBackend) -> Result<(), EfexError> {
+        let result = unsafe {
+            libefex_sys::sunxi_usb_set_backend(&mut self.ctx, rust_usb_backend_to_c(backend))
+        };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(())
+    }
+
     /// Scan USB devices
     pub fn scan_usb_device(&mut self) -> Result<(), EfexError> {
         let result = unsafe { sunxi_scan_usb_device(&mut self.ctx) };
@@ -312,23 +353,48 @@ impl Context {
 
         let devices = unsafe {
             let slice = std::slice::from_raw_parts(devices_ptr, count);
-            let vec: Vec<HotplugDevice> = slice
+            let vec: Vec<HotplugDevice> = slice.iter().map(|d| HotplugDevice::from_raw(d)).collect();
+            sunxi_hotplug_free_snapshot(devices_ptr, count);
+            vec
+        };
+
+        Ok(devices)
+    }
+
+    /// Wait up to `timeout_ms` for hotplug events.
+    ///
+    /// The first call reports every device already present as arrived. Returns an empty
+    /// vector on timeout. A negative timeout is rejected with `EfexError::InvalidParam`.
+    pub fn poll_hotplug_events(timeout_ms: i32) -> Result<Vec<HotplugEvent>, EfexError> {
+        let mut events_ptr: *mut sunxi_hotplug_event_t = std::ptr::null_mut();
+        let mut count: usize = 0;
+
+        let result = unsafe { sunxi_hotplug_poll(&mut events_ptr, &mut count, timeout_ms) };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+
+        if events_ptr.is_null() || count == 0 {
+            return Ok(Vec::new());
+        }
+
+        let events = unsafe {
+            let slice = std::slice::from_raw_parts(events_ptr, count);
+            let vec: Vec<HotplugEvent> = slice
                 .iter()
-                .map(|d| HotplugDevice {
-                    vendor_id: d.vid,
-                    product_id: d.pid,
-                    bus_id: d.bus_id,
-                    usb_device_id: d.usb_device_id,
-                    port: (d.port != 0).then_some(d.port),
-                    device_path: (!d.device_path.is_null())
-                        .then(|| CStr::from_ptr(d.device_path).to_string_lossy().into_owned()),
+                .map(|e| {
+                    let device = HotplugDevice::from_raw(&e.device);
+                    match e.type_ {
+                        sunxi_hotplug_event_type_t::SUNXI_HOTPLUG_ARRIVED => HotplugEvent::Arrived(device),
+                        sunxi_hotplug_event_type_t::SUNXI_HOTPLUG_LEFT => HotplugEvent::Left(device),
+                    }
                 })
                 .collect();
-            sunxi_hotplug_free_snapshot(devices_ptr, count);
+            sunxi_hotplug_free_events(events_ptr, count);
             vec
         };
 
-        Ok(devices)
+        Ok(events)
     }
 
     /// Initialize USB
@@ -340,6 +406,178 @@ impl Context {
         Ok(())
     }
 
+    /// Set the number of URBs kept in flight per data phase (0 or 1 = synchronous)
+    pub fn set_queue_depth(&mut self, queue_depth: u32) -> Result<(), EfexError> {
+        let result = unsafe { sunxi_usb_set_queue_depth(&mut self.ctx, queue_depth as c_int) };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(())
+    }
+
+    /// Enable or disable pipelined FEL transfers (all USB phases of a chunk queued at once)
+    pub fn set_fel_pipeline(&mut self, enable: bool) -> Result<(), EfexError> {
+        let result = unsafe { sunxi_efex_fel_set_pipeline(&mut self.ctx, enable as c_int) };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(())
+    }
+
+    /// Enable or disable verified FEL writes, checked with a device-side CRC32 after each write
+    pub fn set_fel_verify(&mut self, enable: bool) -> Result<(), EfexError> {
+        let result = unsafe { sunxi_efex_fel_set_verify(&mut self.ctx, enable as c_int) };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(())
+    }
+
+    /// Set a fixed number of bytes per FEL/FES transaction (0 = default 64KB)
+    pub fn set_chunk_size(&mut self, chunk_size: u32) -> Result<(), EfexError> {
+        let result = unsafe { sunxi_efex_set_chunk_size(&mut self.ctx, chunk_size) };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(())
+    }
+
+    /// Enable or disable chunk size auto-tuning from measured throughput
+    pub fn set_chunk_auto(&mut self, enable: bool) -> Result<(), EfexError> {
+        let result = unsafe { sunxi_efex_set_chunk_auto(&mut self.ctx, enable as c_int) };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(())
+    }
+
+    /// Probe the largest chunk the device accepts by reading at a safe address
+    pub fn probe_chunk_size(&mut self, addr: u32, max: u32) -> Result<u32, EfexError> {
+        let mut accepted: u32 = 0;
+        let result = unsafe { sunxi_efex_probe_chunk_size(&mut self.ctx, addr, max, &mut accepted) };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(accepted)
+    }
+
+    /// Attach a timeout and retry policy: base timeout (0 = default), extra timeout per MiB of data,
+    /// retries per failed chunk and the pause before each retry
+    pub fn set_retry_policy(
+        &mut self,
+        timeout_ms: u32,
+        timeout_per_mib_ms: u32,
+        max_retries: u32,
+        retry_delay_ms: u32,
+    ) -> Result<(), EfexError> {
+        let mut policy: Box<sunxi_efex_policy_t> = Box::new(unsafe { std::mem::zeroed() });
+        unsafe { sunxi_efex_policy_init(policy.as_mut()) };
+        if timeout_ms != 0 {
+            policy.timeout_ms = timeout_ms;
+        }
+        policy.timeout_per_mib_ms = timeout_per_mib_ms;
+        policy.max_retries = max_retries;
+        policy.retry_delay_ms = retry_delay_ms;
+
+        let result = unsafe { sunxi_efex_set_policy(&mut self.ctx, policy.as_mut()) };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        self.policy = Some(policy);
+        Ok(())
+    }
+
+    /// Retry statistics of the attached policy: (retries, recovered, failed, timeouts)
+    pub fn retry_stats(&self) -> Option<(u64, u64, u64, u64)> {
+        self.policy.as_ref().map(|p| {
+            (
+                p.stats.retries,
+                p.stats.recovered,
+                p.stats.failed,
+                p.stats.timeouts,
+            )
+        })
+    }
+
+    /// Enable or disable per-command transfer statistics and latency histograms
+    pub fn enable_stats(&mut self, enable: bool) -> Result<(), EfexError> {
+        let result = unsafe { sunxi_efex_stats_enable(&mut self.ctx, enable as c_int) };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(())
+    }
+
+    /// Transfer statistics collected since enabling or the last reset
+    pub fn stats(&self) -> Result<sunxi_efex_stats_t, EfexError> {
+        let mut stats = sunxi_efex_stats_t::default();
+        let result = unsafe { sunxi_efex_stats_get(&self.ctx, &mut stats) };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(stats)
+    }
+
+    /// Reset the transfer statistics to zero
+    pub fn reset_stats(&mut self) -> Result<(), EfexError> {
+        let result = unsafe { sunxi_efex_stats_reset(&mut self.ctx) };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(())
+    }
+
+    /// Record every bulk transfer into a ring of `records` entries (0 = off), keeping the first
+    /// `snap` payload bytes of each
+    pub fn enable_trace(&mut self, records: usize, snap: usize) -> Result<(), EfexError> {
+        let result = unsafe { sunxi_efex_trace_enable(&mut self.ctx, records, snap) };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(())
+    }
+
+    /// Records still held by the trace ring, oldest first
+    pub fn trace(&self) -> Result<Vec<sunxi_efex_trace_record_t>, EfexError> {
+        let mut count: usize = 0;
+        let result = unsafe { sunxi_efex_trace_get(&self.ctx, std::ptr::null_mut(), 0, &mut count) };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+
+        let mut records = Vec::with_capacity(count);
+        let result = unsafe { sunxi_efex_trace_get(&self.ctx, records.as_mut_ptr(), count, &mut count) };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        unsafe { records.set_len(count) };
+        Ok(records)
+    }
+
+    /// Write the trace ring to a file
+    pub fn export_trace(&self, path: &str, format: TraceFormat) -> Result<(), EfexError> {
+        let c_path = std::ffi::CString::new(path).map_err(|_| EfexError::InvalidParam)?;
+        let format = match format {
+            TraceFormat::Chrome => sunxi_efex_trace_format_t::SUNXI_EFEX_TRACE_CHROME,
+            TraceFormat::Binary => sunxi_efex_trace_format_t::SUNXI_EFEX_TRACE_BINARY,
+        };
+        let result = unsafe { sunxi_efex_trace_export(&self.ctx, c_path.as_ptr(), format) };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(())
+    }
+
+    /// Record the transfers of this context, None to stop; the recorder must outlive the recording
+    pub fn attach_recorder(&mut self, recorder: Option<&Recorder>) -> Result<(), EfexError> {
+        let rec = recorder.map_or(std::ptr::null_mut(), |r| r.rec);
+        let result = unsafe { sunxi_efex_record_attach(&mut self.ctx, rec) };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(())
+    }
+
     /// Initialize EFEX
     pub fn efex_init(&mut self) -> Result<(), EfexError> {
         let result = unsafe { sunxi_efex_init(&mut self.ctx) };
@@ -612,6 +850,219 @@ impl Context {
         Ok(())
     }
 
+    /// Download data to device, returning the CRC32 of what was sent
+    ///
+    /// The CRC is computed chunk by chunk as the transfer runs, for comparison with the
+    /// CRC the device reports in its verify response.
+    pub fn fes_down_crc(&self, buf: &[u8], addr: u32, data_type: FesDataType) -> Result<u32, EfexError> {
+        let mut crc: u32 = 0;
+        let result = unsafe {
+            sunxi_efex_fes_down_crc(
+                self.as_ptr(),
+                buf.as_ptr() as *const c_char,
+                buf.len() as c_int,
+                addr,
+                rust_fes_data_type_to_c(data_type),
+                &mut crc,
+            )
+        };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(crc)
+    }
+
+    /// Download data to device from a reader, returning the CRC32 of what was sent
+    ///
+    /// Only a few chunks of the data are in memory at a time; the library reads ahead on its
+    /// own thread while earlier chunks go out. The reader must supply `total_len` bytes.
+    pub fn fes_down_stream<R: std::io::Read + Send>(
+        &self,
+        reader: &mut R,
+        total_len: u64,
+        addr: u32,
+        data_type: FesDataType,
+    ) -> Result<u32, EfexError> {
+        let mut crc: u32 = 0;
+        let result = unsafe {
+            sunxi_efex_fes_down_stream(
+                self.as_ptr(),
+                Some(stream_read::<R>),
+                reader as *mut R as *mut std::ffi::c_void,
+                total_len,
+                addr,
+                rust_fes_data_type_to_c(data_type),
+                &mut crc,
+            )
+        };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(crc)
+    }
+
+    /// Download data to device, leaving out blank runs the target already holds
+    ///
+    /// Returns the CRC32 of the data, skipped runs included, and the number of bytes not sent.
+    pub fn fes_down_sparse(
+        &self,
+        buf: &[u8],
+        addr: u32,
+        data_type: FesDataType,
+        blank: SparseFill,
+    ) -> Result<(u32, u64), EfexError> {
+        let mut crc: u32 = 0;
+        let mut skipped: u64 = 0;
+        let result = unsafe {
+            sunxi_efex_fes_down_sparse(
+                self.as_ptr(),
+                buf.as_ptr() as *const c_char,
+                buf.len() as u64,
+                addr,
+                rust_fes_data_type_to_c(data_type),
+                rust_sparse_fill_to_c(blank),
+                &mut crc,
+                &mut skipped,
+            )
+        };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok((crc, skipped))
+    }
+
+    /// Download an Android sparse image (.simg) to device, expanded on the fly
+    ///
+    /// Returns the CRC32 of the expanded image and the number of bytes not sent.
+    pub fn fes_down_simg(
+        &self,
+        data: &[u8],
+        addr: u32,
+        data_type: FesDataType,
+        blank: SparseFill,
+    ) -> Result<(u32, u64), EfexError> {
+        let mut crc: u32 = 0;
+        let mut skipped: u64 = 0;
+        let result = unsafe {
+            sunxi_efex_fes_down_simg(
+                self.as_ptr(),
+                data.as_ptr() as *const c_char,
+                data.len() as u64,
+                addr,
+                rust_fes_data_type_to_c(data_type),
+                rust_sparse_fill_to_c(blank),
+                &mut crc,
+                &mut skipped,
+            )
+        };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok((crc, skipped))
+    }
+
+    /// Upload data from device into a writer, returning the CRC32 of what was received
+    ///
+    /// The writer runs on the library's own thread behind the USB transfers, so a slow disk
+    /// does not stall them; only a few chunks of the data are in memory at a time.
+    pub fn fes_up_stream<W: std::io::Write + Send>(
+        &self,
+        writer: &mut W,
+        total_len: u64,
+        addr: u32,
+        data_type: FesDataType,
+    ) -> Result<u32, EfexError> {
+        let mut crc: u32 = 0;
+        let result = unsafe {
+            sunxi_efex_fes_up_stream(
+                self.as_ptr(),
+                Some(stream_write::<W>),
+                writer as *mut W as *mut std::ffi::c_void,
+                total_len,
+                addr,
+                rust_fes_data_type_to_c(data_type),
+                &mut crc,
+            )
+        };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(crc)
+    }
+
+    /// Upload data from device into a sparse dump file, optionally with a block map
+    ///
+    /// Returns the number of bytes stored in the file, headers included.
+    pub fn fes_up_sparse(
+        &self,
+        path: &str,
+        format: SparseFormat,
+        map_path: Option<&str>,
+        total_len: u64,
+        addr: u32,
+        data_type: FesDataType,
+    ) -> Result<u64, EfexError> {
+        let c_path = std::ffi::CString::new(path).map_err(|_| EfexError::InvalidParam)?;
+        let c_map = match map_path {
+            Some(path) => Some(std::ffi::CString::new(path).map_err(|_| EfexError::InvalidParam)?),
+            None => None,
+        };
+        let mut sink = Box::new(std::mem::MaybeUninit::<sunxi_efex_sparse_sink_t>::uninit());
+        let sink = sink.as_mut_ptr();
+        let result = unsafe {
+            sunxi_efex_sparse_sink_open(
+                sink,
+                c_path.as_ptr(),
+                rust_sparse_format_to_c(format),
+                c_map.as_ref().map_or(std::ptr::null(), |p| p.as_ptr()),
+            )
+        };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        let result = unsafe {
+            sunxi_efex_fes_up_stream(
+                self.as_ptr(),
+                Some(sunxi_efex_sparse_sink_write),
+                sink as *mut std::ffi::c_void,
+                total_len,
+                addr,
+                rust_fes_data_type_to_c(data_type),
+                std::ptr::null_mut(),
+            )
+        };
+        let close_result = unsafe { sunxi_efex_sparse_sink_close(sink) };
+        let result = if result == EFEX_ERR_SUCCESS { close_result } else { result };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(unsafe { (*sink).written })
+    }
+
+    /// Upload data from device, returning the CRC32 of what was received
+    pub fn fes_up_crc(
+        &self,
+        buf: &mut [u8],
+        addr: u32,
+        data_type: FesDataType,
+    ) -> Result<u32, EfexError> {
+        let mut crc: u32 = 0;
+        let result = unsafe {
+            sunxi_efex_fes_up_crc(
+                self.as_ptr(),
+                buf.as_mut_ptr() as *const c_char,
+                buf.len() as c_int,
+                addr,
+                rust_fes_data_type_to_c(data_type),
+                &mut crc,
+            )
+        };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(crc)
+    }
+
     /// Upload (read) data from raw NAND (byte-addressed, FES_NAND command).
     pub fn fes_nand_up(
         &self,
@@ -960,6 +1411,140 @@ pub enum PayloadArch {
     Riscv,
 }
 
+/// Transaction trace export format
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum TraceFormat {
+    /// Chrome trace event JSON (chrome://tracing, Perfetto)
+    Chrome,
+    /// Compact binary records
+    Binary,
+}
+
+/// Replay speed of `UsbBackend::Replay`
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum ReplaySpeed {
+    /// As fast as possible, only host-side time remains
+    Fast,
+    /// Every transfer takes as long as it did on the device
+    Recorded,
+}
+
+/// Records every bulk transfer of the contexts it is attached to into a file
+pub struct Recorder {
+    rec: *mut std::ffi::c_void,
+}
+
+impl Recorder {
+    /// Create a recording file; without `out_data` only the length of sent data is kept
+    pub fn open(path: &str, out_data: bool) -> Result<Self, EfexError> {
+        let c_path = std::ffi::CString::new(path).map_err(|_| EfexError::InvalidParam)?;
+        let flags = if out_data { 0 } else { SUNXI_EFEX_RECORD_NO_OUT_DATA };
+        let mut rec = std::ptr::null_mut();
+        let result = unsafe { sunxi_efex_record_open(c_path.as_ptr(), flags, &mut rec) };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(Recorder { rec })
+    }
+
+    /// Flush and close the recording, reporting data that could not be written
+    pub fn close(mut self) -> Result<(), EfexError> {
+        let rec = std::mem::replace(&mut self.rec, std::ptr::null_mut());
+        let result = unsafe { sunxi_efex_record_close(rec) };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(())
+    }
+}
+
+impl Drop for Recorder {
+    fn drop(&mut self) {
+        unsafe {
+            sunxi_efex_record_close(self.rec);
+        }
+    }
+}
+
+/// Set the recording `UsbBackend::Replay` serves, None to close it
+pub fn configure_replay(path: Option<&str>, speed: ReplaySpeed) -> Result<(), EfexError> {
+    let c_path = match path {
+        Some(path) => Some(std::ffi::CString::new(path).map_err(|_| EfexError::InvalidParam)?),
+        None => None,
+    };
+    let speed = match speed {
+        ReplaySpeed::Fast => sunxi_efex_replay_speed_t::SUNXI_EFEX_REPLAY_FAST,
+        ReplaySpeed::Recorded => sunxi_efex_replay_speed_t::SUNXI_EFEX_REPLAY_RECORDED,
+    };
+    let result = unsafe {
+        sunxi_usb_replay_configure(c_path.as_ref().map_or(std::ptr::null(), |p| p.as_ptr()), speed)
+    };
+    if result != EFEX_ERR_SUCCESS {
+        return Err(c_error_to_rust(result));
+    }
+    Ok(())
+}
+
+/// Simulated device configuration, for `UsbBackend::Sim`
+#[derive(Debug, Clone)]
+pub struct SimConfig {
+    /// Mode the devices come up in
+    pub mode: DeviceMode,
+    /// Chip ID reported to the host
+    pub chip_id: u32,
+    /// Storage type reported by FES storage queries
+    pub storage_type: u32,
+    /// Flash image file, created if missing; None keeps flash in memory
+    pub flash_path: Option<String>,
+    /// Flash size in bytes, 0 for the image size or the default
+    pub flash_size: u64,
+    /// Latency added to every bulk transfer
+    pub latency_us: u32,
+    /// Bytes per second, 0 for unlimited
+    pub bandwidth: u64,
+}
+
+impl Default for SimConfig {
+    fn default() -> Self {
+        SimConfig {
+            mode: DeviceMode::Fel,
+            chip_id: SUNXI_EFEX_SIM_CHIP_ID,
+            storage_type: 0,
+            flash_path: None,
+            flash_size: 0,
+            latency_us: 0,
+            bandwidth: 0,
+        }
+    }
+}
+
+/// Configure the devices `UsbBackend::Sim` presents, on bus 0, ports 1 to `devices`
+pub fn configure_sim(config: &SimConfig, devices: u32) -> Result<(), EfexError> {
+    let flash_path = match &config.flash_path {
+        Some(path) => {
+            Some(std::ffi::CString::new(path.as_str()).map_err(|_| EfexError::InvalidParam)?)
+        }
+        None => None,
+    };
+    let mut c_config: sunxi_efex_sim_config_t = unsafe { std::mem::zeroed() };
+    unsafe { sunxi_efex_sim_config_init(&mut c_config) };
+    c_config.mode = match config.mode {
+        DeviceMode::Srv => sunxi_verify_device_mode_t::DEVICE_MODE_SRV as u16,
+        _ => sunxi_verify_device_mode_t::DEVICE_MODE_FEL as u16,
+    };
+    c_config.chip_id = config.chip_id;
+    c_config.storage_type = config.storage_type;
+    c_config.flash_path = flash_path.as_ref().map_or(std::ptr::null(), |p| p.as_ptr());
+    c_config.flash_size = config.flash_size;
+    c_config.latency_us = config.latency_us;
+    c_config.bandwidth = config.bandwidth;
+    let result = unsafe { sunxi_usb_sim_configure(&c_config, devices) };
+    if result != EFEX_ERR_SUCCESS {
+        return Err(c_error_to_rust(result));
+    }
+    Ok(())
+}
+
 /// USB backend type enumeration
 #[derive(Debug, Copy, Clone, PartialEq, Eq)]
 pub enum UsbBackend {
@@ -969,6 +1554,10 @@ pub enum UsbBackend {
     Libusb,
     /// Force use winusb (Windows only)
     Winusb,
+    /// In-process simulated devices, see `configure_sim`
+    Sim,
+    /// Serves a recording, see `configure_replay`
+    Replay,
 }
 
 /// Convert Rust USB backend to C USB backend
@@ -977,6 +1566,8 @@ fn rust_usb_backend_to_c(backend: UsbBackend) -> libefex_sys::usb_backend_type {
         UsbBackend::Auto => libefex_sys::usb_backend_type::USB_BACKEND_AUTO,
         UsbBackend::Libusb => libefex_sys::usb_backend_type::USB_BACKEND_LIBUSB,
         UsbBackend::Winusb => libefex_sys::usb_backend_type::USB_BACKEND_WINUSB,
+        UsbBackend::Sim => libefex_sys::usb_backend_type::USB_BACKEND_SIM,
+        UsbBackend::Replay => libefex_sys::usb_backend_type::USB_BACKEND_REPLAY,
     }
 }
 
@@ -986,6 +1577,8 @@ fn c_usb_backend_to_rust(backend: libefex_sys::usb_backend_type) -> UsbBackend {
         libefex_sys::usb_backend_type::USB_BACKEND_AUTO => UsbBackend::Auto,
         libefex_sys::usb_backend_type::USB_BACKEND_LIBUSB => UsbBackend::Libusb,
         libefex_sys::usb_backend_type::USB_BACKEND_WINUSB => UsbBackend::Winusb,
+        libefex_sys::usb_backend_type::USB_BACKEND_SIM => UsbBackend::Sim,
+        libefex_sys::usb_backend_type::USB_BACKEND_REPLAY => UsbBackend::Replay,
     }
 }
 
@@ -1109,6 +1702,137 @@ fn rust_arch_to_c(arch: PayloadArch) -> sunxi_efex_fel_payloads_arch {
     }
 }
 
+/// Continue a zlib-compatible CRC32 over more data, starting from 0
+pub fn crc32(crc: u32, data: &[u8]) -> u32 {
+    unsafe { sunxi_efex_crc32(crc, data.as_ptr() as *const std::ffi::c_void, data.len()) }
+}
+
+/// Contents of a block, and what a target reads as where nothing is written
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum SparseFill {
+    /// Mixed contents; as target state nothing is assumed and only DONT_CARE is skipped
+    Data,
+    /// All bytes 0x00
+    Zero,
+    /// All bytes 0xFF, as erased NAND or NOR
+    Erased,
+}
+
+/// Convert Rust sparse fill to C sparse fill
+fn rust_sparse_fill_to_c(fill: SparseFill) -> sunxi_efex_sparse_fill_t {
+    match fill {
+        SparseFill::Data => sunxi_efex_sparse_fill_t::SUNXI_EFEX_SPARSE_DATA,
+        SparseFill::Zero => sunxi_efex_sparse_fill_t::SUNXI_EFEX_SPARSE_ZERO,
+        SparseFill::Erased => sunxi_efex_sparse_fill_t::SUNXI_EFEX_SPARSE_ERASED,
+    }
+}
+
+/// Output format of a sparse dump
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum SparseFormat {
+    /// Plain image, zero blocks left as holes the filesystem does not store
+    Holes,
+    /// Android sparse image, uniform blocks as FILL chunks
+    Simg,
+}
+
+/// Convert Rust sparse format to C sparse format
+fn rust_sparse_format_to_c(format: SparseFormat) -> sunxi_efex_sparse_format_t {
+    match format {
+        SparseFormat::Holes => sunxi_efex_sparse_format_t::SUNXI_EFEX_SPARSE_HOLES,
+        SparseFormat::Simg => sunxi_efex_sparse_format_t::SUNXI_EFEX_SPARSE_SIMG,
+    }
+}
+
+/// Classify a buffer as all 0x00, all 0xFF or data
+pub fn sparse_classify(data: &[u8]) -> SparseFill {
+    match unsafe { sunxi_efex_sparse_classify(data.as_ptr() as *const std::ffi::c_void, data.len()) } {
+        sunxi_efex_sparse_fill_t::SUNXI_EFEX_SPARSE_ZERO => SparseFill::Zero,
+        sunxi_efex_sparse_fill_t::SUNXI_EFEX_SPARSE_ERASED => SparseFill::Erased,
+        sunxi_efex_sparse_fill_t::SUNXI_EFEX_SPARSE_DATA => SparseFill::Data,
+    }
+}
+
+/// Whether data starts with an Android sparse image header
+pub fn is_simg(data: &[u8]) -> bool {
+    unsafe { sunxi_efex_simg_check(data.as_ptr() as *const std::ffi::c_void, data.len() as u64) != 0 }
+}
+
+/// A firmware file mapped into memory, see sunxi_efex_image_open
+///
+/// The data can be passed to the transfer functions as it is. Writes to it stay private to
+/// this mapping and never reach the file.
+pub struct Image {
+    raw: sunxi_efex_image_t,
+}
+
+impl Image {
+    /// Map a file, reading it into memory instead where it cannot be mapped
+    pub fn open(path: &str) -> Result<Self, EfexError> {
+        let path = std::ffi::CString::new(path).map_err(|_| EfexError::InvalidParam)?;
+        let mut raw: sunxi_efex_image_t = unsafe { std::mem::zeroed() };
+        let result = unsafe { sunxi_efex_image_open(&mut raw, path.as_ptr()) };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(Image { raw })
+    }
+
+    /// Whether the data maps the file rather than being a heap copy
+    pub fn is_mapped(&self) -> bool {
+        self.raw.mapped != 0
+    }
+
+    pub fn as_slice(&self) -> &[u8] {
+        unsafe { std::slice::from_raw_parts(self.raw.data as *const u8, self.raw.size as usize) }
+    }
+
+    pub fn as_mut_slice(&mut self) -> &mut [u8] {
+        unsafe { std::slice::from_raw_parts_mut(self.raw.data as *mut u8, self.raw.size as usize) }
+    }
+}
+
+// The mapping is plain memory, one image can feed several boards at once
+unsafe impl Send for Image {}
+unsafe impl Sync for Image {}
+
+impl Drop for Image {
+    fn drop(&mut self) {
+        unsafe { sunxi_efex_image_close(&mut self.raw) }
+    }
+}
+
+/// Reader callback of the streaming downloads, called from the library's reader thread
+unsafe extern "C" fn stream_read<R: std::io::Read>(
+    user: *mut std::ffi::c_void,
+    buf: *mut c_char,
+    len: libc::size_t,
+) -> isize {
+    let reader = &mut *(user as *mut R);
+    let buf = std::slice::from_raw_parts_mut(buf as *mut u8, len);
+    loop {
+        match reader.read(buf) {
+            Ok(n) => return n as isize,
+            Err(e) if e.kind() == std::io::ErrorKind::Interrupted => continue,
+            Err(_) => return -61, // EFEX_ERR_FILE_READ
+        }
+    }
+}
+
+/// Writer callback of the streaming uploads, called from the library's writer thread
+unsafe extern "C" fn stream_write<W: std::io::Write>(
+    user: *mut std::ffi::c_void,
+    buf: *const c_char,
+    len: libc::size_t,
+) -> c_int {
+    let writer = &mut *(user as *mut W);
+    let buf = std::slice::from_raw_parts(buf as *const u8, len);
+    match writer.write_all(buf) {
+        Ok(()) => EFEX_ERR_SUCCESS,
+        Err(_) => -62, // EFEX_ERR_FILE_WRITE
+    }
+}
+
 /// Payloads related functions
 pub mod payloads {
     use super::*;
@@ -1122,6 +1846,15 @@ pub mod payloads {
         Ok(())
     }
 
+    /// Select the payloads of one context, overriding the default set by `init`
+    pub fn select(ctx: &mut Context, arch: PayloadArch) -> Result<(), EfexError> {
+        let result = unsafe { sunxi_efex_fel_payloads_select(ctx.as_mut_ptr(), rust_arch_to_c(arch)) };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(())
+    }
+
     /// Read 32-bit value
     pub fn readl(ctx: &Context, addr: u32) -> Result<u32, EfexError> {
         let mut val: u32 = 0;
@@ -1140,6 +1873,126 @@ pub mod payloads {
         }
         Ok(())
     }
+
+    /// Read the 32-bit values of several addresses, one payload run per batch
+    pub fn readl_batch(ctx: &Context, addrs: &[u32]) -> Result<Vec<u32>, EfexError> {
+        let mut vals = vec![0u32; addrs.len()];
+        let result = unsafe {
+            sunxi_efex_fel_payloads_readl_batch(ctx.as_ptr(), addrs.as_ptr(), vals.as_mut_ptr(), addrs.len())
+        };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(vals)
+    }
+
+    /// Write 32-bit values to several addresses in order, one payload run per batch
+    pub fn writel_batch(ctx: &Context, addrs: &[u32], vals: &[u32]) -> Result<(), EfexError> {
+        if addrs.len() != vals.len() {
+            return Err(EfexError::InvalidParam);
+        }
+        let result = unsafe {
+            sunxi_efex_fel_payloads_writel_batch(ctx.as_ptr(), addrs.as_ptr(), vals.as_ptr(), addrs.len())
+        };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(())
+    }
+
+    /// Fill device memory with a byte on the device CPU, without sending the data over USB
+    pub fn memset(ctx: &Context, addr: u32, value: u8, len: u32) -> Result<(), EfexError> {
+        let result = unsafe { sunxi_efex_fel_memset(ctx.as_ptr(), addr, value, len) };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(())
+    }
+
+    /// Copy between non-overlapping ranges of device memory on the device CPU
+    pub fn memcpy(ctx: &Context, dst: u32, src: u32, len: u32) -> Result<(), EfexError> {
+        let result = unsafe { sunxi_efex_fel_memcpy(ctx.as_ptr(), dst, src, len) };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(())
+    }
+
+    /// CRC32 of device memory computed on the device CPU, comparable with `crate::crc32`
+    pub fn crc32(ctx: &Context, addr: u32, len: u32) -> Result<u32, EfexError> {
+        let mut crc: u32 = 0;
+        let result = unsafe { sunxi_efex_fel_crc32(ctx.as_ptr(), addr, len, &mut crc) };
+        if result != EFEX_ERR_SUCCESS {
+            return Err(c_error_to_rust(result));
+        }
+        Ok(crc)
+    }
+
+    /// Register sequence the interpreter payload runs on the device in one exec
+    ///
+    /// Builder errors, such as a full sequence, are kept and reported by `run`.
+    pub struct Sequence {
+        seq: Box<sunxi_efex_seq_t>,
+    }
+
+    impl Sequence {
+        pub fn new() -> Self {
+            let mut seq: Box<sunxi_efex_seq_t> = Box::new(unsafe { std::mem::zeroed() });
+            unsafe { sunxi_efex_seq_init(seq.as_mut()) };
+            Sequence { seq }
+        }
+
+        /// Write a 32-bit register
+        pub fn write(&mut self, addr: u32, value: u32) -> &mut Self {
+            unsafe { sunxi_efex_seq_write(self.seq.as_mut(), addr, value) };
+            self
+        }
+
+        /// Read a 32-bit register, its value is returned by `run`
+        pub fn read(&mut self, addr: u32) -> &mut Self {
+            unsafe { sunxi_efex_seq_read(self.seq.as_mut(), addr) };
+            self
+        }
+
+        /// Clear and then set bits of a register
+        pub fn modify(&mut self, addr: u32, clear: u32, set: u32) -> &mut Self {
+            unsafe { sunxi_efex_seq_modify(self.seq.as_mut(), addr, clear, set) };
+            self
+        }
+
+        /// Wait until `(reg & mask) == value`, reading the register at most `tries` times
+        pub fn poll(&mut self, addr: u32, mask: u32, value: u32, tries: u32) -> &mut Self {
+            unsafe { sunxi_efex_seq_poll(self.seq.as_mut(), addr, mask, value, tries) };
+            self
+        }
+
+        /// Spin for a number of loop iterations
+        pub fn delay(&mut self, loops: u32) -> &mut Self {
+            unsafe { sunxi_efex_seq_delay(self.seq.as_mut(), loops) };
+            self
+        }
+
+        /// Run the sequence and return the values read; a poll that gave up is `DeviceNotReady`
+        pub fn run(&self, ctx: &Context) -> Result<Vec<u32>, EfexError> {
+            let mut reads = vec![0u32; self.seq.reads];
+            let result = unsafe {
+                sunxi_efex_fel_seq_run(ctx.as_ptr(), self.seq.as_ref(), reads.as_mut_ptr(), std::ptr::null_mut())
+            };
+            if result == sunxi_efex_error_t::EFEX_ERR_DEVICE_NOT_READY as i32 {
+                return Err(EfexError::DeviceNotReady);
+            }
+            if result != EFEX_ERR_SUCCESS {
+                return Err(c_error_to_rust(result));
+            }
+            Ok(reads)
+        }
+    }
+
+    impl Default for Sequence {
+        fn default() -> Self {
+            Self::new()
+        }
+    }
 }
 
 #[cfg(test)]
@@ -1160,6 +2013,13 @@ mod tests {
         assert!(matches!(c_error_to_rust(-11), EfexError::UsbDeviceNotFound)); // EFEX_ERR_USB_DEVICE_NOT_FOUND
     }
 
+    #[test]
+    fn test_crc32() {
+        // zlib check value, also when continued piece by piece
+        assert_eq!(crc32(0, b"123456789"), 0xcbf43926);
+        assert_eq!(crc32(crc32(0, b"1234"), b"56789"), 0xcbf43926);
+    }
+
     #[test]
     fn test_mode_conversion() {
         // Test device mode conversion
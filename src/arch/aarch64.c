@@ -41,33 +41,13 @@ static int payloads_readl(const struct sunxi_efex_ctx_t *ctx, const uint32_t add
 		return EFEX_ERR_NULL_PTR;
 	}
 
-	// Convert address to little-endian format before writing to memory
-	uint32_t addr_le32 = cpu_to_le32(addr);
+	// The address to read goes right after the code, the value read is stored after it
+	const uint32_t addr_le32 = cpu_to_le32(addr);
 	uint32_t tmp_val = 0;
-	int ret = EFEX_ERR_SUCCESS;
 
-	// Write the payload to the specified memory address in the context
-	ret = sunxi_efex_fel_write(ctx, ctx->resp.data_start_address, (void *) payload, sizeof(payload));
-	if (ret != EFEX_ERR_SUCCESS) {
-		return ret;
-	}
-
-	// Write the address to be read from into memory
-	ret = sunxi_efex_fel_write(ctx, ctx->resp.data_start_address + sizeof(payload), (void *) &addr_le32,
-							   sizeof(addr_le32));
-	if (ret != EFEX_ERR_SUCCESS) {
-		return ret;
-	}
-
-	// Execute the ARMv832 instructions starting at the given memory address
-	ret = sunxi_efex_fel_exec(ctx, ctx->resp.data_start_address);
-	if (ret != EFEX_ERR_SUCCESS) {
-		return ret;
-	}
-
-	// Read the value from memory after execution
-	ret = sunxi_efex_fel_read(ctx, ctx->resp.data_start_address + sizeof(payload) + sizeof(addr_le32),
-							  (void *) &tmp_val, sizeof(tmp_val));
+	// Upload the payload unless it is still resident, then run it and read the value back
+	const int ret = sunxi_efex_fel_payloads_run(ctx, payload, sizeof(payload), &addr_le32, sizeof(addr_le32), &tmp_val,
+	                                            sizeof(tmp_val));
 	if (ret != EFEX_ERR_SUCCESS) {
 		return ret;
 	}
@@ -109,33 +89,382 @@ static int payloads_writel(const struct sunxi_efex_ctx_t *ctx, const uint32_t va
 			cpu_to_le32(value),
 	};
 
-	int ret = EFEX_ERR_SUCCESS;
+	// Upload the payload unless it is still resident, then run it with the new parameters
+	return sunxi_efex_fel_payloads_run(ctx, payload, sizeof(payload), params, sizeof(params), NULL, 0);
+}
 
-	// Write the payload to the specified memory address in the context
-	ret = sunxi_efex_fel_write(ctx, ctx->resp.data_start_address, (void *) payload, sizeof(payload));
-	if (ret != EFEX_ERR_SUCCESS) {
-		return ret;
+// Function to read a list of 32-bit values in one payload run for ARMv8
+static int payloads_readl_batch(const struct sunxi_efex_ctx_t *ctx, const uint32_t *addrs, uint32_t *vals,
+                                const size_t count) {
+	// payload array containing ARMv8 machine code instructions for reading the values of a list of addresses
+	/* Note: Do NOT declare this array as 'static'. Some Windows drivers cannot access payload symbols marked static;
+	 * keep it non-static to ensure data visibility when writing to device memory via FEL.
+	 */
+	return EFEX_ERR_NOT_SUPPORT;
+	const uint32_t payload[] = {
+			WARP_INST(0b11100011101000000000000000000000), /* mov r0, #0 */
+			WARP_INST(0b11101110000010000000111100010111), /* mcr 15, 0, r0, cr8, cr7, {0} */
+			WARP_INST(0b11101110000001110000111100010101), /* mcr 15, 0, r0, cr7, cr5, {0} */
+			WARP_INST(0b11101110000001110000111111010101), /* mcr 15, 0, r0, cr7, cr5, {6} */
+			WARP_INST(0b11101110000001110000111110011010), /* mcr 15, 0, r0, cr7, cr10, {4} */
+			WARP_INST(0b11101110000001110000111110010101), /* mcr 15, 0, r0, cr7, cr5, {4} */
+			WARP_INST(0b11101010111111111111111111111111), /* b 0x4 */
+			WARP_INST(0b11100010100011110000000000011100), /* add r0, pc, #28 */
+			WARP_INST(0b11100100100100000001000000000100), /* ldr r1, [r0], #4 */
+			WARP_INST(0b11100000100000000010000100000001), /* add r2, r0, r1, lsl #2 */
+			WARP_INST(0b11100010010100010001000000000001), /* subs r1, r1, #1 */
+			WARP_INST(0b01000001001011111111111100011110), /* bxmi lr */
+			WARP_INST(0b11100100100100000011000000000100), /* ldr r3, [r0], #4 */
+			WARP_INST(0b11100101100100110011000000000000), /* ldr r3, [r3] */
+			WARP_INST(0b11100100100000100011000000000100), /* str r3, [r2], #4 */
+			WARP_INST(0b11101010111111111111111111111001), /* b -0x14 */
+			// Followed by uint32_t count, count addresses and room for count values
+	};
+
+	if (count > SUNXI_EFEX_PAYLOAD_BATCH_MAX) {
+		return EFEX_ERR_INVALID_PARAM;
 	}
 
-	// Write the parameters (address and value) to memory
-	ret = sunxi_efex_fel_write(ctx, ctx->resp.data_start_address + sizeof(payload), (void *) params, sizeof(params));
-	if (ret != EFEX_ERR_SUCCESS) {
-		return ret;
+	// The count and the addresses go right after the code, the values read are stored after them
+	uint32_t params[1 + SUNXI_EFEX_PAYLOAD_BATCH_MAX];
+	uint32_t result[SUNXI_EFEX_PAYLOAD_BATCH_MAX];
+	params[0] = cpu_to_le32((uint32_t) count);
+	for (size_t i = 0; i < count; i++) {
+		params[1 + i] = cpu_to_le32(addrs[i]);
 	}
 
-	// Execute the ARMv832 instructions starting at the given memory address
-	ret = sunxi_efex_fel_exec(ctx, ctx->resp.data_start_address);
+	const int ret = sunxi_efex_fel_payloads_run(ctx, payload, sizeof(payload), params, (1 + count) * sizeof(uint32_t),
+	                                            result, count * sizeof(uint32_t));
 	if (ret != EFEX_ERR_SUCCESS) {
 		return ret;
 	}
 
+	for (size_t i = 0; i < count; i++) {
+		vals[i] = le32_to_cpu(result[i]);
+	}
 	return EFEX_ERR_SUCCESS;
 }
 
+// Function to write a list of 32-bit values in one payload run for ARMv8
+static int payloads_writel_batch(const struct sunxi_efex_ctx_t *ctx, const uint32_t *addrs, const uint32_t *vals,
+                                 const size_t count) {
+	// payload array containing ARMv8 machine code instructions for writing values to a list of addresses
+	/* Note: Do NOT declare this array as 'static'. Some Windows drivers cannot access payload symbols marked static;
+	 * keep it non-static to ensure data visibility when writing to device memory via FEL.
+	 */
+	return EFEX_ERR_NOT_SUPPORT;
+	const uint32_t payload[] = {
+			WARP_INST(0b11100011101000000000000000000000), /* mov r0, #0 */
+			WARP_INST(0b11101110000010000000111100010111), /* mcr 15, 0, r0, cr8, cr7, {0} */
+			WARP_INST(0b11101110000001110000111100010101), /* mcr 15, 0, r0, cr7, cr5, {0} */
+			WARP_INST(0b11101110000001110000111111010101), /* mcr 15, 0, r0, cr7, cr5, {6} */
+			WARP_INST(0b11101110000001110000111110011010), /* mcr 15, 0, r0, cr7, cr10, {4} */
+			WARP_INST(0b11101110000001110000111110010101), /* mcr 15, 0, r0, cr7, cr5, {4} */
+			WARP_INST(0b11101010111111111111111111111111), /* b 0x4 */
+			WARP_INST(0b11100010100011110000000000011000), /* add r0, pc, #24 */
+			WARP_INST(0b11100100100100000001000000000100), /* ldr r1, [r0], #4 */
+			WARP_INST(0b11100010010100010001000000000001), /* subs r1, r1, #1 */
+			WARP_INST(0b01000001001011111111111100011110), /* bxmi lr */
+			WARP_INST(0b11100100100100000010000000000100), /* ldr r2, [r0], #4 */
+			WARP_INST(0b11100100100100000011000000000100), /* ldr r3, [r0], #4 */
+			WARP_INST(0b11100101100000100011000000000000), /* str r3, [r2] */
+			WARP_INST(0b11101010111111111111111111111001), /* b -0x14 */
+			// Followed by uint32_t count and count pairs of address and value
+	};
+
+	if (count > SUNXI_EFEX_PAYLOAD_BATCH_MAX) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+
+	// The count and the address/value pairs go right after the code
+	uint32_t params[1 + 2 * SUNXI_EFEX_PAYLOAD_BATCH_MAX];
+	params[0] = cpu_to_le32((uint32_t) count);
+	for (size_t i = 0; i < count; i++) {
+		params[1 + 2 * i] = cpu_to_le32(addrs[i]);
+		params[2 + 2 * i] = cpu_to_le32(vals[i]);
+	}
+
+	return sunxi_efex_fel_payloads_run(ctx, payload, sizeof(payload), params, (1 + 2 * count) * sizeof(uint32_t), NULL,
+	                                   0);
+}
+
+// Function to run a register sequence program for ARMv8
+static int payloads_seq(const struct sunxi_efex_ctx_t *ctx, const uint32_t *program, const size_t program_len,
+                        uint32_t *result, const size_t result_len) {
+	// payload array containing ARMv8 machine code instructions for the register sequence interpreter
+	/* Note: Do NOT declare this array as 'static'. Some Windows drivers cannot access payload symbols marked static;
+	 * keep it non-static to ensure data visibility when writing to device memory via FEL.
+	 */
+	return EFEX_ERR_NOT_SUPPORT;
+	const uint32_t payload[] = {
+			WARP_INST(0b11100011101000000000000000000000), /* mov r0, #0 */
+			WARP_INST(0b11101110000010000000111100010111), /* mcr 15, 0, r0, cr8, cr7, {0} */
+			WARP_INST(0b11101110000001110000111100010101), /* mcr 15, 0, r0, cr7, cr5, {0} */
+			WARP_INST(0b11101110000001110000111111010101), /* mcr 15, 0, r0, cr7, cr5, {6} */
+			WARP_INST(0b11101110000001110000111110011010), /* mcr 15, 0, r0, cr7, cr10, {4} */
+			WARP_INST(0b11101110000001110000111110010101), /* mcr 15, 0, r0, cr7, cr5, {4} */
+			WARP_INST(0b11101010111111111111111111111111), /* b 0x4 */
+			WARP_INST(0b11101001001011010100000111110000), /* push {r4, r5, r6, r7, r8, lr} */
+			WARP_INST(0b11100010100011110000000010001100), /* add r0, pc, #140 */
+			WARP_INST(0b11100100100100000001000000000100), /* ldr r1, [r0], #4 */
+			WARP_INST(0b11100000100000000010000000000001), /* add r2, r0, r1 */
+			WARP_INST(0b11100010100000100001000000000100), /* add r1, r2, #4 */
+			WARP_INST(0b11100011101000001100000000000000), /* mov r12, #0 */
+			WARP_INST(0b11101000101100000000000011111000), /* ldm r0!, {r3, r4, r5, r6, r7} */
+			WARP_INST(0b11100011010100110000000000000001), /* cmp r3, #1 */
+			WARP_INST(0b00000101100001000101000000000000), /* streq r5, [r4] */
+			WARP_INST(0b00001010000000000000000000010111), /* beq +100 */
+			WARP_INST(0b11100011010100110000000000000010), /* cmp r3, #2 */
+			WARP_INST(0b00000101100101001000000000000000), /* ldreq r8, [r4] */
+			WARP_INST(0b00000100100000011000000000000100), /* streq r8, [r1], #4 */
+			WARP_INST(0b00001010000000000000000000010011), /* beq +84 */
+			WARP_INST(0b11100011010100110000000000000011), /* cmp r3, #3 */
+			WARP_INST(0b00011010000000000000000000000100), /* bne +24 */
+			WARP_INST(0b11100101100101001000000000000000), /* ldr r8, [r4] */
+			WARP_INST(0b11100001110010001000000000000101), /* bic r8, r8, r5 */
+			WARP_INST(0b11100001100010001000000000000110), /* orr r8, r8, r6 */
+			WARP_INST(0b11100101100001001000000000000000), /* str r8, [r4] */
+			WARP_INST(0b11101010000000000000000000001100), /* b +56 */
+			WARP_INST(0b11100011010100110000000000000100), /* cmp r3, #4 */
+			WARP_INST(0b00011010000000000000000000000110), /* bne +32 */
+			WARP_INST(0b11100101100101001000000000000000), /* ldr r8, [r4] */
+			WARP_INST(0b11100000000010001000000000000101), /* and r8, r8, r5 */
+			WARP_INST(0b11100001010110000000000000000110), /* cmp r8, r6 */
+			WARP_INST(0b00001010000000000000000000000110), /* beq +32 */
+			WARP_INST(0b11100010010101110111000000000001), /* subs r7, r7, #1 */
+			WARP_INST(0b00011010111111111111111111111001), /* bne -20 */
+			WARP_INST(0b11101010000000000000000000000101), /* b +28 */
+			WARP_INST(0b11100011010100110000000000000101), /* cmp r3, #5 */
+			WARP_INST(0b00011010000000000000000000000011), /* bne +20 */
+			WARP_INST(0b11100010010101010101000000000001), /* subs r5, r5, #1 */
+			WARP_INST(0b00101010111111111111111111111101), /* bhs -4 */
+			WARP_INST(0b11100010100011001100000000000001), /* add r12, r12, #1 */
+			WARP_INST(0b11101010111111111111111111100001), /* b -116 */
+			WARP_INST(0b11100101100000101100000000000000), /* str r12, [r2] */
+			WARP_INST(0b11101000101111011000000111110000), /* pop {r4, r5, r6, r7, r8, pc} */
+			// Followed by the program size in bytes, the program, the completed operation count and the reads
+	};
+
+	return sunxi_efex_fel_payloads_run(ctx, payload, sizeof(payload), program, program_len, result, result_len);
+}
+
+// Function to fill device memory with a byte for ARMv8
+static int payloads_fill(const struct sunxi_efex_ctx_t *ctx, const uint32_t addr, const uint32_t pattern,
+                         const uint32_t len) {
+	// payload array containing ARMv8 machine code instructions for filling memory, word-wise once aligned
+	/* Note: Do NOT declare this array as 'static'. Some Windows drivers cannot access payload symbols marked static;
+	 * keep it non-static to ensure data visibility when writing to device memory via FEL.
+	 */
+	return EFEX_ERR_NOT_SUPPORT;
+	const uint32_t payload[] = {
+			WARP_INST(0b11100011101000000000000000000000), /* mov r0, #0 */
+			WARP_INST(0b11101110000010000000111100010111), /* mcr 15, 0, r0, cr8, cr7, {0} */
+			WARP_INST(0b11101110000001110000111100010101), /* mcr 15, 0, r0, cr7, cr5, {0} */
+			WARP_INST(0b11101110000001110000111111010101), /* mcr 15, 0, r0, cr7, cr5, {6} */
+			WARP_INST(0b11101110000001110000111110011010), /* mcr 15, 0, r0, cr7, cr10, {4} */
+			WARP_INST(0b11101110000001110000111110010101), /* mcr 15, 0, r0, cr7, cr5, {4} */
+			WARP_INST(0b11101010111111111111111111111111), /* b 0x4 */
+			WARP_INST(0b11101001001011010100000111110000), /* push {r4, r5, r6, r7, r8, lr} */
+			WARP_INST(0b11100010100011110011000001101000), /* add r3, pc, #104 */
+			WARP_INST(0b11101000100100110000000000000111), /* ldm r3, {r0, r1, r2} */
+			WARP_INST(0b11100011010100100000000000000000), /* cmp r2, #0 */
+			WARP_INST(0b00001010000000000000000000010110), /* beq +96 */
+			WARP_INST(0b11100011000100000000000000000011), /* tst r0, #3 */
+			WARP_INST(0b00001010000000000000000000000010), /* beq +16 */
+			WARP_INST(0b11100100110000000001000000000001), /* strb r1, [r0], #1 */
+			WARP_INST(0b11100010010000100010000000000001), /* sub r2, r2, #1 */
+			WARP_INST(0b11101010111111111111111111111000), /* b -24 */
+			WARP_INST(0b11100001101000000011000000000001), /* mov r3, r1 */
+			WARP_INST(0b11100001101000000100000000000001), /* mov r4, r1 */
+			WARP_INST(0b11100001101000000101000000000001), /* mov r5, r1 */
+			WARP_INST(0b11100001101000000110000000000001), /* mov r6, r1 */
+			WARP_INST(0b11100001101000000111000000000001), /* mov r7, r1 */
+			WARP_INST(0b11100001101000001000000000000001), /* mov r8, r1 */
+			WARP_INST(0b11100001101000001100000000000001), /* mov r12, r1 */
+			WARP_INST(0b11100010010100100010000000100000), /* subs r2, r2, #32 */
+			WARP_INST(0b00101000101000000001000111111010), /* stmhs r0!, {r1, r3, r4, r5, r6, r7, r8, r12} */
+			WARP_INST(0b00101010111111111111111111111100), /* bhs -8 */
+			WARP_INST(0b11100010100000100010000000100000), /* add r2, r2, #32 */
+			WARP_INST(0b11100010010100100010000000000100), /* subs r2, r2, #4 */
+			WARP_INST(0b00100100100000000001000000000100), /* strhs r1, [r0], #4 */
+			WARP_INST(0b00101010111111111111111111111100), /* bhs -8 */
+			WARP_INST(0b11100010100000100010000000000100), /* add r2, r2, #4 */
+			WARP_INST(0b11100010010100100010000000000001), /* subs r2, r2, #1 */
+			WARP_INST(0b00100100110000000001000000000001), /* strbhs r1, [r0], #1 */
+			WARP_INST(0b00101010111111111111111111111100), /* bhs -8 */
+			WARP_INST(0b11101000101111011000000111110000), /* pop {r4, r5, r6, r7, r8, pc} */
+			// Followed by uint32_t dst, pattern and len
+	};
+
+	const uint32_t params[] = {cpu_to_le32(addr), cpu_to_le32(pattern), cpu_to_le32(len)};
+	return sunxi_efex_fel_payloads_run(ctx, payload, sizeof(payload), params, sizeof(params), NULL, 0);
+}
+
+// Function to copy device memory for ARMv8
+static int payloads_copy(const struct sunxi_efex_ctx_t *ctx, const uint32_t dst, const uint32_t src,
+                         const uint32_t len) {
+	// payload array containing ARMv8 machine code instructions for copying memory forwards, word-wise when
+	// source and destination share their alignment
+	/* Note: Do NOT declare this array as 'static'. Some Windows drivers cannot access payload symbols marked static;
+	 * keep it non-static to ensure data visibility when writing to device memory via FEL.
+	 */
+	return EFEX_ERR_NOT_SUPPORT;
+	const uint32_t payload[] = {
+			WARP_INST(0b11100011101000000000000000000000), /* mov r0, #0 */
+			WARP_INST(0b11101110000010000000111100010111), /* mcr 15, 0, r0, cr8, cr7, {0} */
+			WARP_INST(0b11101110000001110000111100010101), /* mcr 15, 0, r0, cr7, cr5, {0} */
+			WARP_INST(0b11101110000001110000111111010101), /* mcr 15, 0, r0, cr7, cr5, {6} */
+			WARP_INST(0b11101110000001110000111110011010), /* mcr 15, 0, r0, cr7, cr10, {4} */
+			WARP_INST(0b11101110000001110000111110010101), /* mcr 15, 0, r0, cr7, cr5, {4} */
+			WARP_INST(0b11101010111111111111111111111111), /* b 0x4 */
+			WARP_INST(0b11101001001011010100000111110000), /* push {r4, r5, r6, r7, r8, lr} */
+			WARP_INST(0b11100010100011110011000001101000), /* add r3, pc, #104 */
+			WARP_INST(0b11101000100100110000000000000111), /* ldm r3, {r0, r1, r2} */
+			WARP_INST(0b11100000001000000011000000000001), /* eor r3, r0, r1 */
+			WARP_INST(0b11100011000100110000000000000011), /* tst r3, #3 */
+			WARP_INST(0b00011010000000000000000000010001), /* bne +76 */
+			WARP_INST(0b11100011010100100000000000000000), /* cmp r2, #0 */
+			WARP_INST(0b00001010000000000000000000010011), /* beq +84 */
+			WARP_INST(0b11100011000100000000000000000011), /* tst r0, #3 */
+			WARP_INST(0b00001010000000000000000000000011), /* beq +20 */
+			WARP_INST(0b11100100110100010011000000000001), /* ldrb r3, [r1], #1 */
+			WARP_INST(0b11100100110000000011000000000001), /* strb r3, [r0], #1 */
+			WARP_INST(0b11100010010000100010000000000001), /* sub r2, r2, #1 */
+			WARP_INST(0b11101010111111111111111111110111), /* b -28 */
+			WARP_INST(0b11100010010100100010000000100000), /* subs r2, r2, #32 */
+			WARP_INST(0b00101000101100010101000111111000), /* ldmhs r1!, {r3, r4, r5, r6, r7, r8, r12, lr} */
+			WARP_INST(0b00101000101000000101000111111000), /* stmhs r0!, {r3, r4, r5, r6, r7, r8, r12, lr} */
+			WARP_INST(0b00101010111111111111111111111011), /* bhs -12 */
+			WARP_INST(0b11100010100000100010000000100000), /* add r2, r2, #32 */
+			WARP_INST(0b11100010010100100010000000000100), /* subs r2, r2, #4 */
+			WARP_INST(0b00100100100100010011000000000100), /* ldrhs r3, [r1], #4 */
+			WARP_INST(0b00100100100000000011000000000100), /* strhs r3, [r0], #4 */
+			WARP_INST(0b00101010111111111111111111111011), /* bhs -12 */
+			WARP_INST(0b11100010100000100010000000000100), /* add r2, r2, #4 */
+			WARP_INST(0b11100010010100100010000000000001), /* subs r2, r2, #1 */
+			WARP_INST(0b00100100110100010011000000000001), /* ldrbhs r3, [r1], #1 */
+			WARP_INST(0b00100100110000000011000000000001), /* strbhs r3, [r0], #1 */
+			WARP_INST(0b00101010111111111111111111111011), /* bhs -12 */
+			WARP_INST(0b11101000101111011000000111110000), /* pop {r4, r5, r6, r7, r8, pc} */
+			// Followed by uint32_t dst, src and len
+	};
+
+	const uint32_t params[] = {cpu_to_le32(dst), cpu_to_le32(src), cpu_to_le32(len)};
+	return sunxi_efex_fel_payloads_run(ctx, payload, sizeof(payload), params, sizeof(params), NULL, 0);
+}
+
+// Function to compute the CRC32 of device memory for ARMv8
+static int payloads_crc32(const struct sunxi_efex_ctx_t *ctx, const uint32_t addr, const uint32_t len,
+                          const uint32_t crc_in, uint32_t *crc) {
+	// payload array containing ARMv8 machine code instructions for a nibble-wise CRC32, words once aligned
+	/* Note: Do NOT declare this array as 'static'. Some Windows drivers cannot access payload symbols marked static;
+	 * keep it non-static to ensure data visibility when writing to device memory via FEL.
+	 */
+	return EFEX_ERR_NOT_SUPPORT;
+	const uint32_t payload[] = {
+			WARP_INST(0b11100011101000000000000000000000), /* mov r0, #0 */
+			WARP_INST(0b11101110000010000000111100010111), /* mcr 15, 0, r0, cr8, cr7, {0} */
+			WARP_INST(0b11101110000001110000111100010101), /* mcr 15, 0, r0, cr7, cr5, {0} */
+			WARP_INST(0b11101110000001110000111111010101), /* mcr 15, 0, r0, cr7, cr5, {6} */
+			WARP_INST(0b11101110000001110000111110011010), /* mcr 15, 0, r0, cr7, cr10, {4} */
+			WARP_INST(0b11101110000001110000111110010101), /* mcr 15, 0, r0, cr7, cr5, {4} */
+			WARP_INST(0b11101010111111111111111111111111), /* b 0x4 */
+			WARP_INST(0b11101001001011010100000000010000), /* push {r4, lr} */
+			WARP_INST(0b11100010100011110011111101001101), /* add r3, pc, #308 */
+			WARP_INST(0b11101000100100110000000000000111), /* ldm r3, {r0, r1, r2} */
+			WARP_INST(0b11100010100011111100000011101100), /* add r12, pc, #236 */
+			WARP_INST(0b11100001111000000010000000000010), /* mvn r2, r2 */
+			WARP_INST(0b11100011010100010000000000000000), /* cmp r1, #0 */
+			WARP_INST(0b00001010000000000000000000110100), /* beq +216 */
+			WARP_INST(0b11100011000100000000000000000011), /* tst r0, #3 */
+			WARP_INST(0b00001010000000000000000000001001), /* beq +44 */
+			WARP_INST(0b11100100110100000011000000000001), /* ldrb r3, [r0], #1 */
+			WARP_INST(0b11100010010000010001000000000001), /* sub r1, r1, #1 */
+			WARP_INST(0b11100000001000100010000000000011), /* eor r2, r2, r3 */
+			WARP_INST(0b11100010000000100011000000001111), /* and r3, r2, #15 */
+			WARP_INST(0b11100111100111000011000100000011), /* ldr r3, [r12, r3, lsl #2] */
+			WARP_INST(0b11100000001000110010001000100010), /* eor r2, r3, r2, lsr #4 */
+			WARP_INST(0b11100010000000100011000000001111), /* and r3, r2, #15 */
+			WARP_INST(0b11100111100111000011000100000011), /* ldr r3, [r12, r3, lsl #2] */
+			WARP_INST(0b11100000001000110010001000100010), /* eor r2, r3, r2, lsr #4 */
+			WARP_INST(0b11101010111111111111111111110001), /* b -52 */
+			WARP_INST(0b11100010010100010001000000000100), /* subs r1, r1, #4 */
+			WARP_INST(0b00111010000000000000000000011010), /* blo +112 */
+			WARP_INST(0b11100100100100000100000000000100), /* ldr r4, [r0], #4 */
+			WARP_INST(0b11100000001000100010000000000100), /* eor r2, r2, r4 */
+			WARP_INST(0b11100010000000100011000000001111), /* and r3, r2, #15 */
+			WARP_INST(0b11100111100111000011000100000011), /* ldr r3, [r12, r3, lsl #2] */
+			WARP_INST(0b11100000001000110010001000100010), /* eor r2, r3, r2, lsr #4 */
+			WARP_INST(0b11100010000000100011000000001111), /* and r3, r2, #15 */
+			WARP_INST(0b11100111100111000011000100000011), /* ldr r3, [r12, r3, lsl #2] */
+			WARP_INST(0b11100000001000110010001000100010), /* eor r2, r3, r2, lsr #4 */
+			WARP_INST(0b11100010000000100011000000001111), /* and r3, r2, #15 */
+			WARP_INST(0b11100111100111000011000100000011), /* ldr r3, [r12, r3, lsl #2] */
+			WARP_INST(0b11100000001000110010001000100010), /* eor r2, r3, r2, lsr #4 */
+			WARP_INST(0b11100010000000100011000000001111), /* and r3, r2, #15 */
+			WARP_INST(0b11100111100111000011000100000011), /* ldr r3, [r12, r3, lsl #2] */
+			WARP_INST(0b11100000001000110010001000100010), /* eor r2, r3, r2, lsr #4 */
+			WARP_INST(0b11100010000000100011000000001111), /* and r3, r2, #15 */
+			WARP_INST(0b11100111100111000011000100000011), /* ldr r3, [r12, r3, lsl #2] */
+			WARP_INST(0b11100000001000110010001000100010), /* eor r2, r3, r2, lsr #4 */
+			WARP_INST(0b11100010000000100011000000001111), /* and r3, r2, #15 */
+			WARP_INST(0b11100111100111000011000100000011), /* ldr r3, [r12, r3, lsl #2] */
+			WARP_INST(0b11100000001000110010001000100010), /* eor r2, r3, r2, lsr #4 */
+			WARP_INST(0b11100010000000100011000000001111), /* and r3, r2, #15 */
+			WARP_INST(0b11100111100111000011000100000011), /* ldr r3, [r12, r3, lsl #2] */
+			WARP_INST(0b11100000001000110010001000100010), /* eor r2, r3, r2, lsr #4 */
+			WARP_INST(0b11100010000000100011000000001111), /* and r3, r2, #15 */
+			WARP_INST(0b11100111100111000011000100000011), /* ldr r3, [r12, r3, lsl #2] */
+			WARP_INST(0b11100000001000110010001000100010), /* eor r2, r3, r2, lsr #4 */
+			WARP_INST(0b11101010111111111111111111100010), /* b -112 */
+			WARP_INST(0b11100010100000010001000000000100), /* add r1, r1, #4 */
+			WARP_INST(0b11100010010100010001000000000001), /* subs r1, r1, #1 */
+			WARP_INST(0b00111010000000000000000000001000), /* blo +40 */
+			WARP_INST(0b11100100110100000011000000000001), /* ldrb r3, [r0], #1 */
+			WARP_INST(0b11100000001000100010000000000011), /* eor r2, r2, r3 */
+			WARP_INST(0b11100010000000100011000000001111), /* and r3, r2, #15 */
+			WARP_INST(0b11100111100111000011000100000011), /* ldr r3, [r12, r3, lsl #2] */
+			WARP_INST(0b11100000001000110010001000100010), /* eor r2, r3, r2, lsr #4 */
+			WARP_INST(0b11100010000000100011000000001111), /* and r3, r2, #15 */
+			WARP_INST(0b11100111100111000011000100000011), /* ldr r3, [r12, r3, lsl #2] */
+			WARP_INST(0b11100000001000110010001000100010), /* eor r2, r3, r2, lsr #4 */
+			WARP_INST(0b11101010111111111111111111110100), /* b -40 */
+			WARP_INST(0b11100001111000000010000000000010), /* mvn r2, r2 */
+			WARP_INST(0b11100010100011110011000001000100), /* add r3, pc, #68 */
+			WARP_INST(0b11100101100000110010000000001100), /* str r2, [r3, #12] */
+			WARP_INST(0b11101000101111011000000000010000), /* pop {r4, pc} */
+			// CRC32 of each nibble value, the table the code indexes
+			0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+			0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+			0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+			0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+			// Followed by uint32_t addr, len and the CRC to continue from, then the CRC computed
+	};
+
+	if (!crc) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	const uint32_t params[] = {cpu_to_le32(addr), cpu_to_le32(len), cpu_to_le32(crc_in)};
+	uint32_t result = 0;
+	const int ret =
+			sunxi_efex_fel_payloads_run(ctx, payload, sizeof(payload), params, sizeof(params), &result, sizeof(result));
+	if (ret == EFEX_ERR_SUCCESS) {
+		*crc = le32_to_cpu(result);
+	}
+	return ret;
+}
+
 // Structure defining the operations for the riscv_ops platform
 struct payloads_ops aarch64_ops = {
 		.name = "aarch64",
 		.arch = ARCH_AARCH64,
 		.readl = payloads_readl,
 		.writel = payloads_writel,
+		.readl_batch = payloads_readl_batch,
+		.writel_batch = payloads_writel_batch,
+		.seq = payloads_seq,
+		.fill = payloads_fill,
+		.copy = payloads_copy,
+		.crc32 = payloads_crc32,
 };
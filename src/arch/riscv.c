@@ -40,33 +40,13 @@ static int payloads_readl(const struct sunxi_efex_ctx_t *ctx, const uint32_t add
 		return EFEX_ERR_NULL_PTR;
 	}
 
-	// Convert address to little-endian format before writing to memory
-	uint32_t addr_le32 = cpu_to_le32(addr);
+	// The address to read goes right after the code, the value read is stored after it
+	const uint32_t addr_le32 = cpu_to_le32(addr);
 	uint32_t tmp_val = 0;
-	int ret = EFEX_ERR_SUCCESS;
 
-	// Write the payload to the specified memory address in the context
-	ret = sunxi_efex_fel_write(ctx, ctx->resp.data_start_address, (void *) payload, sizeof(payload));
-	if (ret != EFEX_ERR_SUCCESS) {
-		return ret;
-	}
-
-	// Write the address to be read from into memory
-	ret = sunxi_efex_fel_write(ctx, ctx->resp.data_start_address + sizeof(payload), (void *) &addr_le32,
-							   sizeof(addr_le32));
-	if (ret != EFEX_ERR_SUCCESS) {
-		return ret;
-	}
-
-	// Execute the RISC-V32 instructions starting at the given memory address
-	ret = sunxi_efex_fel_exec(ctx, ctx->resp.data_start_address);
-	if (ret != EFEX_ERR_SUCCESS) {
-		return ret;
-	}
-
-	// Read the value from memory after execution
-	ret = sunxi_efex_fel_read(ctx, ctx->resp.data_start_address + sizeof(payload) + sizeof(addr_le32),
-							  (void *) &tmp_val, sizeof(tmp_val));
+	// Upload the payload unless it is still resident, then run it and read the value back
+	const int ret = sunxi_efex_fel_payloads_run(ctx, payload, sizeof(payload), &addr_le32, sizeof(addr_le32), &tmp_val,
+	                                            sizeof(tmp_val));
 	if (ret != EFEX_ERR_SUCCESS) {
 		return ret;
 	}
@@ -108,33 +88,451 @@ static int payloads_writel(const struct sunxi_efex_ctx_t *ctx, const uint32_t va
 			cpu_to_le32(value),
 	};
 
-	int ret = EFEX_ERR_SUCCESS;
+	// Upload the payload unless it is still resident, then run it with the new parameters
+	return sunxi_efex_fel_payloads_run(ctx, payload, sizeof(payload), params, sizeof(params), NULL, 0);
+}
 
-	// Write the payload to the specified memory address in the context
-	ret = sunxi_efex_fel_write(ctx, ctx->resp.data_start_address, (void *) payload, sizeof(payload));
-	if (ret != EFEX_ERR_SUCCESS) {
-		return ret;
+// Function to read a list of 32-bit values in one payload run for RISC-V
+static int payloads_readl_batch(const struct sunxi_efex_ctx_t *ctx, const uint32_t *addrs, uint32_t *vals,
+                                const size_t count) {
+	// payload array containing RISC-V machine code instructions for reading the values of a list of addresses
+	/* Note: Do NOT declare this array as 'static'. Some Windows drivers cannot access payload symbols marked static;
+	 * keep it non-static to ensure data visibility when writing to device memory via FEL.
+	 */
+	const uint32_t payload[] = {
+			WARP_INST(0b00000000010000000000001100110111), /* lui t1,0x400 */
+			WARP_INST(0b01111100000000110010000001110011), /* csrs mxstatus,t1 */
+			WARP_INST(0b00000000000000000001000000001111), /* fence.i */
+			WARP_INST(0b00000000010000000000000001101111), /* j +4 */
+			WARP_INST(0b00000000000000000000001010010111), /* auipc t0,0x0 */
+			WARP_INST(0b00000011110000101000001010010011), /* addi t0,t0,60 */
+			WARP_INST(0b00000000000000101010001100000011), /* lw t1,0(t0) */
+			WARP_INST(0b00000000010000101000001010010011), /* addi t0,t0,4 */
+			WARP_INST(0b00000000001000110001001110010011), /* slli t2,t1,2 */
+			WARP_INST(0b00000000011100101000001110110011), /* add t2,t0,t2 */
+			WARP_INST(0b00000010000000110000000001100011), /* beqz t1,+32 */
+			WARP_INST(0b00000000000000101010010100000011), /* lw a0,0(t0) */
+			WARP_INST(0b00000000000001010010010100000011), /* lw a0,0(a0) */
+			WARP_INST(0b00000000101000111010000000100011), /* sw a0,0(t2) */
+			WARP_INST(0b00000000010000101000001010010011), /* addi t0,t0,4 */
+			WARP_INST(0b00000000010000111000001110010011), /* addi t2,t2,4 */
+			WARP_INST(0b11111111111100110000001100010011), /* addi t1,t1,-1 */
+			WARP_INST(0b11111110010111111111000001101111), /* j -28 */
+			WARP_INST(0b00000000000000001000000001100111), /* ret */
+			// Followed by uint32_t count, count addresses and room for count values
+	};
+
+	if (count > SUNXI_EFEX_PAYLOAD_BATCH_MAX) {
+		return EFEX_ERR_INVALID_PARAM;
 	}
 
-	// Write the parameters (address and value) to memory
-	ret = sunxi_efex_fel_write(ctx, ctx->resp.data_start_address + sizeof(payload), (void *) params, sizeof(params));
-	if (ret != EFEX_ERR_SUCCESS) {
-		return ret;
+	// The count and the addresses go right after the code, the values read are stored after them
+	uint32_t params[1 + SUNXI_EFEX_PAYLOAD_BATCH_MAX];
+	uint32_t result[SUNXI_EFEX_PAYLOAD_BATCH_MAX];
+	params[0] = cpu_to_le32((uint32_t) count);
+	for (size_t i = 0; i < count; i++) {
+		params[1 + i] = cpu_to_le32(addrs[i]);
 	}
 
-	// Execute the RISC-V32 instructions starting at the given memory address
-	ret = sunxi_efex_fel_exec(ctx, ctx->resp.data_start_address);
+	const int ret = sunxi_efex_fel_payloads_run(ctx, payload, sizeof(payload), params, (1 + count) * sizeof(uint32_t),
+	                                            result, count * sizeof(uint32_t));
 	if (ret != EFEX_ERR_SUCCESS) {
 		return ret;
 	}
 
+	for (size_t i = 0; i < count; i++) {
+		vals[i] = le32_to_cpu(result[i]);
+	}
 	return EFEX_ERR_SUCCESS;
 }
 
+// Function to write a list of 32-bit values in one payload run for RISC-V
+static int payloads_writel_batch(const struct sunxi_efex_ctx_t *ctx, const uint32_t *addrs, const uint32_t *vals,
+                                 const size_t count) {
+	// payload array containing RISC-V machine code instructions for writing values to a list of addresses
+	/* Note: Do NOT declare this array as 'static'. Some Windows drivers cannot access payload symbols marked static;
+	 * keep it non-static to ensure data visibility when writing to device memory via FEL.
+	 */
+	const uint32_t payload[] = {
+			WARP_INST(0b00000000010000000000001100110111), /* lui t1,0x400 */
+			WARP_INST(0b01111100000000110010000001110011), /* csrs mxstatus,t1 */
+			WARP_INST(0b00000000000000000001000000001111), /* fence.i */
+			WARP_INST(0b00000000010000000000000001101111), /* j +4 */
+			WARP_INST(0b00000000000000000000001010010111), /* auipc t0,0x0 */
+			WARP_INST(0b00000011000000101000001010010011), /* addi t0,t0,48 */
+			WARP_INST(0b00000000000000101010001100000011), /* lw t1,0(t0) */
+			WARP_INST(0b00000000010000101000001010010011), /* addi t0,t0,4 */
+			WARP_INST(0b00000000000000110000111001100011), /* beqz t1,+28 */
+			WARP_INST(0b00000000000000101010010100000011), /* lw a0,0(t0) */
+			WARP_INST(0b00000000010000101010010110000011), /* lw a1,4(t0) */
+			WARP_INST(0b00000000101101010010000000100011), /* sw a1,0(a0) */
+			WARP_INST(0b00000000100000101000001010010011), /* addi t0,t0,8 */
+			WARP_INST(0b11111111111100110000001100010011), /* addi t1,t1,-1 */
+			WARP_INST(0b11111110100111111111000001101111), /* j -24 */
+			WARP_INST(0b00000000000000001000000001100111), /* ret */
+			// Followed by uint32_t count and count pairs of address and value
+	};
+
+	if (count > SUNXI_EFEX_PAYLOAD_BATCH_MAX) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+
+	// The count and the address/value pairs go right after the code
+	uint32_t params[1 + 2 * SUNXI_EFEX_PAYLOAD_BATCH_MAX];
+	params[0] = cpu_to_le32((uint32_t) count);
+	for (size_t i = 0; i < count; i++) {
+		params[1 + 2 * i] = cpu_to_le32(addrs[i]);
+		params[2 + 2 * i] = cpu_to_le32(vals[i]);
+	}
+
+	return sunxi_efex_fel_payloads_run(ctx, payload, sizeof(payload), params, (1 + 2 * count) * sizeof(uint32_t), NULL,
+	                                   0);
+}
+
+// Function to run a register sequence program for RISC-V
+static int payloads_seq(const struct sunxi_efex_ctx_t *ctx, const uint32_t *program, const size_t program_len,
+                        uint32_t *result, const size_t result_len) {
+	// payload array containing RISC-V machine code instructions for the register sequence interpreter
+	/* Note: Do NOT declare this array as 'static'. Some Windows drivers cannot access payload symbols marked static;
+	 * keep it non-static to ensure data visibility when writing to device memory via FEL.
+	 */
+	const uint32_t payload[] = {
+			WARP_INST(0b00000000010000000000001100110111), /* lui t1,0x400 */
+			WARP_INST(0b01111100000000110010000001110011), /* csrs mxstatus,t1 */
+			WARP_INST(0b00000000000000000001000000001111), /* fence.i */
+			WARP_INST(0b00000000010000000000000001101111), /* j +4 */
+			WARP_INST(0b00000000000000000000001010010111), /* auipc t0,0 */
+			WARP_INST(0b00001100000000101000001010010011), /* addi t0,t0,192 */
+			WARP_INST(0b00000000000000101010001100000011), /* lw t1,0(t0) */
+			WARP_INST(0b00000000010000101000001010010011), /* addi t0,t0,4 */
+			WARP_INST(0b00000000011000101000001110110011), /* add t2,t0,t1 */
+			WARP_INST(0b00000000010000111000001100010011), /* addi t1,t2,4 */
+			WARP_INST(0b00000000000000000000111000010011), /* li t3,0 */
+			WARP_INST(0b00000000000000101010010100000011), /* lw a0,0(t0) */
+			WARP_INST(0b00000000010000101010010110000011), /* lw a1,4(t0) */
+			WARP_INST(0b00000000100000101010011000000011), /* lw a2,8(t0) */
+			WARP_INST(0b00000000110000101010011010000011), /* lw a3,12(t0) */
+			WARP_INST(0b00000001000000101010011100000011), /* lw a4,16(t0) */
+			WARP_INST(0b00000001010000101000001010010011), /* addi t0,t0,20 */
+			WARP_INST(0b00000000000100000000111010010011), /* li t4,1 */
+			WARP_INST(0b00000001110101010001011001100011), /* bne a0,t4,+12 */
+			WARP_INST(0b00000000110001011010000000100011), /* sw a2,0(a1) */
+			WARP_INST(0b00000111000000000000000001101111), /* j +112 */
+			WARP_INST(0b00000000001000000000111010010011), /* li t4,2 */
+			WARP_INST(0b00000001110101010001101001100011), /* bne a0,t4,+20 */
+			WARP_INST(0b00000000000001011010011110000011), /* lw a5,0(a1) */
+			WARP_INST(0b00000000111100110010000000100011), /* sw a5,0(t1) */
+			WARP_INST(0b00000000010000110000001100010011), /* addi t1,t1,4 */
+			WARP_INST(0b00000101100000000000000001101111), /* j +88 */
+			WARP_INST(0b00000000001100000000111010010011), /* li t4,3 */
+			WARP_INST(0b00000001110101010001111001100011), /* bne a0,t4,+28 */
+			WARP_INST(0b00000000000001011010011110000011), /* lw a5,0(a1) */
+			WARP_INST(0b11111111111101100100011000010011), /* not a2,a2 */
+			WARP_INST(0b00000000110001111111011110110011), /* and a5,a5,a2 */
+			WARP_INST(0b00000000110101111110011110110011), /* or a5,a5,a3 */
+			WARP_INST(0b00000000111101011010000000100011), /* sw a5,0(a1) */
+			WARP_INST(0b00000011100000000000000001101111), /* j +56 */
+			WARP_INST(0b00000000010000000000111010010011), /* li t4,4 */
+			WARP_INST(0b00000001110101010001111001100011), /* bne a0,t4,+28 */
+			WARP_INST(0b00000000000001011010011110000011), /* lw a5,0(a1) */
+			WARP_INST(0b00000000110001111111011110110011), /* and a5,a5,a2 */
+			WARP_INST(0b00000010110101111000001001100011), /* beq a5,a3,+36 */
+			WARP_INST(0b11111111111101110000011100010011), /* addi a4,a4,-1 */
+			WARP_INST(0b11111110000001110001100011100011), /* bnez a4,-16 */
+			WARP_INST(0b00000010000000000000000001101111), /* j +32 */
+			WARP_INST(0b00000000010100000000111010010011), /* li t4,5 */
+			WARP_INST(0b00000001110101010001110001100011), /* bne a0,t4,+24 */
+			WARP_INST(0b00000000000001100000011001100011), /* beqz a2,+12 */
+			WARP_INST(0b11111111111101100000011000010011), /* addi a2,a2,-1 */
+			WARP_INST(0b11111111100111111111000001101111), /* j -8 */
+			WARP_INST(0b00000000000111100000111000010011), /* addi t3,t3,1 */
+			WARP_INST(0b11110110100111111111000001101111), /* j -152 */
+			WARP_INST(0b00000001110000111010000000100011), /* sw t3,0(t2) */
+			WARP_INST(0b00000000000000001000000001100111), /* ret */
+			// Followed by the program size in bytes, the program, the completed operation count and the reads
+	};
+
+	return sunxi_efex_fel_payloads_run(ctx, payload, sizeof(payload), program, program_len, result, result_len);
+}
+
+// Function to fill device memory with a byte for RISC-V
+static int payloads_fill(const struct sunxi_efex_ctx_t *ctx, const uint32_t addr, const uint32_t pattern,
+                         const uint32_t len) {
+	// payload array containing RISC-V machine code instructions for filling memory, word-wise once aligned
+	/* Note: Do NOT declare this array as 'static'. Some Windows drivers cannot access payload symbols marked static;
+	 * keep it non-static to ensure data visibility when writing to device memory via FEL.
+	 */
+	const uint32_t payload[] = {
+			WARP_INST(0b00000000010000000000001100110111), /* lui t1,0x400 */
+			WARP_INST(0b01111100000000110010000001110011), /* csrs mxstatus,t1 */
+			WARP_INST(0b00000000000000000001000000001111), /* fence.i */
+			WARP_INST(0b00000000010000000000000001101111), /* j +4 */
+			WARP_INST(0b00000000000000000000001010010111), /* auipc t0,0 */
+			WARP_INST(0b00001001010000101000001010010011), /* addi t0,t0,148 */
+			WARP_INST(0b00000000000000101010010100000011), /* lw a0,0(t0) */
+			WARP_INST(0b00000000010000101010010110000011), /* lw a1,4(t0) */
+			WARP_INST(0b00000000100000101010011000000011), /* lw a2,8(t0) */
+			WARP_INST(0b00000110000001100000111001100011), /* beqz a2,+124 */
+			WARP_INST(0b00000000001101010111001100010011), /* andi t1,a0,3 */
+			WARP_INST(0b00000000000000110000101001100011), /* beqz t1,+20 */
+			WARP_INST(0b00000000101101010000000000100011), /* sb a1,0(a0) */
+			WARP_INST(0b00000000000101010000010100010011), /* addi a0,a0,1 */
+			WARP_INST(0b11111111111101100000011000010011), /* addi a2,a2,-1 */
+			WARP_INST(0b11111110100111111111000001101111), /* j -24 */
+			WARP_INST(0b00000010000000000000001100010011), /* li t1,32 */
+			WARP_INST(0b00000010011001100110100001100011), /* bltu a2,t1,+48 */
+			WARP_INST(0b00000000101101010010000000100011), /* sw a1,0(a0) */
+			WARP_INST(0b00000000101101010010001000100011), /* sw a1,4(a0) */
+			WARP_INST(0b00000000101101010010010000100011), /* sw a1,8(a0) */
+			WARP_INST(0b00000000101101010010011000100011), /* sw a1,12(a0) */
+			WARP_INST(0b00000000101101010010100000100011), /* sw a1,16(a0) */
+			WARP_INST(0b00000000101101010010101000100011), /* sw a1,20(a0) */
+			WARP_INST(0b00000000101101010010110000100011), /* sw a1,24(a0) */
+			WARP_INST(0b00000000101101010010111000100011), /* sw a1,28(a0) */
+			WARP_INST(0b00000010000001010000010100010011), /* addi a0,a0,32 */
+			WARP_INST(0b11111110000001100000011000010011), /* addi a2,a2,-32 */
+			WARP_INST(0b11111101010111111111000001101111), /* j -44 */
+			WARP_INST(0b00000000010000000000001100010011), /* li t1,4 */
+			WARP_INST(0b00000000011001100110101001100011), /* bltu a2,t1,+20 */
+			WARP_INST(0b00000000101101010010000000100011), /* sw a1,0(a0) */
+			WARP_INST(0b00000000010001010000010100010011), /* addi a0,a0,4 */
+			WARP_INST(0b11111111110001100000011000010011), /* addi a2,a2,-4 */
+			WARP_INST(0b11111111000111111111000001101111), /* j -16 */
+			WARP_INST(0b00000000000001100000101001100011), /* beqz a2,+20 */
+			WARP_INST(0b00000000101101010000000000100011), /* sb a1,0(a0) */
+			WARP_INST(0b00000000000101010000010100010011), /* addi a0,a0,1 */
+			WARP_INST(0b11111111111101100000011000010011), /* addi a2,a2,-1 */
+			WARP_INST(0b11111111000111111111000001101111), /* j -16 */
+			WARP_INST(0b00000000000000001000000001100111), /* ret */
+			// Followed by uint32_t dst, pattern and len
+	};
+
+	const uint32_t params[] = {cpu_to_le32(addr), cpu_to_le32(pattern), cpu_to_le32(len)};
+	return sunxi_efex_fel_payloads_run(ctx, payload, sizeof(payload), params, sizeof(params), NULL, 0);
+}
+
+// Function to copy device memory for RISC-V
+static int payloads_copy(const struct sunxi_efex_ctx_t *ctx, const uint32_t dst, const uint32_t src,
+                         const uint32_t len) {
+	// payload array containing RISC-V machine code instructions for copying memory forwards, word-wise when
+	// source and destination share their alignment
+	/* Note: Do NOT declare this array as 'static'. Some Windows drivers cannot access payload symbols marked static;
+	 * keep it non-static to ensure data visibility when writing to device memory via FEL.
+	 */
+	const uint32_t payload[] = {
+			WARP_INST(0b00000000010000000000001100110111), /* lui t1,0x400 */
+			WARP_INST(0b01111100000000110010000001110011), /* csrs mxstatus,t1 */
+			WARP_INST(0b00000000000000000001000000001111), /* fence.i */
+			WARP_INST(0b00000000010000000000000001101111), /* j +4 */
+			WARP_INST(0b00000000000000000000001010010111), /* auipc t0,0 */
+			WARP_INST(0b00001101110000101000001010010011), /* addi t0,t0,220 */
+			WARP_INST(0b00000000000000101010010100000011), /* lw a0,0(t0) */
+			WARP_INST(0b00000000010000101010010110000011), /* lw a1,4(t0) */
+			WARP_INST(0b00000000100000101010011000000011), /* lw a2,8(t0) */
+			WARP_INST(0b00000000101101010100001100110011), /* xor t1,a0,a1 */
+			WARP_INST(0b00000000001100110111001100010011), /* andi t1,t1,3 */
+			WARP_INST(0b00001010000000110001000001100011), /* bnez t1,+160 */
+			WARP_INST(0b00001010000001100000110001100011), /* beqz a2,+184 */
+			WARP_INST(0b00000000001101010111001100010011), /* andi t1,a0,3 */
+			WARP_INST(0b00000000000000110000111001100011), /* beqz t1,+28 */
+			WARP_INST(0b00000000000001011100001110000011), /* lbu t2,0(a1) */
+			WARP_INST(0b00000000011101010000000000100011), /* sb t2,0(a0) */
+			WARP_INST(0b00000000000101010000010100010011), /* addi a0,a0,1 */
+			WARP_INST(0b00000000000101011000010110010011), /* addi a1,a1,1 */
+			WARP_INST(0b11111111111101100000011000010011), /* addi a2,a2,-1 */
+			WARP_INST(0b11111110000111111111000001101111), /* j -32 */
+			WARP_INST(0b00000010000000000000001100010011), /* li t1,32 */
+			WARP_INST(0b00000100011001100110101001100011), /* bltu a2,t1,+84 */
+			WARP_INST(0b00000000000001011010001110000011), /* lw t2,0(a1) */
+			WARP_INST(0b00000000010001011010111000000011), /* lw t3,4(a1) */
+			WARP_INST(0b00000000100001011010111010000011), /* lw t4,8(a1) */
+			WARP_INST(0b00000000110001011010111100000011), /* lw t5,12(a1) */
+			WARP_INST(0b00000001000001011010111110000011), /* lw t6,16(a1) */
+			WARP_INST(0b00000001010001011010011010000011), /* lw a3,20(a1) */
+			WARP_INST(0b00000001100001011010011100000011), /* lw a4,24(a1) */
+			WARP_INST(0b00000001110001011010011110000011), /* lw a5,28(a1) */
+			WARP_INST(0b00000000011101010010000000100011), /* sw t2,0(a0) */
+			WARP_INST(0b00000001110001010010001000100011), /* sw t3,4(a0) */
+			WARP_INST(0b00000001110101010010010000100011), /* sw t4,8(a0) */
+			WARP_INST(0b00000001111001010010011000100011), /* sw t5,12(a0) */
+			WARP_INST(0b00000001111101010010100000100011), /* sw t6,16(a0) */
+			WARP_INST(0b00000000110101010010101000100011), /* sw a3,20(a0) */
+			WARP_INST(0b00000000111001010010110000100011), /* sw a4,24(a0) */
+			WARP_INST(0b00000000111101010010111000100011), /* sw a5,28(a0) */
+			WARP_INST(0b00000010000001010000010100010011), /* addi a0,a0,32 */
+			WARP_INST(0b00000010000001011000010110010011), /* addi a1,a1,32 */
+			WARP_INST(0b11111110000001100000011000010011), /* addi a2,a2,-32 */
+			WARP_INST(0b11111011000111111111000001101111), /* j -80 */
+			WARP_INST(0b00000000010000000000001100010011), /* li t1,4 */
+			WARP_INST(0b00000000011001100110111001100011), /* bltu a2,t1,+28 */
+			WARP_INST(0b00000000000001011010001110000011), /* lw t2,0(a1) */
+			WARP_INST(0b00000000011101010010000000100011), /* sw t2,0(a0) */
+			WARP_INST(0b00000000010001010000010100010011), /* addi a0,a0,4 */
+			WARP_INST(0b00000000010001011000010110010011), /* addi a1,a1,4 */
+			WARP_INST(0b11111111110001100000011000010011), /* addi a2,a2,-4 */
+			WARP_INST(0b11111110100111111111000001101111), /* j -24 */
+			WARP_INST(0b00000000000001100000111001100011), /* beqz a2,+28 */
+			WARP_INST(0b00000000000001011100001110000011), /* lbu t2,0(a1) */
+			WARP_INST(0b00000000011101010000000000100011), /* sb t2,0(a0) */
+			WARP_INST(0b00000000000101010000010100010011), /* addi a0,a0,1 */
+			WARP_INST(0b00000000000101011000010110010011), /* addi a1,a1,1 */
+			WARP_INST(0b11111111111101100000011000010011), /* addi a2,a2,-1 */
+			WARP_INST(0b11111110100111111111000001101111), /* j -24 */
+			WARP_INST(0b00000000000000001000000001100111), /* ret */
+			// Followed by uint32_t dst, src and len
+	};
+
+	const uint32_t params[] = {cpu_to_le32(dst), cpu_to_le32(src), cpu_to_le32(len)};
+	return sunxi_efex_fel_payloads_run(ctx, payload, sizeof(payload), params, sizeof(params), NULL, 0);
+}
+
+// Function to compute the CRC32 of device memory for RISC-V
+static int payloads_crc32(const struct sunxi_efex_ctx_t *ctx, const uint32_t addr, const uint32_t len,
+                          const uint32_t crc_in, uint32_t *crc) {
+	// payload array containing RISC-V machine code instructions for a nibble-wise CRC32, words once aligned
+	/* Note: Do NOT declare this array as 'static'. Some Windows drivers cannot access payload symbols marked static;
+	 * keep it non-static to ensure data visibility when writing to device memory via FEL.
+	 */
+	const uint32_t payload[] = {
+			WARP_INST(0b00000000010000000000001100110111), /* lui t1,0x400 */
+			WARP_INST(0b01111100000000110010000001110011), /* csrs mxstatus,t1 */
+			WARP_INST(0b00000000000000000001000000001111), /* fence.i */
+			WARP_INST(0b00000000010000000000000001101111), /* j +4 */
+			WARP_INST(0b00000000000000000000001010010111), /* auipc t0,0 */
+			WARP_INST(0b00011101110000101000001010010011), /* addi t0,t0,476 */
+			WARP_INST(0b11111100000000101000001100010011), /* addi t1,t0,-64 */
+			WARP_INST(0b00000000000000101010010100000011), /* lw a0,0(t0) */
+			WARP_INST(0b00000000010000101010010110000011), /* lw a1,4(t0) */
+			WARP_INST(0b00000000100000101010011000000011), /* lw a2,8(t0) */
+			WARP_INST(0b11111111111101100100011000010011), /* not a2,a2 */
+			WARP_INST(0b00010110000001011000101001100011), /* beqz a1,+372 */
+			WARP_INST(0b00000000001101010111001110010011), /* andi t2,a0,3 */
+			WARP_INST(0b00000100000000111000010001100011), /* beqz t2,+72 */
+			WARP_INST(0b00000000000001010100001110000011), /* lbu t2,0(a0) */
+			WARP_INST(0b00000000000101010000010100010011), /* addi a0,a0,1 */
+			WARP_INST(0b11111111111101011000010110010011), /* addi a1,a1,-1 */
+			WARP_INST(0b00000000011101100100011000110011), /* xor a2,a2,t2 */
+			WARP_INST(0b00000000111101100111001110010011), /* andi t2,a2,15 */
+			WARP_INST(0b00000000001000111001001110010011), /* slli t2,t2,2 */
+			WARP_INST(0b00000000011100110000001110110011), /* add t2,t1,t2 */
+			WARP_INST(0b00000000000000111010001110000011), /* lw t2,0(t2) */
+			WARP_INST(0b00000000010001100101011000010011), /* srli a2,a2,4 */
+			WARP_INST(0b00000000011101100100011000110011), /* xor a2,a2,t2 */
+			WARP_INST(0b00000000111101100111001110010011), /* andi t2,a2,15 */
+			WARP_INST(0b00000000001000111001001110010011), /* slli t2,t2,2 */
+			WARP_INST(0b00000000011100110000001110110011), /* add t2,t1,t2 */
+			WARP_INST(0b00000000000000111010001110000011), /* lw t2,0(t2) */
+			WARP_INST(0b00000000010001100101011000010011), /* srli a2,a2,4 */
+			WARP_INST(0b00000000011101100100011000110011), /* xor a2,a2,t2 */
+			WARP_INST(0b11111011010111111111000001101111), /* j -76 */
+			WARP_INST(0b00000000010000000000111000010011), /* li t3,4 */
+			WARP_INST(0b00001101110001011110110001100011), /* bltu a1,t3,+216 */
+			WARP_INST(0b00000000000001010010001110000011), /* lw t2,0(a0) */
+			WARP_INST(0b00000000010001010000010100010011), /* addi a0,a0,4 */
+			WARP_INST(0b11111111110001011000010110010011), /* addi a1,a1,-4 */
+			WARP_INST(0b00000000011101100100011000110011), /* xor a2,a2,t2 */
+			WARP_INST(0b00000000111101100111001110010011), /* andi t2,a2,15 */
+			WARP_INST(0b00000000001000111001001110010011), /* slli t2,t2,2 */
+			WARP_INST(0b00000000011100110000001110110011), /* add t2,t1,t2 */
+			WARP_INST(0b00000000000000111010001110000011), /* lw t2,0(t2) */
+			WARP_INST(0b00000000010001100101011000010011), /* srli a2,a2,4 */
+			WARP_INST(0b00000000011101100100011000110011), /* xor a2,a2,t2 */
+			WARP_INST(0b00000000111101100111001110010011), /* andi t2,a2,15 */
+			WARP_INST(0b00000000001000111001001110010011), /* slli t2,t2,2 */
+			WARP_INST(0b00000000011100110000001110110011), /* add t2,t1,t2 */
+			WARP_INST(0b00000000000000111010001110000011), /* lw t2,0(t2) */
+			WARP_INST(0b00000000010001100101011000010011), /* srli a2,a2,4 */
+			WARP_INST(0b00000000011101100100011000110011), /* xor a2,a2,t2 */
+			WARP_INST(0b00000000111101100111001110010011), /* andi t2,a2,15 */
+			WARP_INST(0b00000000001000111001001110010011), /* slli t2,t2,2 */
+			WARP_INST(0b00000000011100110000001110110011), /* add t2,t1,t2 */
+			WARP_INST(0b00000000000000111010001110000011), /* lw t2,0(t2) */
+			WARP_INST(0b00000000010001100101011000010011), /* srli a2,a2,4 */
+			WARP_INST(0b00000000011101100100011000110011), /* xor a2,a2,t2 */
+			WARP_INST(0b00000000111101100111001110010011), /* andi t2,a2,15 */
+			WARP_INST(0b00000000001000111001001110010011), /* slli t2,t2,2 */
+			WARP_INST(0b00000000011100110000001110110011), /* add t2,t1,t2 */
+			WARP_INST(0b00000000000000111010001110000011), /* lw t2,0(t2) */
+			WARP_INST(0b00000000010001100101011000010011), /* srli a2,a2,4 */
+			WARP_INST(0b00000000011101100100011000110011), /* xor a2,a2,t2 */
+			WARP_INST(0b00000000111101100111001110010011), /* andi t2,a2,15 */
+			WARP_INST(0b00000000001000111001001110010011), /* slli t2,t2,2 */
+			WARP_INST(0b00000000011100110000001110110011), /* add t2,t1,t2 */
+			WARP_INST(0b00000000000000111010001110000011), /* lw t2,0(t2) */
+			WARP_INST(0b00000000010001100101011000010011), /* srli a2,a2,4 */
+			WARP_INST(0b00000000011101100100011000110011), /* xor a2,a2,t2 */
+			WARP_INST(0b00000000111101100111001110010011), /* andi t2,a2,15 */
+			WARP_INST(0b00000000001000111001001110010011), /* slli t2,t2,2 */
+			WARP_INST(0b00000000011100110000001110110011), /* add t2,t1,t2 */
+			WARP_INST(0b00000000000000111010001110000011), /* lw t2,0(t2) */
+			WARP_INST(0b00000000010001100101011000010011), /* srli a2,a2,4 */
+			WARP_INST(0b00000000011101100100011000110011), /* xor a2,a2,t2 */
+			WARP_INST(0b00000000111101100111001110010011), /* andi t2,a2,15 */
+			WARP_INST(0b00000000001000111001001110010011), /* slli t2,t2,2 */
+			WARP_INST(0b00000000011100110000001110110011), /* add t2,t1,t2 */
+			WARP_INST(0b00000000000000111010001110000011), /* lw t2,0(t2) */
+			WARP_INST(0b00000000010001100101011000010011), /* srli a2,a2,4 */
+			WARP_INST(0b00000000011101100100011000110011), /* xor a2,a2,t2 */
+			WARP_INST(0b00000000111101100111001110010011), /* andi t2,a2,15 */
+			WARP_INST(0b00000000001000111001001110010011), /* slli t2,t2,2 */
+			WARP_INST(0b00000000011100110000001110110011), /* add t2,t1,t2 */
+			WARP_INST(0b00000000000000111010001110000011), /* lw t2,0(t2) */
+			WARP_INST(0b00000000010001100101011000010011), /* srli a2,a2,4 */
+			WARP_INST(0b00000000011101100100011000110011), /* xor a2,a2,t2 */
+			WARP_INST(0b11110010110111111111000001101111), /* j -212 */
+			WARP_INST(0b00000100000001011000010001100011), /* beqz a1,+72 */
+			WARP_INST(0b00000000000001010100001110000011), /* lbu t2,0(a0) */
+			WARP_INST(0b00000000000101010000010100010011), /* addi a0,a0,1 */
+			WARP_INST(0b11111111111101011000010110010011), /* addi a1,a1,-1 */
+			WARP_INST(0b00000000011101100100011000110011), /* xor a2,a2,t2 */
+			WARP_INST(0b00000000111101100111001110010011), /* andi t2,a2,15 */
+			WARP_INST(0b00000000001000111001001110010011), /* slli t2,t2,2 */
+			WARP_INST(0b00000000011100110000001110110011), /* add t2,t1,t2 */
+			WARP_INST(0b00000000000000111010001110000011), /* lw t2,0(t2) */
+			WARP_INST(0b00000000010001100101011000010011), /* srli a2,a2,4 */
+			WARP_INST(0b00000000011101100100011000110011), /* xor a2,a2,t2 */
+			WARP_INST(0b00000000111101100111001110010011), /* andi t2,a2,15 */
+			WARP_INST(0b00000000001000111001001110010011), /* slli t2,t2,2 */
+			WARP_INST(0b00000000011100110000001110110011), /* add t2,t1,t2 */
+			WARP_INST(0b00000000000000111010001110000011), /* lw t2,0(t2) */
+			WARP_INST(0b00000000010001100101011000010011), /* srli a2,a2,4 */
+			WARP_INST(0b00000000011101100100011000110011), /* xor a2,a2,t2 */
+			WARP_INST(0b11111011110111111111000001101111), /* j -68 */
+			WARP_INST(0b11111111111101100100011000010011), /* not a2,a2 */
+			WARP_INST(0b00000000110000101010011000100011), /* sw a2,12(t0) */
+			WARP_INST(0b00000000000000001000000001100111), /* ret */
+			// CRC32 of each nibble value, the table the code indexes
+			0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+			0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+			0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+			0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+			// Followed by uint32_t addr, len and the CRC to continue from, then the CRC computed
+	};
+
+	if (!crc) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	const uint32_t params[] = {cpu_to_le32(addr), cpu_to_le32(len), cpu_to_le32(crc_in)};
+	uint32_t result = 0;
+	const int ret =
+			sunxi_efex_fel_payloads_run(ctx, payload, sizeof(payload), params, sizeof(params), &result, sizeof(result));
+	if (ret == EFEX_ERR_SUCCESS) {
+		*crc = le32_to_cpu(result);
+	}
+	return ret;
+}
+
 // Structure defining the operations for the riscv_ops platform
 struct payloads_ops riscv_ops = {
 		.name = "riscv",
 		.arch = ARCH_RISCV,
 		.readl = payloads_readl,
 		.writel = payloads_writel,
+		.readl_batch = payloads_readl_batch,
+		.writel_batch = payloads_writel_batch,
+		.seq = payloads_seq,
+		.fill = payloads_fill,
+		.copy = payloads_copy,
+		.crc32 = payloads_crc32,
 };
@@ -0,0 +1,113 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "efex-buffer.h"
+#include "efex-common.h"
+#include "efex-protocol.h"
+#include "usb_layer.h"
+
+struct sunxi_efex_buffer_t {
+	struct sunxi_efex_buffer_t *next;
+	char *data;
+	size_t len;
+	int dma;  /* Allocated from device memory rather than the heap */
+	int used; /* Handed out to the caller */
+};
+
+struct sunxi_efex_buffer_pool_t {
+	struct sunxi_efex_buffer_t *buffers;
+};
+
+static struct sunxi_efex_buffer_t *sunxi_efex_buffer_find(const struct sunxi_efex_buffer_pool_t *pool,
+                                                          const void *buf, const size_t len) {
+	const uintptr_t start = (uintptr_t) buf;
+
+	for (struct sunxi_efex_buffer_t *b = pool ? pool->buffers : NULL; b; b = b->next) {
+		const uintptr_t data = (uintptr_t) b->data;
+		if (start >= data && start - data <= b->len && len <= b->len - (start - data))
+			return b;
+	}
+	return NULL;
+}
+
+void *sunxi_efex_buffer_alloc(struct sunxi_efex_ctx_t *ctx, const size_t len) {
+	if (!ctx || len == 0) {
+		return NULL;
+	}
+
+	if (!ctx->buffer_pool) {
+		ctx->buffer_pool = calloc(1, sizeof(*ctx->buffer_pool));
+		if (!ctx->buffer_pool)
+			return NULL;
+	}
+
+	// Reuse the smallest free buffer that fits
+	struct sunxi_efex_buffer_t *best = NULL;
+	for (struct sunxi_efex_buffer_t *b = ctx->buffer_pool->buffers; b; b = b->next) {
+		if (!b->used && b->len >= len && (!best || b->len < best->len))
+			best = b;
+	}
+	if (best) {
+		best->used = 1;
+		return best->data;
+	}
+
+	struct sunxi_efex_buffer_t *b = calloc(1, sizeof(*b));
+	if (!b) {
+		return NULL;
+	}
+
+	b->data = sunxi_usb_dev_mem_alloc(ctx, len);
+	b->dma = b->data != NULL;
+	if (!b->data)
+		b->data = malloc(len);
+	if (!b->data) {
+		free(b);
+		return NULL;
+	}
+
+	b->len = len;
+	b->used = 1;
+	b->next = ctx->buffer_pool->buffers;
+	ctx->buffer_pool->buffers = b;
+	return b->data;
+}
+
+void sunxi_efex_buffer_free(struct sunxi_efex_ctx_t *ctx, void *buf) {
+	if (!ctx || !buf) {
+		return;
+	}
+
+	struct sunxi_efex_buffer_t *b = sunxi_efex_buffer_find(ctx->buffer_pool, buf, 0);
+	if (b && b->data == buf)
+		b->used = 0;
+}
+
+int sunxi_efex_buffer_is_dma(const struct sunxi_efex_ctx_t *ctx, const void *buf, const size_t len) {
+	if (!ctx || !buf) {
+		return 0;
+	}
+
+	const struct sunxi_efex_buffer_t *b = sunxi_efex_buffer_find(ctx->buffer_pool, buf, len);
+	return b && b->dma;
+}
+
+void sunxi_efex_buffer_pool_release(struct sunxi_efex_ctx_t *ctx) {
+	if (!ctx || !ctx->buffer_pool) {
+		return;
+	}
+
+	struct sunxi_efex_buffer_t *b = ctx->buffer_pool->buffers;
+	while (b) {
+		struct sunxi_efex_buffer_t *next = b->next;
+		if (b->dma)
+			sunxi_usb_dev_mem_free(ctx, b->data, b->len);
+		else
+			free(b->data);
+		free(b);
+		b = next;
+	}
+
+	free(ctx->buffer_pool);
+	ctx->buffer_pool = NULL;
+}
@@ -0,0 +1,232 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "efex-chunk.h"
+#include "efex-common.h"
+#include "efex-fel.h"
+#include "efex-fes.h"
+#include "efex-protocol.h"
+
+// A tuning decision is taken once a window holds this many chunks and bytes
+#define SUNXI_EFEX_CHUNK_TUNE_CHUNKS (4)
+#define SUNXI_EFEX_CHUNK_TUNE_BYTES (1024 * 1024)
+// Throughput must change by more than this (percent) to count as better or worse
+#define SUNXI_EFEX_CHUNK_TUNE_MARGIN (5)
+// Windows spent on a settled size before exploring upwards again
+#define SUNXI_EFEX_CHUNK_TUNE_RESTART (64)
+
+struct sunxi_efex_chunk_state_t {
+	uint32_t size;
+	uint32_t chunks;
+	uint64_t bytes;
+	uint64_t usec;
+	uint64_t rate;  /* Bytes per second of the previous window, 0 for none */
+	int step;       /* 1 growing, -1 shrinking, 0 settled */
+	int improved;   /* A step in the current direction paid off */
+	uint32_t idle;  /* Windows spent settled */
+};
+
+struct sunxi_efex_chunk_tuner_t {
+	struct sunxi_efex_chunk_state_t state[SUNXI_EFEX_CHUNK_CLASS_COUNT];
+};
+
+uint64_t sunxi_efex_time_us(void) {
+#ifdef _WIN32
+	LARGE_INTEGER freq, now;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+	return (uint64_t) (now.QuadPart / freq.QuadPart) * 1000000ULL +
+	       (uint64_t) (now.QuadPart % freq.QuadPart) * 1000000ULL / (uint64_t) freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000ULL + (uint64_t) ts.tv_nsec / 1000ULL;
+#endif
+}
+
+static uint32_t sunxi_efex_chunk_fixed(const struct sunxi_efex_ctx_t *ctx) {
+	return ctx->chunk_size ? ctx->chunk_size : EFEX_CODE_MAX_SIZE;
+}
+
+static uint32_t sunxi_efex_chunk_limit(const struct sunxi_efex_ctx_t *ctx) {
+	return ctx->chunk_limit ? ctx->chunk_limit : EFEX_CODE_MAX_SIZE;
+}
+
+int sunxi_efex_set_chunk_size(struct sunxi_efex_ctx_t *ctx, const uint32_t chunk_size) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	if (chunk_size % SUNXI_EFEX_CHUNK_SIZE_MIN || chunk_size > SUNXI_EFEX_CHUNK_SIZE_MAX) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+	ctx->chunk_size = chunk_size;
+	return EFEX_ERR_SUCCESS;
+}
+
+int sunxi_efex_set_chunk_auto(struct sunxi_efex_ctx_t *ctx, const int enable) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	if (!enable) {
+		free(ctx->chunk_tuner);
+		ctx->chunk_tuner = NULL;
+		return EFEX_ERR_SUCCESS;
+	}
+
+	if (!ctx->chunk_tuner) {
+		ctx->chunk_tuner = calloc(1, sizeof(*ctx->chunk_tuner));
+		if (!ctx->chunk_tuner)
+			return EFEX_ERR_MEMORY;
+	}
+
+	for (int i = 0; i < SUNXI_EFEX_CHUNK_CLASS_COUNT; i++) {
+		struct sunxi_efex_chunk_state_t *s = &ctx->chunk_tuner->state[i];
+		*s = (struct sunxi_efex_chunk_state_t) {
+				.size = sunxi_efex_chunk_fixed(ctx),
+				.step = 1,
+		};
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+int sunxi_efex_probe_chunk_size(struct sunxi_efex_ctx_t *ctx, const uint32_t addr, const uint32_t max,
+                                uint32_t *accepted) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	if (max % SUNXI_EFEX_CHUNK_SIZE_MIN || max < EFEX_CODE_MAX_SIZE || max > SUNXI_EFEX_CHUNK_SIZE_MAX) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+	if (ctx->resp.mode != DEVICE_MODE_FEL && ctx->resp.mode != DEVICE_MODE_SRV) {
+		return EFEX_ERR_INVALID_DEVICE_MODE;
+	}
+
+	char *buf = malloc(max);
+	if (!buf) {
+		return EFEX_ERR_MEMORY;
+	}
+
+	// Probe through the regular transfer paths, pinned to one chunk of the tried size
+	const uint32_t saved_size = ctx->chunk_size;
+	struct sunxi_efex_chunk_tuner_t *saved_tuner = ctx->chunk_tuner;
+	ctx->chunk_tuner = NULL;
+
+	uint32_t best = EFEX_CODE_MAX_SIZE;
+	int ret = EFEX_ERR_SUCCESS;
+	for (uint32_t size = EFEX_CODE_MAX_SIZE * 2; size <= max; size *= 2) {
+		ctx->chunk_size = size;
+		if (ctx->resp.mode == DEVICE_MODE_FEL)
+			ret = sunxi_efex_fel_read(ctx, addr, buf, size);
+		else
+			ret = sunxi_efex_fes_up(ctx, buf, size, addr, SUNXI_EFEX_FLASH_TAG);
+		if (ret != EFEX_ERR_SUCCESS) {
+			// Make sure the rejected transaction left the device usable
+			ret = sunxi_efex_init(ctx);
+			break;
+		}
+		best = size;
+	}
+
+	ctx->chunk_size = saved_size;
+	ctx->chunk_tuner = saved_tuner;
+	free(buf);
+
+	if (ret != EFEX_ERR_SUCCESS) {
+		return ret;
+	}
+
+	ctx->chunk_limit = best;
+	if (accepted)
+		*accepted = best;
+	return EFEX_ERR_SUCCESS;
+}
+
+uint32_t sunxi_efex_chunk_size(const struct sunxi_efex_ctx_t *ctx, const enum sunxi_efex_chunk_class_t cls) {
+	if (!ctx) {
+		return EFEX_CODE_MAX_SIZE;
+	}
+	if (ctx->chunk_tuner && cls < SUNXI_EFEX_CHUNK_CLASS_COUNT) {
+		return ctx->chunk_tuner->state[cls].size;
+	}
+	return sunxi_efex_chunk_fixed(ctx);
+}
+
+void sunxi_efex_chunk_update(const struct sunxi_efex_ctx_t *ctx, const enum sunxi_efex_chunk_class_t cls,
+                             const uint32_t len, const uint64_t usec) {
+	if (!ctx || !ctx->chunk_tuner || cls >= SUNXI_EFEX_CHUNK_CLASS_COUNT) {
+		return;
+	}
+
+	struct sunxi_efex_chunk_state_t *s = &ctx->chunk_tuner->state[cls];
+	s->chunks++;
+	s->bytes += len;
+	s->usec += usec;
+	if (s->chunks < SUNXI_EFEX_CHUNK_TUNE_CHUNKS || s->bytes < SUNXI_EFEX_CHUNK_TUNE_BYTES) {
+		return;
+	}
+
+	const uint64_t rate = s->bytes * 1000000ULL / (s->usec ? s->usec : 1);
+	s->chunks = 0;
+	s->bytes = 0;
+	s->usec = 0;
+
+	if (s->step == 0) {
+		// Settled: every now and then look upwards again in case conditions changed
+		if (++s->idle < SUNXI_EFEX_CHUNK_TUNE_RESTART) {
+			s->rate = rate;
+			return;
+		}
+		s->idle = 0;
+		s->step = 1;
+		s->improved = 0;
+	} else if (s->rate && rate * 100 <= s->rate * (100 - SUNXI_EFEX_CHUNK_TUNE_MARGIN)) {
+		// The last step made things worse: undo it
+		s->size = s->step > 0 ? s->size / 2 : s->size * 2;
+		if (s->step > 0 && !s->improved && s->size / 2 >= SUNXI_EFEX_CHUNK_TUNE_FLOOR) {
+			// Growing never paid off, so try smaller chunks against the rate of the restored size
+			s->size /= 2;
+			s->step = -1;
+			return;
+		}
+		s->step = 0;
+		s->rate = 0;
+		return;
+	} else if (s->rate && rate * 100 < s->rate * (100 + SUNXI_EFEX_CHUNK_TUNE_MARGIN)) {
+		// No measurable difference, stay at the current size
+		s->step = 0;
+		s->rate = rate;
+		return;
+	} else if (s->rate) {
+		s->improved = 1;
+	}
+
+	s->rate = rate;
+	const uint32_t floor = SUNXI_EFEX_CHUNK_TUNE_FLOOR;
+	const uint32_t limit = sunxi_efex_chunk_limit(ctx);
+	uint32_t next = s->step > 0 ? s->size * 2 : s->size / 2;
+	if (next > limit && !s->improved) {
+		// Already at the limit, smaller chunks are the only direction left
+		s->step = -1;
+		next = s->size / 2;
+	}
+	if (next < floor || next > limit) {
+		s->step = 0;
+		return;
+	}
+	s->size = next;
+}
+
+void sunxi_efex_chunk_release(struct sunxi_efex_ctx_t *ctx) {
+	if (!ctx) {
+		return;
+	}
+	free(ctx->chunk_tuner);
+	ctx->chunk_tuner = NULL;
+}
@@ -5,8 +5,13 @@
 #include <string.h>
 
 #include "compiler.h"
+#include "efex-buffer.h"
+#include "efex-chunk.h"
 #include "efex-common.h"
+#include "efex-payloads.h"
 #include "efex-protocol.h"
+#include "efex-stats.h"
+#include "efex-trace.h"
 #include "efex-usb.h"
 #include "ending.h"
 
@@ -16,6 +21,9 @@ int sunxi_send_efex_request(const struct sunxi_efex_ctx_t *ctx, const enum sunxi
 		return EFEX_ERR_NULL_PTR;
 	}
 
+	sunxi_efex_stats_cmd(ctx, type);
+	sunxi_efex_trace_cmd(ctx, type);
+
 	const struct sunxi_efex_request_t req = {
 			.cmd = cpu_to_le16(type),
 			.tag = 0x0,
@@ -98,9 +106,38 @@ int sunxi_efex_init(struct sunxi_efex_ctx_t *ctx) {
 	ctx->resp.data_length = ctx->resp.data_length;
 	ctx->resp.data_flag = ctx->resp.data_flag;
 
+	sunxi_efex_fel_payloads_reset(ctx);
+	return EFEX_ERR_SUCCESS;
+}
+
+void sunxi_efex_ctx_release(struct sunxi_efex_ctx_t *ctx) {
+	if (!ctx) {
+		return;
+	}
+	sunxi_efex_buffer_pool_release(ctx);
+	sunxi_efex_chunk_release(ctx);
+	sunxi_efex_stats_release(ctx);
+	sunxi_efex_trace_release(ctx);
+	sunxi_efex_fel_payloads_release(ctx);
+}
+
+int sunxi_efex_set_progress(struct sunxi_efex_ctx_t *ctx,
+                            void (*on_progress)(const struct sunxi_efex_ctx_t *ctx, size_t done, void *arg),
+                            void *arg) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	ctx->on_progress = on_progress;
+	ctx->progress_arg = arg;
 	return EFEX_ERR_SUCCESS;
 }
 
+void sunxi_efex_progress(const struct sunxi_efex_ctx_t *ctx, const size_t done) {
+	if (ctx && ctx->on_progress) {
+		ctx->on_progress(ctx, done, ctx->progress_arg);
+	}
+}
+
 const char *sunxi_efex_strerror(const int error_code) {
 	switch (error_code) {
 		case EFEX_ERR_SUCCESS:
@@ -151,6 +188,8 @@ const char *sunxi_efex_strerror(const int error_code) {
 			return "Failed to write file";
 		case EFEX_ERR_FILE_SIZE:
 			return "File size error";
+		case EFEX_ERR_FILE_FORMAT:
+			return "Invalid file format";
 		case EFEX_ERR_INVALID_DEVICE_MODE:
 			return "Invalid device mode";
 		default:
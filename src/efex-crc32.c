@@ -0,0 +1,201 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "efex-crc32.h"
+#include "efex-thread.h"
+#include "ending.h"
+
+/*
+ * Slice-by-16 in portable C, folded with carry-less multiplication where the CPU has PCLMULQDQ,
+ * or the ARMv8 CRC32 instructions when the compiler targets them. The internal functions work on
+ * the inverted CRC register, sunxi_efex_crc32() inverts on the way in and out.
+ */
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define CRC32_PCLMUL
+#define CRC32_PCLMUL_TARGET __attribute__((target("sse2,pclmul")))
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#elif defined(_M_X64) && defined(_MSC_VER)
+#define CRC32_PCLMUL
+#define CRC32_PCLMUL_TARGET
+#include <intrin.h>
+#endif
+
+#if defined(__AARCH64EL__) && defined(__ARM_FEATURE_CRC32)
+#define CRC32_ARMV8
+#include <arm_acle.h>
+#endif
+
+// Folding only pays off from a few blocks of 16 bytes on
+#define CRC32_PCLMUL_MIN (64)
+
+static uint32_t crc32_table[16][256];
+static sunxi_efex_atomic_t crc32_table_ready;
+static sunxi_efex_mutex_t crc32_table_lock = SUNXI_EFEX_MUTEX_INIT;
+
+static void crc32_table_init(void) {
+	if (sunxi_efex_atomic_load(&crc32_table_ready))
+		return;
+
+	sunxi_efex_mutex_lock(&crc32_table_lock);
+	if (!sunxi_efex_atomic_load(&crc32_table_ready)) {
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t c = i;
+			for (int k = 0; k < 8; k++)
+				c = (c >> 1) ^ (0xedb88320U & (0U - (c & 1U)));
+			crc32_table[0][i] = c;
+		}
+		// Table k advances a byte k positions further back through the CRC
+		for (int k = 1; k < 16; k++) {
+			for (uint32_t i = 0; i < 256; i++) {
+				const uint32_t c = crc32_table[k - 1][i];
+				crc32_table[k][i] = (c >> 8) ^ crc32_table[0][c & 0xff];
+			}
+		}
+		sunxi_efex_atomic_store(&crc32_table_ready, 1);
+	}
+	sunxi_efex_mutex_unlock(&crc32_table_lock);
+}
+
+static uint32_t crc32_slice16(uint32_t crc, const uint8_t *p, size_t len) {
+	uint32_t (*t)[256] = crc32_table;
+
+	while (len >= 16) {
+		uint32_t w[4];
+		memcpy(w, p, sizeof(w));
+		const uint32_t a = le32_to_cpu(w[0]) ^ crc;
+		const uint32_t b = le32_to_cpu(w[1]);
+		const uint32_t c = le32_to_cpu(w[2]);
+		const uint32_t d = le32_to_cpu(w[3]);
+		crc = t[15][a & 0xff] ^ t[14][(a >> 8) & 0xff] ^ t[13][(a >> 16) & 0xff] ^ t[12][a >> 24] ^
+		      t[11][b & 0xff] ^ t[10][(b >> 8) & 0xff] ^ t[9][(b >> 16) & 0xff] ^ t[8][b >> 24] ^
+		      t[7][c & 0xff] ^ t[6][(c >> 8) & 0xff] ^ t[5][(c >> 16) & 0xff] ^ t[4][c >> 24] ^
+		      t[3][d & 0xff] ^ t[2][(d >> 8) & 0xff] ^ t[1][(d >> 16) & 0xff] ^ t[0][d >> 24];
+		p += 16;
+		len -= 16;
+	}
+	while (len--)
+		crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+	return crc;
+}
+
+#ifdef CRC32_PCLMUL
+static int crc32_have_pclmul(void) {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] >> 1) & 1;
+#else
+	return __builtin_cpu_supports("pclmul");
+#endif
+}
+
+/*
+ * Folds four 128-bit lanes over 64-byte blocks, then down to one lane and Barrett-reduces it,
+ * after Intel's "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction".
+ * len is at least CRC32_PCLMUL_MIN and a multiple of 16.
+ */
+CRC32_PCLMUL_TARGET static uint32_t crc32_pclmul(const uint32_t crc, const uint8_t *p, size_t len) {
+	const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+	const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+	const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163cd6124);
+	const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+	const __m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+
+	__m128i x1 = _mm_loadu_si128((const __m128i *) (p + 0x00));
+	__m128i x2 = _mm_loadu_si128((const __m128i *) (p + 0x10));
+	__m128i x3 = _mm_loadu_si128((const __m128i *) (p + 0x20));
+	__m128i x4 = _mm_loadu_si128((const __m128i *) (p + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int) crc));
+	p += 64;
+	len -= 64;
+
+	while (len >= 64) {
+		const __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+		const __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+		const __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+		const __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *) (p + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *) (p + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *) (p + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *) (p + 0x30)));
+		p += 64;
+		len -= 64;
+	}
+
+	// Four lanes into one, then any single blocks left
+	__m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x4), x5);
+	while (len >= 16) {
+		x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+		x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_loadu_si128((const __m128i *) p)),
+		                   x5);
+		p += 16;
+		len -= 16;
+	}
+
+	// 128 bits to 64
+	x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask), k5k0, 0x00), x2);
+
+	// Barrett reduction to 32 bits
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), poly, 0x10);
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask), poly, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+	return (uint32_t) _mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+#endif
+
+#ifdef CRC32_ARMV8
+static uint32_t crc32_armv8(uint32_t crc, const uint8_t *p, size_t len) {
+	while (len && ((uintptr_t) p & 7)) {
+		crc = __crc32b(crc, *p++);
+		len--;
+	}
+	while (len >= 8) {
+		uint64_t v;
+		memcpy(&v, p, sizeof(v));
+		crc = __crc32d(crc, v);
+		p += 8;
+		len -= 8;
+	}
+	while (len--)
+		crc = __crc32b(crc, *p++);
+	return crc;
+}
+#endif
+
+uint32_t sunxi_efex_crc32(uint32_t crc, const void *buf, size_t len) {
+	const uint8_t *p = buf;
+
+	crc = ~crc;
+	if (!p || !len)
+		return ~crc;
+
+#ifdef CRC32_ARMV8
+	return ~crc32_armv8(crc, p, len);
+#else
+#ifdef CRC32_PCLMUL
+	if (len >= CRC32_PCLMUL_MIN && crc32_have_pclmul()) {
+		const size_t n = len & ~(size_t) 15;
+		crc = crc32_pclmul(crc, p, n);
+		p += n;
+		len -= n;
+	}
+#endif
+	crc32_table_init();
+	return ~crc32_slice16(crc, p, len);
+#endif
+}
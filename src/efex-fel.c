@@ -4,10 +4,50 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "efex-chunk.h"
 #include "efex-common.h"
+#include "efex-crc32.h"
+#include "efex-payloads.h"
+#include "efex-policy.h"
 #include "efex-protocol.h"
+#include "efex-stats.h"
+#include "efex-stream.h"
+#include "efex-thread.h"
+#include "efex-trace.h"
 #include "efex-usb.h"
 #include "ending.h"
+#include "usb_layer.h"
+
+// Chunks queued ahead of the one being checked in pipelined mode
+#define SUNXI_EFEX_FEL_PIPELINE_DEPTH (2)
+#define SUNXI_EFEX_FEL_CHAIN_XFERS (9)
+
+// Verified writes from this size on get their host CRC computed on a thread during the transfer
+#define SUNXI_EFEX_FEL_VERIFY_THREAD_MIN (64 * 1024)
+// Bytes compared per read when a verified write is checked by reading it back
+#define SUNXI_EFEX_FEL_VERIFY_READBACK (64 * 1024)
+
+// All USB phases of one pipelined FEL read or write chunk
+struct sunxi_efex_fel_chain_t {
+	struct sunxi_usb_request_t awuc[3];
+	struct sunxi_usb_response_t awus[3];
+	struct sunxi_efex_request_t req;
+	struct sunxi_efex_response_t resp;
+	struct sunxi_usb_chain_xfer_t xfers[SUNXI_EFEX_FEL_CHAIN_XFERS];
+	void *handle;
+	uint32_t addr;
+	char *buf;
+	uint32_t len;
+};
+
+// A verified write, split around the payload footprint; the part inside it cannot be checked by a payload run
+struct sunxi_efex_fel_verify_t {
+	const char *buf;
+	size_t len;
+	size_t skip_start; // offset of the part inside the footprint, len if none
+	size_t skip_end;
+	uint32_t crc[2]; // host CRCs of the parts before and after it
+};
 
 int sunxi_efex_fel_exec(const struct sunxi_efex_ctx_t *ctx, const uint32_t addr) {
 	if (!ctx) {
@@ -18,6 +58,11 @@ int sunxi_efex_fel_exec(const struct sunxi_efex_ctx_t *ctx, const uint32_t addr)
 		return EFEX_ERR_INVALID_DEVICE_MODE;
 	}
 
+	// Code other than our own payloads may overwrite them
+	if (!sunxi_efex_fel_payloads_resident(ctx, addr)) {
+		sunxi_efex_fel_payloads_invalidate(ctx, 0, 1ULL << 32);
+	}
+
 	int ret = sunxi_send_efex_request(ctx, EFEX_CMD_FEL_EXEC, addr, 0);
 	if (ret != EFEX_ERR_SUCCESS) {
 		return ret;
@@ -39,7 +84,7 @@ static inline int sunxi_efex_fel_read_data(const struct sunxi_efex_ctx_t *ctx, c
 		return ret;
 	}
 
-	ret = sunxi_usb_read(ctx, (void *) buf, size);
+	ret = sunxi_usb_read_timeout(ctx, (void *) buf, size, sunxi_efex_policy_timeout(ctx, EFEX_CMD_FEL_READ, size));
 	if (ret != EFEX_ERR_SUCCESS) {
 		return ret;
 	}
@@ -58,7 +103,7 @@ static inline int sunxi_efex_fel_write_data(const struct sunxi_efex_ctx_t *ctx,
 		return ret;
 	}
 
-	ret = sunxi_usb_write(ctx, buf, size);
+	ret = sunxi_usb_write_timeout(ctx, buf, size, sunxi_efex_policy_timeout(ctx, EFEX_CMD_FEL_WRITE, size));
 	if (ret != EFEX_ERR_SUCCESS) {
 		return ret;
 	}
@@ -71,6 +116,323 @@ static inline int sunxi_efex_fel_write_data(const struct sunxi_efex_ctx_t *ctx,
 	return EFEX_ERR_SUCCESS;
 }
 
+// Blocking FEL read/write, one chunk at a time, each retried as the context's policy allows
+static int sunxi_efex_fel_xfer(const struct sunxi_efex_ctx_t *ctx, const enum sunxi_efex_cmd_t cmd, uint32_t addr,
+                               char *buf, ssize_t len, void (*callback)(ssize_t done)) {
+	const enum sunxi_efex_chunk_class_t cls =
+			cmd == EFEX_CMD_FEL_READ ? SUNXI_EFEX_CHUNK_FEL_READ : SUNXI_EFEX_CHUNK_FEL_WRITE;
+	int ret = EFEX_ERR_SUCCESS;
+
+	while (len > 0) {
+		const uint32_t chunk = sunxi_efex_chunk_size(ctx, cls);
+		const uint32_t n = len > chunk ? chunk : (uint32_t) len;
+		const uint64_t start = sunxi_efex_time_us();
+
+		uint32_t attempt = 0;
+		do {
+			if (cmd == EFEX_CMD_FEL_READ)
+				ret = sunxi_efex_fel_read_data(ctx, addr, buf, n);
+			else
+				ret = sunxi_efex_fel_write_data(ctx, addr, buf, n);
+		} while (sunxi_efex_policy_check(ctx, cmd, addr, attempt++, ret));
+		if (ret < 0)
+			return ret;
+		sunxi_efex_chunk_update(ctx, cls, n, sunxi_efex_time_us() - start);
+
+		sunxi_efex_progress(ctx, n);
+		if (callback)
+			callback((ssize_t) n);
+
+		addr += n;
+		buf += n;
+		len -= n;
+	}
+	return ret;
+}
+
+static void sunxi_efex_fel_chain_fill(const struct sunxi_efex_ctx_t *ctx, struct sunxi_efex_fel_chain_t *chain,
+                                      const enum sunxi_efex_cmd_t cmd, const uint32_t addr, char *buf,
+                                      const uint32_t len) {
+	const int is_read = cmd == EFEX_CMD_FEL_READ;
+
+	chain->addr = addr;
+	chain->buf = buf;
+	chain->len = len;
+	chain->handle = NULL;
+	memset(chain->awus, 0, sizeof(chain->awus));
+	memset(&chain->resp, 0, sizeof(chain->resp));
+
+	chain->req.cmd = cpu_to_le16(cmd);
+	chain->req.tag = 0x0;
+	chain->req.address = cpu_to_le32(addr);
+	chain->req.len = cpu_to_le32(len);
+	chain->req.flags = 0x0;
+
+	sunxi_usb_fill_request(&chain->awuc[0], AW_USB_WRITE, sizeof(chain->req));
+	sunxi_usb_fill_request(&chain->awuc[1], is_read ? AW_USB_READ : AW_USB_WRITE, len);
+	sunxi_usb_fill_request(&chain->awuc[2], AW_USB_READ, sizeof(chain->resp));
+
+	// Same order as the blocking path: request, data, then status, each framed by AWUC/AWUS
+	const struct sunxi_usb_chain_xfer_t xfers[SUNXI_EFEX_FEL_CHAIN_XFERS] = {
+			{ctx->epout, (char *) &chain->awuc[0], sizeof(chain->awuc[0])},
+			{ctx->epout, (char *) &chain->req, sizeof(chain->req)},
+			{ctx->epin, (char *) &chain->awus[0], sizeof(chain->awus[0])},
+			{ctx->epout, (char *) &chain->awuc[1], sizeof(chain->awuc[1])},
+			{is_read ? ctx->epin : ctx->epout, buf, len},
+			{ctx->epin, (char *) &chain->awus[1], sizeof(chain->awus[1])},
+			{ctx->epout, (char *) &chain->awuc[2], sizeof(chain->awuc[2])},
+			{ctx->epin, (char *) &chain->resp, sizeof(chain->resp)},
+			{ctx->epin, (char *) &chain->awus[2], sizeof(chain->awus[2])},
+	};
+	memcpy(chain->xfers, xfers, sizeof(xfers));
+}
+
+static int sunxi_efex_fel_chain_check(const struct sunxi_efex_fel_chain_t *chain) {
+	for (size_t i = 0; i < sizeof(chain->awus) / sizeof(chain->awus[0]); i++) {
+		const int ret = sunxi_usb_check_response(&chain->awus[i]);
+		if (ret < 0) {
+			return ret;
+		}
+		if (ret != 0) {
+			return EFEX_ERR_PROTOCOL;
+		}
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+// A chain is timed as a whole in the data phase; its other transfers are only counted
+static void sunxi_efex_fel_chain_stats(const struct sunxi_efex_ctx_t *ctx, const struct sunxi_efex_fel_chain_t *chain,
+                                       const enum sunxi_efex_cmd_t cmd, const uint64_t usec, const int error) {
+	if (!ctx->stats && !ctx->trace)
+		return;
+
+	const uint64_t start = sunxi_efex_time_us() - usec;
+	sunxi_efex_stats_cmd(ctx, cmd);
+	sunxi_efex_trace_cmd(ctx, cmd);
+	for (size_t i = 0; i < SUNXI_EFEX_FEL_CHAIN_XFERS; i++) {
+		const struct sunxi_usb_chain_xfer_t *x = &chain->xfers[i];
+		const enum sunxi_efex_stats_dir_t dir = (x->ep & 0x80) ? SUNXI_EFEX_DIR_IN : SUNXI_EFEX_DIR_OUT;
+		const int data = x->buf == chain->buf;
+		if (data)
+			sunxi_efex_stats_xfer(ctx, SUNXI_EFEX_PHASE_DATA, dir, (size_t) x->len, usec, error);
+		else if (error >= 0)
+			sunxi_efex_stats_count(ctx, dir, (size_t) x->len);
+		// Three transfers per phase, in request, data, status order
+		sunxi_efex_trace_xfer(ctx, (int) (i / 3), x->ep, x->buf, (size_t) x->len, start, data ? usec : 0, error);
+	}
+}
+
+// Pipelined FEL read/write: while one chunk is checked the next is already queued on the bus
+static int sunxi_efex_fel_pipeline(const struct sunxi_efex_ctx_t *ctx, const enum sunxi_efex_cmd_t cmd,
+                                   uint32_t addr, char *buf, ssize_t len, void (*callback)(ssize_t done)) {
+	const enum sunxi_efex_chunk_class_t cls =
+			cmd == EFEX_CMD_FEL_READ ? SUNXI_EFEX_CHUNK_FEL_READ : SUNXI_EFEX_CHUNK_FEL_WRITE;
+	struct sunxi_efex_fel_chain_t chain[SUNXI_EFEX_FEL_PIPELINE_DEPTH];
+	const char *end = buf + len;
+	size_t head = 0;
+	size_t count = 0;
+	uint64_t last = sunxi_efex_time_us();
+	uint32_t resume_addr = addr;
+	char *resume_buf = buf;
+	int ret = EFEX_ERR_SUCCESS;
+
+	while (len > 0 || count > 0) {
+		if (len > 0 && count < SUNXI_EFEX_FEL_PIPELINE_DEPTH) {
+			struct sunxi_efex_fel_chain_t *c = &chain[(head + count) % SUNXI_EFEX_FEL_PIPELINE_DEPTH];
+			const uint32_t chunk = sunxi_efex_chunk_size(ctx, cls);
+			const uint32_t n = len > chunk ? chunk : (uint32_t) len;
+
+			sunxi_efex_fel_chain_fill(ctx, c, cmd, addr, buf, n);
+			ret = sunxi_usb_bulk_chain_submit(ctx, c->xfers, SUNXI_EFEX_FEL_CHAIN_XFERS,
+			                                  sunxi_efex_policy_timeout(ctx, cmd, n), &c->handle);
+			if (ret == EFEX_ERR_SUCCESS && !c->handle) {
+				// Backend ran the chain synchronously, it is already complete
+				ret = sunxi_efex_fel_chain_check(c);
+				if (ret == EFEX_ERR_SUCCESS) {
+					const uint64_t now = sunxi_efex_time_us();
+					sunxi_efex_fel_chain_stats(ctx, c, cmd, now - last, ret);
+					sunxi_efex_chunk_update(ctx, cls, n, now - last);
+					last = now;
+					sunxi_efex_progress(ctx, n);
+					if (callback)
+						callback((ssize_t) n);
+				}
+			} else if (ret == EFEX_ERR_SUCCESS) {
+				count++;
+			}
+			if (ret != EFEX_ERR_SUCCESS) {
+				// Oldest chunk not confirmed yet is where a retry has to pick up
+				resume_addr = count ? chain[head].addr : c->addr;
+				resume_buf = count ? chain[head].buf : c->buf;
+				break;
+			}
+
+			addr += n;
+			buf += n;
+			len -= n;
+			continue;
+		}
+
+		struct sunxi_efex_fel_chain_t *c = &chain[head];
+		head = (head + 1) % SUNXI_EFEX_FEL_PIPELINE_DEPTH;
+		count--;
+
+		ret = sunxi_usb_bulk_chain_wait(ctx, c->handle);
+		if (ret == EFEX_ERR_SUCCESS)
+			ret = sunxi_efex_fel_chain_check(c);
+		if (ret != EFEX_ERR_SUCCESS) {
+			sunxi_efex_fel_chain_stats(ctx, c, cmd, sunxi_efex_time_us() - last, ret);
+			resume_addr = c->addr;
+			resume_buf = c->buf;
+			break;
+		}
+
+		// With chunks overlapping, the time between completions is what a chunk costs
+		const uint64_t now = sunxi_efex_time_us();
+		sunxi_efex_fel_chain_stats(ctx, c, cmd, now - last, ret);
+		sunxi_efex_chunk_update(ctx, cls, c->len, now - last);
+		last = now;
+
+		sunxi_efex_progress(ctx, c->len);
+		if (callback)
+			callback((ssize_t) c->len);
+	}
+
+	// Chunks still queued reference buffers on this stack, let them finish before returning
+	while (count > 0) {
+		sunxi_usb_bulk_chain_wait(ctx, chain[head].handle);
+		head = (head + 1) % SUNXI_EFEX_FEL_PIPELINE_DEPTH;
+		count--;
+	}
+
+	// Retries are made in blocking mode, from the first chunk that did not complete
+	if (ret != EFEX_ERR_SUCCESS && sunxi_efex_policy_check(ctx, cmd, resume_addr, 0, ret)) {
+		return sunxi_efex_fel_xfer(ctx, cmd, resume_addr, resume_buf, end - resume_buf, callback);
+	}
+	return ret;
+}
+
+int sunxi_efex_fel_set_pipeline(struct sunxi_efex_ctx_t *ctx, const int enable) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	ctx->fel_pipeline = enable ? 1 : 0;
+	return EFEX_ERR_SUCCESS;
+}
+
+int sunxi_efex_fel_set_verify(struct sunxi_efex_ctx_t *ctx, const int enable) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	ctx->fel_verify = enable ? 1 : 0;
+	return EFEX_ERR_SUCCESS;
+}
+
+static int sunxi_efex_fel_write_xfer(const struct sunxi_efex_ctx_t *ctx, const uint32_t addr, const char *buf,
+                                     const ssize_t len, void (*callback)(ssize_t done)) {
+	if (ctx->fel_pipeline) {
+		return sunxi_efex_fel_pipeline(ctx, EFEX_CMD_FEL_WRITE, addr, (char *) buf, len, callback);
+	}
+
+	return sunxi_efex_fel_xfer(ctx, EFEX_CMD_FEL_WRITE, addr, (char *) buf, len, callback);
+}
+
+static void sunxi_efex_fel_verify_crc(struct sunxi_efex_fel_verify_t *v) {
+	v->crc[0] = sunxi_efex_crc32(0, v->buf, v->skip_start);
+	v->crc[1] = sunxi_efex_crc32(0, v->buf + v->skip_end, v->len - v->skip_end);
+}
+
+static void *sunxi_efex_fel_verify_thread(void *arg) {
+	sunxi_efex_fel_verify_crc(arg);
+	return NULL;
+}
+
+static int sunxi_efex_fel_verify_readback(const struct sunxi_efex_ctx_t *ctx, const uint32_t addr, const char *buf,
+                                          const size_t len) {
+	char *tmp = malloc(len < SUNXI_EFEX_FEL_VERIFY_READBACK ? len : SUNXI_EFEX_FEL_VERIFY_READBACK);
+	if (!tmp) {
+		return EFEX_ERR_MEMORY;
+	}
+
+	int ret = EFEX_ERR_SUCCESS;
+	for (size_t done = 0; done < len && ret == EFEX_ERR_SUCCESS;) {
+		const size_t n = len - done < SUNXI_EFEX_FEL_VERIFY_READBACK ? len - done : SUNXI_EFEX_FEL_VERIFY_READBACK;
+		ret = sunxi_efex_fel_read(ctx, addr + (uint32_t) done, tmp, (ssize_t) n);
+		if (ret == EFEX_ERR_SUCCESS && memcmp(tmp, buf + done, n) != 0)
+			ret = EFEX_ERR_VERIFICATION;
+		done += n;
+	}
+	free(tmp);
+	return ret;
+}
+
+// Device CRC of a range against the host one; payloads without CRC32 support fall back to reading it back
+static int sunxi_efex_fel_verify_range(const struct sunxi_efex_ctx_t *ctx, const uint32_t addr, const char *buf,
+                                       const size_t len, const uint32_t crc, int *ran) {
+	if (len == 0) {
+		return EFEX_ERR_SUCCESS;
+	}
+
+	uint32_t device_crc = 0;
+	const int ret = sunxi_efex_fel_crc32(ctx, addr, (uint32_t) len, &device_crc);
+	if (ret == EFEX_ERR_NOT_SUPPORT) {
+		return sunxi_efex_fel_verify_readback(ctx, addr, buf, len);
+	}
+	if (ret != EFEX_ERR_SUCCESS) {
+		return ret;
+	}
+	*ran = 1;
+	return device_crc == crc ? EFEX_ERR_SUCCESS : EFEX_ERR_CRC_MISMATCH;
+}
+
+// Writes, then checks the data with the CRC32 payload while the host CRC was computed alongside the transfer
+static int sunxi_efex_fel_write_verified(const struct sunxi_efex_ctx_t *ctx, const uint32_t addr, const char *buf,
+                                         const ssize_t len, void (*callback)(ssize_t done)) {
+	struct sunxi_efex_fel_verify_t v = {.buf = buf, .len = (size_t) len, .skip_start = (size_t) len,
+	                                    .skip_end = (size_t) len};
+	const uint64_t base = ctx->resp.data_start_address;
+	const uint64_t end = base + SUNXI_EFEX_PAYLOAD_FOOTPRINT;
+	const uint64_t stop = (uint64_t) addr + v.len;
+	if (addr < end && stop > base) {
+		v.skip_start = base > addr ? (size_t) (base - addr) : 0;
+		v.skip_end = (size_t) ((end < stop ? end : stop) - addr);
+	}
+
+	sunxi_efex_thread_t thread;
+	const int threaded = v.len >= SUNXI_EFEX_FEL_VERIFY_THREAD_MIN &&
+	                     sunxi_efex_thread_create(&thread, sunxi_efex_fel_verify_thread, &v) == 0;
+	int ret = sunxi_efex_fel_write_xfer(ctx, addr, buf, len, callback);
+	if (threaded)
+		sunxi_efex_thread_join(thread);
+	else if (ret == EFEX_ERR_SUCCESS)
+		sunxi_efex_fel_verify_crc(&v);
+	if (ret != EFEX_ERR_SUCCESS) {
+		return ret;
+	}
+
+	int ran = 0;
+	ret = sunxi_efex_fel_verify_range(ctx, addr, buf, v.skip_start, v.crc[0], &ran);
+	if (ret == EFEX_ERR_SUCCESS) {
+		ret = sunxi_efex_fel_verify_range(ctx, addr + (uint32_t) v.skip_end, buf + v.skip_end, v.len - v.skip_end,
+		                                  v.crc[1], &ran);
+	}
+	if (ret != EFEX_ERR_SUCCESS || v.skip_start == v.skip_end) {
+		return ret;
+	}
+
+	// The payload runs overwrote the footprint part, which goes out again and is read back
+	const uint32_t skip_addr = addr + (uint32_t) v.skip_start;
+	const size_t skip_len = v.skip_end - v.skip_start;
+	if (ran) {
+		sunxi_efex_fel_payloads_invalidate(ctx, skip_addr, skip_len);
+		ret = sunxi_efex_fel_write_xfer(ctx, skip_addr, buf + v.skip_start, (ssize_t) skip_len, NULL);
+	}
+	if (ret == EFEX_ERR_SUCCESS) {
+		ret = sunxi_efex_fel_verify_readback(ctx, skip_addr, buf + v.skip_start, skip_len);
+	}
+	return ret;
+}
+
 int sunxi_efex_fel_read(const struct sunxi_efex_ctx_t *ctx, uint32_t addr, char *buf, ssize_t len) {
 	if (!ctx || !buf) {
 		return EFEX_ERR_NULL_PTR;
@@ -84,19 +446,11 @@ int sunxi_efex_fel_read(const struct sunxi_efex_ctx_t *ctx, uint32_t addr, char
 		return EFEX_ERR_INVALID_PARAM;
 	}
 
-	int ret = EFEX_ERR_SUCCESS;
-	while (len > 0) {
-		const uint32_t n = len > EFEX_CODE_MAX_SIZE ? EFEX_CODE_MAX_SIZE : (uint32_t) len;
-
-		ret = sunxi_efex_fel_read_data(ctx, addr, buf, n);
-		if (ret < 0)
-			return ret;
-
-		addr += n;
-		buf += n;
-		len -= n;
+	if (ctx->fel_pipeline) {
+		return sunxi_efex_fel_pipeline(ctx, EFEX_CMD_FEL_READ, addr, (char *) buf, len, NULL);
 	}
-	return ret;
+
+	return sunxi_efex_fel_xfer(ctx, EFEX_CMD_FEL_READ, addr, (char *) buf, len, NULL);
 }
 
 int sunxi_efex_fel_write(const struct sunxi_efex_ctx_t *ctx, uint32_t addr, const char *buf, ssize_t len) {
@@ -112,19 +466,31 @@ int sunxi_efex_fel_write(const struct sunxi_efex_ctx_t *ctx, uint32_t addr, cons
 		return EFEX_ERR_INVALID_PARAM;
 	}
 
-	int ret = EFEX_ERR_SUCCESS;
-	while (len > 0) {
-		const uint32_t n = len > EFEX_CODE_MAX_SIZE ? EFEX_CODE_MAX_SIZE : (uint32_t) len;
+	sunxi_efex_fel_payloads_invalidate(ctx, addr, (uint64_t) len);
 
-		ret = sunxi_efex_fel_write_data(ctx, addr, buf, n);
-		if (ret < 0)
-			return ret;
+	if (ctx->fel_verify) {
+		return sunxi_efex_fel_write_verified(ctx, addr, buf, len, NULL);
+	}
 
-		addr += n;
-		buf += n;
-		len -= n;
+	return sunxi_efex_fel_write_xfer(ctx, addr, buf, len, NULL);
+}
+
+int sunxi_efex_fel_write_unverified(const struct sunxi_efex_ctx_t *ctx, uint32_t addr, const char *buf, ssize_t len) {
+	if (!ctx || !buf) {
+		return EFEX_ERR_NULL_PTR;
 	}
-	return ret;
+
+	if (ctx->resp.mode != DEVICE_MODE_FEL) {
+		return EFEX_ERR_INVALID_DEVICE_MODE;
+	}
+
+	if (len <= 0) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+
+	sunxi_efex_fel_payloads_invalidate(ctx, addr, (uint64_t) len);
+
+	return sunxi_efex_fel_write_xfer(ctx, addr, buf, len, NULL);
 }
 
 int sunxi_efex_fel_read_cb(const struct sunxi_efex_ctx_t *ctx, uint32_t addr, const char *buf, ssize_t len,
@@ -141,22 +507,46 @@ int sunxi_efex_fel_read_cb(const struct sunxi_efex_ctx_t *ctx, uint32_t addr, co
 		return EFEX_ERR_INVALID_PARAM;
 	}
 
-	int ret = EFEX_ERR_SUCCESS;
-	while (len > 0) {
-		const uint32_t n = len > EFEX_CODE_MAX_SIZE ? EFEX_CODE_MAX_SIZE : (uint32_t) len;
+	if (ctx->fel_pipeline) {
+		return sunxi_efex_fel_pipeline(ctx, EFEX_CMD_FEL_READ, addr, (char *) buf, len, callback);
+	}
 
-		ret = sunxi_efex_fel_read_data(ctx, addr, buf, n);
-		if (ret < 0)
-			return ret;
+	return sunxi_efex_fel_xfer(ctx, EFEX_CMD_FEL_READ, addr, (char *) buf, len, callback);
+}
 
-		if (callback)
-			callback((ssize_t) n);
+// A streaming FEL read, advanced one ring slot at a time
+struct sunxi_efex_fel_stream_t {
+	const struct sunxi_efex_ctx_t *ctx;
+	uint32_t addr;
+	void (*callback)(ssize_t done);
+};
+
+static int sunxi_efex_fel_stream_xfer(void *arg, char *buf, const uint32_t len, const int last) {
+	(void) last;
+	struct sunxi_efex_fel_stream_t *s = arg;
+	const int ret = sunxi_efex_fel_read_cb(s->ctx, s->addr, buf, (ssize_t) len, s->callback);
+	s->addr += len;
+	return ret;
+}
 
-		addr += n;
-		buf += n;
-		len -= n;
+int sunxi_efex_fel_read_stream(const struct sunxi_efex_ctx_t *ctx, const uint32_t addr, const uint64_t len,
+                               const sunxi_efex_stream_writer_t writer, void *user, void (*callback)(ssize_t done)) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
 	}
-	return ret;
+	if (ctx->resp.mode != DEVICE_MODE_FEL) {
+		return EFEX_ERR_INVALID_DEVICE_MODE;
+	}
+	if (len > 0x100000000ULL - addr) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+
+	struct sunxi_efex_fel_stream_t s = {
+			.ctx = ctx,
+			.addr = addr,
+			.callback = callback,
+	};
+	return sunxi_efex_stream_up(writer, user, len, sunxi_efex_fel_stream_xfer, &s);
 }
 
 int sunxi_efex_fel_write_cb(const struct sunxi_efex_ctx_t *ctx, uint32_t addr, const char *buf, ssize_t len,
@@ -173,20 +563,11 @@ int sunxi_efex_fel_write_cb(const struct sunxi_efex_ctx_t *ctx, uint32_t addr, c
 		return EFEX_ERR_INVALID_PARAM;
 	}
 
-	int ret = EFEX_ERR_SUCCESS;
-	while (len > 0) {
-		const uint32_t n = len > EFEX_CODE_MAX_SIZE ? EFEX_CODE_MAX_SIZE : (uint32_t) len;
+	sunxi_efex_fel_payloads_invalidate(ctx, addr, (uint64_t) len);
 
-		ret = sunxi_efex_fel_write_data(ctx, addr, buf, n);
-		if (ret < 0)
-			return ret;
-
-		if (callback)
-			callback((ssize_t) n);
-
-		addr += n;
-		buf += n;
-		len -= n;
+	if (ctx->fel_verify) {
+		return sunxi_efex_fel_write_verified(ctx, addr, buf, len, callback);
 	}
-	return ret;
+
+	return sunxi_efex_fel_write_xfer(ctx, addr, buf, len, callback);
 }
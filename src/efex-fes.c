@@ -5,10 +5,17 @@
 #include <string.h>
 
 
+#include "efex-chunk.h"
+#include "efex-crc32.h"
+#include "efex-policy.h"
 #include "efex-protocol.h"
+#include "efex-sparse.h"
+#include "efex-stream.h"
 #include "efex-usb.h"
 #include "ending.h"
 
+// Longest run handed to one sunxi_efex_fes_stream_xfer() call, sector-aligned
+#define FES_SPARSE_MAX_RUN (1U << 30)
 
 int sunxi_efex_fes_query_storage(const struct sunxi_efex_ctx_t *ctx, uint32_t *storage_type) {
 	return sunxi_usb_fes_xfer(ctx, FES_XFER_RECV, EFEX_CMD_FES_QUERY_STORAGE, NULL, 0, (char *) storage_type,
@@ -56,9 +63,42 @@ int sunxi_efex_fes_flash_switch(const struct sunxi_efex_ctx_t *ctx, const uint32
 	                          sizeof(fes_flash), NULL, 0);
 }
 
+// Addressing mode: data-type tags (0x7xxx) are byte-addressed, while the
+// FLASH tag (0x8000) is sector-addressed. The storage-specific commands
+// (raw NAND / SPI NAND / SPI NOR) are always byte-addressed regardless of
+// the tag, so the address advances by the byte count of each chunk.
+static bool sunxi_efex_fes_byte_addressed(const enum sunxi_fes_data_type_t type, const enum sunxi_efex_cmd_t cmd) {
+	const bool is_data_type = (type & SUNXI_EFEX_DATA_TYPE_MASK) != 0;
+	return is_data_type || cmd == EFEX_CMD_FES_NAND || cmd == EFEX_CMD_FES_SPINAND || cmd == EFEX_CMD_FES_NOR;
+}
+
+// One FES transaction, issued again after a link failure if the policy allows
+static int sunxi_efex_fes_chunk(const struct sunxi_efex_ctx_t *ctx, const enum sunxi_efex_cmd_t cmd,
+                                const enum sunxi_efex_chunk_class_t cls, const uint32_t addr, const char *buf,
+                                const uint32_t length, const enum sunxi_fes_data_type_t flags) {
+	// Prepare transfer structure
+	const struct sunxi_fes_trans_t trans = {
+			.addr = addr,
+			.len = length,
+			.flags = flags,
+	};
+
+	// Direction: FES_DOWN sends data to the device; all other commands
+	// (FES_UP, FES_NAND, FES_SPINAND, FES_NOR) receive data from it.
+	const enum sunxi_usb_fes_xfer_type_t xfer_type = (cmd == EFEX_CMD_FES_DOWN) ? FES_XFER_SEND : FES_XFER_RECV;
+	const uint64_t start = sunxi_efex_time_us();
+	uint32_t attempt = 0;
+	int ret;
+	do {
+		ret = sunxi_usb_fes_xfer(ctx, xfer_type, cmd, (const char *) &trans, sizeof(trans), buf, length);
+	} while (sunxi_efex_policy_check(ctx, cmd, addr, attempt++, ret));
+	sunxi_efex_chunk_update(ctx, cls, length, sunxi_efex_time_us() - start);
+	return ret;
+}
+
 static int sunxi_efex_fes_up_down(const struct sunxi_efex_ctx_t *ctx, const char *buf, const ssize_t len,
                                   const uint32_t addr, const enum sunxi_fes_data_type_t type,
-                                  const enum sunxi_efex_cmd_t cmd) {
+                                  const enum sunxi_efex_cmd_t cmd, uint32_t *crc) {
 	if (!ctx || !buf) {
 		return EFEX_ERR_NULL_PTR;
 	}
@@ -72,17 +112,14 @@ static int sunxi_efex_fes_up_down(const struct sunxi_efex_ctx_t *ctx, const char
 	const char *buff_ptr = (char *) buf;
 	uint32_t addr_cur = addr;
 	enum sunxi_fes_data_type_t current_type = type;
-	// Addressing mode: data-type tags (0x7xxx) are byte-addressed, while the
-	// FLASH tag (0x8000) is sector-addressed. The storage-specific commands
-	// (raw NAND / SPI NAND / SPI NOR) are always byte-addressed regardless of
-	// the tag, so the address advances by the byte count of each 64KB chunk.
-	const bool is_data_type = (type & SUNXI_EFEX_DATA_TYPE_MASK) != 0;
-	const bool byte_addressed = is_data_type || cmd == EFEX_CMD_FES_NAND || cmd == EFEX_CMD_FES_SPINAND ||
-	                            cmd == EFEX_CMD_FES_NOR;
+	const bool byte_addressed = sunxi_efex_fes_byte_addressed(type, cmd);
+
+	const enum sunxi_efex_chunk_class_t cls = cmd == EFEX_CMD_FES_DOWN ? SUNXI_EFEX_CHUNK_FES_DOWN : SUNXI_EFEX_CHUNK_FES_UP;
 
 	while (remain_data > 0) {
 		// Calculate current transfer length
-		const uint32_t length = (remain_data > EFEX_CODE_MAX_SIZE) ? EFEX_CODE_MAX_SIZE : remain_data;
+		const uint32_t chunk = sunxi_efex_chunk_size(ctx, cls);
+		const uint32_t length = (remain_data > chunk) ? chunk : remain_data;
 		remain_data -= length;
 
 		// Add finish tag if this is the last data block
@@ -90,18 +127,8 @@ static int sunxi_efex_fes_up_down(const struct sunxi_efex_ctx_t *ctx, const char
 			current_type |= SUNXI_EFEX_TRANS_FINISH_TAG;
 		}
 
-		// Prepare transfer structure
-		const struct sunxi_fes_trans_t trans = {
-				.addr = addr_cur,
-				.len = length,
-				.flags = current_type,
-		};
-
-		// Direction: FES_DOWN sends data to the device; all other commands
-		// (FES_UP, FES_NAND, FES_SPINAND, FES_NOR) receive data from it.
-		const enum sunxi_usb_fes_xfer_type_t xfer_type = (cmd == EFEX_CMD_FES_DOWN) ? FES_XFER_SEND : FES_XFER_RECV;
 		// Perform USB transfer
-		ret = sunxi_usb_fes_xfer(ctx, xfer_type, cmd, (const char *) &trans, sizeof(trans), buff_ptr, length);
+		ret = sunxi_efex_fes_chunk(ctx, cmd, cls, addr_cur, buff_ptr, length, current_type);
 
 		// Update address based on addressing mode (byte vs. sector)
 		addr_cur += byte_addressed ? length : (length / 512);
@@ -111,6 +138,11 @@ static int sunxi_efex_fes_up_down(const struct sunxi_efex_ctx_t *ctx, const char
 		if (ret != EFEX_ERR_SUCCESS) {
 			return ret;
 		}
+		// Each chunk is checksummed once it went through, at a fraction of its transfer time
+		if (crc) {
+			*crc = sunxi_efex_crc32(*crc, buff_ptr - length, length);
+		}
+		sunxi_efex_progress(ctx, length);
 	}
 
 	return EFEX_ERR_SUCCESS;
@@ -118,27 +150,414 @@ static int sunxi_efex_fes_up_down(const struct sunxi_efex_ctx_t *ctx, const char
 
 int sunxi_efex_fes_down(const struct sunxi_efex_ctx_t *ctx, const char *buf, const ssize_t len, const uint32_t addr,
                         const enum sunxi_fes_data_type_t type) {
-	return sunxi_efex_fes_up_down(ctx, buf, len, addr, type, EFEX_CMD_FES_DOWN);
+	return sunxi_efex_fes_up_down(ctx, buf, len, addr, type, EFEX_CMD_FES_DOWN, NULL);
 }
 
 int sunxi_efex_fes_up(const struct sunxi_efex_ctx_t *ctx, const char *buf, const ssize_t len, const uint32_t addr,
                       const enum sunxi_fes_data_type_t type) {
-	return sunxi_efex_fes_up_down(ctx, buf, len, addr, type, EFEX_CMD_FES_UP);
+	return sunxi_efex_fes_up_down(ctx, buf, len, addr, type, EFEX_CMD_FES_UP, NULL);
+}
+
+int sunxi_efex_fes_down_crc(const struct sunxi_efex_ctx_t *ctx, const char *buf, const ssize_t len,
+                            const uint32_t addr, const enum sunxi_fes_data_type_t type, uint32_t *crc) {
+	if (!crc) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	return sunxi_efex_fes_up_down(ctx, buf, len, addr, type, EFEX_CMD_FES_DOWN, crc);
+}
+
+int sunxi_efex_fes_up_crc(const struct sunxi_efex_ctx_t *ctx, const char *buf, const ssize_t len, const uint32_t addr,
+                          const enum sunxi_fes_data_type_t type, uint32_t *crc) {
+	if (!crc) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	return sunxi_efex_fes_up_down(ctx, buf, len, addr, type, EFEX_CMD_FES_UP, crc);
+}
+
+// A streaming FES transfer, advanced one ring slot at a time
+struct sunxi_efex_fes_stream_t {
+	const struct sunxi_efex_ctx_t *ctx;
+	enum sunxi_efex_cmd_t cmd;
+	enum sunxi_efex_chunk_class_t cls;
+	enum sunxi_fes_data_type_t type;
+	bool byte_addressed;
+	uint32_t addr;
+	uint32_t *crc;
+};
+
+static int sunxi_efex_fes_stream_xfer(void *arg, char *buf, const uint32_t len, const int last) {
+	struct sunxi_efex_fes_stream_t *s = arg;
+	uint32_t left = len;
+	while (left > 0) {
+		const uint32_t chunk = sunxi_efex_chunk_size(s->ctx, s->cls);
+		const uint32_t length = left > chunk ? chunk : left;
+		left -= length;
+
+		// The finish tag goes on the last chunk of the whole transfer, not of the slot
+		const enum sunxi_fes_data_type_t flags = last && left == 0 ? s->type | SUNXI_EFEX_TRANS_FINISH_TAG : s->type;
+		const int ret = sunxi_efex_fes_chunk(s->ctx, s->cmd, s->cls, s->addr, buf, length, flags);
+		if (ret != EFEX_ERR_SUCCESS) {
+			return ret;
+		}
+		if (s->crc) {
+			*s->crc = sunxi_efex_crc32(*s->crc, buf, length);
+		}
+		sunxi_efex_progress(s->ctx, length);
+		s->addr += s->byte_addressed ? length : (length / 512);
+		buf += length;
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+static void sunxi_efex_fes_stream_init(struct sunxi_efex_fes_stream_t *s, const struct sunxi_efex_ctx_t *ctx,
+                                       const uint32_t addr, const enum sunxi_fes_data_type_t type,
+                                       const enum sunxi_efex_cmd_t cmd, uint32_t *crc) {
+	s->ctx = ctx;
+	s->cmd = cmd;
+	s->cls = cmd == EFEX_CMD_FES_DOWN ? SUNXI_EFEX_CHUNK_FES_DOWN : SUNXI_EFEX_CHUNK_FES_UP;
+	s->type = type;
+	s->byte_addressed = sunxi_efex_fes_byte_addressed(type, cmd);
+	s->addr = addr;
+	s->crc = crc;
+}
+
+int sunxi_efex_fes_down_stream(const struct sunxi_efex_ctx_t *ctx, const sunxi_efex_stream_reader_t reader, void *user,
+                               const uint64_t total_len, const uint32_t addr, const enum sunxi_fes_data_type_t type,
+                               uint32_t *crc) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	struct sunxi_efex_fes_stream_t s;
+	sunxi_efex_fes_stream_init(&s, ctx, addr, type, EFEX_CMD_FES_DOWN, crc);
+	return sunxi_efex_stream_down(reader, user, total_len, sunxi_efex_fes_stream_xfer, &s);
+}
+
+static int sunxi_efex_fes_up_stream_cmd(const struct sunxi_efex_ctx_t *ctx, const sunxi_efex_stream_writer_t writer,
+                                        void *user, const uint64_t total_len, const uint32_t addr,
+                                        const enum sunxi_fes_data_type_t type, const enum sunxi_efex_cmd_t cmd,
+                                        uint32_t *crc) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	struct sunxi_efex_fes_stream_t s;
+	sunxi_efex_fes_stream_init(&s, ctx, addr, type, cmd, crc);
+	return sunxi_efex_stream_up(writer, user, total_len, sunxi_efex_fes_stream_xfer, &s);
+}
+
+int sunxi_efex_fes_up_stream(const struct sunxi_efex_ctx_t *ctx, const sunxi_efex_stream_writer_t writer, void *user,
+                             const uint64_t total_len, const uint32_t addr, const enum sunxi_fes_data_type_t type,
+                             uint32_t *crc) {
+	return sunxi_efex_fes_up_stream_cmd(ctx, writer, user, total_len, addr, type, EFEX_CMD_FES_UP, crc);
+}
+
+int sunxi_efex_fes_nand_up_stream(const struct sunxi_efex_ctx_t *ctx, const sunxi_efex_stream_writer_t writer,
+                                  void *user, const uint64_t total_len, const uint32_t addr,
+                                  const enum sunxi_fes_data_type_t type, uint32_t *crc) {
+	return sunxi_efex_fes_up_stream_cmd(ctx, writer, user, total_len, addr, type, EFEX_CMD_FES_NAND, crc);
+}
+
+int sunxi_efex_fes_spinand_up_stream(const struct sunxi_efex_ctx_t *ctx, const sunxi_efex_stream_writer_t writer,
+                                     void *user, const uint64_t total_len, const uint32_t addr,
+                                     const enum sunxi_fes_data_type_t type, uint32_t *crc) {
+	return sunxi_efex_fes_up_stream_cmd(ctx, writer, user, total_len, addr, type, EFEX_CMD_FES_SPINAND, crc);
+}
+
+int sunxi_efex_fes_spinor_up_stream(const struct sunxi_efex_ctx_t *ctx, const sunxi_efex_stream_writer_t writer,
+                                    void *user, const uint64_t total_len, const uint32_t addr,
+                                    const enum sunxi_fes_data_type_t type, uint32_t *crc) {
+	return sunxi_efex_fes_up_stream_cmd(ctx, writer, user, total_len, addr, type, EFEX_CMD_FES_NOR, crc);
+}
+
+// A sparse download. Data is held back as a run until the next skip ends it, so the last chunk
+// actually sent is known and gets the finish tag.
+struct sunxi_efex_fes_sparse_t {
+	struct sunxi_efex_fes_stream_t s;
+	enum sunxi_efex_sparse_fill_t blank; // what the target holds where nothing is written
+	uint32_t base;                       // target address of the start of the image
+	uint64_t pos;                        // bytes of the image placed so far
+	const char *run;                     // data not sent yet
+	uint64_t run_pos;
+	uint64_t run_len;
+	uint64_t skipped;
+	uint64_t tail; // bytes skipped since the last data
+	bool want_crc;
+	bool crc_as_image; // crc still matches the image's own definition, DONT_CARE as zeros
+	uint32_t crc;
+	char *fill; // FILL pattern expanded, allocated on first use
+};
+
+static int sunxi_efex_fes_sparse_init(struct sunxi_efex_fes_sparse_t *sp, const struct sunxi_efex_ctx_t *ctx,
+                                      const uint32_t addr, const enum sunxi_fes_data_type_t type,
+                                      const enum sunxi_efex_sparse_fill_t blank, const uint32_t crc,
+                                      const bool want_crc) {
+	if (blank != SUNXI_EFEX_SPARSE_DATA && blank != SUNXI_EFEX_SPARSE_ZERO && blank != SUNXI_EFEX_SPARSE_ERASED) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+	memset(sp, 0, sizeof(*sp));
+	sunxi_efex_fes_stream_init(&sp->s, ctx, addr, type, EFEX_CMD_FES_DOWN, NULL);
+	sp->blank = blank;
+	sp->base = addr;
+	sp->want_crc = want_crc;
+	sp->crc_as_image = true;
+	sp->crc = crc;
+	return EFEX_ERR_SUCCESS;
+}
+
+static int sunxi_efex_fes_sparse_flush(struct sunxi_efex_fes_sparse_t *sp, const int last) {
+	while (sp->run_len > 0) {
+		const uint32_t n = sp->run_len > FES_SPARSE_MAX_RUN ? FES_SPARSE_MAX_RUN : (uint32_t) sp->run_len;
+		sp->s.addr = sp->base + (uint32_t) (sp->s.byte_addressed ? sp->run_pos : sp->run_pos / 512);
+		const int ret = sunxi_efex_fes_stream_xfer(&sp->s, (char *) sp->run, n, last && n == sp->run_len);
+		if (ret != EFEX_ERR_SUCCESS) {
+			return ret;
+		}
+		sp->run += n;
+		sp->run_pos += n;
+		sp->run_len -= n;
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+static int sunxi_efex_fes_sparse_data(struct sunxi_efex_fes_sparse_t *sp, const char *buf, const uint64_t len) {
+	// Data right behind the held back run, in memory and on the target, extends it
+	if (sp->run_len > 0 && (sp->run + sp->run_len != buf || sp->run_pos + sp->run_len != sp->pos)) {
+		const int ret = sunxi_efex_fes_sparse_flush(sp, 0);
+		if (ret != EFEX_ERR_SUCCESS) {
+			return ret;
+		}
+	}
+	if (sp->run_len == 0) {
+		sp->run = buf;
+		sp->run_pos = sp->pos;
+	}
+	sp->run_len += len;
+	sp->pos += len;
+	sp->tail = 0;
+	return EFEX_ERR_SUCCESS;
+}
+
+static void sunxi_efex_fes_sparse_skip(struct sunxi_efex_fes_sparse_t *sp, const uint64_t len) {
+	sp->pos += len;
+	sp->skipped += len;
+	sp->tail += len;
+	// Skipped bytes count as done, so progress still adds up to the image size
+	sunxi_efex_progress(sp->s.ctx, (size_t) len);
+}
+
+static int sunxi_efex_fes_sparse_raw(struct sunxi_efex_fes_sparse_t *sp, const char *buf, const uint64_t len) {
+	if (sp->want_crc) {
+		sp->crc = sunxi_efex_crc32(sp->crc, buf, (size_t) len);
+	}
+	if (sp->blank == SUNXI_EFEX_SPARSE_DATA) {
+		return sunxi_efex_fes_sparse_data(sp, buf, len);
+	}
+
+	uint64_t off = 0;
+	while (off < len) {
+		uint64_t end = off;
+		while (end < len) {
+			const uint64_t n = len - end < SUNXI_EFEX_SPARSE_BLOCK ? len - end : SUNXI_EFEX_SPARSE_BLOCK;
+			if (sunxi_efex_sparse_classify(buf + end, (size_t) n) != sp->blank) {
+				break;
+			}
+			end += n;
+		}
+		if (end - off >= SUNXI_EFEX_SPARSE_MIN_SKIP) {
+			sunxi_efex_fes_sparse_skip(sp, end - off);
+		} else {
+			// A blank run too short to skip goes out with the data block after it
+			end += len - end < SUNXI_EFEX_SPARSE_BLOCK ? len - end : SUNXI_EFEX_SPARSE_BLOCK;
+			const int ret = sunxi_efex_fes_sparse_data(sp, buf + off, end - off);
+			if (ret != EFEX_ERR_SUCCESS) {
+				return ret;
+			}
+		}
+		off = end;
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+// Expands a 32-bit pattern into the fill buffer, which must not be part of a held back run then
+static int sunxi_efex_fes_sparse_pattern(struct sunxi_efex_fes_sparse_t *sp, const uint32_t value) {
+	int ret = sunxi_efex_fes_sparse_flush(sp, 0);
+	if (ret != EFEX_ERR_SUCCESS) {
+		return ret;
+	}
+	if (!sp->fill) {
+		sp->fill = malloc(SUNXI_EFEX_SPARSE_FILL_SIZE);
+		if (!sp->fill) {
+			return EFEX_ERR_MEMORY;
+		}
+	}
+	for (size_t i = 0; i < SUNXI_EFEX_SPARSE_FILL_SIZE; i += sizeof(value)) {
+		memcpy(sp->fill + i, &value, sizeof(value));
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+static void sunxi_efex_fes_sparse_crc_fill(struct sunxi_efex_fes_sparse_t *sp, uint64_t len) {
+	while (sp->want_crc && len > 0) {
+		const size_t n = len > SUNXI_EFEX_SPARSE_FILL_SIZE ? SUNXI_EFEX_SPARSE_FILL_SIZE : (size_t) len;
+		sp->crc = sunxi_efex_crc32(sp->crc, sp->fill, n);
+		len -= n;
+	}
+}
+
+static int sunxi_efex_fes_sparse_fill(struct sunxi_efex_fes_sparse_t *sp, const uint32_t value, uint64_t len) {
+	enum sunxi_efex_sparse_fill_t kind = SUNXI_EFEX_SPARSE_DATA;
+	if (value == 0) {
+		kind = SUNXI_EFEX_SPARSE_ZERO;
+	} else if (value == ~0U) {
+		kind = SUNXI_EFEX_SPARSE_ERASED;
+	}
+	int ret = sunxi_efex_fes_sparse_pattern(sp, value);
+	if (ret != EFEX_ERR_SUCCESS) {
+		return ret;
+	}
+	sunxi_efex_fes_sparse_crc_fill(sp, len);
+	if (kind == sp->blank && kind != SUNXI_EFEX_SPARSE_DATA && len >= SUNXI_EFEX_SPARSE_MIN_SKIP) {
+		sunxi_efex_fes_sparse_skip(sp, len);
+		return EFEX_ERR_SUCCESS;
+	}
+	while (len > 0) {
+		const uint64_t n = len > SUNXI_EFEX_SPARSE_FILL_SIZE ? SUNXI_EFEX_SPARSE_FILL_SIZE : len;
+		ret = sunxi_efex_fes_sparse_data(sp, sp->fill, n);
+		if (ret != EFEX_ERR_SUCCESS) {
+			return ret;
+		}
+		len -= n;
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+static int sunxi_efex_fes_sparse_dont_care(struct sunxi_efex_fes_sparse_t *sp, const uint64_t len) {
+	// Never written; the CRC counts what the target is assumed to hold there
+	if (sp->want_crc) {
+		const int ret = sunxi_efex_fes_sparse_pattern(sp, sp->blank == SUNXI_EFEX_SPARSE_ERASED ? ~0U : 0);
+		if (ret != EFEX_ERR_SUCCESS) {
+			return ret;
+		}
+		sunxi_efex_fes_sparse_crc_fill(sp, len);
+		if (sp->blank == SUNXI_EFEX_SPARSE_ERASED && len > 0) {
+			sp->crc_as_image = false;
+		}
+	}
+	sunxi_efex_fes_sparse_skip(sp, len);
+	return EFEX_ERR_SUCCESS;
+}
+
+// An image ending in a skip leaves nothing held back, so the blank pattern is written over the end of
+// the skip to carry the finish tag. Sector-addressed skips are whole sectors or SUNXI_EFEX_SPARSE_MIN_SKIP
+// long, so rounding up to a sector keeps the write inside the skip.
+static int sunxi_efex_fes_sparse_end(struct sunxi_efex_fes_sparse_t *sp) {
+	uint64_t start = sp->pos - (sp->tail < SUNXI_EFEX_SPARSE_BLOCK ? sp->tail : SUNXI_EFEX_SPARSE_BLOCK);
+	if (!sp->s.byte_addressed) {
+		start = (start + 511) & ~(uint64_t) 511;
+	}
+	int ret = sunxi_efex_fes_sparse_pattern(sp, sp->blank == SUNXI_EFEX_SPARSE_ERASED ? ~0U : 0);
+	if (ret != EFEX_ERR_SUCCESS) {
+		return ret;
+	}
+	const uint32_t len = (uint32_t) (sp->pos - start);
+	const uint32_t addr = sp->base + (uint32_t) (sp->s.byte_addressed ? start : start / 512);
+	ret = sunxi_efex_fes_chunk(sp->s.ctx, sp->s.cmd, sp->s.cls, addr, sp->fill, len,
+	                           sp->s.type | SUNXI_EFEX_TRANS_FINISH_TAG);
+	if (ret == EFEX_ERR_SUCCESS) {
+		sp->skipped -= len;
+	}
+	return ret;
+}
+
+static int sunxi_efex_fes_sparse_finish(struct sunxi_efex_fes_sparse_t *sp, int ret, uint32_t *crc,
+                                        uint64_t *skipped) {
+	if (ret == EFEX_ERR_SUCCESS) {
+		ret = sp->run_len == 0 && sp->tail > 0 ? sunxi_efex_fes_sparse_end(sp) : sunxi_efex_fes_sparse_flush(sp, 1);
+	}
+	if (ret == EFEX_ERR_SUCCESS && crc) {
+		*crc = sp->crc;
+	}
+	if (skipped) {
+		*skipped = sp->skipped;
+	}
+	free(sp->fill);
+	return ret;
+}
+
+int sunxi_efex_fes_down_sparse(const struct sunxi_efex_ctx_t *ctx, const char *buf, const uint64_t len,
+                               const uint32_t addr, const enum sunxi_fes_data_type_t type,
+                               const enum sunxi_efex_sparse_fill_t blank, uint32_t *crc, uint64_t *skipped) {
+	if (!ctx || !buf) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	if (len == 0 || len > SIZE_MAX) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+	struct sunxi_efex_fes_sparse_t sp;
+	const int ret = sunxi_efex_fes_sparse_init(&sp, ctx, addr, type, blank, crc ? *crc : 0, crc != NULL);
+	if (ret != EFEX_ERR_SUCCESS) {
+		return ret;
+	}
+	return sunxi_efex_fes_sparse_finish(&sp, sunxi_efex_fes_sparse_raw(&sp, buf, len), crc, skipped);
+}
+
+int sunxi_efex_fes_down_simg(const struct sunxi_efex_ctx_t *ctx, const char *data, const uint64_t size,
+                             const uint32_t addr, const enum sunxi_fes_data_type_t type,
+                             const enum sunxi_efex_sparse_fill_t blank, uint32_t *crc, uint64_t *skipped) {
+	if (!ctx || !data) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	struct sunxi_efex_simg_t simg;
+	int ret = sunxi_efex_simg_open(&simg, data, size);
+	if (ret != EFEX_ERR_SUCCESS) {
+		return ret;
+	}
+	struct sunxi_efex_fes_sparse_t sp;
+	ret = sunxi_efex_fes_sparse_init(&sp, ctx, addr, type, blank, 0, crc != NULL);
+	if (ret != EFEX_ERR_SUCCESS) {
+		return ret;
+	}
+	// Sector-addressed targets can only start a run on a sector
+	if (!sp.s.byte_addressed && simg.blk_sz % 512 != 0) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+
+	struct sunxi_efex_simg_chunk_t chunk;
+	while ((ret = sunxi_efex_simg_next(&simg, &chunk)) > 0) {
+		switch (chunk.type) {
+			case SUNXI_EFEX_SIMG_RAW:
+				ret = sunxi_efex_fes_sparse_raw(&sp, chunk.data, chunk.len);
+				break;
+			case SUNXI_EFEX_SIMG_FILL:
+				ret = sunxi_efex_fes_sparse_fill(&sp, chunk.value, chunk.len);
+				break;
+			case SUNXI_EFEX_SIMG_DONT_CARE:
+				ret = sunxi_efex_fes_sparse_dont_care(&sp, chunk.len);
+				break;
+			case SUNXI_EFEX_SIMG_CRC32:
+				ret = sp.want_crc && sp.crc_as_image && chunk.value != sp.crc ? EFEX_ERR_CRC_MISMATCH
+				                                                              : EFEX_ERR_SUCCESS;
+				break;
+		}
+		if (ret != EFEX_ERR_SUCCESS) {
+			break;
+		}
+	}
+	return sunxi_efex_fes_sparse_finish(&sp, ret, crc, skipped);
 }
 
 int sunxi_efex_fes_nand_up(const struct sunxi_efex_ctx_t *ctx, const char *buf, const ssize_t len, const uint32_t addr,
                            const enum sunxi_fes_data_type_t type) {
-	return sunxi_efex_fes_up_down(ctx, buf, len, addr, type, EFEX_CMD_FES_NAND);
+	return sunxi_efex_fes_up_down(ctx, buf, len, addr, type, EFEX_CMD_FES_NAND, NULL);
 }
 
 int sunxi_efex_fes_spinand_up(const struct sunxi_efex_ctx_t *ctx, const char *buf, const ssize_t len,
                               const uint32_t addr, const enum sunxi_fes_data_type_t type) {
-	return sunxi_efex_fes_up_down(ctx, buf, len, addr, type, EFEX_CMD_FES_SPINAND);
+	return sunxi_efex_fes_up_down(ctx, buf, len, addr, type, EFEX_CMD_FES_SPINAND, NULL);
 }
 
 int sunxi_efex_fes_spinor_up(const struct sunxi_efex_ctx_t *ctx, const char *buf, const ssize_t len,
                              const uint32_t addr, const enum sunxi_fes_data_type_t type) {
-	return sunxi_efex_fes_up_down(ctx, buf, len, addr, type, EFEX_CMD_FES_NOR);
+	return sunxi_efex_fes_up_down(ctx, buf, len, addr, type, EFEX_CMD_FES_NOR, NULL);
 }
 
 int sunxi_efex_fes_verify_value(const struct sunxi_efex_ctx_t *ctx, const uint32_t addr, const uint64_t size,
@@ -0,0 +1,154 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "efex-image.h"
+#include "efex-protocol.h"
+
+#ifdef _WIN32
+static int sunxi_efex_image_read(struct sunxi_efex_image_t *img, const HANDLE file) {
+	img->data = malloc((size_t) img->size);
+	if (!img->data) {
+		return EFEX_ERR_MEMORY;
+	}
+	for (uint64_t done = 0; done < img->size;) {
+		const uint64_t left = img->size - done;
+		const DWORD want = left > 0x40000000 ? 0x40000000 : (DWORD) left;
+		DWORD got = 0;
+		if (!ReadFile(file, img->data + done, want, &got, NULL) || got == 0) {
+			free(img->data);
+			img->data = NULL;
+			return EFEX_ERR_FILE_READ;
+		}
+		done += got;
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+int sunxi_efex_image_open(struct sunxi_efex_image_t *img, const char *path) {
+	if (!img || !path) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	memset(img, 0, sizeof(*img));
+
+	const HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                                FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return EFEX_ERR_FILE_OPEN;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0 || (uint64_t) size.QuadPart > SIZE_MAX) {
+		CloseHandle(file);
+		return EFEX_ERR_FILE_SIZE;
+	}
+	img->size = (uint64_t) size.QuadPart;
+
+	// The view keeps the mapping alive after both handles are closed
+	int ret = EFEX_ERR_SUCCESS;
+	const HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if (mapping) {
+		img->data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+		CloseHandle(mapping);
+	}
+	if (img->data) {
+		img->mapped = 1;
+	} else {
+		ret = sunxi_efex_image_read(img, file);
+	}
+	CloseHandle(file);
+	if (ret != EFEX_ERR_SUCCESS) {
+		img->size = 0;
+	}
+	return ret;
+}
+
+void sunxi_efex_image_close(struct sunxi_efex_image_t *img) {
+	if (!img || !img->data) {
+		return;
+	}
+	if (img->mapped) {
+		UnmapViewOfFile(img->data);
+	} else {
+		free(img->data);
+	}
+	memset(img, 0, sizeof(*img));
+}
+#else
+static int sunxi_efex_image_read(struct sunxi_efex_image_t *img, const int fd) {
+	img->data = malloc((size_t) img->size);
+	if (!img->data) {
+		return EFEX_ERR_MEMORY;
+	}
+	for (uint64_t done = 0; done < img->size;) {
+		const ssize_t got = read(fd, img->data + done, (size_t) (img->size - done));
+		if (got < 0 && errno == EINTR) {
+			continue;
+		}
+		if (got <= 0) {
+			free(img->data);
+			img->data = NULL;
+			return EFEX_ERR_FILE_READ;
+		}
+		done += (uint64_t) got;
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+int sunxi_efex_image_open(struct sunxi_efex_image_t *img, const char *path) {
+	if (!img || !path) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	memset(img, 0, sizeof(*img));
+
+	const int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return EFEX_ERR_FILE_OPEN;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0 || (uint64_t) st.st_size > SIZE_MAX) {
+		close(fd);
+		return EFEX_ERR_FILE_SIZE;
+	}
+	img->size = (uint64_t) st.st_size;
+
+	// Private and writable: a patched header costs one copied page, the file stays as it is
+	int ret = EFEX_ERR_SUCCESS;
+	void *p = mmap(NULL, (size_t) img->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (p != MAP_FAILED) {
+		img->data = p;
+		img->mapped = 1;
+		madvise(p, (size_t) img->size, MADV_SEQUENTIAL);
+		madvise(p, img->size < SUNXI_EFEX_IMAGE_PREFETCH ? (size_t) img->size : SUNXI_EFEX_IMAGE_PREFETCH,
+		        MADV_WILLNEED);
+	} else {
+		ret = sunxi_efex_image_read(img, fd);
+	}
+	close(fd);
+	if (ret != EFEX_ERR_SUCCESS) {
+		img->size = 0;
+	}
+	return ret;
+}
+
+void sunxi_efex_image_close(struct sunxi_efex_image_t *img) {
+	if (!img || !img->data) {
+		return;
+	}
+	if (img->mapped) {
+		munmap(img->data, (size_t) img->size);
+	} else {
+		free(img->data);
+	}
+	memset(img, 0, sizeof(*img));
+}
+#endif
@@ -0,0 +1,219 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "efex-chunk.h"
+#include "efex-common.h"
+#include "efex-fel.h"
+#include "efex-fes.h"
+#include "efex-multi.h"
+#include "efex-protocol.h"
+#include "efex-thread.h"
+#include "efex-usb.h"
+#include "usb_layer.h"
+
+struct sunxi_efex_multi_run_t {
+	const struct sunxi_efex_multi_job_t *job;
+	struct sunxi_efex_multi_device_t *devices;
+	size_t count;
+	size_t next;              // next device to hand to a worker
+	sunxi_efex_mutex_t lock;  // guards next and serializes on_progress
+};
+
+static void sunxi_efex_multi_report(struct sunxi_efex_multi_run_t *run, const struct sunxi_efex_multi_device_t *dev) {
+	if (!run->job->on_progress)
+		return;
+	sunxi_efex_mutex_lock(&run->lock);
+	run->job->on_progress(dev, run->job->arg);
+	sunxi_efex_mutex_unlock(&run->lock);
+}
+
+struct sunxi_efex_multi_worker_t {
+	struct sunxi_efex_multi_run_t *run;
+	struct sunxi_efex_multi_device_t *dev;
+};
+
+static void sunxi_efex_multi_progress(const struct sunxi_efex_ctx_t *ctx, const size_t done, void *arg) {
+	(void) ctx;
+	const struct sunxi_efex_multi_worker_t *w = arg;
+	w->dev->done += done;
+	sunxi_efex_multi_report(w->run, w->dev);
+}
+
+static int sunxi_efex_multi_job(struct sunxi_efex_ctx_t *ctx, const struct sunxi_efex_multi_job_t *job,
+                                struct sunxi_efex_multi_device_t *dev) {
+	switch (job->type) {
+		case SUNXI_EFEX_MULTI_FEL_BOOT: {
+			if (ctx->resp.mode != DEVICE_MODE_FEL)
+				return EFEX_ERR_INVALID_DEVICE_MODE;
+			const int ret = sunxi_efex_fel_write(ctx, job->addr, job->data, (ssize_t) job->len);
+			if (ret != EFEX_ERR_SUCCESS)
+				return ret;
+			return sunxi_efex_fel_exec(ctx, job->addr);
+		}
+		case SUNXI_EFEX_MULTI_FES_FLASH:
+			if (ctx->resp.mode != DEVICE_MODE_SRV)
+				return EFEX_ERR_INVALID_DEVICE_MODE;
+			return sunxi_efex_fes_down(ctx, job->data, (ssize_t) job->len, job->addr, job->fes_type);
+		case SUNXI_EFEX_MULTI_DUMP:
+			dev->dump = malloc(job->len);
+			if (!dev->dump)
+				return EFEX_ERR_MEMORY;
+			if (ctx->resp.mode == DEVICE_MODE_FEL)
+				return sunxi_efex_fel_read(ctx, job->addr, dev->dump, (ssize_t) job->len);
+			if (ctx->resp.mode == DEVICE_MODE_SRV)
+				return sunxi_efex_fes_up(ctx, dev->dump, (ssize_t) job->len, job->addr, job->fes_type);
+			return EFEX_ERR_INVALID_DEVICE_MODE;
+		case SUNXI_EFEX_MULTI_CUSTOM:
+			return job->run(ctx, dev, job->arg);
+		default:
+			return EFEX_ERR_INVALID_PARAM;
+	}
+}
+
+static void sunxi_efex_multi_device(struct sunxi_efex_multi_run_t *run, struct sunxi_efex_multi_device_t *dev) {
+	const struct sunxi_efex_multi_job_t *job = run->job;
+	struct sunxi_efex_multi_worker_t w = {
+			.run = run,
+			.dev = dev,
+	};
+	struct sunxi_efex_ctx_t ctx = {0};
+	const uint64_t start = sunxi_efex_time_us();
+
+	dev->state = SUNXI_EFEX_MULTI_RUNNING;
+	sunxi_efex_multi_report(run, dev);
+
+	int ret = sunxi_scan_usb_device_at(&ctx, dev->bus, dev->port);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_usb_init(&ctx);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_init(&ctx);
+	if (ret == EFEX_ERR_SUCCESS) {
+		dev->mode = ctx.resp.mode;
+		sunxi_efex_set_progress(&ctx, sunxi_efex_multi_progress, &w);
+		if (job->setup)
+			ret = job->setup(&ctx, dev, job->arg);
+	}
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_multi_job(&ctx, job, dev);
+	sunxi_usb_exit(&ctx);
+
+	dev->elapsed_us = sunxi_efex_time_us() - start;
+	dev->result = ret;
+	dev->state = ret == EFEX_ERR_SUCCESS ? SUNXI_EFEX_MULTI_DONE : SUNXI_EFEX_MULTI_FAILED;
+	sunxi_efex_multi_report(run, dev);
+}
+
+static void *sunxi_efex_multi_worker(void *arg) {
+	struct sunxi_efex_multi_run_t *run = arg;
+
+	for (;;) {
+		sunxi_efex_mutex_lock(&run->lock);
+		const size_t idx = run->next < run->count ? run->next++ : run->count;
+		sunxi_efex_mutex_unlock(&run->lock);
+
+		if (idx == run->count)
+			return NULL;
+		sunxi_efex_multi_device(run, &run->devices[idx]);
+	}
+}
+
+static int sunxi_efex_multi_check_job(const struct sunxi_efex_multi_job_t *job) {
+	switch (job->type) {
+		case SUNXI_EFEX_MULTI_FEL_BOOT:
+		case SUNXI_EFEX_MULTI_FES_FLASH:
+			return job->data && job->len > 0 ? EFEX_ERR_SUCCESS : EFEX_ERR_INVALID_PARAM;
+		case SUNXI_EFEX_MULTI_DUMP:
+			return job->len > 0 ? EFEX_ERR_SUCCESS : EFEX_ERR_INVALID_PARAM;
+		case SUNXI_EFEX_MULTI_CUSTOM:
+			return job->run ? EFEX_ERR_SUCCESS : EFEX_ERR_INVALID_PARAM;
+		default:
+			return EFEX_ERR_INVALID_PARAM;
+	}
+}
+
+int sunxi_efex_multi_run(const struct sunxi_efex_multi_job_t *job, const struct sunxi_scanned_device_t *targets,
+                         size_t target_count, int workers, struct sunxi_efex_multi_device_t **devices,
+                         size_t *count) {
+	if (!job || !devices || !count) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	*devices = NULL;
+	*count = 0;
+
+	int ret = sunxi_efex_multi_check_job(job);
+	if (ret != EFEX_ERR_SUCCESS) {
+		return ret;
+	}
+
+	struct sunxi_scanned_device_t *scanned = NULL;
+	if (!targets) {
+		ret = sunxi_scan_usb_devices(&scanned, &target_count);
+		if (ret != EFEX_ERR_SUCCESS) {
+			return ret;
+		}
+		targets = scanned;
+	}
+	if (target_count == 0) {
+		free(scanned);
+		return EFEX_ERR_USB_DEVICE_NOT_FOUND;
+	}
+
+	struct sunxi_efex_multi_run_t run = {
+			.job = job,
+			.count = target_count,
+	};
+	sunxi_efex_mutex_init(&run.lock);
+
+	run.devices = calloc(target_count, sizeof(*run.devices));
+	if (!run.devices) {
+		free(scanned);
+		sunxi_efex_mutex_destroy(&run.lock);
+		return EFEX_ERR_MEMORY;
+	}
+	for (size_t i = 0; i < target_count; i++) {
+		run.devices[i].bus = targets[i].bus;
+		run.devices[i].port = targets[i].port;
+		run.devices[i].result = EFEX_ERR_SUCCESS;
+		if (job->type != SUNXI_EFEX_MULTI_CUSTOM)
+			run.devices[i].total = job->len;
+	}
+	free(scanned);
+
+	size_t nworkers = workers > 0 ? (size_t) workers : target_count;
+	if (nworkers > target_count)
+		nworkers = target_count;
+	if (nworkers > SUNXI_EFEX_MULTI_MAX_WORKERS)
+		nworkers = SUNXI_EFEX_MULTI_MAX_WORKERS;
+
+	sunxi_efex_thread_t threads[SUNXI_EFEX_MULTI_MAX_WORKERS];
+	size_t started = 0;
+	while (started < nworkers && sunxi_efex_thread_create(&threads[started], sunxi_efex_multi_worker, &run) == 0)
+		started++;
+
+	// Could not start a single thread: the calling thread does the work alone
+	if (started == 0)
+		sunxi_efex_multi_worker(&run);
+	for (size_t i = 0; i < started; i++)
+		sunxi_efex_thread_join(threads[i]);
+	sunxi_efex_mutex_destroy(&run.lock);
+
+	ret = EFEX_ERR_SUCCESS;
+	for (size_t i = 0; i < target_count && ret == EFEX_ERR_SUCCESS; i++)
+		ret = run.devices[i].result;
+
+	*devices = run.devices;
+	*count = target_count;
+	return ret;
+}
+
+void sunxi_efex_multi_free(struct sunxi_efex_multi_device_t *devices, const size_t count) {
+	if (!devices) {
+		return;
+	}
+
+	for (size_t i = 0; i < count; i++)
+		free(devices[i].dump);
+	free(devices);
+}
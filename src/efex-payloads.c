@@ -5,6 +5,7 @@
 
 
 #include "efex-common.h"
+#include "efex-fel.h"
 #include "efex-payloads.h"
 #include "efex-protocol.h"
 
@@ -19,21 +20,66 @@ static struct payloads_ops *payloads[] = {
 		&riscv_ops,
 };
 
+// Only the default for contexts that did not select payloads themselves
 static struct payloads_ops *current_payload;
 
-int sunxi_efex_fel_payloads_init(const enum sunxi_efex_fel_payloads_arch arch) {
+// Longest code whose residency is tracked, longer payloads are uploaded on every call
+#define PAYLOAD_CODE_MAX (1024)
+
+// Code loaded in one slot above the data start address, len 0 when the slot is free
+struct sunxi_efex_payload_slot_t {
+	size_t len;
+	uint32_t code[PAYLOAD_CODE_MAX / 4];
+};
+
+// The small slots, then the area for payloads with bulk parameters
+struct sunxi_efex_payload_cache_t {
+	uint32_t base; // data start address the slots were laid out from
+	unsigned int next; // small slot replaced on the next miss
+	struct sunxi_efex_payload_slot_t slots[SUNXI_EFEX_PAYLOAD_SLOTS + 1];
+};
+
+static struct payloads_ops *sunxi_efex_fel_payloads_find(const enum sunxi_efex_fel_payloads_arch arch) {
 	for (size_t i = 0; i < sizeof(payloads) / sizeof(payloads[0]); ++i) {
 		struct payloads_ops *p = payloads[i];
 		if (p->arch == arch) {
-			current_payload = p;
-			return EFEX_ERR_SUCCESS;
+			return p;
 		}
 	}
-	return EFEX_ERR_INVALID_PARAM;
+	return NULL;
+}
+
+int sunxi_efex_fel_payloads_init(const enum sunxi_efex_fel_payloads_arch arch) {
+	struct payloads_ops *p = sunxi_efex_fel_payloads_find(arch);
+	if (!p) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+	current_payload = p;
+	return EFEX_ERR_SUCCESS;
+}
+
+int sunxi_efex_fel_payloads_select(struct sunxi_efex_ctx_t *ctx, const enum sunxi_efex_fel_payloads_arch arch) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	const struct payloads_ops *p = sunxi_efex_fel_payloads_find(arch);
+	if (!p) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+	ctx->payload = p;
+	return EFEX_ERR_SUCCESS;
 }
 
 struct payloads_ops *sunxi_efex_fel_get_current_payload() { return current_payload; }
 
+const struct payloads_ops *sunxi_efex_fel_get_payload(const struct sunxi_efex_ctx_t *ctx) {
+	if (ctx && ctx->payload) {
+		return ctx->payload;
+	}
+	return current_payload;
+}
+
 int sunxi_efex_fel_payloads_readl(const struct sunxi_efex_ctx_t *ctx, const uint32_t addr, uint32_t *val) {
 	if (!ctx || !val) {
 		return EFEX_ERR_NULL_PTR;
@@ -41,10 +87,11 @@ int sunxi_efex_fel_payloads_readl(const struct sunxi_efex_ctx_t *ctx, const uint
 	if (ctx->resp.mode != DEVICE_MODE_FEL) {
 		return EFEX_ERR_INVALID_DEVICE_MODE;
 	}
-	if (!current_payload || !current_payload->readl) {
+	const struct payloads_ops *payload = sunxi_efex_fel_get_payload(ctx);
+	if (!payload || !payload->readl) {
 		return EFEX_ERR_NOT_SUPPORT;
 	}
-	return current_payload->readl(ctx, addr, val);
+	return payload->readl(ctx, addr, val);
 }
 
 int sunxi_efex_fel_payloads_writel(const struct sunxi_efex_ctx_t *ctx, const uint32_t value, const uint32_t addr) {
@@ -54,8 +101,268 @@ int sunxi_efex_fel_payloads_writel(const struct sunxi_efex_ctx_t *ctx, const uin
 	if (ctx->resp.mode != DEVICE_MODE_FEL) {
 		return EFEX_ERR_INVALID_DEVICE_MODE;
 	}
-	if (!current_payload || !current_payload->writel) {
+	const struct payloads_ops *payload = sunxi_efex_fel_get_payload(ctx);
+	if (!payload || !payload->writel) {
+		return EFEX_ERR_NOT_SUPPORT;
+	}
+	// The store may land on resident code, drop it even when the run failed
+	const int ret = payload->writel(ctx, value, addr);
+	sunxi_efex_fel_payloads_invalidate(ctx, addr, sizeof(uint32_t));
+	return ret;
+}
+
+// Each payload run takes up to SUNXI_EFEX_PAYLOAD_BATCH_MAX entries
+int sunxi_efex_fel_payloads_readl_batch(const struct sunxi_efex_ctx_t *ctx, const uint32_t *addrs, uint32_t *vals,
+                                        const size_t count) {
+	if (!ctx || (count && (!addrs || !vals))) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	if (ctx->resp.mode != DEVICE_MODE_FEL) {
+		return EFEX_ERR_INVALID_DEVICE_MODE;
+	}
+	const struct payloads_ops *payload = sunxi_efex_fel_get_payload(ctx);
+	if (!payload || !payload->readl_batch) {
 		return EFEX_ERR_NOT_SUPPORT;
 	}
-	return current_payload->writel(ctx, value, addr);
+
+	int ret = EFEX_ERR_SUCCESS;
+
+	for (size_t done = 0; done < count && ret == EFEX_ERR_SUCCESS;) {
+		const size_t n = count - done < SUNXI_EFEX_PAYLOAD_BATCH_MAX ? count - done : SUNXI_EFEX_PAYLOAD_BATCH_MAX;
+		ret = payload->readl_batch(ctx, addrs + done, vals + done, n);
+		done += n;
+	}
+	return ret;
+}
+
+int sunxi_efex_fel_payloads_writel_batch(const struct sunxi_efex_ctx_t *ctx, const uint32_t *addrs,
+                                         const uint32_t *vals, const size_t count) {
+	if (!ctx || (count && (!addrs || !vals))) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	if (ctx->resp.mode != DEVICE_MODE_FEL) {
+		return EFEX_ERR_INVALID_DEVICE_MODE;
+	}
+	const struct payloads_ops *payload = sunxi_efex_fel_get_payload(ctx);
+	if (!payload || !payload->writel_batch) {
+		return EFEX_ERR_NOT_SUPPORT;
+	}
+
+	int ret = EFEX_ERR_SUCCESS;
+
+	for (size_t done = 0; done < count && ret == EFEX_ERR_SUCCESS;) {
+		const size_t n = count - done < SUNXI_EFEX_PAYLOAD_BATCH_MAX ? count - done : SUNXI_EFEX_PAYLOAD_BATCH_MAX;
+		ret = payload->writel_batch(ctx, addrs + done, vals + done, n);
+		for (size_t i = done; i < done + n; i++)
+			sunxi_efex_fel_payloads_invalidate(ctx, addrs[i], sizeof(uint32_t));
+		done += n;
+	}
+	return ret;
+}
+
+// Whether a range overlaps the slots and the area the payloads run from
+static int payloads_overlap(const struct sunxi_efex_ctx_t *ctx, const uint32_t addr, const uint32_t len) {
+	const uint64_t base = ctx->resp.data_start_address;
+	const uint64_t end = base + SUNXI_EFEX_PAYLOAD_FOOTPRINT;
+	return len && addr < end && (uint64_t) addr + len > base;
+}
+
+int sunxi_efex_fel_memset(const struct sunxi_efex_ctx_t *ctx, const uint32_t addr, const uint8_t value,
+                          const uint32_t len) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	if (ctx->resp.mode != DEVICE_MODE_FEL) {
+		return EFEX_ERR_INVALID_DEVICE_MODE;
+	}
+	if ((uint64_t) addr + len > 0x100000000ULL || payloads_overlap(ctx, addr, len)) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+	const struct payloads_ops *payload = sunxi_efex_fel_get_payload(ctx);
+	if (!payload || !payload->fill) {
+		return EFEX_ERR_NOT_SUPPORT;
+	}
+
+	const uint32_t pattern = value * 0x01010101U;
+	int ret = EFEX_ERR_SUCCESS;
+
+	for (uint32_t done = 0; done < len && ret == EFEX_ERR_SUCCESS;) {
+		const uint32_t n = len - done < SUNXI_EFEX_PAYLOAD_MEM_CHUNK ? len - done : SUNXI_EFEX_PAYLOAD_MEM_CHUNK;
+		ret = payload->fill(ctx, addr + done, pattern, n);
+		done += n;
+	}
+	return ret;
+}
+
+int sunxi_efex_fel_memcpy(const struct sunxi_efex_ctx_t *ctx, const uint32_t dst, const uint32_t src,
+                          const uint32_t len) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	if (ctx->resp.mode != DEVICE_MODE_FEL) {
+		return EFEX_ERR_INVALID_DEVICE_MODE;
+	}
+	if ((uint64_t) dst + len > 0x100000000ULL || (uint64_t) src + len > 0x100000000ULL) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+	if ((len && dst < (uint64_t) src + len && src < (uint64_t) dst + len) || payloads_overlap(ctx, dst, len) ||
+	    payloads_overlap(ctx, src, len)) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+	const struct payloads_ops *payload = sunxi_efex_fel_get_payload(ctx);
+	if (!payload || !payload->copy) {
+		return EFEX_ERR_NOT_SUPPORT;
+	}
+
+	int ret = EFEX_ERR_SUCCESS;
+
+	for (uint32_t done = 0; done < len && ret == EFEX_ERR_SUCCESS;) {
+		const uint32_t n = len - done < SUNXI_EFEX_PAYLOAD_MEM_CHUNK ? len - done : SUNXI_EFEX_PAYLOAD_MEM_CHUNK;
+		ret = payload->copy(ctx, dst + done, src + done, n);
+		done += n;
+	}
+	return ret;
+}
+
+int sunxi_efex_fel_crc32(const struct sunxi_efex_ctx_t *ctx, const uint32_t addr, const uint32_t len, uint32_t *crc) {
+	if (!ctx || !crc) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	if (ctx->resp.mode != DEVICE_MODE_FEL) {
+		return EFEX_ERR_INVALID_DEVICE_MODE;
+	}
+	if ((uint64_t) addr + len > 0x100000000ULL || payloads_overlap(ctx, addr, len)) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+	const struct payloads_ops *payload = sunxi_efex_fel_get_payload(ctx);
+	if (!payload || !payload->crc32) {
+		return EFEX_ERR_NOT_SUPPORT;
+	}
+
+	// Each run continues the CRC of the previous one
+	uint32_t value = 0;
+	int ret = EFEX_ERR_SUCCESS;
+
+	for (uint32_t done = 0; done < len && ret == EFEX_ERR_SUCCESS;) {
+		const uint32_t n = len - done < SUNXI_EFEX_PAYLOAD_MEM_CHUNK ? len - done : SUNXI_EFEX_PAYLOAD_MEM_CHUNK;
+		ret = payload->crc32(ctx, addr + done, n, value, &value);
+		done += n;
+	}
+	if (ret == EFEX_ERR_SUCCESS) {
+		*crc = value;
+	}
+	return ret;
+}
+
+int sunxi_efex_fel_payloads_run(const struct sunxi_efex_ctx_t *ctx, const uint32_t *code, const size_t code_len,
+                                const void *params, const size_t params_len, void *result, const size_t result_len) {
+	if (!ctx || !code || (params_len && !params) || (result_len && !result)) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	const size_t total = code_len + params_len + result_len;
+	if (code_len == 0 || code_len % 4 || total > SUNXI_EFEX_PAYLOAD_AREA_SIZE) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+
+	struct sunxi_efex_payload_cache_t *cache = ctx->payload_cache;
+	if (cache && cache->base != ctx->resp.data_start_address) {
+		cache = NULL;
+	}
+
+	// Small payloads share the slots, anything larger goes to the area behind them
+	const int large = total > SUNXI_EFEX_PAYLOAD_SLOT_SIZE;
+	unsigned int idx = large ? SUNXI_EFEX_PAYLOAD_SLOTS : 0;
+	struct sunxi_efex_payload_slot_t *slot = NULL;
+	if (cache) {
+		const unsigned int first = idx, last = large ? SUNXI_EFEX_PAYLOAD_SLOTS : SUNXI_EFEX_PAYLOAD_SLOTS - 1;
+		for (unsigned int i = first; i <= last && !slot; i++) {
+			if (cache->slots[i].len == code_len && memcmp(cache->slots[i].code, code, code_len) == 0) {
+				idx = i;
+				slot = &cache->slots[i];
+			}
+		}
+		if (!slot && !large) {
+			idx = cache->next;
+			cache->next = (cache->next + 1) % SUNXI_EFEX_PAYLOAD_SLOTS;
+		}
+	}
+
+	const uint32_t entry = ctx->resp.data_start_address + idx * SUNXI_EFEX_PAYLOAD_SLOT_SIZE;
+	int ret;
+	if (slot) {
+		ret = params_len ? sunxi_efex_fel_write_unverified(ctx, entry + (uint32_t) code_len, params,
+		                                                   (ssize_t) params_len)
+		                 : EFEX_ERR_SUCCESS;
+	} else {
+		// Code and parameters in one write; the write itself drops whatever was in the slot. Payload writes are
+		// not verified, the verification runs payloads itself
+		uint8_t image[SUNXI_EFEX_PAYLOAD_AREA_SIZE];
+		memcpy(image, code, code_len);
+		if (params_len)
+			memcpy(image + code_len, params, params_len);
+		ret = sunxi_efex_fel_write_unverified(ctx, entry, (const char *) image, (ssize_t) (code_len + params_len));
+		if (ret == EFEX_ERR_SUCCESS && cache && code_len <= PAYLOAD_CODE_MAX) {
+			slot = &cache->slots[idx];
+			slot->len = code_len;
+			memcpy(slot->code, code, code_len);
+		}
+	}
+	if (ret != EFEX_ERR_SUCCESS) {
+		return ret;
+	}
+
+	ret = sunxi_efex_fel_exec(ctx, entry);
+	if (ret != EFEX_ERR_SUCCESS) {
+		return ret;
+	}
+
+	if (result_len) {
+		return sunxi_efex_fel_read(ctx, entry + (uint32_t) (code_len + params_len), result, (ssize_t) result_len);
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+void sunxi_efex_fel_payloads_reset(struct sunxi_efex_ctx_t *ctx) {
+	if (!ctx) {
+		return;
+	}
+	if (!ctx->payload_cache && ctx->resp.mode == DEVICE_MODE_FEL) {
+		// Without the state every call uploads its payload again
+		ctx->payload_cache = malloc(sizeof(*ctx->payload_cache));
+	}
+	if (ctx->payload_cache) {
+		memset(ctx->payload_cache, 0, sizeof(*ctx->payload_cache));
+		ctx->payload_cache->base = ctx->resp.data_start_address;
+	}
+}
+
+void sunxi_efex_fel_payloads_invalidate(const struct sunxi_efex_ctx_t *ctx, const uint32_t addr, const uint64_t len) {
+	struct sunxi_efex_payload_cache_t *cache = ctx ? ctx->payload_cache : NULL;
+	if (!cache) {
+		return;
+	}
+	for (unsigned int i = 0; i <= SUNXI_EFEX_PAYLOAD_SLOTS; i++) {
+		struct sunxi_efex_payload_slot_t *slot = &cache->slots[i];
+		const uint64_t start = (uint64_t) cache->base + i * SUNXI_EFEX_PAYLOAD_SLOT_SIZE;
+		// Parameters are rewritten on every call, only the code has to survive
+		if (slot->len && addr < start + slot->len && start < (uint64_t) addr + len)
+			slot->len = 0;
+	}
+}
+
+int sunxi_efex_fel_payloads_resident(const struct sunxi_efex_ctx_t *ctx, const uint32_t addr) {
+	const struct sunxi_efex_payload_cache_t *cache = ctx ? ctx->payload_cache : NULL;
+	if (!cache || addr < cache->base || (addr - cache->base) % SUNXI_EFEX_PAYLOAD_SLOT_SIZE) {
+		return 0;
+	}
+	const uint32_t idx = (addr - cache->base) / SUNXI_EFEX_PAYLOAD_SLOT_SIZE;
+	return idx <= SUNXI_EFEX_PAYLOAD_SLOTS && cache->slots[idx].len != 0;
+}
+
+void sunxi_efex_fel_payloads_release(struct sunxi_efex_ctx_t *ctx) {
+	if (!ctx) {
+		return;
+	}
+	free(ctx->payload_cache);
+	ctx->payload_cache = NULL;
 }
@@ -0,0 +1,118 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "efex-chunk.h"
+#include "efex-common.h"
+#include "efex-policy.h"
+#include "efex-protocol.h"
+#include "efex-stats.h"
+#include "efex-thread.h"
+#include "efex-usb.h"
+#include "usb_layer.h"
+
+// Only failures of the link itself are worth another attempt
+static int sunxi_efex_policy_retryable(const int error) {
+	switch (error) {
+		case EFEX_ERR_USB_TRANSFER:
+		case EFEX_ERR_USB_TIMEOUT:
+		case EFEX_ERR_PROTOCOL:
+		case EFEX_ERR_INVALID_RESPONSE:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+void sunxi_efex_policy_init(struct sunxi_efex_policy_t *policy) {
+	if (!policy) {
+		return;
+	}
+	memset(policy, 0, sizeof(*policy));
+	policy->timeout_ms = DEFAULT_USB_TIMEOUT;
+}
+
+int sunxi_efex_set_policy(struct sunxi_efex_ctx_t *ctx, struct sunxi_efex_policy_t *policy) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	ctx->policy = policy;
+	return EFEX_ERR_SUCCESS;
+}
+
+uint32_t sunxi_efex_policy_timeout(const struct sunxi_efex_ctx_t *ctx, const uint32_t cmd, const size_t len) {
+	const struct sunxi_efex_policy_t *policy = ctx ? ctx->policy : NULL;
+	if (!policy) {
+		return DEFAULT_USB_TIMEOUT;
+	}
+
+	uint64_t timeout = policy->timeout_ms ? policy->timeout_ms : DEFAULT_USB_TIMEOUT;
+	for (size_t i = 0; cmd && i < SUNXI_EFEX_POLICY_CMD_TIMEOUTS; i++) {
+		if (policy->cmd_timeouts[i].cmd == cmd) {
+			timeout = policy->cmd_timeouts[i].timeout_ms;
+			break;
+		}
+	}
+
+	// Round the data share up so small transfers still get a little headroom
+	timeout += ((uint64_t) len * policy->timeout_per_mib_ms + (1024 * 1024 - 1)) / (1024 * 1024);
+	return timeout > UINT32_MAX ? UINT32_MAX : (uint32_t) timeout;
+}
+
+int sunxi_efex_recover(const struct sunxi_efex_ctx_t *ctx) {
+	if (!ctx || !ctx->hdl) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	struct sunxi_efex_policy_t *policy = ctx->policy;
+	const int eps[] = {ctx->epin, ctx->epout};
+	int ret = EFEX_ERR_SUCCESS;
+	for (size_t i = 0; i < sizeof(eps) / sizeof(eps[0]); i++) {
+		const int r = sunxi_usb_clear_halt(ctx, eps[i]);
+		if (r == EFEX_ERR_SUCCESS && policy)
+			policy->stats.clear_halts++;
+		else if (r != EFEX_ERR_SUCCESS && r != EFEX_ERR_NOT_SUPPORT)
+			ret = r;
+	}
+
+	// Drop a data phase or AWUS the device still had queued for the failed transaction
+	char scratch[SUNXI_USB_BULK_PACKET_SIZE * 8];
+	for (size_t drained = 0; drained <= SUNXI_EFEX_CHUNK_SIZE_MAX; drained += sizeof(scratch)) {
+		if (sunxi_usb_bulk_recv_timeout(ctx, ctx->epin, scratch, sizeof(scratch),
+		                                SUNXI_EFEX_POLICY_DRAIN_TIMEOUT) != EFEX_ERR_SUCCESS)
+			break;
+	}
+	return ret;
+}
+
+int sunxi_efex_policy_check(const struct sunxi_efex_ctx_t *ctx, const uint32_t cmd, const uint32_t addr,
+                            const uint32_t attempt, const int error) {
+	struct sunxi_efex_policy_t *policy = ctx ? ctx->policy : NULL;
+	if (!policy) {
+		return 0;
+	}
+
+	if (error == EFEX_ERR_SUCCESS) {
+		if (attempt > 0)
+			policy->stats.recovered++;
+		return 0;
+	}
+
+	if (error == EFEX_ERR_USB_TIMEOUT)
+		policy->stats.timeouts++;
+
+	if (attempt >= policy->max_retries || !sunxi_efex_policy_retryable(error)) {
+		policy->stats.failed++;
+		return 0;
+	}
+
+	policy->stats.retries++;
+	sunxi_efex_stats_retry(ctx);
+	if (policy->on_retry)
+		policy->on_retry(ctx, cmd, addr, attempt + 1, error, policy->arg);
+
+	sunxi_efex_recover(ctx);
+	if (policy->retry_delay_ms)
+		sunxi_efex_sleep_ms(policy->retry_delay_ms);
+	return 1;
+}
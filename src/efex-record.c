@@ -0,0 +1,100 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "efex-chunk.h"
+#include "efex-common.h"
+#include "efex-protocol.h"
+#include "efex-record.h"
+#include "ending.h"
+
+#define RECORD_FILE_BUFFER (1024 * 1024)
+
+struct sunxi_efex_recorder_t {
+	FILE *fp;
+	uint32_t flags;
+	uint64_t epoch; // sunxi_efex_time_us() when opened
+	int error;      // first write error, later transfers are dropped
+};
+
+int sunxi_efex_record_open(const char *path, const uint32_t flags, struct sunxi_efex_recorder_t **rec) {
+	if (!path || !rec) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	if (flags & ~(uint32_t) SUNXI_EFEX_RECORD_NO_OUT_DATA) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+
+	*rec = NULL;
+	struct sunxi_efex_recorder_t *r = calloc(1, sizeof(*r));
+	if (!r) {
+		return EFEX_ERR_MEMORY;
+	}
+
+	r->fp = fopen(path, "wb");
+	if (!r->fp) {
+		free(r);
+		return EFEX_ERR_FILE_OPEN;
+	}
+	// Transfers are recorded in the caller's thread, keep the writes large
+	setvbuf(r->fp, NULL, _IOFBF, RECORD_FILE_BUFFER);
+
+	const struct sunxi_efex_record_file_t hdr = {
+			.magic = cpu_to_le32(SUNXI_EFEX_RECORD_MAGIC),
+			.version = cpu_to_le16(SUNXI_EFEX_RECORD_VERSION),
+			.flags = cpu_to_le16(flags),
+	};
+	if (fwrite(&hdr, sizeof(hdr), 1, r->fp) != 1) {
+		fclose(r->fp);
+		free(r);
+		return EFEX_ERR_FILE_WRITE;
+	}
+
+	r->flags = flags;
+	r->epoch = sunxi_efex_time_us();
+	*rec = r;
+	return EFEX_ERR_SUCCESS;
+}
+
+int sunxi_efex_record_attach(struct sunxi_efex_ctx_t *ctx, struct sunxi_efex_recorder_t *rec) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	ctx->record = rec;
+	return EFEX_ERR_SUCCESS;
+}
+
+void sunxi_efex_record_xfer(struct sunxi_efex_recorder_t *rec, const int ep, const void *buf, const size_t len,
+                            const uint64_t start, const uint64_t usec, const int status) {
+	if (!rec || rec->error) {
+		return;
+	}
+
+	// A failed IN transfer leaves nothing the replay could serve
+	const int in = (ep & 0x80) != 0;
+	const int data = buf && len && (in ? status >= 0 : !(rec->flags & SUNXI_EFEX_RECORD_NO_OUT_DATA));
+	const struct sunxi_efex_record_xfer_t x = {
+			.ts_us = cpu_to_le64(start - rec->epoch),
+			.len = cpu_to_le64(len),
+			.dur_us = cpu_to_le32(usec > UINT32_MAX ? UINT32_MAX : (uint32_t) usec),
+			.status = (int32_t) cpu_to_le32(status),
+			.ep = (uint8_t) ep,
+			.data = (uint8_t) data,
+	};
+	if (fwrite(&x, sizeof(x), 1, rec->fp) != 1 || (data && fwrite(buf, 1, len, rec->fp) != len)) {
+		rec->error = EFEX_ERR_FILE_WRITE;
+	}
+}
+
+int sunxi_efex_record_close(struct sunxi_efex_recorder_t *rec) {
+	if (!rec) {
+		return EFEX_ERR_SUCCESS;
+	}
+
+	int ret = rec->error;
+	if (fclose(rec->fp) != 0 && ret == EFEX_ERR_SUCCESS) {
+		ret = EFEX_ERR_FILE_WRITE;
+	}
+	free(rec);
+	return ret;
+}
@@ -0,0 +1,140 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "efex-common.h"
+#include "efex-payloads.h"
+#include "efex-protocol.h"
+#include "efex-seq.h"
+#include "ending.h"
+
+#define SEQ_OP_WORDS (sizeof(struct sunxi_efex_seq_op_t) / sizeof(uint32_t))
+
+// Size word, the operations and the closing SUNXI_EFEX_SEQ_END
+#define SEQ_PROGRAM_WORDS (1 + (SUNXI_EFEX_SEQ_MAX_OPS + 1) * SEQ_OP_WORDS)
+
+void sunxi_efex_seq_init(struct sunxi_efex_seq_t *seq) {
+	if (!seq) {
+		return;
+	}
+	seq->count = 0;
+	seq->reads = 0;
+	seq->error = EFEX_ERR_SUCCESS;
+}
+
+static int seq_append(struct sunxi_efex_seq_t *seq, const uint32_t op, const uint32_t addr, const uint32_t arg0,
+                      const uint32_t arg1, const uint32_t arg2) {
+	if (!seq) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	if (seq->error != EFEX_ERR_SUCCESS) {
+		return seq->error;
+	}
+	if (seq->count >= SUNXI_EFEX_SEQ_MAX_OPS) {
+		seq->error = EFEX_ERR_INVALID_PARAM;
+		return seq->error;
+	}
+
+	struct sunxi_efex_seq_op_t *o = &seq->ops[seq->count++];
+	o->op = op;
+	o->addr = addr;
+	o->arg[0] = arg0;
+	o->arg[1] = arg1;
+	o->arg[2] = arg2;
+	if (op == SUNXI_EFEX_SEQ_READ) {
+		seq->reads++;
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+int sunxi_efex_seq_write(struct sunxi_efex_seq_t *seq, const uint32_t addr, const uint32_t value) {
+	return seq_append(seq, SUNXI_EFEX_SEQ_WRITE, addr, value, 0, 0);
+}
+
+int sunxi_efex_seq_read(struct sunxi_efex_seq_t *seq, const uint32_t addr) {
+	return seq_append(seq, SUNXI_EFEX_SEQ_READ, addr, 0, 0, 0);
+}
+
+int sunxi_efex_seq_modify(struct sunxi_efex_seq_t *seq, const uint32_t addr, const uint32_t clear, const uint32_t set) {
+	return seq_append(seq, SUNXI_EFEX_SEQ_MODIFY, addr, clear, set, 0);
+}
+
+int sunxi_efex_seq_poll(struct sunxi_efex_seq_t *seq, const uint32_t addr, const uint32_t mask, const uint32_t value,
+                        const uint32_t tries) {
+	// The interpreter counts tries down before testing for zero, 0 would poll 2^32 times
+	if (seq && tries == 0 && seq->error == EFEX_ERR_SUCCESS) {
+		seq->error = EFEX_ERR_INVALID_PARAM;
+	}
+	return seq_append(seq, SUNXI_EFEX_SEQ_POLL, addr, mask, value, tries);
+}
+
+int sunxi_efex_seq_delay(struct sunxi_efex_seq_t *seq, const uint32_t loops) {
+	return seq_append(seq, SUNXI_EFEX_SEQ_DELAY, 0, loops, 0, 0);
+}
+
+int sunxi_efex_fel_seq_run(const struct sunxi_efex_ctx_t *ctx, const struct sunxi_efex_seq_t *seq, uint32_t *reads,
+                           size_t *done) {
+	if (!ctx || !seq || (seq->reads && !reads)) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	if (done) {
+		*done = 0;
+	}
+	if (seq->error != EFEX_ERR_SUCCESS) {
+		return seq->error;
+	}
+	if (seq->count > SUNXI_EFEX_SEQ_MAX_OPS || seq->reads > seq->count) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+	if (ctx->resp.mode != DEVICE_MODE_FEL) {
+		return EFEX_ERR_INVALID_DEVICE_MODE;
+	}
+	const struct payloads_ops *payload = sunxi_efex_fel_get_payload(ctx);
+	if (!payload || !payload->seq) {
+		return EFEX_ERR_NOT_SUPPORT;
+	}
+
+	uint32_t program[SEQ_PROGRAM_WORDS];
+	uint32_t result[1 + SUNXI_EFEX_SEQ_MAX_OPS];
+	size_t n = 1;
+	for (size_t i = 0; i < seq->count; i++) {
+		const struct sunxi_efex_seq_op_t *o = &seq->ops[i];
+		program[n++] = cpu_to_le32(o->op);
+		program[n++] = cpu_to_le32(o->addr);
+		program[n++] = cpu_to_le32(o->arg[0]);
+		program[n++] = cpu_to_le32(o->arg[1]);
+		program[n++] = cpu_to_le32(o->arg[2]);
+	}
+	memset(&program[n], 0, SEQ_OP_WORDS * sizeof(uint32_t));
+	n += SEQ_OP_WORDS;
+	program[0] = cpu_to_le32((uint32_t) ((n - 1) * sizeof(uint32_t)));
+
+	const int ret = payload->seq(ctx, program, n * sizeof(uint32_t), result, (1 + seq->reads) * sizeof(uint32_t));
+	// Stores into resident code are dropped from the cache, whether or not the run got to them
+	for (size_t i = 0; i < seq->count; i++) {
+		if (seq->ops[i].op == SUNXI_EFEX_SEQ_WRITE || seq->ops[i].op == SUNXI_EFEX_SEQ_MODIFY) {
+			sunxi_efex_fel_payloads_invalidate(ctx, seq->ops[i].addr, sizeof(uint32_t));
+		}
+	}
+	if (ret != EFEX_ERR_SUCCESS) {
+		return ret;
+	}
+
+	const uint32_t completed = le32_to_cpu(result[0]);
+	if (completed > seq->count) {
+		return EFEX_ERR_INVALID_RESPONSE;
+	}
+
+	// Reads before a poll that gave up still happened
+	size_t logged = 0;
+	for (size_t i = 0; i < completed; i++) {
+		if (seq->ops[i].op == SUNXI_EFEX_SEQ_READ) {
+			reads[logged] = le32_to_cpu(result[1 + logged]);
+			logged++;
+		}
+	}
+	if (done) {
+		*done = completed;
+	}
+	return completed == seq->count ? EFEX_ERR_SUCCESS : EFEX_ERR_DEVICE_NOT_READY;
+}
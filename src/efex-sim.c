@@ -0,0 +1,659 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "efex-common.h"
+#include "efex-crc32.h"
+#include "efex-fes.h"
+#include "efex-protocol.h"
+#include "efex-sim.h"
+#include "efex-usb.h"
+#include "ending.h"
+
+#ifdef _WIN32
+#define sim_fseek _fseeki64
+#else
+#define sim_fseek fseeko
+#endif
+
+#define SIM_PAGE_SHIFT (16)
+#define SIM_PAGE_SIZE (1U << SIM_PAGE_SHIFT)
+#define SIM_SECTOR_SIZE (512)
+#define SIM_MAX_TAGS (32)
+
+// Sparse memory: 64 KiB pages in an open-addressed table, pages that were never written read as zero
+struct sim_page_t {
+	uint64_t index;
+	uint8_t *data;
+};
+
+struct sim_store_t {
+	struct sim_page_t *pages;
+	size_t count;
+	size_t capacity; // power of two
+};
+
+enum sim_phase_t {
+	SIM_PHASE_CMD = 0, // waiting for an AWUC header or a FES command block
+	SIM_PHASE_OUT,     // data from the host
+	SIM_PHASE_IN,      // data to the host
+	SIM_PHASE_STATUS,  // AWUS to the host
+};
+
+// What the AWUC framed data phases carry
+enum sim_efex_state_t {
+	SIM_EFEX_IDLE = 0, // next OUT is a struct sunxi_efex_request_t
+	SIM_EFEX_WRITE,    // FEL write data
+	SIM_EFEX_READ,     // FEL read data
+	SIM_EFEX_REPLY,    // reply buffer
+	SIM_EFEX_STATUS,   // struct sunxi_efex_response_t
+};
+
+struct sunxi_efex_sim_t {
+	struct sunxi_efex_sim_config_t config;
+
+	enum sim_phase_t phase;
+	int fes;          // transaction started by a FES command block
+	uint64_t remain;  // bytes left in the data phase
+	uint8_t status;   // AWUS status of the transaction
+
+	enum sim_efex_state_t efex;
+	uint8_t efex_status;
+	struct {
+		uint32_t cmd;
+		uint32_t addr;
+		uint32_t len;    // FEL read/write length
+		uint64_t offset; // bytes done for FEL, else flash byte offset or tag store offset
+		int tagged;      // data-type tag, lands in the tag store instead of flash
+		uint32_t tag;
+		uint32_t flags;
+	} req;
+
+	uint8_t reply[64];
+	size_t reply_len;
+	size_t reply_pos;
+
+	struct sim_store_t mem;
+	struct sim_store_t flash_mem;
+	struct sim_store_t tag_mem;
+	FILE *flash;
+	uint32_t tags_done[SIM_MAX_TAGS];
+	size_t tags_done_count;
+};
+
+static uint8_t *sim_store_page(struct sim_store_t *s, const uint64_t index, const int create) {
+	if (s->capacity == 0) {
+		if (!create)
+			return NULL;
+		s->pages = calloc(64, sizeof(*s->pages));
+		if (!s->pages)
+			return NULL;
+		s->capacity = 64;
+	}
+
+	size_t slot = (size_t) ((index * 0x9E3779B97F4A7C15ULL) >> 20) & (s->capacity - 1);
+	while (s->pages[slot].data) {
+		if (s->pages[slot].index == index)
+			return s->pages[slot].data;
+		slot = (slot + 1) & (s->capacity - 1);
+	}
+	if (!create)
+		return NULL;
+
+	// Keep the table at most half full
+	if ((s->count + 1) * 2 > s->capacity) {
+		struct sim_store_t grown = {
+				.pages = calloc(s->capacity * 2, sizeof(*s->pages)),
+				.capacity = s->capacity * 2,
+		};
+		if (!grown.pages)
+			return NULL;
+		for (size_t i = 0; i < s->capacity; i++) {
+			if (!s->pages[i].data)
+				continue;
+			size_t j = (size_t) ((s->pages[i].index * 0x9E3779B97F4A7C15ULL) >> 20) & (grown.capacity - 1);
+			while (grown.pages[j].data)
+				j = (j + 1) & (grown.capacity - 1);
+			grown.pages[j] = s->pages[i];
+			grown.count++;
+		}
+		free(s->pages);
+		*s = grown;
+		return sim_store_page(s, index, create);
+	}
+
+	uint8_t *data = calloc(1, SIM_PAGE_SIZE);
+	if (!data)
+		return NULL;
+	s->pages[slot].index = index;
+	s->pages[slot].data = data;
+	s->count++;
+	return data;
+}
+
+static void sim_store_read(const struct sim_store_t *s, uint64_t off, void *buf, size_t len) {
+	uint8_t *p = buf;
+	while (len > 0) {
+		const size_t in_page = (size_t) (off & (SIM_PAGE_SIZE - 1));
+		const size_t n = len < SIM_PAGE_SIZE - in_page ? len : SIM_PAGE_SIZE - in_page;
+		const uint8_t *page = sim_store_page((struct sim_store_t *) s, off >> SIM_PAGE_SHIFT, 0);
+		if (page)
+			memcpy(p, page + in_page, n);
+		else
+			memset(p, 0, n);
+		p += n;
+		off += n;
+		len -= n;
+	}
+}
+
+static int sim_store_write(struct sim_store_t *s, uint64_t off, const void *buf, size_t len) {
+	const uint8_t *p = buf;
+	while (len > 0) {
+		const size_t in_page = (size_t) (off & (SIM_PAGE_SIZE - 1));
+		const size_t n = len < SIM_PAGE_SIZE - in_page ? len : SIM_PAGE_SIZE - in_page;
+		uint8_t *page = sim_store_page(s, off >> SIM_PAGE_SHIFT, 1);
+		if (!page)
+			return EFEX_ERR_MEMORY;
+		memcpy(page + in_page, p, n);
+		p += n;
+		off += n;
+		len -= n;
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+static void sim_store_free(struct sim_store_t *s) {
+	for (size_t i = 0; i < s->capacity; i++)
+		free(s->pages[i].data);
+	free(s->pages);
+	memset(s, 0, sizeof(*s));
+}
+
+static int sim_flash_read(struct sunxi_efex_sim_t *sim, const uint64_t off, void *buf, const size_t len) {
+	if (off > sim->config.flash_size || len > sim->config.flash_size - off)
+		return EFEX_ERR_FLASH_ACCESS;
+	if (!sim->flash) {
+		sim_store_read(&sim->flash_mem, off, buf, len);
+		return EFEX_ERR_SUCCESS;
+	}
+	if (sim_fseek(sim->flash, off, SEEK_SET) != 0)
+		return EFEX_ERR_FILE_READ;
+	const size_t got = fread(buf, 1, len, sim->flash);
+	// Beyond the end of the image file the flash is blank
+	memset((uint8_t *) buf + got, 0, len - got);
+	return EFEX_ERR_SUCCESS;
+}
+
+static int sim_flash_write(struct sunxi_efex_sim_t *sim, const uint64_t off, const void *buf, const size_t len) {
+	if (off > sim->config.flash_size || len > sim->config.flash_size - off)
+		return EFEX_ERR_FLASH_ACCESS;
+	if (!sim->flash)
+		return sim_store_write(&sim->flash_mem, off, buf, len);
+	if (sim_fseek(sim->flash, off, SEEK_SET) != 0 || fwrite(buf, 1, len, sim->flash) != len)
+		return EFEX_ERR_FILE_WRITE;
+	return EFEX_ERR_SUCCESS;
+}
+
+static int sim_flash_crc32(struct sunxi_efex_sim_t *sim, uint64_t off, uint64_t len, uint32_t *crc) {
+	uint8_t *buf = malloc(SIM_PAGE_SIZE);
+	if (!buf)
+		return EFEX_ERR_MEMORY;
+
+	uint32_t c = 0;
+	int ret = EFEX_ERR_SUCCESS;
+	while (len > 0 && ret == EFEX_ERR_SUCCESS) {
+		const size_t n = len < SIM_PAGE_SIZE ? (size_t) len : SIM_PAGE_SIZE;
+		ret = sim_flash_read(sim, off, buf, n);
+		c = sunxi_efex_crc32(c, buf, n);
+		off += n;
+		len -= n;
+	}
+	free(buf);
+	*crc = c;
+	return ret;
+}
+
+static void sim_reply(struct sunxi_efex_sim_t *sim, const void *data, const size_t len) {
+	memcpy(sim->reply, data, len);
+	sim->reply_len = len;
+	sim->reply_pos = 0;
+}
+
+static void sim_reply_u32(struct sunxi_efex_sim_t *sim, const uint32_t value) {
+	const uint32_t le = cpu_to_le32(value);
+	sim_reply(sim, &le, sizeof(le));
+}
+
+static void sim_reply_verify(struct sunxi_efex_sim_t *sim, const int32_t fes_crc, const int32_t media_crc) {
+	const struct sunxi_fes_verify_resp_t resp = {
+			.flag = cpu_to_le32(SUNXI_EFEX_SIM_VERIFY_FLAG),
+			.fes_crc = (int32_t) cpu_to_le32(fes_crc),
+			.media_crc = (int32_t) cpu_to_le32(media_crc),
+	};
+	sim_reply(sim, &resp, sizeof(resp));
+}
+
+/* ---- AWUC framed EFEX/FEL commands ---- */
+
+static void sim_efex_request(struct sunxi_efex_sim_t *sim, const struct sunxi_efex_request_t *req) {
+	sim->req.cmd = le16_to_cpu(req->cmd);
+	sim->req.addr = le32_to_cpu(req->address);
+	sim->req.offset = 0;
+	sim->req.len = le32_to_cpu(req->len);
+	sim->efex_status = 0;
+
+	switch (sim->req.cmd) {
+		case EFEX_CMD_VERIFY_DEVICE: {
+			struct sunxi_efex_device_resp_t resp = {
+					.id = cpu_to_le32(sim->config.chip_id),
+					.firmware = cpu_to_le32(1),
+					.mode = cpu_to_le16(sim->config.mode),
+					.data_flag = 0x44,
+					.data_length = 0x08,
+					.data_start_address = cpu_to_le32(0x7e00),
+			};
+			memcpy(resp.magic, "AWUSBFEX", sizeof(resp.magic));
+			sim_reply(sim, &resp, sizeof(resp));
+			sim->efex = SIM_EFEX_REPLY;
+			return;
+		}
+		case EFEX_CMD_FEL_WRITE:
+			sim->efex = sim->config.mode == DEVICE_MODE_FEL ? SIM_EFEX_WRITE : SIM_EFEX_STATUS;
+			break;
+		case EFEX_CMD_FEL_READ:
+			sim->efex = sim->config.mode == DEVICE_MODE_FEL ? SIM_EFEX_READ : SIM_EFEX_STATUS;
+			break;
+		case EFEX_CMD_FEL_EXEC:
+			sim->efex = SIM_EFEX_STATUS;
+			if (sim->config.mode != DEVICE_MODE_FEL)
+				break;
+			if (sim->config.on_exec && sim->config.on_exec(sim, sim->req.addr, sim->config.arg) != 0)
+				sim->efex_status = 1;
+			return;
+		default:
+			sim->efex = SIM_EFEX_STATUS;
+			break;
+	}
+	// Everything else, and FEL commands outside FEL mode, are refused
+	if (sim->efex == SIM_EFEX_STATUS)
+		sim->efex_status = 1;
+}
+
+static int sim_efex_out(struct sunxi_efex_sim_t *sim, const char *buf, const size_t len) {
+	switch (sim->efex) {
+		case SIM_EFEX_IDLE: {
+			struct sunxi_efex_request_t req;
+			if (len != sizeof(req))
+				return EFEX_ERR_USB_TRANSFER;
+			memcpy(&req, buf, sizeof(req));
+			sim_efex_request(sim, &req);
+			return EFEX_ERR_SUCCESS;
+		}
+		case SIM_EFEX_WRITE: {
+			if (sim->req.offset + len > sim->req.len)
+				return EFEX_ERR_USB_TRANSFER;
+			if (sunxi_efex_sim_mem_write(sim, sim->req.addr + (uint32_t) sim->req.offset, buf, len) != 0)
+				sim->efex_status = 1;
+			sim->req.offset += len;
+			if (sim->req.offset == sim->req.len)
+				sim->efex = SIM_EFEX_STATUS;
+			return EFEX_ERR_SUCCESS;
+		}
+		default:
+			return EFEX_ERR_USB_TRANSFER;
+	}
+}
+
+static int sim_efex_in(struct sunxi_efex_sim_t *sim, char *buf, const size_t len) {
+	switch (sim->efex) {
+		case SIM_EFEX_READ:
+			if (sim->req.offset + len > sim->req.len)
+				return EFEX_ERR_USB_TRANSFER;
+			sunxi_efex_sim_mem_read(sim, sim->req.addr + (uint32_t) sim->req.offset, buf, len);
+			sim->req.offset += len;
+			if (sim->req.offset == sim->req.len)
+				sim->efex = SIM_EFEX_STATUS;
+			return EFEX_ERR_SUCCESS;
+		case SIM_EFEX_REPLY:
+			if (len > sim->reply_len - sim->reply_pos)
+				return EFEX_ERR_USB_TRANSFER;
+			memcpy(buf, sim->reply + sim->reply_pos, len);
+			sim->reply_pos += len;
+			if (sim->reply_pos == sim->reply_len)
+				sim->efex = SIM_EFEX_STATUS;
+			return EFEX_ERR_SUCCESS;
+		case SIM_EFEX_STATUS: {
+			const struct sunxi_efex_response_t resp = {
+					.magic = cpu_to_le16(0xffff),
+					.status = sim->efex_status,
+			};
+			if (len != sizeof(resp))
+				return EFEX_ERR_USB_TRANSFER;
+			memcpy(buf, &resp, sizeof(resp));
+			sim->efex = SIM_EFEX_IDLE;
+			return EFEX_ERR_SUCCESS;
+		}
+		default:
+			return EFEX_ERR_USB_TIMEOUT;
+	}
+}
+
+/* ---- FES commands ---- */
+
+static int sim_tag_done(const struct sunxi_efex_sim_t *sim, const uint32_t tag) {
+	for (size_t i = 0; i < sim->tags_done_count; i++) {
+		if (sim->tags_done[i] == tag)
+			return 1;
+	}
+	return 0;
+}
+
+// Sets up the data phase of a FES command; returns the direction, or SIM_PHASE_STATUS if there is none
+static enum sim_phase_t sim_fes_command(struct sunxi_efex_sim_t *sim, const struct sunxi_fes_xfer_t *xfer) {
+	const uint32_t cmd = le16_to_cpu(xfer->cmd);
+	sim->req.cmd = cmd;
+	sim->remain = 0;
+	sim->reply_len = 0;
+	sim->reply_pos = 0;
+
+	if (sim->config.mode != DEVICE_MODE_SRV) {
+		sim->status = 1;
+		return SIM_PHASE_STATUS;
+	}
+
+	switch (cmd) {
+		case EFEX_CMD_FES_DOWN:
+		case EFEX_CMD_FES_UP:
+		case EFEX_CMD_FES_NAND:
+		case EFEX_CMD_FES_SPINAND:
+		case EFEX_CMD_FES_NOR: {
+			struct sunxi_fes_trans_t trans;
+			memcpy(&trans, xfer->buf, sizeof(trans));
+			const uint32_t addr = le32_to_cpu(trans.addr);
+			sim->req.flags = le32_to_cpu(trans.flags);
+			sim->req.tag = sim->req.flags & SUNXI_EFEX_DATA_TYPE_MASK;
+			sim->req.tagged = sim->req.tag != 0 && cmd != EFEX_CMD_FES_NAND && cmd != EFEX_CMD_FES_SPINAND &&
+			                  cmd != EFEX_CMD_FES_NOR;
+			// Data-type tags and the storage-specific commands are byte-addressed, flash is sector-addressed
+			if (sim->req.tagged)
+				sim->req.offset = ((uint64_t) sim->req.tag << 32) | addr;
+			else if (cmd == EFEX_CMD_FES_DOWN || cmd == EFEX_CMD_FES_UP)
+				sim->req.offset = (uint64_t) addr * SIM_SECTOR_SIZE;
+			else
+				sim->req.offset = addr;
+			sim->remain = le32_to_cpu(trans.len);
+			return cmd == EFEX_CMD_FES_DOWN ? SIM_PHASE_OUT : SIM_PHASE_IN;
+		}
+		case EFEX_CMD_FES_VERIFY_VALUE: {
+			struct sunxi_fes_verify_value_t verify;
+			memcpy(&verify, xfer->buf, sizeof(verify));
+			uint32_t crc = 0;
+			const int ret = sim_flash_crc32(sim, (uint64_t) le32_to_cpu(verify.addr) * SIM_SECTOR_SIZE,
+			                                le64_to_cpu(verify.size), &crc);
+			if (ret != EFEX_ERR_SUCCESS)
+				sim->status = 1;
+			sim_reply_verify(sim, (int32_t) crc, (int32_t) crc);
+			break;
+		}
+		case EFEX_CMD_FES_VERIFY_STATUS:
+		case EFEX_CMD_FES_VERIFY_UBOOT_BLK: {
+			struct sunxi_fes_verify_status_t verify;
+			memcpy(&verify, xfer->buf, sizeof(verify));
+			// media_crc 0 tells the host the tagged download completed
+			sim_reply_verify(sim, 0, sim_tag_done(sim, le32_to_cpu(verify.tag) & SUNXI_EFEX_DATA_TYPE_MASK) ? 0 : 1);
+			break;
+		}
+		case EFEX_CMD_FES_QUERY_STORAGE:
+			sim_reply_u32(sim, sim->config.storage_type);
+			break;
+		case EFEX_CMD_FES_QUERY_SECURE:
+			sim_reply_u32(sim, 0);
+			break;
+		case EFEX_CMD_FES_FLASH_SIZE_PROBE:
+			sim_reply_u32(sim, (uint32_t) (sim->config.flash_size / SIM_SECTOR_SIZE));
+			break;
+		case EFEX_CMD_FES_QUERY_STORAGE_LIST: {
+			const uint8_t mask = (uint8_t) (1U << (sim->config.storage_type & 7));
+			sim_reply(sim, &mask, sizeof(mask));
+			break;
+		}
+		case EFEX_CMD_FES_FLASH_SET_ON:
+		case EFEX_CMD_FES_FLASH_SET_OFF:
+		case EFEX_CMD_FES_FLASH_SWITCH:
+		case EFEX_CMD_FES_TOOL_MODE:
+			return SIM_PHASE_STATUS;
+		default:
+			sim->status = 1;
+			return SIM_PHASE_STATUS;
+	}
+	sim->remain = sim->reply_len;
+	return SIM_PHASE_IN;
+}
+
+static void sim_fes_finish(struct sunxi_efex_sim_t *sim) {
+	if (sim->req.cmd != EFEX_CMD_FES_DOWN || !sim->req.tagged || !(sim->req.flags & SUNXI_EFEX_TRANS_FINISH_TAG))
+		return;
+	if (!sim_tag_done(sim, sim->req.tag) && sim->tags_done_count < SIM_MAX_TAGS)
+		sim->tags_done[sim->tags_done_count++] = sim->req.tag;
+}
+
+static int sim_fes_out(struct sunxi_efex_sim_t *sim, const char *buf, const size_t len) {
+	const int ret = sim->req.tagged ? sim_store_write(&sim->tag_mem, sim->req.offset, buf, len)
+	                                : sim_flash_write(sim, sim->req.offset, buf, len);
+	if (ret != EFEX_ERR_SUCCESS)
+		sim->status = 1;
+	sim->req.offset += len;
+	return EFEX_ERR_SUCCESS;
+}
+
+static int sim_fes_in(struct sunxi_efex_sim_t *sim, char *buf, const size_t len) {
+	if (sim->reply_len) {
+		memcpy(buf, sim->reply + sim->reply_pos, len);
+		sim->reply_pos += len;
+		return EFEX_ERR_SUCCESS;
+	}
+	int ret = EFEX_ERR_SUCCESS;
+	if (sim->req.tagged)
+		sim_store_read(&sim->tag_mem, sim->req.offset, buf, len);
+	else
+		ret = sim_flash_read(sim, sim->req.offset, buf, len);
+	if (ret != EFEX_ERR_SUCCESS) {
+		memset(buf, 0, len);
+		sim->status = 1;
+	}
+	sim->req.offset += len;
+	return EFEX_ERR_SUCCESS;
+}
+
+/* ---- Transport ---- */
+
+int sunxi_efex_sim_out(struct sunxi_efex_sim_t *sim, const char *buf, const size_t len) {
+	if (!sim || !buf) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	if (sim->phase == SIM_PHASE_CMD) {
+		struct sunxi_usb_request_t req;
+		struct sunxi_fes_xfer_t xfer;
+		sim->status = 0;
+		if (len == sizeof(req) && memcmp(buf, SUNXI_USB_REQ_MAGIC, 4) == 0) {
+			memcpy(&req, buf, sizeof(req));
+			sim->fes = 0;
+			sim->remain = le32_to_cpu(req.data_length);
+			sim->phase = req.cmd_package[0] == AW_USB_WRITE ? SIM_PHASE_OUT : SIM_PHASE_IN;
+		} else if (len == sizeof(xfer) && memcmp(buf + offsetof(struct sunxi_fes_xfer_t, magic),
+		                                         SUNXI_USB_REQ_MAGIC, 4) == 0) {
+			memcpy(&xfer, buf, sizeof(xfer));
+			sim->fes = 1;
+			sim->phase = sim_fes_command(sim, &xfer);
+		} else {
+			return EFEX_ERR_USB_TRANSFER;
+		}
+		if (sim->phase != SIM_PHASE_STATUS && sim->remain == 0)
+			sim->phase = SIM_PHASE_STATUS;
+		return EFEX_ERR_SUCCESS;
+	}
+
+	if (sim->phase != SIM_PHASE_OUT || len > sim->remain) {
+		return EFEX_ERR_USB_TRANSFER;
+	}
+	const int ret = sim->fes ? sim_fes_out(sim, buf, len) : sim_efex_out(sim, buf, len);
+	if (ret != EFEX_ERR_SUCCESS) {
+		return ret;
+	}
+	sim->remain -= len;
+	if (sim->remain == 0)
+		sim->phase = SIM_PHASE_STATUS;
+	return EFEX_ERR_SUCCESS;
+}
+
+int sunxi_efex_sim_in(struct sunxi_efex_sim_t *sim, char *buf, const size_t len) {
+	if (!sim || !buf) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	if (sim->phase == SIM_PHASE_STATUS) {
+		struct sunxi_usb_response_t resp = {
+				.tag = 0,
+				.residue = 0,
+				.status = sim->status,
+		};
+		memcpy(resp.magic, SUNXI_USB_RSP_MAGIC, 4);
+		if (len != sizeof(resp))
+			return EFEX_ERR_USB_TRANSFER;
+		memcpy(buf, &resp, sizeof(resp));
+		if (sim->fes)
+			sim_fes_finish(sim);
+		sim->phase = SIM_PHASE_CMD;
+		return EFEX_ERR_SUCCESS;
+	}
+
+	if (sim->phase != SIM_PHASE_IN) {
+		return EFEX_ERR_USB_TIMEOUT;
+	}
+	if (len > sim->remain) {
+		return EFEX_ERR_USB_TRANSFER;
+	}
+	const int ret = sim->fes ? sim_fes_in(sim, buf, len) : sim_efex_in(sim, buf, len);
+	if (ret != EFEX_ERR_SUCCESS) {
+		return ret;
+	}
+	sim->remain -= len;
+	if (sim->remain == 0)
+		sim->phase = SIM_PHASE_STATUS;
+	return EFEX_ERR_SUCCESS;
+}
+
+size_t sunxi_efex_sim_next(const struct sunxi_efex_sim_t *sim, int *in) {
+	if (!sim || !in) {
+		return 0;
+	}
+
+	switch (sim->phase) {
+		case SIM_PHASE_OUT:
+			*in = 0;
+			return (size_t) sim->remain;
+		case SIM_PHASE_IN:
+			*in = 1;
+			return (size_t) sim->remain;
+		case SIM_PHASE_STATUS:
+			*in = 1;
+			return sizeof(struct sunxi_usb_response_t);
+		default:
+			*in = 0;
+			return sizeof(struct sunxi_usb_request_t);
+	}
+}
+
+void sunxi_efex_sim_reset(struct sunxi_efex_sim_t *sim) {
+	if (!sim) {
+		return;
+	}
+	sim->phase = SIM_PHASE_CMD;
+	sim->efex = SIM_EFEX_IDLE;
+	sim->remain = 0;
+}
+
+void sunxi_efex_sim_set_mode(struct sunxi_efex_sim_t *sim, const uint16_t mode) {
+	if (sim) {
+		sim->config.mode = mode;
+	}
+}
+
+void sunxi_efex_sim_mem_read(const struct sunxi_efex_sim_t *sim, const uint32_t addr, void *buf, const size_t len) {
+	if (sim && buf) {
+		sim_store_read(&sim->mem, addr, buf, len);
+	}
+}
+
+int sunxi_efex_sim_mem_write(struct sunxi_efex_sim_t *sim, const uint32_t addr, const void *buf, const size_t len) {
+	if (!sim || !buf) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	return sim_store_write(&sim->mem, addr, buf, len);
+}
+
+const struct sunxi_efex_sim_config_t *sunxi_efex_sim_config(const struct sunxi_efex_sim_t *sim) {
+	return sim ? &sim->config : NULL;
+}
+
+void sunxi_efex_sim_config_init(struct sunxi_efex_sim_config_t *config) {
+	if (!config) {
+		return;
+	}
+	memset(config, 0, sizeof(*config));
+	config->mode = DEVICE_MODE_FEL;
+	config->chip_id = SUNXI_EFEX_SIM_CHIP_ID;
+	config->storage_type = 1;
+}
+
+int sunxi_efex_sim_create(const struct sunxi_efex_sim_config_t *config, struct sunxi_efex_sim_t **sim) {
+	if (!config || !sim) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	*sim = NULL;
+	struct sunxi_efex_sim_t *s = calloc(1, sizeof(*s));
+	if (!s) {
+		return EFEX_ERR_MEMORY;
+	}
+	s->config = *config;
+	s->config.flash_path = NULL;
+
+	if (config->flash_path) {
+		s->flash = fopen(config->flash_path, "r+b");
+		if (!s->flash)
+			s->flash = fopen(config->flash_path, "w+b");
+		if (!s->flash) {
+			free(s);
+			return EFEX_ERR_FILE_OPEN;
+		}
+		if (s->config.flash_size == 0 && sim_fseek(s->flash, 0, SEEK_END) == 0) {
+#ifdef _WIN32
+			const long long end = _ftelli64(s->flash);
+#else
+			const long long end = (long long) ftello(s->flash);
+#endif
+			s->config.flash_size = end > 0 ? (uint64_t) end : 0;
+		}
+	}
+	if (s->config.flash_size == 0)
+		s->config.flash_size = SUNXI_EFEX_SIM_FLASH_SIZE;
+
+	*sim = s;
+	return EFEX_ERR_SUCCESS;
+}
+
+void sunxi_efex_sim_destroy(struct sunxi_efex_sim_t *sim) {
+	if (!sim) {
+		return;
+	}
+	if (sim->flash)
+		fclose(sim->flash);
+	sim_store_free(&sim->mem);
+	sim_store_free(&sim->flash_mem);
+	sim_store_free(&sim->tag_mem);
+	free(sim);
+}
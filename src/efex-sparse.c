@@ -0,0 +1,545 @@
+// fseeko and ftruncate need the POSIX declarations, and off_t must hold offsets past 4 GiB on 32-bit hosts too
+#ifndef _WIN32
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#include <winioctl.h>
+#define sparse_fseek _fseeki64
+typedef __int64 sparse_off_t;
+#else
+#include <unistd.h>
+#define sparse_fseek fseeko
+typedef off_t sparse_off_t;
+_Static_assert(sizeof(off_t) == 8, "dumps past 4 GiB need a 64-bit off_t");
+#endif
+
+#include "efex-protocol.h"
+#include "efex-sparse.h"
+#include "ending.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SPARSE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define SPARSE_NEON
+#include <arm_neon.h>
+#endif
+
+// Bytes folded between checks for an early exit
+#define SPARSE_STRIDE (256)
+
+// Sizes of the headers as written by libsparse, newer versions may add fields after them
+#define SIMG_FILE_HDR_SZ (28)
+#define SIMG_CHUNK_HDR_SZ (12)
+
+// Blocks per RAW chunk at most, its total_sz must fit 32 bits
+#define SIMG_MAX_RAW_BLOCKS ((UINT32_MAX - SIMG_CHUNK_HDR_SZ) / SUNXI_EFEX_SPARSE_BLOCK)
+
+/*
+ * The scanners fold whole strides of the buffer into an OR of all bytes XOR a repeating 32-bit
+ * pattern and an AND of all bytes; the OR is 0x00 only when the buffer repeats the pattern, the AND
+ * 0xFF only when it is erased. They stop once neither can be, and return the bytes they consumed.
+ */
+#ifdef SPARSE_SSE2
+static size_t sparse_scan(const uint8_t *p, const size_t len, const uint32_t pattern, uint8_t *o, uint8_t *a) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_cmpeq_epi8(zero, zero);
+	const __m128i pat = _mm_set1_epi32((int) pattern);
+	__m128i vo = zero;
+	__m128i va = ones;
+	size_t done = 0;
+	int is_zero = 1, is_ones = 1;
+
+	while (len - done >= SPARSE_STRIDE) {
+		for (size_t i = 0; i < SPARSE_STRIDE; i += 64) {
+			const __m128i v0 = _mm_loadu_si128((const __m128i *) (p + done + i + 0x00));
+			const __m128i v1 = _mm_loadu_si128((const __m128i *) (p + done + i + 0x10));
+			const __m128i v2 = _mm_loadu_si128((const __m128i *) (p + done + i + 0x20));
+			const __m128i v3 = _mm_loadu_si128((const __m128i *) (p + done + i + 0x30));
+			const __m128i x = _mm_or_si128(_mm_or_si128(_mm_xor_si128(v0, pat), _mm_xor_si128(v1, pat)),
+			                               _mm_or_si128(_mm_xor_si128(v2, pat), _mm_xor_si128(v3, pat)));
+			vo = _mm_or_si128(vo, x);
+			va = _mm_and_si128(va, _mm_and_si128(_mm_and_si128(v0, v1), _mm_and_si128(v2, v3)));
+		}
+		done += SPARSE_STRIDE;
+		is_zero = _mm_movemask_epi8(_mm_cmpeq_epi8(vo, zero)) == 0xffff;
+		is_ones = _mm_movemask_epi8(_mm_cmpeq_epi8(va, ones)) == 0xffff;
+		if (!is_zero && !is_ones)
+			break;
+	}
+	*o = is_zero ? 0x00 : 0x01;
+	*a = is_ones ? 0xff : 0x00;
+	return done;
+}
+#elif defined(SPARSE_NEON)
+static size_t sparse_scan(const uint8_t *p, const size_t len, const uint32_t pattern, uint8_t *o, uint8_t *a) {
+	const uint8x16_t pat = vreinterpretq_u8_u32(vdupq_n_u32(pattern));
+	uint8x16_t vo = vdupq_n_u8(0x00);
+	uint8x16_t va = vdupq_n_u8(0xff);
+	size_t done = 0;
+
+	while (len - done >= SPARSE_STRIDE) {
+		for (size_t i = 0; i < SPARSE_STRIDE; i += 64) {
+			const uint8x16_t v0 = vld1q_u8(p + done + i + 0x00);
+			const uint8x16_t v1 = vld1q_u8(p + done + i + 0x10);
+			const uint8x16_t v2 = vld1q_u8(p + done + i + 0x20);
+			const uint8x16_t v3 = vld1q_u8(p + done + i + 0x30);
+			const uint8x16_t x = vorrq_u8(vorrq_u8(veorq_u8(v0, pat), veorq_u8(v1, pat)),
+			                              vorrq_u8(veorq_u8(v2, pat), veorq_u8(v3, pat)));
+			vo = vorrq_u8(vo, x);
+			va = vandq_u8(va, vandq_u8(vandq_u8(v0, v1), vandq_u8(v2, v3)));
+		}
+		done += SPARSE_STRIDE;
+		if (vmaxvq_u8(vo) != 0x00 && vminvq_u8(va) != 0xff)
+			break;
+	}
+	*o = vmaxvq_u8(vo);
+	*a = vminvq_u8(va);
+	return done;
+}
+#else
+static size_t sparse_scan(const uint8_t *p, const size_t len, const uint32_t pattern, uint8_t *o, uint8_t *a) {
+	const uint64_t pat = (uint64_t) pattern << 32 | pattern;
+	uint64_t wo = 0;
+	uint64_t wa = ~(uint64_t) 0;
+	size_t done = 0;
+
+	while (len - done >= SPARSE_STRIDE) {
+		for (size_t i = 0; i < SPARSE_STRIDE; i += sizeof(uint64_t)) {
+			uint64_t w;
+			memcpy(&w, p + done + i, sizeof(w));
+			wo |= w ^ pat;
+			wa &= w;
+		}
+		done += SPARSE_STRIDE;
+		if (wo != 0 && wa != ~(uint64_t) 0)
+			break;
+	}
+	*o = wo ? 0x01 : 0x00;
+	*a = wa == ~(uint64_t) 0 ? 0xff : 0x00;
+	return done;
+}
+#endif
+
+enum sunxi_efex_sparse_fill_t sunxi_efex_sparse_classify(const void *buf, const size_t len) {
+	const uint8_t *p = buf;
+	if (!p || !len)
+		return SUNXI_EFEX_SPARSE_DATA;
+
+	uint8_t o, a;
+	const size_t done = sparse_scan(p, len, 0, &o, &a);
+	if (o != 0x00 && a != 0xff)
+		return SUNXI_EFEX_SPARSE_DATA;
+	for (size_t i = done; i < len; i++) {
+		o |= p[i];
+		a &= p[i];
+	}
+	if (o == 0x00)
+		return SUNXI_EFEX_SPARSE_ZERO;
+	return a == 0xff ? SUNXI_EFEX_SPARSE_ERASED : SUNXI_EFEX_SPARSE_DATA;
+}
+
+int sunxi_efex_sparse_uniform(const void *buf, const size_t len, uint32_t *value) {
+	const uint8_t *p = buf;
+	if (!p || len < sizeof(uint32_t) || len % sizeof(uint32_t) != 0)
+		return 0;
+
+	uint32_t pattern;
+	memcpy(&pattern, p, sizeof(pattern));
+	uint8_t o, a;
+	const size_t done = sparse_scan(p, len, pattern, &o, &a);
+	// Strides keep the tail in step with the pattern
+	for (size_t i = done; i < len && o == 0x00; i++)
+		o |= p[i] ^ p[i % sizeof(uint32_t)];
+	if (o != 0x00)
+		return 0;
+	if (value)
+		*value = pattern;
+	return 1;
+}
+
+static uint16_t simg_le16(const char *p) {
+	uint16_t v;
+	memcpy(&v, p, sizeof(v));
+	return le16_to_cpu(v);
+}
+
+static uint32_t simg_le32(const char *p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return le32_to_cpu(v);
+}
+
+int sunxi_efex_simg_check(const void *data, const uint64_t size) {
+	return data && size >= SIMG_FILE_HDR_SZ && simg_le32(data) == SUNXI_EFEX_SIMG_MAGIC;
+}
+
+int sunxi_efex_simg_open(struct sunxi_efex_simg_t *simg, const void *data, const uint64_t size) {
+	if (!simg || !data) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	memset(simg, 0, sizeof(*simg));
+	if (!sunxi_efex_simg_check(data, size)) {
+		return EFEX_ERR_FILE_FORMAT;
+	}
+
+	// magic, major, minor, file_hdr_sz, chunk_hdr_sz, blk_sz, total_blks, total_chunks, image_checksum
+	const char *h = data;
+	const uint16_t major = simg_le16(h + 4);
+	const uint16_t file_hdr_sz = simg_le16(h + 8);
+	const uint16_t chunk_hdr_sz = simg_le16(h + 10);
+	const uint32_t blk_sz = simg_le32(h + 12);
+	if (major != 1 || file_hdr_sz < SIMG_FILE_HDR_SZ || file_hdr_sz > size || chunk_hdr_sz < SIMG_CHUNK_HDR_SZ ||
+	    blk_sz == 0 || blk_sz % 4 != 0) {
+		return EFEX_ERR_FILE_FORMAT;
+	}
+
+	simg->data = data;
+	simg->size = size;
+	simg->blk_sz = blk_sz;
+	simg->total_blks = simg_le32(h + 16);
+	simg->total_chunks = simg_le32(h + 20);
+	simg->pos = file_hdr_sz;
+	simg->chunk_hdr_sz = chunk_hdr_sz;
+	return EFEX_ERR_SUCCESS;
+}
+
+int sunxi_efex_simg_next(struct sunxi_efex_simg_t *simg, struct sunxi_efex_simg_chunk_t *chunk) {
+	if (!simg || !chunk || !simg->data) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	if (simg->chunk == simg->total_chunks) {
+		// Every block of the image must have been described by then
+		return simg->blk == simg->total_blks ? 0 : EFEX_ERR_FILE_FORMAT;
+	}
+	if (simg->size - simg->pos < simg->chunk_hdr_sz) {
+		return EFEX_ERR_FILE_FORMAT;
+	}
+
+	// chunk_type, reserved, chunk_sz in blocks, total_sz in bytes including the header
+	const char *h = simg->data + simg->pos;
+	const uint16_t type = simg_le16(h);
+	const uint32_t blocks = simg_le32(h + 4);
+	const uint32_t total_sz = simg_le32(h + 8);
+	const uint64_t body = (uint64_t) total_sz - simg->chunk_hdr_sz;
+	if (total_sz < simg->chunk_hdr_sz || simg->size - simg->pos < total_sz ||
+	    blocks > simg->total_blks - simg->blk) {
+		return EFEX_ERR_FILE_FORMAT;
+	}
+
+	chunk->type = (enum sunxi_efex_simg_chunk_type_t) type;
+	chunk->offset = (uint64_t) simg->blk * simg->blk_sz;
+	chunk->len = (uint64_t) blocks * simg->blk_sz;
+	chunk->data = NULL;
+	chunk->value = 0;
+	switch (type) {
+		case SUNXI_EFEX_SIMG_RAW:
+			if (body != chunk->len)
+				return EFEX_ERR_FILE_FORMAT;
+			chunk->data = h + simg->chunk_hdr_sz;
+			break;
+		case SUNXI_EFEX_SIMG_FILL:
+			if (body != sizeof(uint32_t))
+				return EFEX_ERR_FILE_FORMAT;
+			// Kept in file byte order, it is only ever copied out again
+			memcpy(&chunk->value, h + simg->chunk_hdr_sz, sizeof(uint32_t));
+			break;
+		case SUNXI_EFEX_SIMG_DONT_CARE:
+			if (body != 0)
+				return EFEX_ERR_FILE_FORMAT;
+			break;
+		case SUNXI_EFEX_SIMG_CRC32:
+			if (body != sizeof(uint32_t) || blocks != 0)
+				return EFEX_ERR_FILE_FORMAT;
+			chunk->value = simg_le32(h + simg->chunk_hdr_sz);
+			break;
+		default:
+			return EFEX_ERR_FILE_FORMAT;
+	}
+
+	simg->pos += total_sz;
+	simg->blk += blocks;
+	simg->chunk++;
+	return 1;
+}
+
+uint64_t sunxi_efex_simg_size(const struct sunxi_efex_simg_t *simg) {
+	return simg ? (uint64_t) simg->total_blks * simg->blk_sz : 0;
+}
+
+static void simg_put16(char *p, const uint16_t v) {
+	const uint16_t le = cpu_to_le16(v);
+	memcpy(p, &le, sizeof(le));
+}
+
+static void simg_put32(char *p, const uint32_t v) {
+	const uint32_t le = cpu_to_le32(v);
+	memcpy(p, &le, sizeof(le));
+}
+
+static int sparse_sink_put(struct sunxi_efex_sparse_sink_t *sink, const void *buf, const size_t len) {
+	if (fwrite(buf, 1, len, sink->fp) != len) {
+		return EFEX_ERR_FILE_WRITE;
+	}
+	sink->written += len;
+	return EFEX_ERR_SUCCESS;
+}
+
+static int sparse_sink_put_at(struct sunxi_efex_sparse_sink_t *sink, const uint64_t off, const void *buf,
+                              const size_t len) {
+	if (sparse_fseek(sink->fp, (sparse_off_t) off, SEEK_SET) != 0 || fwrite(buf, 1, len, sink->fp) != len) {
+		return EFEX_ERR_FILE_WRITE;
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+static int sparse_sink_simg_header(struct sunxi_efex_sparse_sink_t *sink) {
+	char h[SIMG_FILE_HDR_SZ] = {0};
+	simg_put32(h, SUNXI_EFEX_SIMG_MAGIC);
+	simg_put16(h + 4, 1);
+	simg_put16(h + 8, SIMG_FILE_HDR_SZ);
+	simg_put16(h + 10, SIMG_CHUNK_HDR_SZ);
+	simg_put32(h + 12, SUNXI_EFEX_SPARSE_BLOCK);
+	simg_put32(h + 16, sink->blocks);
+	simg_put32(h + 20, sink->chunks);
+	return sparse_sink_put_at(sink, 0, h, sizeof(h));
+}
+
+static void sparse_sink_chunk_header(char *h, const uint16_t type, const uint32_t blocks, const uint32_t body) {
+	memset(h, 0, SIMG_CHUNK_HDR_SZ);
+	simg_put16(h, type);
+	simg_put32(h + 4, blocks);
+	simg_put32(h + 8, SIMG_CHUNK_HDR_SZ + body);
+}
+
+// Closes the current run: the chunk is completed and the run goes into the block map
+static int sparse_sink_end_run(struct sunxi_efex_sparse_sink_t *sink) {
+	if (!sink->run_blocks) {
+		return EFEX_ERR_SUCCESS;
+	}
+	int ret = EFEX_ERR_SUCCESS;
+	if (sink->format == SUNXI_EFEX_SPARSE_SIMG) {
+		char h[SIMG_CHUNK_HDR_SZ + sizeof(uint32_t)];
+		if (sink->run_type == SUNXI_EFEX_SIMG_RAW) {
+			// The header went out as a placeholder before the data
+			sparse_sink_chunk_header(h, SUNXI_EFEX_SIMG_RAW, sink->run_blocks,
+			                         sink->run_blocks * SUNXI_EFEX_SPARSE_BLOCK);
+			ret = sparse_sink_put_at(sink, sink->run_hdr, h, SIMG_CHUNK_HDR_SZ);
+			if (ret == EFEX_ERR_SUCCESS && sparse_fseek(sink->fp, 0, SEEK_END) != 0) {
+				ret = EFEX_ERR_FILE_WRITE;
+			}
+		} else {
+			sparse_sink_chunk_header(h, SUNXI_EFEX_SIMG_FILL, sink->run_blocks, sizeof(uint32_t));
+			memcpy(h + SIMG_CHUNK_HDR_SZ, &sink->run_value, sizeof(uint32_t));
+			ret = sparse_sink_put(sink, h, sizeof(h));
+		}
+		sink->chunks++;
+	}
+	if (ret == EFEX_ERR_SUCCESS && sink->map) {
+		const int n = sink->run_type == SUNXI_EFEX_SIMG_RAW
+		                      ? fprintf(sink->map, "%u %u data\n", sink->run_start, sink->run_blocks)
+		                      : fprintf(sink->map, "%u %u fill 0x%08x\n", sink->run_start, sink->run_blocks,
+		                                le32_to_cpu(sink->run_value));
+		if (n < 0) {
+			ret = EFEX_ERR_FILE_WRITE;
+		}
+	}
+	sink->run_blocks = 0;
+	return ret;
+}
+
+// Adds a block of the given type to the current run, closing it first when the block does not fit
+static int sparse_sink_run(struct sunxi_efex_sparse_sink_t *sink, const uint16_t type, const uint32_t value) {
+	if (sink->blocks == UINT32_MAX) {
+		return EFEX_ERR_FILE_SIZE;
+	}
+
+	int ret = EFEX_ERR_SUCCESS;
+	if (sink->run_blocks && (type != sink->run_type || (type == SUNXI_EFEX_SIMG_FILL && value != sink->run_value) ||
+	                         (type == SUNXI_EFEX_SIMG_RAW && sink->run_blocks == SIMG_MAX_RAW_BLOCKS))) {
+		ret = sparse_sink_end_run(sink);
+		if (ret != EFEX_ERR_SUCCESS) {
+			return ret;
+		}
+	}
+	if (!sink->run_blocks) {
+		sink->run_type = type;
+		sink->run_value = value;
+		sink->run_start = sink->blocks;
+		if (sink->format == SUNXI_EFEX_SPARSE_SIMG && type == SUNXI_EFEX_SIMG_RAW) {
+			char h[SIMG_CHUNK_HDR_SZ] = {0};
+			sink->run_hdr = sink->written;
+			ret = sparse_sink_put(sink, h, sizeof(h));
+		}
+	}
+	sink->run_blocks++;
+	sink->blocks++;
+	return ret;
+}
+
+static int sparse_sink_block(struct sunxi_efex_sparse_sink_t *sink, const char *block) {
+	uint32_t value = 0;
+	const uint16_t type = sunxi_efex_sparse_uniform(block, SUNXI_EFEX_SPARSE_BLOCK, &value) ? SUNXI_EFEX_SIMG_FILL
+	                                                                                         : SUNXI_EFEX_SIMG_RAW;
+	const int ret = sparse_sink_run(sink, type, value);
+	if (ret != EFEX_ERR_SUCCESS) {
+		return ret;
+	}
+
+	if (sink->format == SUNXI_EFEX_SPARSE_SIMG) {
+		return type == SUNXI_EFEX_SIMG_RAW ? sparse_sink_put(sink, block, SUNXI_EFEX_SPARSE_BLOCK) : EFEX_ERR_SUCCESS;
+	}
+	// Zero blocks become holes, the next data block is written past them
+	if (type == SUNXI_EFEX_SIMG_FILL && value == 0) {
+		sink->seek = 1;
+		return EFEX_ERR_SUCCESS;
+	}
+	if (sink->seek) {
+		const uint64_t off = (uint64_t) (sink->blocks - 1) * SUNXI_EFEX_SPARSE_BLOCK;
+		if (sparse_fseek(sink->fp, (sparse_off_t) off, SEEK_SET) != 0) {
+			return EFEX_ERR_FILE_WRITE;
+		}
+		sink->seek = 0;
+	}
+	return sparse_sink_put(sink, block, SUNXI_EFEX_SPARSE_BLOCK);
+}
+
+int sunxi_efex_sparse_sink_open(struct sunxi_efex_sparse_sink_t *sink, const char *path,
+                                const enum sunxi_efex_sparse_format_t format, const char *map_path) {
+	if (!sink || !path) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	memset(sink, 0, sizeof(*sink));
+	if (format != SUNXI_EFEX_SPARSE_HOLES && format != SUNXI_EFEX_SPARSE_SIMG) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+	sink->format = format;
+	sink->fp = fopen(path, "wb");
+	if (!sink->fp) {
+		return EFEX_ERR_FILE_OPEN;
+	}
+#ifdef _WIN32
+	// NTFS only leaves holes in files marked sparse
+	if (format == SUNXI_EFEX_SPARSE_HOLES) {
+		DWORD bytes;
+		DeviceIoControl((HANDLE) _get_osfhandle(_fileno(sink->fp)), FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &bytes,
+		                NULL);
+	}
+#endif
+	if (map_path) {
+		sink->map = fopen(map_path, "w");
+		if (!sink->map) {
+			fclose(sink->fp);
+			sink->fp = NULL;
+			return EFEX_ERR_FILE_OPEN;
+		}
+	}
+	// The sparse image header is rewritten with the final counts on close
+	if (format == SUNXI_EFEX_SPARSE_SIMG) {
+		char h[SIMG_FILE_HDR_SZ] = {0};
+		sink->error = sparse_sink_put(sink, h, sizeof(h));
+	}
+	if (sink->error != EFEX_ERR_SUCCESS) {
+		fclose(sink->fp);
+		if (sink->map) {
+			fclose(sink->map);
+		}
+		sink->fp = NULL;
+		sink->map = NULL;
+	}
+	return sink->error;
+}
+
+int sunxi_efex_sparse_sink_write(void *user, const char *buf, size_t len) {
+	struct sunxi_efex_sparse_sink_t *sink = user;
+	if (!sink || !sink->fp || !buf) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	while (len > 0 && sink->error == EFEX_ERR_SUCCESS) {
+		// Whole blocks are classified in place, only a partial one is copied
+		if (sink->fill == 0 && len >= SUNXI_EFEX_SPARSE_BLOCK) {
+			sink->error = sparse_sink_block(sink, buf);
+			buf += SUNXI_EFEX_SPARSE_BLOCK;
+			len -= SUNXI_EFEX_SPARSE_BLOCK;
+			sink->size += SUNXI_EFEX_SPARSE_BLOCK;
+			continue;
+		}
+		const size_t n = SUNXI_EFEX_SPARSE_BLOCK - sink->fill < len ? SUNXI_EFEX_SPARSE_BLOCK - sink->fill : len;
+		memcpy(sink->block + sink->fill, buf, n);
+		sink->fill += n;
+		buf += n;
+		len -= n;
+		sink->size += n;
+		if (sink->fill == SUNXI_EFEX_SPARSE_BLOCK) {
+			sink->fill = 0;
+			sink->error = sparse_sink_block(sink, sink->block);
+		}
+	}
+	return sink->error;
+}
+
+static int sparse_sink_truncate(FILE *fp, const uint64_t size) {
+	if (fflush(fp) != 0) {
+		return EFEX_ERR_FILE_WRITE;
+	}
+#ifdef _WIN32
+	return _chsize_s(_fileno(fp), (__int64) size) == 0 ? EFEX_ERR_SUCCESS : EFEX_ERR_FILE_WRITE;
+#else
+	return ftruncate(fileno(fp), (sparse_off_t) size) == 0 ? EFEX_ERR_SUCCESS : EFEX_ERR_FILE_WRITE;
+#endif
+}
+
+int sunxi_efex_sparse_sink_close(struct sunxi_efex_sparse_sink_t *sink) {
+	if (!sink || !sink->fp) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	int ret = sink->error;
+	if (ret == EFEX_ERR_SUCCESS && sink->fill > 0) {
+		if (sink->format == SUNXI_EFEX_SPARSE_SIMG) {
+			// A sparse image holds whole blocks only
+			memset(sink->block + sink->fill, 0, SUNXI_EFEX_SPARSE_BLOCK - sink->fill);
+			ret = sparse_sink_block(sink, sink->block);
+		} else if (sunxi_efex_sparse_classify(sink->block, sink->fill) == SUNXI_EFEX_SPARSE_ZERO) {
+			// The tail still counts as a block in the map, a zero one stays a hole
+			ret = sparse_sink_run(sink, SUNXI_EFEX_SIMG_FILL, 0);
+		} else {
+			ret = sparse_sink_run(sink, SUNXI_EFEX_SIMG_RAW, 0);
+			if (ret == EFEX_ERR_SUCCESS && sink->seek &&
+			    sparse_fseek(sink->fp, (sparse_off_t) (sink->size - sink->fill), SEEK_SET) != 0) {
+				ret = EFEX_ERR_FILE_WRITE;
+			}
+			sink->seek = 0;
+			if (ret == EFEX_ERR_SUCCESS) {
+				ret = sparse_sink_put(sink, sink->block, sink->fill);
+			}
+		}
+	}
+	if (ret == EFEX_ERR_SUCCESS) {
+		ret = sparse_sink_end_run(sink);
+	}
+	if (ret == EFEX_ERR_SUCCESS) {
+		// The header gets the final counts, a plain image is extended over a trailing hole
+		ret = sink->format == SUNXI_EFEX_SPARSE_SIMG ? sparse_sink_simg_header(sink)
+		                                             : sparse_sink_truncate(sink->fp, sink->size);
+	}
+	if (fclose(sink->fp) != 0 && ret == EFEX_ERR_SUCCESS) {
+		ret = EFEX_ERR_FILE_WRITE;
+	}
+	if (sink->map && fclose(sink->map) != 0 && ret == EFEX_ERR_SUCCESS) {
+		ret = EFEX_ERR_FILE_WRITE;
+	}
+	sink->fp = NULL;
+	sink->map = NULL;
+	return ret;
+}
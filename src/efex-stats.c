@@ -0,0 +1,144 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "efex-common.h"
+#include "efex-protocol.h"
+#include "efex-stats.h"
+
+int sunxi_efex_stats_enable(struct sunxi_efex_ctx_t *ctx, const int enable) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	if (!enable) {
+		sunxi_efex_stats_release(ctx);
+		return EFEX_ERR_SUCCESS;
+	}
+
+	if (!ctx->stats) {
+		ctx->stats = calloc(1, sizeof(*ctx->stats));
+		if (!ctx->stats)
+			return EFEX_ERR_MEMORY;
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+int sunxi_efex_stats_get(const struct sunxi_efex_ctx_t *ctx, struct sunxi_efex_stats_t *stats) {
+	if (!ctx || !stats) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	if (!ctx->stats) {
+		return EFEX_ERR_NOT_SUPPORT;
+	}
+	*stats = *ctx->stats;
+	return EFEX_ERR_SUCCESS;
+}
+
+int sunxi_efex_stats_reset(struct sunxi_efex_ctx_t *ctx) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	if (!ctx->stats) {
+		return EFEX_ERR_NOT_SUPPORT;
+	}
+	memset(ctx->stats, 0, sizeof(*ctx->stats));
+	return EFEX_ERR_SUCCESS;
+}
+
+static unsigned int sunxi_efex_histogram_bucket(const uint64_t usec) {
+	unsigned int bucket = 0;
+	for (uint64_t v = usec >> 1; v && bucket < SUNXI_EFEX_STATS_BUCKETS - 1; v >>= 1)
+		bucket++;
+	return bucket;
+}
+
+uint64_t sunxi_efex_histogram_percentile(const struct sunxi_efex_histogram_t *hist, const unsigned int percent) {
+	if (!hist || hist->count == 0) {
+		return 0;
+	}
+
+	const uint64_t rank = (hist->count * (percent > 100 ? 100 : percent) + 99) / 100;
+	uint64_t seen = 0;
+	for (unsigned int i = 0; i < SUNXI_EFEX_STATS_BUCKETS - 1; i++) {
+		seen += hist->buckets[i];
+		if (seen >= rank && seen > 0)
+			return (2ULL << i) < hist->max_us ? (2ULL << i) : hist->max_us;
+	}
+	return hist->max_us;
+}
+
+void sunxi_efex_stats_cmd(const struct sunxi_efex_ctx_t *ctx, const uint32_t cmd) {
+	if (!ctx || !ctx->stats) {
+		return;
+	}
+
+	struct sunxi_efex_stats_t *stats = ctx->stats;
+	stats->cmd = cmd;
+	for (size_t i = 0; i < SUNXI_EFEX_STATS_CMDS; i++) {
+		struct sunxi_efex_cmd_stats_t *c = &stats->cmds[i];
+		// The last slot takes whatever does not fit any more
+		if (c->cmd == 0 || c->cmd == cmd || i == SUNXI_EFEX_STATS_CMDS - 1) {
+			c->cmd = c->cmd ? c->cmd : cmd;
+			c->issued++;
+			return;
+		}
+	}
+}
+
+void sunxi_efex_stats_xfer(const struct sunxi_efex_ctx_t *ctx, const enum sunxi_efex_stats_phase_t phase,
+                           const enum sunxi_efex_stats_dir_t dir, const size_t len, const uint64_t usec,
+                           const int error) {
+	if (!ctx || !ctx->stats) {
+		return;
+	}
+
+	struct sunxi_efex_stats_t *stats = ctx->stats;
+	if (error == EFEX_ERR_USB_TIMEOUT) {
+		stats->timeouts++;
+	} else if (error < 0) {
+		stats->errors++;
+	}
+
+	struct sunxi_efex_histogram_t *hist = &stats->phases[phase];
+	hist->count++;
+	hist->total_us += usec;
+	if (usec > hist->max_us)
+		hist->max_us = usec;
+	hist->buckets[sunxi_efex_histogram_bucket(usec)]++;
+
+	if (error >= 0)
+		sunxi_efex_stats_count(ctx, dir, len);
+}
+
+void sunxi_efex_stats_count(const struct sunxi_efex_ctx_t *ctx, const enum sunxi_efex_stats_dir_t dir,
+                            const size_t len) {
+	// Nothing issued yet to account the bytes to
+	if (!ctx || !ctx->stats || ctx->stats->cmd == 0) {
+		return;
+	}
+
+	struct sunxi_efex_stats_t *stats = ctx->stats;
+	for (size_t i = 0; i < SUNXI_EFEX_STATS_CMDS; i++) {
+		struct sunxi_efex_cmd_stats_t *c = &stats->cmds[i];
+		if (c->cmd == stats->cmd || i == SUNXI_EFEX_STATS_CMDS - 1) {
+			c->transfers[dir]++;
+			c->bytes[dir] += len;
+			return;
+		}
+	}
+}
+
+void sunxi_efex_stats_retry(const struct sunxi_efex_ctx_t *ctx) {
+	if (ctx && ctx->stats) {
+		ctx->stats->retries++;
+	}
+}
+
+void sunxi_efex_stats_release(struct sunxi_efex_ctx_t *ctx) {
+	if (!ctx) {
+		return;
+	}
+	free(ctx->stats);
+	ctx->stats = NULL;
+}
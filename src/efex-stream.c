@@ -0,0 +1,416 @@
+// O_DIRECT is only declared by glibc with the GNU extensions
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "efex-stream.h"
+#include "efex-thread.h"
+
+struct sunxi_efex_stream_ring_t {
+	sunxi_efex_stream_reader_t reader;
+	sunxi_efex_stream_writer_t writer;
+	void *user;
+	uint64_t remain;    /* Bytes the reader has yet to supply, only touched by whoever fills */
+	uint32_t slot_size; /* SUNXI_EFEX_STREAM_SLOT_SIZE, less for a shorter transfer */
+	char *slot[SUNXI_EFEX_STREAM_SLOTS];
+	uint32_t fill[SUNXI_EFEX_STREAM_SLOTS];
+	sunxi_efex_mutex_t lock;
+	sunxi_efex_cond_t cond;
+	/* Under lock */
+	uint64_t produced;
+	uint64_t consumed;
+	int error;
+	int stop;
+};
+
+static void *sunxi_efex_stream_alloc(const size_t len) {
+#ifdef _WIN32
+	return _aligned_malloc(len, SUNXI_EFEX_STREAM_ALIGN);
+#else
+	void *p = NULL;
+	return posix_memalign(&p, SUNXI_EFEX_STREAM_ALIGN, len) == 0 ? p : NULL;
+#endif
+}
+
+static void sunxi_efex_stream_free(void *p) {
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+static void sunxi_efex_stream_ring_release(struct sunxi_efex_stream_ring_t *r) {
+	sunxi_efex_cond_destroy(&r->cond);
+	sunxi_efex_mutex_destroy(&r->lock);
+	for (size_t i = 0; i < SUNXI_EFEX_STREAM_SLOTS; i++) {
+		sunxi_efex_stream_free(r->slot[i]);
+	}
+}
+
+static int sunxi_efex_stream_ring_init(struct sunxi_efex_stream_ring_t *r, const uint64_t total_len) {
+	r->remain = total_len;
+	r->slot_size = total_len < SUNXI_EFEX_STREAM_SLOT_SIZE ? (uint32_t) total_len : SUNXI_EFEX_STREAM_SLOT_SIZE;
+	const size_t alloc = ((size_t) r->slot_size + SUNXI_EFEX_STREAM_ALIGN - 1) & ~(size_t) (SUNXI_EFEX_STREAM_ALIGN - 1);
+	sunxi_efex_mutex_init(&r->lock);
+	sunxi_efex_cond_init(&r->cond);
+	for (size_t i = 0; i < SUNXI_EFEX_STREAM_SLOTS; i++) {
+		r->slot[i] = sunxi_efex_stream_alloc(alloc);
+		if (!r->slot[i]) {
+			sunxi_efex_stream_ring_release(r);
+			return EFEX_ERR_MEMORY;
+		}
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+// Ends the helper thread once it has nothing left to do
+static void sunxi_efex_stream_ring_stop(struct sunxi_efex_stream_ring_t *r, const sunxi_efex_thread_t thread) {
+	sunxi_efex_mutex_lock(&r->lock);
+	r->stop = 1;
+	sunxi_efex_cond_broadcast(&r->cond);
+	sunxi_efex_mutex_unlock(&r->lock);
+	sunxi_efex_thread_join(thread);
+}
+
+// Fills a slot from the reader, short reads are repeated until the slot or the data is complete
+static int sunxi_efex_stream_fill(struct sunxi_efex_stream_ring_t *r, const size_t i) {
+	const uint32_t want = r->remain < r->slot_size ? (uint32_t) r->remain : r->slot_size;
+	uint32_t got = 0;
+	while (got < want) {
+		const ssize_t n = r->reader(r->user, r->slot[i] + got, want - got);
+		if (n < 0) {
+			return (int) n;
+		}
+		// The data ended before total_len
+		if (n == 0 || (size_t) n > want - got) {
+			return EFEX_ERR_FILE_READ;
+		}
+		got += (uint32_t) n;
+	}
+	r->remain -= want;
+	r->fill[i] = want;
+	return EFEX_ERR_SUCCESS;
+}
+
+// Reads ahead of the transfers for as long as a slot is free
+static void *sunxi_efex_stream_reader_thread(void *arg) {
+	struct sunxi_efex_stream_ring_t *r = arg;
+	for (;;) {
+		sunxi_efex_mutex_lock(&r->lock);
+		while (!r->stop && r->produced - r->consumed == SUNXI_EFEX_STREAM_SLOTS) {
+			sunxi_efex_cond_wait(&r->cond, &r->lock);
+		}
+		const int done = r->stop || r->remain == 0;
+		const size_t i = (size_t) (r->produced % SUNXI_EFEX_STREAM_SLOTS);
+		sunxi_efex_mutex_unlock(&r->lock);
+		if (done) {
+			return NULL;
+		}
+
+		const int ret = sunxi_efex_stream_fill(r, i);
+		sunxi_efex_mutex_lock(&r->lock);
+		if (ret == EFEX_ERR_SUCCESS) {
+			r->produced++;
+		} else {
+			r->error = ret;
+		}
+		sunxi_efex_cond_broadcast(&r->cond);
+		sunxi_efex_mutex_unlock(&r->lock);
+		if (ret != EFEX_ERR_SUCCESS) {
+			return NULL;
+		}
+	}
+}
+
+// Writes behind the transfers until stopped and drained
+static void *sunxi_efex_stream_writer_thread(void *arg) {
+	struct sunxi_efex_stream_ring_t *r = arg;
+	for (;;) {
+		sunxi_efex_mutex_lock(&r->lock);
+		while (!r->stop && r->produced == r->consumed) {
+			sunxi_efex_cond_wait(&r->cond, &r->lock);
+		}
+		const int done = r->produced == r->consumed;
+		const size_t i = (size_t) (r->consumed % SUNXI_EFEX_STREAM_SLOTS);
+		sunxi_efex_mutex_unlock(&r->lock);
+		if (done) {
+			return NULL;
+		}
+
+		const int ret = r->writer(r->user, r->slot[i], r->fill[i]);
+		sunxi_efex_mutex_lock(&r->lock);
+		if (ret == EFEX_ERR_SUCCESS) {
+			r->consumed++;
+		} else {
+			r->error = ret;
+		}
+		sunxi_efex_cond_broadcast(&r->cond);
+		sunxi_efex_mutex_unlock(&r->lock);
+		if (ret != EFEX_ERR_SUCCESS) {
+			return NULL;
+		}
+	}
+}
+
+int sunxi_efex_stream_down(const sunxi_efex_stream_reader_t reader, void *user, const uint64_t total_len,
+                           const sunxi_efex_stream_xfer_t xfer, void *arg) {
+	if (!reader || !xfer) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	if (total_len == 0) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+
+	struct sunxi_efex_stream_ring_t r = {
+			.reader = reader,
+			.user = user,
+	};
+	int ret = sunxi_efex_stream_ring_init(&r, total_len);
+	if (ret != EFEX_ERR_SUCCESS) {
+		return ret;
+	}
+
+	// Without a reader thread the calling thread reads each slot before sending it
+	sunxi_efex_thread_t thread;
+	const int threaded = sunxi_efex_thread_create(&thread, sunxi_efex_stream_reader_thread, &r) == 0;
+
+	uint64_t sent = 0;
+	while (sent < total_len && ret == EFEX_ERR_SUCCESS) {
+		const size_t i = (size_t) (r.consumed % SUNXI_EFEX_STREAM_SLOTS);
+		if (threaded) {
+			sunxi_efex_mutex_lock(&r.lock);
+			while (r.produced == r.consumed && r.error == EFEX_ERR_SUCCESS) {
+				sunxi_efex_cond_wait(&r.cond, &r.lock);
+			}
+			// Slots read before a reader error still go out, the error ends the download after them
+			if (r.produced == r.consumed) {
+				ret = r.error;
+			}
+			sunxi_efex_mutex_unlock(&r.lock);
+		} else {
+			ret = sunxi_efex_stream_fill(&r, i);
+		}
+		if (ret != EFEX_ERR_SUCCESS) {
+			break;
+		}
+
+		sent += r.fill[i];
+		ret = xfer(arg, r.slot[i], r.fill[i], sent == total_len);
+
+		sunxi_efex_mutex_lock(&r.lock);
+		r.consumed++;
+		sunxi_efex_cond_broadcast(&r.cond);
+		sunxi_efex_mutex_unlock(&r.lock);
+	}
+
+	if (threaded) {
+		sunxi_efex_stream_ring_stop(&r, thread);
+	}
+	sunxi_efex_stream_ring_release(&r);
+	return ret;
+}
+
+int sunxi_efex_stream_up(const sunxi_efex_stream_writer_t writer, void *user, const uint64_t total_len,
+                         const sunxi_efex_stream_xfer_t xfer, void *arg) {
+	if (!writer || !xfer) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	if (total_len == 0) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+
+	struct sunxi_efex_stream_ring_t r = {
+			.writer = writer,
+			.user = user,
+	};
+	int ret = sunxi_efex_stream_ring_init(&r, total_len);
+	if (ret != EFEX_ERR_SUCCESS) {
+		return ret;
+	}
+
+	// Without a writer thread the calling thread writes each slot out before receiving the next
+	sunxi_efex_thread_t thread;
+	const int threaded = sunxi_efex_thread_create(&thread, sunxi_efex_stream_writer_thread, &r) == 0;
+
+	uint64_t received = 0;
+	while (received < total_len && ret == EFEX_ERR_SUCCESS) {
+		if (threaded) {
+			sunxi_efex_mutex_lock(&r.lock);
+			while (r.produced - r.consumed == SUNXI_EFEX_STREAM_SLOTS && r.error == EFEX_ERR_SUCCESS) {
+				sunxi_efex_cond_wait(&r.cond, &r.lock);
+			}
+			ret = r.error;
+			sunxi_efex_mutex_unlock(&r.lock);
+			if (ret != EFEX_ERR_SUCCESS) {
+				break;
+			}
+		}
+
+		const size_t i = (size_t) (r.produced % SUNXI_EFEX_STREAM_SLOTS);
+		const uint64_t left = total_len - received;
+		const uint32_t len = left < r.slot_size ? (uint32_t) left : r.slot_size;
+		received += len;
+		ret = xfer(arg, r.slot[i], len, received == total_len);
+		if (ret != EFEX_ERR_SUCCESS) {
+			break;
+		}
+
+		if (threaded) {
+			sunxi_efex_mutex_lock(&r.lock);
+			r.fill[i] = len;
+			r.produced++;
+			sunxi_efex_cond_broadcast(&r.cond);
+			sunxi_efex_mutex_unlock(&r.lock);
+		} else {
+			ret = writer(user, r.slot[i], len);
+		}
+	}
+
+	// The writer drains what was received before it stops, and its error comes after the transfer's
+	if (threaded) {
+		sunxi_efex_stream_ring_stop(&r, thread);
+		if (ret == EFEX_ERR_SUCCESS) {
+			ret = r.error;
+		}
+	}
+	sunxi_efex_stream_ring_release(&r);
+	return ret;
+}
+
+#ifdef _WIN32
+int sunxi_efex_file_sink_open(struct sunxi_efex_file_sink_t *sink, const char *path, const int direct) {
+	(void) direct;
+	if (!sink || !path) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	memset(sink, 0, sizeof(*sink));
+
+	const HANDLE file = CreateFileA(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+	                                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return EFEX_ERR_FILE_OPEN;
+	}
+	sink->handle = file;
+	return EFEX_ERR_SUCCESS;
+}
+
+int sunxi_efex_file_sink_write(void *user, const char *buf, size_t len) {
+	struct sunxi_efex_file_sink_t *sink = user;
+	if (!sink || !buf) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	while (len > 0) {
+		const DWORD want = len > 0x40000000 ? 0x40000000 : (DWORD) len;
+		DWORD done = 0;
+		if (!WriteFile(sink->handle, buf, want, &done, NULL) || done == 0) {
+			return EFEX_ERR_FILE_WRITE;
+		}
+		buf += done;
+		len -= done;
+		sink->offset += done;
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+int sunxi_efex_file_sink_close(struct sunxi_efex_file_sink_t *sink) {
+	if (!sink || !sink->handle) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	const int ret = CloseHandle(sink->handle) ? EFEX_ERR_SUCCESS : EFEX_ERR_FILE_WRITE;
+	sink->handle = NULL;
+	return ret;
+}
+#else
+// Back to buffered writes, for a tail O_DIRECT cannot take or a file system that refuses it
+static void sunxi_efex_file_sink_buffered(struct sunxi_efex_file_sink_t *sink) {
+#ifdef O_DIRECT
+	const int flags = fcntl(sink->fd, F_GETFL);
+	if (flags != -1) {
+		fcntl(sink->fd, F_SETFL, flags & ~O_DIRECT);
+	}
+#endif
+	sink->direct = 0;
+}
+
+int sunxi_efex_file_sink_open(struct sunxi_efex_file_sink_t *sink, const char *path, const int direct) {
+	if (!sink || !path) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	memset(sink, 0, sizeof(*sink));
+	sink->fd = -1;
+
+	const int flags = O_WRONLY | O_CREAT | O_TRUNC;
+	int fd = -1;
+#ifdef O_DIRECT
+	if (direct) {
+		fd = open(path, flags | O_DIRECT, 0666);
+		sink->direct = fd >= 0;
+	}
+#endif
+	if (fd < 0) {
+		fd = open(path, flags, 0666);
+	}
+	if (fd < 0) {
+		return EFEX_ERR_FILE_OPEN;
+	}
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+	if (direct) {
+		sink->direct = fcntl(fd, F_NOCACHE, 1) == 0;
+	}
+#elif !defined(O_DIRECT)
+	(void) direct;
+#endif
+	sink->fd = fd;
+	return EFEX_ERR_SUCCESS;
+}
+
+int sunxi_efex_file_sink_write(void *user, const char *buf, size_t len) {
+	struct sunxi_efex_file_sink_t *sink = user;
+	if (!sink || !buf) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	if (sink->direct && ((len | (uintptr_t) buf) & (SUNXI_EFEX_STREAM_ALIGN - 1))) {
+		sunxi_efex_file_sink_buffered(sink);
+	}
+	while (len > 0) {
+		const ssize_t n = write(sink->fd, buf, len);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n < 0 && errno == EINVAL && sink->direct) {
+			sunxi_efex_file_sink_buffered(sink);
+			continue;
+		}
+		if (n <= 0) {
+			return EFEX_ERR_FILE_WRITE;
+		}
+		buf += n;
+		len -= (size_t) n;
+		sink->offset += (uint64_t) n;
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+int sunxi_efex_file_sink_close(struct sunxi_efex_file_sink_t *sink) {
+	if (!sink || sink->fd < 0) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	const int ret = close(sink->fd) == 0 ? EFEX_ERR_SUCCESS : EFEX_ERR_FILE_WRITE;
+	sink->fd = -1;
+	return ret;
+}
+#endif
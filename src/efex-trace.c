@@ -0,0 +1,272 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "efex-chunk.h"
+#include "efex-common.h"
+#include "efex-protocol.h"
+#include "efex-stats.h"
+#include "efex-thread.h"
+#include "efex-trace.h"
+#include "ending.h"
+
+/*
+ * Every record sits in a slot with a sequence word: 0 while the slot is being written, ticket + 1
+ * once it holds the record of that ticket. Writers claim tickets with one atomic add and never
+ * wait; readers copy a slot and keep the copy only if the sequence word did not move meanwhile.
+ */
+struct sunxi_efex_trace_slot_t {
+	sunxi_efex_atomic_t seq;
+	struct sunxi_efex_trace_record_t rec;
+};
+
+struct sunxi_efex_trace_t {
+	sunxi_efex_atomic_t head; // next ticket
+	uint64_t mask;            // slots - 1
+	uint64_t epoch;           // sunxi_efex_time_us() when enabled
+	size_t snap;
+	uint32_t cmd;
+	struct sunxi_efex_trace_slot_t slots[];
+};
+
+int sunxi_efex_trace_enable(struct sunxi_efex_ctx_t *ctx, const size_t records, size_t snap) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	sunxi_efex_trace_release(ctx);
+	if (records == 0) {
+		return EFEX_ERR_SUCCESS;
+	}
+
+	size_t slots = 1;
+	while (slots < records) {
+		slots <<= 1;
+		if (slots == 0)
+			return EFEX_ERR_INVALID_PARAM;
+	}
+	if (snap > SUNXI_EFEX_TRACE_MAX_SNAP)
+		snap = SUNXI_EFEX_TRACE_MAX_SNAP;
+
+	struct sunxi_efex_trace_t *t = calloc(1, sizeof(*t) + slots * sizeof(t->slots[0]));
+	if (!t) {
+		return EFEX_ERR_MEMORY;
+	}
+	t->mask = slots - 1;
+	t->epoch = sunxi_efex_time_us();
+	t->snap = snap;
+	ctx->trace = t;
+	return EFEX_ERR_SUCCESS;
+}
+
+void sunxi_efex_trace_cmd(const struct sunxi_efex_ctx_t *ctx, const uint32_t cmd) {
+	if (ctx && ctx->trace) {
+		ctx->trace->cmd = cmd;
+	}
+}
+
+void sunxi_efex_trace_xfer(const struct sunxi_efex_ctx_t *ctx, const int phase, const int ep, const void *buf,
+                           const size_t len, const uint64_t start, const uint64_t usec, const int status) {
+	if (!ctx || !ctx->trace) {
+		return;
+	}
+
+	struct sunxi_efex_trace_t *t = ctx->trace;
+	const uint64_t ticket = sunxi_efex_atomic_fetch_add(&t->head, 1);
+	struct sunxi_efex_trace_slot_t *slot = &t->slots[ticket & t->mask];
+
+	sunxi_efex_atomic_store(&slot->seq, 0);
+	sunxi_efex_atomic_fence();
+
+	struct sunxi_efex_trace_record_t *rec = &slot->rec;
+	rec->ts_us = start - t->epoch;
+	rec->dur_us = usec > UINT32_MAX ? UINT32_MAX : (uint32_t) usec;
+	rec->len = len > UINT32_MAX ? UINT32_MAX : (uint32_t) len;
+	rec->cmd = t->cmd;
+	rec->status = status;
+	rec->ep = (uint8_t) ep;
+	rec->phase = (uint8_t) phase;
+	// A failed IN transfer leaves nothing worth keeping in the buffer
+	rec->snap_len = 0;
+	if (buf && (status >= 0 || !(ep & 0x80))) {
+		rec->snap_len = (uint8_t) (len < t->snap ? len : t->snap);
+		memcpy(rec->data, buf, rec->snap_len);
+	}
+
+	sunxi_efex_atomic_store(&slot->seq, ticket + 1);
+}
+
+// Consistent copy of the ring, oldest first; counts records lost to overwrites or torn reads
+static size_t sunxi_efex_trace_collect(const struct sunxi_efex_trace_t *t, struct sunxi_efex_trace_record_t *records,
+                                       const size_t max, uint64_t *dropped) {
+	struct sunxi_efex_trace_t *ring = (struct sunxi_efex_trace_t *) t;
+	const uint64_t head = sunxi_efex_atomic_load(&ring->head);
+	const uint64_t first = head > t->mask + 1 ? head - (t->mask + 1) : 0;
+	size_t n = 0;
+
+	*dropped = first;
+	for (uint64_t ticket = first; ticket < head; ticket++) {
+		struct sunxi_efex_trace_slot_t *slot = &ring->slots[ticket & t->mask];
+		if (records && n == max)
+			break;
+		const uint64_t seq = sunxi_efex_atomic_load(&slot->seq);
+		if (seq != ticket + 1) {
+			(*dropped)++;
+			continue;
+		}
+		if (!records) {
+			n++;
+			continue;
+		}
+		records[n] = slot->rec;
+		sunxi_efex_atomic_fence();
+		if (sunxi_efex_atomic_load(&slot->seq) != seq) {
+			(*dropped)++;
+			continue;
+		}
+		n++;
+	}
+	return n;
+}
+
+int sunxi_efex_trace_get(const struct sunxi_efex_ctx_t *ctx, struct sunxi_efex_trace_record_t *records,
+                         const size_t max, size_t *count) {
+	if (!ctx || !count) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	if (!ctx->trace) {
+		return EFEX_ERR_NOT_SUPPORT;
+	}
+
+	uint64_t dropped;
+	*count = sunxi_efex_trace_collect(ctx->trace, records, max, &dropped);
+	return EFEX_ERR_SUCCESS;
+}
+
+static const char *sunxi_efex_trace_cmd_name(const uint32_t cmd) {
+	switch (cmd) {
+		case EFEX_CMD_VERIFY_DEVICE:
+			return "VERIFY_DEVICE";
+		case EFEX_CMD_FEL_WRITE:
+			return "FEL_WRITE";
+		case EFEX_CMD_FEL_EXEC:
+			return "FEL_EXEC";
+		case EFEX_CMD_FEL_READ:
+			return "FEL_READ";
+		case EFEX_CMD_FES_DOWN:
+			return "FES_DOWN";
+		case EFEX_CMD_FES_UP:
+			return "FES_UP";
+		case EFEX_CMD_FES_VERIFY_VALUE:
+			return "FES_VERIFY_VALUE";
+		case EFEX_CMD_FES_VERIFY_STATUS:
+			return "FES_VERIFY_STATUS";
+		default:
+			return NULL;
+	}
+}
+
+static int sunxi_efex_trace_write_chrome(FILE *fp, const struct sunxi_efex_trace_record_t *records,
+                                         const size_t count) {
+	static const char *phases[SUNXI_EFEX_PHASE_COUNT] = {"request", "data", "status"};
+
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	// One track per phase
+	for (int i = 0; i < SUNXI_EFEX_PHASE_COUNT; i++)
+		fprintf(fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n", i,
+		        phases[i]);
+
+	for (size_t i = 0; i < count; i++) {
+		const struct sunxi_efex_trace_record_t *r = &records[i];
+		const char *name = sunxi_efex_trace_cmd_name(r->cmd);
+		const char *phase = r->phase < SUNXI_EFEX_PHASE_COUNT ? phases[r->phase] : "?";
+
+		if (name)
+			fprintf(fp, "{\"name\":\"%s %s\"", name, phase);
+		else
+			fprintf(fp, "{\"name\":\"0x%04x %s\"", r->cmd, phase);
+		fprintf(fp,
+		        ",\"cat\":\"usb\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%llu,\"dur\":%u,"
+		        "\"args\":{\"ep\":\"0x%02x\",\"len\":%u,\"status\":%d,\"data\":\"",
+		        (unsigned) r->phase, (unsigned long long) r->ts_us, (unsigned) r->dur_us, (unsigned) r->ep,
+		        (unsigned) r->len, (int) r->status);
+		for (size_t j = 0; j < r->snap_len; j++)
+			fprintf(fp, "%02x", r->data[j]);
+		fprintf(fp, "\"}}%s\n", i + 1 < count ? "," : "");
+	}
+	fprintf(fp, "]}\n");
+	return ferror(fp) ? EFEX_ERR_FILE_WRITE : EFEX_ERR_SUCCESS;
+}
+
+static int sunxi_efex_trace_write_binary(FILE *fp, const struct sunxi_efex_trace_t *t,
+                                         const struct sunxi_efex_trace_record_t *records, const size_t count,
+                                         const uint64_t dropped) {
+	const struct sunxi_efex_trace_file_t hdr = {
+			.magic = cpu_to_le32(SUNXI_EFEX_TRACE_MAGIC),
+			.version = cpu_to_le16(SUNXI_EFEX_TRACE_VERSION),
+			.snap = cpu_to_le16(t->snap),
+			.count = cpu_to_le64(count),
+			.dropped = cpu_to_le64(dropped),
+	};
+	if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1) {
+		return EFEX_ERR_FILE_WRITE;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		struct sunxi_efex_trace_record_t r = records[i];
+		const size_t size = offsetof(struct sunxi_efex_trace_record_t, data) + r.snap_len;
+		r.ts_us = cpu_to_le64(r.ts_us);
+		r.dur_us = cpu_to_le32(r.dur_us);
+		r.len = cpu_to_le32(r.len);
+		r.cmd = cpu_to_le32(r.cmd);
+		r.status = (int32_t) cpu_to_le32(r.status);
+		if (fwrite(&r, size, 1, fp) != 1) {
+			return EFEX_ERR_FILE_WRITE;
+		}
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+int sunxi_efex_trace_export(const struct sunxi_efex_ctx_t *ctx, const char *path,
+                            const enum sunxi_efex_trace_format_t format) {
+	if (!ctx || !path) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	if (!ctx->trace) {
+		return EFEX_ERR_NOT_SUPPORT;
+	}
+	if (format != SUNXI_EFEX_TRACE_CHROME && format != SUNXI_EFEX_TRACE_BINARY) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+
+	const struct sunxi_efex_trace_t *t = ctx->trace;
+	struct sunxi_efex_trace_record_t *records = malloc((t->mask + 1) * sizeof(*records));
+	if (!records) {
+		return EFEX_ERR_MEMORY;
+	}
+
+	uint64_t dropped;
+	const size_t count = sunxi_efex_trace_collect(t, records, t->mask + 1, &dropped);
+
+	FILE *fp = fopen(path, "wb");
+	if (!fp) {
+		free(records);
+		return EFEX_ERR_FILE_OPEN;
+	}
+
+	int ret = format == SUNXI_EFEX_TRACE_CHROME ? sunxi_efex_trace_write_chrome(fp, records, count)
+	                                            : sunxi_efex_trace_write_binary(fp, t, records, count, dropped);
+	if (fclose(fp) != 0 && ret == EFEX_ERR_SUCCESS)
+		ret = EFEX_ERR_FILE_WRITE;
+	free(records);
+	return ret;
+}
+
+void sunxi_efex_trace_release(struct sunxi_efex_ctx_t *ctx) {
+	if (!ctx) {
+		return;
+	}
+	free(ctx->trace);
+	ctx->trace = NULL;
+}
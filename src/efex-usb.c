@@ -5,69 +5,147 @@
 #include <string.h>
 
 
+#include "efex-chunk.h"
 #include "efex-common.h"
+#include "efex-policy.h"
 #include "efex-protocol.h"
+#include "efex-stats.h"
+#include "efex-trace.h"
 #include "efex-usb.h"
 #include "ending.h"
+#include "usb_layer.h"
 
+// Every bulk transfer of a transaction goes through here, so statistics and the trace see all of them
+static int sunxi_usb_phase_send(const struct sunxi_efex_ctx_t *ctx, const enum sunxi_efex_stats_phase_t phase,
+                                const char *buf, const ssize_t len, const unsigned int timeout) {
+	const uint64_t start = ctx->stats || ctx->trace ? sunxi_efex_time_us() : 0;
+	int ret;
+	// Data phases go through the asynchronous engine when the context asks for a queue depth
+	if (phase == SUNXI_EFEX_PHASE_DATA && ctx->queue_depth > 1) {
+		ret = sunxi_usb_bulk_send_async(ctx, ctx->epout, buf, len, ctx->queue_depth, timeout);
+	} else {
+		ret = sunxi_usb_bulk_send_timeout(ctx, ctx->epout, buf, len, timeout);
+	}
+	if (ctx->stats || ctx->trace) {
+		const uint64_t usec = sunxi_efex_time_us() - start;
+		sunxi_efex_stats_xfer(ctx, phase, SUNXI_EFEX_DIR_OUT, (size_t) len, usec, ret);
+		sunxi_efex_trace_xfer(ctx, phase, ctx->epout, buf, (size_t) len, start, usec, ret);
+	}
+	return ret;
+}
 
-int sunxi_send_usb_request(const struct sunxi_efex_ctx_t *ctx, const enum sunxi_efex_usb_request_t type,
-                           const size_t length) {
+static int sunxi_usb_phase_recv(const struct sunxi_efex_ctx_t *ctx, const enum sunxi_efex_stats_phase_t phase,
+                                char *buf, const ssize_t len, const unsigned int timeout) {
+	const uint64_t start = ctx->stats || ctx->trace ? sunxi_efex_time_us() : 0;
+	int ret;
+	if (phase == SUNXI_EFEX_PHASE_DATA && ctx->queue_depth > 1) {
+		ret = sunxi_usb_bulk_recv_async(ctx, ctx->epin, buf, len, ctx->queue_depth, timeout);
+	} else {
+		ret = sunxi_usb_bulk_recv_timeout(ctx, ctx->epin, buf, len, timeout);
+	}
+	if (ctx->stats || ctx->trace) {
+		const uint64_t usec = sunxi_efex_time_us() - start;
+		sunxi_efex_stats_xfer(ctx, phase, SUNXI_EFEX_DIR_IN, (size_t) len, usec, ret);
+		sunxi_efex_trace_xfer(ctx, phase, ctx->epin, buf, (size_t) len, start, usec, ret);
+	}
+	return ret;
+}
+
+static int sunxi_usb_data_send(const struct sunxi_efex_ctx_t *ctx, const char *buf, const ssize_t len,
+                               const unsigned int timeout) {
+	return sunxi_usb_phase_send(ctx, SUNXI_EFEX_PHASE_DATA, buf, len, timeout);
+}
+
+static int sunxi_usb_data_recv(const struct sunxi_efex_ctx_t *ctx, char *buf, const ssize_t len,
+                               const unsigned int timeout) {
+	return sunxi_usb_phase_recv(ctx, SUNXI_EFEX_PHASE_DATA, buf, len, timeout);
+}
+
+static int sunxi_usb_request_send(const struct sunxi_efex_ctx_t *ctx, const enum sunxi_efex_usb_request_t type,
+                                  const size_t length, const unsigned int timeout) {
 	if (!ctx || !ctx->hdl) {
 		return EFEX_ERR_NULL_PTR;
 	}
 
-	struct sunxi_usb_request_t req = {
-			.magics = SUNXI_USB_REQ_MAGIC_INT,
-			.tab = 0x0,
-			.data_length = cpu_to_le32(length),
-			.cmd_length = SUNXI_EFEX_CMD_LEN,
-			.cmd_package[0] = type,
-	};
-	req.cmd_length = (uint8_t) req.data_length;
+	struct sunxi_usb_request_t req;
+	sunxi_usb_fill_request(&req, type, length);
 
-	const int ret = sunxi_usb_bulk_send(ctx->hdl, ctx->epout, (const char *) &req, sizeof(struct sunxi_usb_request_t));
+	const int ret = sunxi_usb_phase_send(ctx, SUNXI_EFEX_PHASE_REQUEST, (const char *) &req, sizeof(req), timeout);
 	if (ret != 0) {
 		return ret;
 	}
 	return EFEX_ERR_SUCCESS;
 }
 
-int sunxi_read_usb_response(const struct sunxi_efex_ctx_t *ctx) {
+static int sunxi_usb_response_read(const struct sunxi_efex_ctx_t *ctx, const unsigned int timeout) {
 	if (!ctx || !ctx->hdl) {
 		return EFEX_ERR_NULL_PTR;
 	}
 
 	struct sunxi_usb_response_t resp = {0};
 
-	const int ret = sunxi_usb_bulk_recv(ctx->hdl, ctx->epin, (char *) &resp, sizeof(resp));
+	const int ret = sunxi_usb_phase_recv(ctx, SUNXI_EFEX_PHASE_STATUS, (char *) &resp, sizeof(resp), timeout);
 	if (ret != 0) {
 		return ret;
 	}
 
-	if (strncmp(resp.magic, SUNXI_USB_RSP_MAGIC, 4) != 0) {
+	return sunxi_usb_check_response(&resp);
+}
+
+void sunxi_usb_fill_request(struct sunxi_usb_request_t *req, const enum sunxi_efex_usb_request_t type,
+                            const size_t length) {
+	const struct sunxi_usb_request_t tmp = {
+			.magics = SUNXI_USB_REQ_MAGIC_INT,
+			.tab = 0x0,
+			.data_length = cpu_to_le32(length),
+			.cmd_length = SUNXI_EFEX_CMD_LEN,
+			.cmd_package[0] = type,
+	};
+	*req = tmp;
+	req->cmd_length = (uint8_t) req->data_length;
+}
+
+int sunxi_usb_check_response(const struct sunxi_usb_response_t *resp) {
+	if (strncmp(resp->magic, SUNXI_USB_RSP_MAGIC, 4) != 0) {
 		return EFEX_ERR_INVALID_RESPONSE;
 	}
+	return resp->status;
+}
 
-	return resp.status;
+int sunxi_send_usb_request(const struct sunxi_efex_ctx_t *ctx, const enum sunxi_efex_usb_request_t type,
+                           const size_t length) {
+	return sunxi_usb_request_send(ctx, type, length, sunxi_efex_policy_timeout(ctx, 0, 0));
+}
+
+int sunxi_read_usb_response(const struct sunxi_efex_ctx_t *ctx) {
+	return sunxi_usb_response_read(ctx, sunxi_efex_policy_timeout(ctx, 0, 0));
 }
 
 int sunxi_usb_write(const struct sunxi_efex_ctx_t *ctx, const void *buf, const size_t len) {
+	return sunxi_usb_write_timeout(ctx, buf, len, sunxi_efex_policy_timeout(ctx, 0, len));
+}
+
+int sunxi_usb_read(const struct sunxi_efex_ctx_t *ctx, const void *data, const size_t len) {
+	return sunxi_usb_read_timeout(ctx, data, len, sunxi_efex_policy_timeout(ctx, 0, len));
+}
+
+int sunxi_usb_write_timeout(const struct sunxi_efex_ctx_t *ctx, const void *buf, const size_t len,
+                            const unsigned int timeout) {
 	if (!ctx || !buf) {
 		return EFEX_ERR_NULL_PTR;
 	}
 
-	int ret = sunxi_send_usb_request(ctx, AW_USB_WRITE, len);
+	int ret = sunxi_usb_request_send(ctx, AW_USB_WRITE, len, timeout);
 	if (ret != EFEX_ERR_SUCCESS) {
 		return ret;
 	}
 
-	ret = sunxi_usb_bulk_send(ctx->hdl, ctx->epout, buf, len);
+	ret = sunxi_usb_data_send(ctx, buf, len, timeout);
 	if (ret != 0) {
 		return ret;
 	}
 
-	ret = sunxi_read_usb_response(ctx);
+	ret = sunxi_usb_response_read(ctx, timeout);
 	if (ret != 0) {
 		if (ret < 0) {
 			return ret;
@@ -77,22 +155,23 @@ int sunxi_usb_write(const struct sunxi_efex_ctx_t *ctx, const void *buf, const s
 	return EFEX_ERR_SUCCESS;
 }
 
-int sunxi_usb_read(const struct sunxi_efex_ctx_t *ctx, const void *data, const size_t len) {
+int sunxi_usb_read_timeout(const struct sunxi_efex_ctx_t *ctx, const void *data, const size_t len,
+                           const unsigned int timeout) {
 	if (!ctx || !data) {
 		return EFEX_ERR_NULL_PTR;
 	}
 
-	int ret = sunxi_send_usb_request(ctx, AW_USB_READ, len);
+	int ret = sunxi_usb_request_send(ctx, AW_USB_READ, len, timeout);
 	if (ret != EFEX_ERR_SUCCESS) {
 		return ret;
 	}
 
-	ret = sunxi_usb_bulk_recv(ctx->hdl, ctx->epin, (char *) data, len);
+	ret = sunxi_usb_data_recv(ctx, (char *) data, len, timeout);
 	if (ret != 0) {
 		return ret;
 	}
 
-	ret = sunxi_read_usb_response(ctx);
+	ret = sunxi_usb_response_read(ctx, timeout);
 	if (ret != 0) {
 		if (ret < 0) {
 			return ret;
@@ -123,7 +202,13 @@ int sunxi_usb_fes_xfer(const struct sunxi_efex_ctx_t *ctx, const enum sunxi_usb_
 		memcpy(fes_xfer.buf, request_buf, request_len);
 	}
 
-	int ret = sunxi_usb_bulk_send(ctx->hdl, ctx->epout, (const char *) &fes_xfer, sizeof(fes_xfer));
+	// Every phase gets the whole budget: the status phase is where slow commands wait
+	const unsigned int timeout = sunxi_efex_policy_timeout(ctx, cmd, len > 0 ? (size_t) len : 0);
+
+	sunxi_efex_stats_cmd(ctx, cmd);
+	sunxi_efex_trace_cmd(ctx, cmd);
+	int ret = sunxi_usb_phase_send(ctx, SUNXI_EFEX_PHASE_REQUEST, (const char *) &fes_xfer, sizeof(fes_xfer),
+	                               timeout);
 	if (ret != 0) {
 		return ret;
 	}
@@ -132,7 +217,7 @@ int sunxi_usb_fes_xfer(const struct sunxi_efex_ctx_t *ctx, const enum sunxi_usb_
 		if (!buf) {
 			return EFEX_ERR_NULL_PTR;
 		}
-		ret = sunxi_usb_bulk_send(ctx->hdl, ctx->epout, buf, len);
+		ret = sunxi_usb_data_send(ctx, buf, len, timeout);
 		if (ret != 0) {
 			return ret;
 		}
@@ -140,13 +225,13 @@ int sunxi_usb_fes_xfer(const struct sunxi_efex_ctx_t *ctx, const enum sunxi_usb_
 		if (!buf) {
 			return EFEX_ERR_NULL_PTR;
 		}
-		ret = sunxi_usb_bulk_recv(ctx->hdl, ctx->epin, (char *) buf, len);
+		ret = sunxi_usb_data_recv(ctx, (char *) buf, len, timeout);
 		if (ret != 0) {
 			return ret;
 		}
 	}
 
-	ret = sunxi_read_usb_response(ctx);
+	ret = sunxi_usb_response_read(ctx, timeout);
 	if (ret != 0) {
 		if (ret < 0) {
 			return ret;
@@ -158,7 +243,6 @@ int sunxi_usb_fes_xfer(const struct sunxi_efex_ctx_t *ctx, const enum sunxi_usb_
 }
 
 void sunxi_usb_hex_dump(const void *buf, size_t len, const char *type) {
-#if DEBUG_USB_TRANSFER
 	if (!buf) {
 		fprintf(stdout, "USB %s len=0\n", type ? type : "");
 		fprintf(stdout, "<empty>\n");
@@ -187,9 +271,4 @@ void sunxi_usb_hex_dump(const void *buf, size_t len, const char *type) {
 		}
 		fputc('\n', stdout);
 	}
-#else
-	(void)buf;
-	(void)len;
-	(void)type;
-#endif /* DEBUG_USB_TRANSFER */
 }
@@ -2,31 +2,63 @@
 #include <string.h>
 
 #include "usb_layer.h"
+#include "efex-chunk.h"
 #include "efex-common.h"
+#include "efex-protocol.h"
+#include "efex-record.h"
 
+// Only the default for contexts that did not pick a backend themselves
 static enum usb_backend_type current_backend = USB_BACKEND_AUTO;
 
 extern const struct usb_backend_ops usb_libusb_ops;
 extern const struct usb_backend_ops usb_winusb_ops;
+extern const struct usb_backend_ops usb_sim_ops;
+extern const struct usb_backend_ops usb_replay_ops;
 
-static const struct usb_backend_ops *get_backend_ops(void) {
+static const struct usb_backend_ops *backend_type_ops(const enum usb_backend_type backend) {
+	if (backend == USB_BACKEND_SIM) {
+		return &usb_sim_ops;
+	}
+	if (backend == USB_BACKEND_REPLAY) {
+		return &usb_replay_ops;
+	}
 #ifdef _WIN32
-	if (current_backend == USB_BACKEND_LIBUSB) {
+	if (backend == USB_BACKEND_LIBUSB) {
 		return &usb_libusb_ops;
 	} else {
 		return &usb_winusb_ops;
 	}
 #else
+	(void) backend;
 	return &usb_libusb_ops;
 #endif
 }
 
+static const struct usb_backend_ops *get_backend_ops(void) {
+	return backend_type_ops(current_backend);
+}
+
+static const struct usb_backend_ops *ctx_backend_ops(const struct sunxi_efex_ctx_t *ctx) {
+	if (ctx && ctx->usb_ops) {
+		return ctx->usb_ops;
+	}
+	return get_backend_ops();
+}
+
+// A context stays on the backend it opened its device with, whatever the default becomes later
+static const struct usb_backend_ops *ctx_bind_backend_ops(struct sunxi_efex_ctx_t *ctx) {
+	if (!ctx->usb_ops) {
+		ctx->usb_ops = get_backend_ops();
+	}
+	return ctx->usb_ops;
+}
+
 int sunxi_usb_bulk_send(void *handle, int ep, const char *buf, ssize_t len) {
 	const struct usb_backend_ops *ops = get_backend_ops();
 	if (!ops || !ops->bulk_send) {
 		return EFEX_ERR_NOT_SUPPORT;
 	}
-	return ops->bulk_send(handle, ep, buf, len);
+	return ops->bulk_send(handle, ep, buf, len, DEFAULT_USB_TIMEOUT);
 }
 
 int sunxi_usb_bulk_recv(void *handle, int ep, char *buf, ssize_t len) {
@@ -34,11 +66,193 @@ int sunxi_usb_bulk_recv(void *handle, int ep, char *buf, ssize_t len) {
 	if (!ops || !ops->bulk_recv) {
 		return EFEX_ERR_NOT_SUPPORT;
 	}
-	return ops->bulk_recv(handle, ep, buf, len);
+	return ops->bulk_recv(handle, ep, buf, len, DEFAULT_USB_TIMEOUT);
+}
+
+int sunxi_usb_bulk_send_timeout(const struct sunxi_efex_ctx_t *ctx, int ep, const char *buf, ssize_t len,
+                                unsigned int timeout) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	const struct usb_backend_ops *ops = ctx_backend_ops(ctx);
+	if (!ops || !ops->bulk_send) {
+		return EFEX_ERR_NOT_SUPPORT;
+	}
+	if (ctx->record) {
+		const uint64_t start = sunxi_efex_time_us();
+		const int ret = ops->bulk_send(ctx->hdl, ep, buf, len, timeout);
+		sunxi_efex_record_xfer(ctx->record, ep, buf, (size_t) len, start, sunxi_efex_time_us() - start, ret);
+		return ret;
+	}
+	return ops->bulk_send(ctx->hdl, ep, buf, len, timeout);
+}
+
+int sunxi_usb_bulk_recv_timeout(const struct sunxi_efex_ctx_t *ctx, int ep, char *buf, ssize_t len,
+                                unsigned int timeout) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	const struct usb_backend_ops *ops = ctx_backend_ops(ctx);
+	if (!ops || !ops->bulk_recv) {
+		return EFEX_ERR_NOT_SUPPORT;
+	}
+	if (ctx->record) {
+		const uint64_t start = sunxi_efex_time_us();
+		const int ret = ops->bulk_recv(ctx->hdl, ep, buf, len, timeout);
+		sunxi_efex_record_xfer(ctx->record, ep, buf, (size_t) len, start, sunxi_efex_time_us() - start, ret);
+		return ret;
+	}
+	return ops->bulk_recv(ctx->hdl, ep, buf, len, timeout);
+}
+
+int sunxi_usb_clear_halt(const struct sunxi_efex_ctx_t *ctx, int ep) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	const struct usb_backend_ops *ops = ctx_backend_ops(ctx);
+	if (!ops || !ops->clear_halt) {
+		return EFEX_ERR_NOT_SUPPORT;
+	}
+	return ops->clear_halt(ctx->hdl, ep);
+}
+
+int sunxi_usb_bulk_send_async(const struct sunxi_efex_ctx_t *ctx, int ep, const char *buf, ssize_t len,
+                              int queue_depth, unsigned int timeout) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	const struct usb_backend_ops *ops = ctx_backend_ops(ctx);
+	if (!ops) {
+		return EFEX_ERR_NOT_SUPPORT;
+	}
+	// Backends without an asynchronous engine keep working through the synchronous path
+	if (queue_depth <= 1 || !ops->bulk_send_async) {
+		return sunxi_usb_bulk_send_timeout(ctx, ep, buf, len, timeout);
+	}
+	// Recorded as one transfer, which a replay serves through the synchronous path
+	if (ctx->record) {
+		const uint64_t start = sunxi_efex_time_us();
+		const int ret = ops->bulk_send_async(ctx->usb_context, ctx->hdl, ep, buf, len, queue_depth, timeout);
+		sunxi_efex_record_xfer(ctx->record, ep, buf, (size_t) len, start, sunxi_efex_time_us() - start, ret);
+		return ret;
+	}
+	return ops->bulk_send_async(ctx->usb_context, ctx->hdl, ep, buf, len, queue_depth, timeout);
+}
+
+int sunxi_usb_bulk_recv_async(const struct sunxi_efex_ctx_t *ctx, int ep, char *buf, ssize_t len, int queue_depth,
+                              unsigned int timeout) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	const struct usb_backend_ops *ops = ctx_backend_ops(ctx);
+	if (!ops) {
+		return EFEX_ERR_NOT_SUPPORT;
+	}
+	if (queue_depth <= 1 || !ops->bulk_recv_async) {
+		return sunxi_usb_bulk_recv_timeout(ctx, ep, buf, len, timeout);
+	}
+	if (ctx->record) {
+		const uint64_t start = sunxi_efex_time_us();
+		const int ret = ops->bulk_recv_async(ctx->usb_context, ctx->hdl, ep, buf, len, queue_depth, timeout);
+		sunxi_efex_record_xfer(ctx->record, ep, buf, (size_t) len, start, sunxi_efex_time_us() - start, ret);
+		return ret;
+	}
+	return ops->bulk_recv_async(ctx->usb_context, ctx->hdl, ep, buf, len, queue_depth, timeout);
+}
+
+int sunxi_usb_bulk_chain_submit(const struct sunxi_efex_ctx_t *ctx, const struct sunxi_usb_chain_xfer_t *xfers,
+                                const size_t count, unsigned int timeout, void **chain) {
+	if (!ctx || !xfers || !chain) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	*chain = NULL;
+
+	const struct usb_backend_ops *ops = ctx_backend_ops(ctx);
+	if (!ops) {
+		return EFEX_ERR_NOT_SUPPORT;
+	}
+	// A recording needs every transfer to complete before the next one is recorded
+	if (ops->bulk_chain_submit && ops->bulk_chain_wait && !ctx->record) {
+		return ops->bulk_chain_submit(ctx->usb_context, ctx->hdl, xfers, count, timeout, chain);
+	}
+
+	// No chain support: run the transfers in protocol order right away
+	for (size_t i = 0; i < count; i++) {
+		int ret;
+		if ((xfers[i].ep & 0x80) != 0) {
+			ret = sunxi_usb_bulk_recv_timeout(ctx, xfers[i].ep, xfers[i].buf, xfers[i].len, timeout);
+		} else {
+			ret = sunxi_usb_bulk_send_timeout(ctx, xfers[i].ep, xfers[i].buf, xfers[i].len, timeout);
+		}
+		if (ret != EFEX_ERR_SUCCESS) {
+			return ret;
+		}
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+int sunxi_usb_bulk_chain_wait(const struct sunxi_efex_ctx_t *ctx, void *chain) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	if (!chain) {
+		return EFEX_ERR_SUCCESS;
+	}
+
+	const struct usb_backend_ops *ops = ctx_backend_ops(ctx);
+	if (!ops || !ops->bulk_chain_wait) {
+		return EFEX_ERR_NOT_SUPPORT;
+	}
+	return ops->bulk_chain_wait(ctx->usb_context, chain);
+}
+
+void *sunxi_usb_dev_mem_alloc(const struct sunxi_efex_ctx_t *ctx, size_t len) {
+	if (!ctx || !ctx->hdl) {
+		return NULL;
+	}
+
+	const struct usb_backend_ops *ops = ctx_backend_ops(ctx);
+	if (!ops || !ops->dev_mem_alloc) {
+		return NULL;
+	}
+	return ops->dev_mem_alloc(ctx->hdl, len);
+}
+
+void sunxi_usb_dev_mem_free(const struct sunxi_efex_ctx_t *ctx, void *buf, size_t len) {
+	if (!ctx || !ctx->hdl || !buf) {
+		return;
+	}
+
+	const struct usb_backend_ops *ops = ctx_backend_ops(ctx);
+	if (!ops || !ops->dev_mem_free) {
+		return;
+	}
+	ops->dev_mem_free(ctx->hdl, buf, len);
+}
+
+int sunxi_usb_set_queue_depth(struct sunxi_efex_ctx_t *ctx, int queue_depth) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	if (queue_depth < 0 || queue_depth > SUNXI_USB_MAX_QUEUE_DEPTH) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+	ctx->queue_depth = queue_depth;
+	return EFEX_ERR_SUCCESS;
 }
 
 int sunxi_scan_usb_device(struct sunxi_efex_ctx_t *ctx) {
-	const struct usb_backend_ops *ops = get_backend_ops();
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	const struct usb_backend_ops *ops = ctx_bind_backend_ops(ctx);
 	if (!ops || !ops->scan_device) {
 		return EFEX_ERR_NOT_SUPPORT;
 	}
@@ -46,7 +260,11 @@ int sunxi_scan_usb_device(struct sunxi_efex_ctx_t *ctx) {
 }
 
 int sunxi_scan_usb_device_at(struct sunxi_efex_ctx_t *ctx, uint8_t bus, uint8_t port) {
-	const struct usb_backend_ops *ops = get_backend_ops();
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	const struct usb_backend_ops *ops = ctx_bind_backend_ops(ctx);
 	if (!ops || !ops->scan_device_at) {
 		return EFEX_ERR_NOT_SUPPORT;
 	}
@@ -84,8 +302,39 @@ void sunxi_hotplug_free_snapshot(struct sunxi_hotplug_device_t *devices, size_t
 	free(devices);
 }
 
-int sunxi_usb_init(struct sunxi_efex_ctx_t *ctx) {
+int sunxi_hotplug_poll(struct sunxi_hotplug_event_t **events, size_t *count, const int timeout_ms) {
 	const struct usb_backend_ops *ops = get_backend_ops();
+	if (!ops || !ops->hotplug_poll) {
+		return EFEX_ERR_NOT_SUPPORT;
+	}
+	return ops->hotplug_poll(events, count, timeout_ms);
+}
+
+void sunxi_hotplug_free_events(struct sunxi_hotplug_event_t *events, size_t count) {
+	if (!events) {
+		return;
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		free(events[i].device.device_path);
+	}
+
+	free(events);
+}
+
+void sunxi_usb_shared_exit(void) {
+	const struct usb_backend_ops *ops = get_backend_ops();
+	if (ops && ops->shared_exit) {
+		ops->shared_exit();
+	}
+}
+
+int sunxi_usb_init(struct sunxi_efex_ctx_t *ctx) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	const struct usb_backend_ops *ops = ctx_bind_backend_ops(ctx);
 	if (!ops || !ops->init) {
 		return EFEX_ERR_NOT_SUPPORT;
 	}
@@ -93,7 +342,10 @@ int sunxi_usb_init(struct sunxi_efex_ctx_t *ctx) {
 }
 
 int sunxi_usb_exit(struct sunxi_efex_ctx_t *ctx) {
-	const struct usb_backend_ops *ops = get_backend_ops();
+	// Device memory must be returned while the handle is still open
+	sunxi_efex_ctx_release(ctx);
+
+	const struct usb_backend_ops *ops = ctx_backend_ops(ctx);
 	if (!ops || !ops->exit) {
 		return EFEX_ERR_NOT_SUPPORT;
 	}
@@ -102,12 +354,14 @@ int sunxi_usb_exit(struct sunxi_efex_ctx_t *ctx) {
 
 int sunxi_efex_set_usb_backend(enum usb_backend_type backend) {
 #ifdef _WIN32
-	if (backend == USB_BACKEND_LIBUSB || backend == USB_BACKEND_WINUSB || backend == USB_BACKEND_AUTO) {
+	if (backend == USB_BACKEND_LIBUSB || backend == USB_BACKEND_WINUSB || backend == USB_BACKEND_SIM ||
+	    backend == USB_BACKEND_REPLAY || backend == USB_BACKEND_AUTO) {
 		current_backend = backend;
 		return EFEX_ERR_SUCCESS;
 	}
 #else
-	if (backend == USB_BACKEND_LIBUSB || backend == USB_BACKEND_AUTO) {
+	if (backend == USB_BACKEND_LIBUSB || backend == USB_BACKEND_SIM || backend == USB_BACKEND_REPLAY ||
+	    backend == USB_BACKEND_AUTO) {
 		current_backend = backend;
 		return EFEX_ERR_SUCCESS;
 	}
@@ -118,3 +372,26 @@ int sunxi_efex_set_usb_backend(enum usb_backend_type backend) {
 enum usb_backend_type sunxi_efex_get_usb_backend(void) {
 	return current_backend;
 }
+
+int sunxi_usb_set_backend(struct sunxi_efex_ctx_t *ctx, enum usb_backend_type backend) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	// The handle belongs to the backend that opened it
+	if (ctx->hdl) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+#ifdef _WIN32
+	if (backend != USB_BACKEND_LIBUSB && backend != USB_BACKEND_WINUSB && backend != USB_BACKEND_SIM &&
+	    backend != USB_BACKEND_REPLAY && backend != USB_BACKEND_AUTO) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+#else
+	if (backend != USB_BACKEND_LIBUSB && backend != USB_BACKEND_SIM && backend != USB_BACKEND_REPLAY &&
+	    backend != USB_BACKEND_AUTO) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+#endif
+	ctx->usb_ops = backend_type_ops(backend);
+	return EFEX_ERR_SUCCESS;
+}
@@ -9,25 +9,24 @@
 #include "compiler.h"
 #include "efex-common.h"
 #include "efex-protocol.h"
+#include "efex-thread.h"
 #include "efex-usb.h"
 #include "ending.h"
 #include "usb_layer.h"
 
-static int libusb_bulk_send(void *handle, int ep, const char *buf, ssize_t len) {
+static int libusb_bulk_send(void *handle, int ep, const char *buf, ssize_t len, unsigned int timeout) {
 	if (!handle || !buf || len <= 0) {
 		return EFEX_ERR_NULL_PTR;
 	}
 
 	libusb_device_handle *hdl = (libusb_device_handle *) handle;
-	const size_t max_chunk = 128 * 1024;
+	const size_t max_chunk = SUNXI_USB_MAX_URB_SIZE;
 	int bytes;
 
 	while (len > 0) {
 		const size_t chunk = (size_t)len < max_chunk ? (size_t)len : max_chunk;
 
-		sunxi_usb_hex_dump(buf, chunk, "SEND");
-
-		const int r = libusb_bulk_transfer(hdl, ep, (void *) buf, (int) chunk, &bytes, DEFAULT_USB_TIMEOUT);
+		const int r = libusb_bulk_transfer(hdl, ep, (void *) buf, (int) chunk, &bytes, timeout);
 		if (r != 0) {
 			if (r == LIBUSB_ERROR_TIMEOUT) {
 				return EFEX_ERR_USB_TIMEOUT;
@@ -40,7 +39,7 @@ static int libusb_bulk_send(void *handle, int ep, const char *buf, ssize_t len)
 	return EFEX_ERR_SUCCESS;
 }
 
-static int libusb_bulk_recv(void *handle, int ep, char *buf, ssize_t len) {
+static int libusb_bulk_recv(void *handle, int ep, char *buf, ssize_t len, unsigned int timeout) {
 	if (!handle || !buf || len <= 0) {
 		return EFEX_ERR_NULL_PTR;
 	}
@@ -49,7 +48,7 @@ static int libusb_bulk_recv(void *handle, int ep, char *buf, ssize_t len) {
 	int bytes;
 
 	while (len > 0) {
-		const int r = libusb_bulk_transfer(hdl, ep, (uint8_t *) buf, (int) len, &bytes, DEFAULT_USB_TIMEOUT);
+		const int r = libusb_bulk_transfer(hdl, ep, (uint8_t *) buf, (int) len, &bytes, timeout);
 		if (r != 0) {
 			if (r == LIBUSB_ERROR_TIMEOUT) {
 				return EFEX_ERR_USB_TIMEOUT;
@@ -57,14 +56,240 @@ static int libusb_bulk_recv(void *handle, int ep, char *buf, ssize_t len) {
 			return EFEX_ERR_USB_TRANSFER;
 		}
 
-		sunxi_usb_hex_dump(buf, (size_t) bytes, "RECV");
-
 		len -= bytes;
 		buf += bytes;
 	}
 	return EFEX_ERR_SUCCESS;
 }
 
+struct libusb_async_queue {
+	int pending; // URBs submitted and not completed yet
+	int error;   // first error reported by a completed URB
+};
+
+struct libusb_async_slot {
+	struct libusb_transfer *xfer;
+	struct libusb_async_queue *queue;
+	int busy;
+};
+
+static void LIBUSB_CALL libusb_async_callback(struct libusb_transfer *xfer) {
+	struct libusb_async_slot *slot = (struct libusb_async_slot *) xfer->user_data;
+	struct libusb_async_queue *queue = slot->queue;
+
+	slot->busy = 0;
+	queue->pending--;
+
+	if (queue->error != EFEX_ERR_SUCCESS) {
+		return;
+	}
+
+	switch (xfer->status) {
+		case LIBUSB_TRANSFER_COMPLETED:
+			// Every URB but the last is a whole number of packets, so a short one means lost data
+			if (xfer->actual_length != xfer->length) {
+				queue->error = EFEX_ERR_USB_TRANSFER;
+			}
+			break;
+		case LIBUSB_TRANSFER_TIMED_OUT:
+			queue->error = EFEX_ERR_USB_TIMEOUT;
+			break;
+		default:
+			queue->error = EFEX_ERR_USB_TRANSFER;
+			break;
+	}
+}
+
+static void libusb_async_cancel(struct libusb_async_slot *slots, const size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		if (slots[i].busy) {
+			libusb_cancel_transfer(slots[i].xfer);
+		}
+	}
+}
+
+static size_t libusb_async_urb_size(const ssize_t len, const int queue_depth) {
+	// Spread the transfer over the whole queue so that even a single chunk keeps
+	// several URBs in flight, rounded up to whole packets
+	size_t urb_size = ((size_t) len + (size_t) queue_depth - 1) / (size_t) queue_depth;
+	urb_size = (urb_size + SUNXI_USB_BULK_PACKET_SIZE - 1) & ~((size_t) SUNXI_USB_BULK_PACKET_SIZE - 1);
+
+	if (urb_size < SUNXI_USB_MIN_URB_SIZE) {
+		urb_size = SUNXI_USB_MIN_URB_SIZE;
+	}
+	if (urb_size > SUNXI_USB_MAX_URB_SIZE) {
+		urb_size = SUNXI_USB_MAX_URB_SIZE;
+	}
+	return urb_size;
+}
+
+static int libusb_bulk_xfer_async(void *usb_context, void *handle, int ep, char *buf, const ssize_t len,
+                                  int queue_depth, unsigned int timeout) {
+	if (!usb_context || !handle || !buf || len <= 0) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	if (queue_depth < 1) {
+		queue_depth = 1;
+	} else if (queue_depth > SUNXI_USB_MAX_QUEUE_DEPTH) {
+		queue_depth = SUNXI_USB_MAX_QUEUE_DEPTH;
+	}
+
+	libusb_context *context = (libusb_context *) usb_context;
+	libusb_device_handle *hdl = (libusb_device_handle *) handle;
+	const size_t urb_size = libusb_async_urb_size(len, queue_depth);
+	struct libusb_async_slot slots[SUNXI_USB_MAX_QUEUE_DEPTH] = {0};
+	struct libusb_async_queue queue = {0};
+	ssize_t offset = 0;
+	int cancelled = 0;
+
+	for (int i = 0; i < queue_depth; i++) {
+		slots[i].xfer = libusb_alloc_transfer(0);
+		slots[i].queue = &queue;
+		if (!slots[i].xfer) {
+			queue.error = EFEX_ERR_MEMORY;
+			goto out;
+		}
+	}
+
+	while ((offset < len && queue.error == EFEX_ERR_SUCCESS) || queue.pending > 0) {
+		// Top the queue up with the next pieces of the buffer
+		for (int i = 0; i < queue_depth && offset < len && queue.error == EFEX_ERR_SUCCESS; i++) {
+			if (slots[i].busy) {
+				continue;
+			}
+
+			const size_t n = (size_t) (len - offset) < urb_size ? (size_t) (len - offset) : urb_size;
+
+			libusb_fill_bulk_transfer(slots[i].xfer, hdl, (unsigned char) ep, (unsigned char *) buf + offset, (int) n,
+			                          libusb_async_callback, &slots[i], timeout);
+			if (libusb_submit_transfer(slots[i].xfer) != 0) {
+				queue.error = EFEX_ERR_USB_TRANSFER;
+				break;
+			}
+			slots[i].busy = 1;
+			queue.pending++;
+			offset += (ssize_t) n;
+		}
+
+		// On failure, cancel what is still queued and wait for it to drain
+		if (queue.error != EFEX_ERR_SUCCESS && !cancelled) {
+			libusb_async_cancel(slots, (size_t) queue_depth);
+			cancelled = 1;
+		}
+
+		if (queue.pending == 0) {
+			continue;
+		}
+
+		const int r = libusb_handle_events_completed(context, NULL);
+		if (r < 0 && r != LIBUSB_ERROR_INTERRUPTED && queue.error == EFEX_ERR_SUCCESS) {
+			queue.error = EFEX_ERR_USB_TRANSFER;
+		}
+	}
+
+out:
+	for (int i = 0; i < queue_depth; i++) {
+		if (slots[i].xfer) {
+			libusb_free_transfer(slots[i].xfer);
+		}
+	}
+	return queue.error;
+}
+
+static int libusb_bulk_send_async(void *usb_context, void *handle, int ep, const char *buf, ssize_t len,
+                                  int queue_depth, unsigned int timeout) {
+	return libusb_bulk_xfer_async(usb_context, handle, ep, (char *) buf, len, queue_depth, timeout);
+}
+
+static int libusb_bulk_recv_async(void *usb_context, void *handle, int ep, char *buf, ssize_t len,
+                                  int queue_depth, unsigned int timeout) {
+	return libusb_bulk_xfer_async(usb_context, handle, ep, buf, len, queue_depth, timeout);
+}
+
+struct libusb_chain {
+	struct libusb_async_queue queue;
+	size_t count;
+	struct libusb_async_slot slots[];
+};
+
+static int libusb_chain_finish(libusb_context *context, struct libusb_chain *chain) {
+	int cancelled = 0;
+
+	while (chain->queue.pending > 0) {
+		// One failed phase makes the rest of the chain meaningless, do not wait for their timeouts
+		if (chain->queue.error != EFEX_ERR_SUCCESS && !cancelled) {
+			libusb_async_cancel(chain->slots, chain->count);
+			cancelled = 1;
+		}
+
+		const int r = libusb_handle_events_completed(context, NULL);
+		if (r < 0 && r != LIBUSB_ERROR_INTERRUPTED && chain->queue.error == EFEX_ERR_SUCCESS) {
+			chain->queue.error = EFEX_ERR_USB_TRANSFER;
+		}
+	}
+
+	const int ret = chain->queue.error;
+	for (size_t i = 0; i < chain->count; i++) {
+		if (chain->slots[i].xfer) {
+			libusb_free_transfer(chain->slots[i].xfer);
+		}
+	}
+	free(chain);
+	return ret;
+}
+
+static int libusb_bulk_chain_submit(void *usb_context, void *handle, const struct sunxi_usb_chain_xfer_t *xfers,
+                                    const size_t count, unsigned int timeout, void **chain_out) {
+	if (!usb_context || !handle || !xfers || !chain_out || count == 0) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	*chain_out = NULL;
+
+	struct libusb_chain *chain = (struct libusb_chain *) calloc(1, sizeof(struct libusb_chain) +
+	                                                                   count * sizeof(struct libusb_async_slot));
+	if (!chain) {
+		return EFEX_ERR_MEMORY;
+	}
+	chain->count = count;
+
+	libusb_device_handle *hdl = (libusb_device_handle *) handle;
+	for (size_t i = 0; i < count; i++) {
+		struct libusb_async_slot *slot = &chain->slots[i];
+		slot->queue = &chain->queue;
+		slot->xfer = libusb_alloc_transfer(0);
+		if (!slot->xfer) {
+			chain->queue.error = EFEX_ERR_MEMORY;
+			break;
+		}
+
+		libusb_fill_bulk_transfer(slot->xfer, hdl, (unsigned char) xfers[i].ep, (unsigned char *) xfers[i].buf,
+		                          (int) xfers[i].len, libusb_async_callback, slot, timeout);
+		if (libusb_submit_transfer(slot->xfer) != 0) {
+			chain->queue.error = EFEX_ERR_USB_TRANSFER;
+			break;
+		}
+		slot->busy = 1;
+		chain->queue.pending++;
+	}
+
+	// A partially queued chain is drained here, so the caller never sees it in flight
+	if (chain->queue.error != EFEX_ERR_SUCCESS) {
+		return libusb_chain_finish((libusb_context *) usb_context, chain);
+	}
+
+	*chain_out = chain;
+	return EFEX_ERR_SUCCESS;
+}
+
+static int libusb_bulk_chain_wait(void *usb_context, void *chain) {
+	if (!usb_context || !chain) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	return libusb_chain_finish((libusb_context *) usb_context, (struct libusb_chain *) chain);
+}
+
 static int libusb_open_error_to_efex(int rc) {
 	if (rc == LIBUSB_ERROR_NOT_SUPPORTED || rc == LIBUSB_ERROR_NOT_FOUND) {
 		return EFEX_ERR_USB_WRONG_DRIVER;
@@ -110,79 +335,202 @@ static int libusb_scan_device(struct sunxi_efex_ctx_t *ctx) {
 	return EFEX_ERR_USB_DEVICE_NOT_FOUND;
 }
 
-static int libusb_scan_devices(struct sunxi_scanned_device_t **devices, size_t *count) {
-	if (!devices || !count) {
-		return EFEX_ERR_NULL_PTR;
+// Library-wide context for scanning and hotplug, so polling does not re-initialize libusb every time.
+// The device index is kept current by hotplug callbacks where libusb supports them, otherwise by
+// diffing a fresh enumeration against it. Callbacks only run inside libusb_shared_pump(), with the lock held.
+static struct {
+	sunxi_efex_mutex_t lock;
+	libusb_context *context;
+	int hotplug; // callback registered, the index follows hotplug events
+	libusb_hotplug_callback_handle callback;
+	struct sunxi_hotplug_device_t *devices;
+	size_t count;
+	size_t capacity;
+	struct sunxi_hotplug_event_t *events;
+	size_t event_count;
+	int events_enabled; // set by the first sunxi_hotplug_poll(), nothing is queued before
+} libusb_shared = {
+		.lock = SUNXI_EFEX_MUTEX_INIT,
+};
+
+static int libusb_hotplug_fill(libusb_device *device, struct sunxi_hotplug_device_t *out) {
+	struct libusb_device_descriptor desc;
+	if (libusb_get_device_descriptor(device, &desc) != 0) {
+		return 0;
+	}
+	if (desc.idVendor != SUNXI_USB_VENDOR || desc.idProduct != SUNXI_USB_PRODUCT) {
+		return 0;
 	}
 
-	*devices = NULL;
-	*count = 0;
+	memset(out, 0, sizeof(*out));
+	out->vid = desc.idVendor;
+	out->pid = desc.idProduct;
+	out->bus_id = libusb_get_bus_number(device);
+	out->usb_device_id = libusb_get_device_address(device);
+	out->port = libusb_get_port_number(device);
+	/* Synthesize a stable device_path from bus:port for libusb backend */
+	{
+		char buf[32];
+		snprintf(buf, sizeof(buf), "libusb:%u:%u", (unsigned) out->bus_id, (unsigned) out->port);
+		out->device_path = strdup(buf);
+	}
+	return 1;
+}
 
-	libusb_device **list = NULL;
-	libusb_context *context = NULL;
+static void libusb_shared_queue_event(const enum sunxi_hotplug_event_type_t type,
+                                      const struct sunxi_hotplug_device_t *device) {
+	if (!libusb_shared.events_enabled) {
+		return;
+	}
 
-	int r = libusb_init(&context);
-	if (r < 0) {
-		return EFEX_ERR_USB_INIT;
+	// Nobody is draining the queue: forget the oldest event rather than grow without bound
+	if (libusb_shared.event_count == SUNXI_HOTPLUG_MAX_EVENTS) {
+		free(libusb_shared.events[0].device.device_path);
+		memmove(libusb_shared.events, libusb_shared.events + 1,
+		        sizeof(*libusb_shared.events) * (SUNXI_HOTPLUG_MAX_EVENTS - 1));
+		libusb_shared.event_count--;
 	}
 
-	const ssize_t device_count = libusb_get_device_list(context, &list);
-	if (device_count < 0) {
-		libusb_exit(context);
-		return EFEX_ERR_USB_DEVICE_NOT_FOUND;
+	if (!libusb_shared.events) {
+		libusb_shared.events = malloc(sizeof(*libusb_shared.events) * SUNXI_HOTPLUG_MAX_EVENTS);
+		if (!libusb_shared.events)
+			return;
 	}
 
-	size_t found_count = 0;
-	for (ssize_t i = 0; i < device_count; i++) {
-		libusb_device *device = list[i];
-		struct libusb_device_descriptor desc;
-		if (libusb_get_device_descriptor(device, &desc) != 0) {
-			continue;
-		}
-		if (desc.idVendor == SUNXI_USB_VENDOR && desc.idProduct == SUNXI_USB_PRODUCT) {
-			found_count++;
+	struct sunxi_hotplug_event_t *event = &libusb_shared.events[libusb_shared.event_count++];
+	event->type = type;
+	event->device = *device;
+	event->device.device_path = device->device_path ? strdup(device->device_path) : NULL;
+}
+
+static size_t libusb_shared_find(const uint32_t bus_id, const uint32_t usb_device_id) {
+	for (size_t i = 0; i < libusb_shared.count; i++) {
+		if (libusb_shared.devices[i].bus_id == bus_id && libusb_shared.devices[i].usb_device_id == usb_device_id)
+			return i;
+	}
+	return SIZE_MAX;
+}
+
+// Takes ownership of device->device_path
+static void libusb_shared_arrived(struct sunxi_hotplug_device_t *device) {
+	if (libusb_shared_find(device->bus_id, device->usb_device_id) != SIZE_MAX) {
+		free(device->device_path);
+		return;
+	}
+
+	if (libusb_shared.count == libusb_shared.capacity) {
+		const size_t capacity = libusb_shared.capacity ? libusb_shared.capacity * 2 : 8;
+		struct sunxi_hotplug_device_t *devices =
+				realloc(libusb_shared.devices, sizeof(*libusb_shared.devices) * capacity);
+		if (!devices) {
+			free(device->device_path);
+			return;
 		}
+		libusb_shared.devices = devices;
+		libusb_shared.capacity = capacity;
 	}
 
-	if (found_count == 0) {
-		libusb_free_device_list(list, 1);
-		libusb_exit(context);
+	libusb_shared.devices[libusb_shared.count++] = *device;
+	libusb_shared_queue_event(SUNXI_HOTPLUG_ARRIVED, device);
+}
+
+static void libusb_shared_left(const size_t idx) {
+	struct sunxi_hotplug_device_t device = libusb_shared.devices[idx];
+	libusb_shared.devices[idx] = libusb_shared.devices[--libusb_shared.count];
+	libusb_shared_queue_event(SUNXI_HOTPLUG_LEFT, &device);
+	free(device.device_path);
+}
+
+static int LIBUSB_CALL libusb_shared_hotplug_callback(libusb_context *context, libusb_device *device,
+                                                      libusb_hotplug_event event, void *user_data) {
+	(void) context;
+	(void) user_data;
+
+	struct sunxi_hotplug_device_t dev;
+	if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED) {
+		if (libusb_hotplug_fill(device, &dev))
+			libusb_shared_arrived(&dev);
+	} else if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT) {
+		const size_t idx = libusb_shared_find(libusb_get_bus_number(device), libusb_get_device_address(device));
+		if (idx != SIZE_MAX)
+			libusb_shared_left(idx);
+	}
+	return 0; // stay registered
+}
+
+// No hotplug support: bring the index up to date from a full enumeration
+static int libusb_shared_rescan(void) {
+	libusb_device **list = NULL;
+	const ssize_t device_count = libusb_get_device_list(libusb_shared.context, &list);
+	if (device_count < 0) {
 		return EFEX_ERR_USB_DEVICE_NOT_FOUND;
 	}
 
-	struct sunxi_scanned_device_t *result = (struct sunxi_scanned_device_t *)malloc(
-		sizeof(struct sunxi_scanned_device_t) * found_count);
-	if (!result) {
+	struct sunxi_hotplug_device_t *seen = calloc((size_t) device_count + 1, sizeof(*seen));
+	if (!seen) {
 		libusb_free_device_list(list, 1);
-		libusb_exit(context);
 		return EFEX_ERR_MEMORY;
 	}
 
-	size_t idx = 0;
-	for (ssize_t i = 0; i < device_count && idx < found_count; i++) {
-		libusb_device *device = list[i];
-		struct libusb_device_descriptor desc;
-		if (libusb_get_device_descriptor(device, &desc) != 0) {
-			continue;
+	size_t seen_count = 0;
+	for (ssize_t i = 0; i < device_count; i++) {
+		if (libusb_hotplug_fill(list[i], &seen[seen_count]))
+			seen_count++;
+	}
+	libusb_free_device_list(list, 1);
+
+	for (size_t i = libusb_shared.count; i-- > 0;) {
+		int present = 0;
+		for (size_t j = 0; j < seen_count && !present; j++) {
+			present = seen[j].bus_id == libusb_shared.devices[i].bus_id &&
+			          seen[j].usb_device_id == libusb_shared.devices[i].usb_device_id;
 		}
-		if (desc.idVendor == SUNXI_USB_VENDOR && desc.idProduct == SUNXI_USB_PRODUCT) {
-			result[idx].bus = libusb_get_bus_number(device);
-			result[idx].port = libusb_get_port_number(device);
-			result[idx].vid = desc.idVendor;
-			result[idx].pid = desc.idProduct;
-			idx++;
+		if (!present)
+			libusb_shared_left(i);
+	}
+	for (size_t j = 0; j < seen_count; j++) {
+		libusb_shared_arrived(&seen[j]);
+	}
+
+	free(seen);
+	return EFEX_ERR_SUCCESS;
+}
+
+// Brings the index up to date, waiting up to timeout_ms for hotplug events. Lock must be held.
+static int libusb_shared_pump(const int timeout_ms) {
+	if (!libusb_shared.context) {
+		if (libusb_init(&libusb_shared.context) < 0) {
+			libusb_shared.context = NULL;
+			return EFEX_ERR_USB_INIT;
 		}
 	}
 
-	libusb_free_device_list(list, 1);
-	libusb_exit(context);
+	if (!libusb_shared.hotplug && libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
+		// ENUMERATE reports the devices already present through the callback right away
+		if (libusb_hotplug_register_callback(
+				    libusb_shared.context, LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+				    LIBUSB_HOTPLUG_ENUMERATE, SUNXI_USB_VENDOR, SUNXI_USB_PRODUCT, LIBUSB_HOTPLUG_MATCH_ANY,
+				    libusb_shared_hotplug_callback, NULL, &libusb_shared.callback) == LIBUSB_SUCCESS) {
+			libusb_shared.hotplug = 1;
+		}
+	}
+
+	if (!libusb_shared.hotplug) {
+		return libusb_shared_rescan();
+	}
 
-	*devices = result;
-	*count = found_count;
+	struct timeval tv = {
+			.tv_sec = timeout_ms / 1000,
+			.tv_usec = (timeout_ms % 1000) * 1000,
+	};
+	const int r = libusb_handle_events_timeout_completed(libusb_shared.context, &tv, NULL);
+	if (r < 0 && r != LIBUSB_ERROR_INTERRUPTED) {
+		return EFEX_ERR_USB_TRANSFER;
+	}
 	return EFEX_ERR_SUCCESS;
 }
 
-static int libusb_hotplug_snapshot(struct sunxi_hotplug_device_t **devices, size_t *count) {
+static int libusb_scan_devices(struct sunxi_scanned_device_t **devices, size_t *count) {
 	if (!devices || !count) {
 		return EFEX_ERR_NULL_PTR;
 	}
@@ -190,77 +538,124 @@ static int libusb_hotplug_snapshot(struct sunxi_hotplug_device_t **devices, size
 	*devices = NULL;
 	*count = 0;
 
-	libusb_device **list = NULL;
-	libusb_context *context = NULL;
+	sunxi_efex_mutex_lock(&libusb_shared.lock);
+	int ret = libusb_shared_pump(0);
+	if (ret == EFEX_ERR_SUCCESS && libusb_shared.count == 0) {
+		ret = EFEX_ERR_USB_DEVICE_NOT_FOUND;
+	}
 
-	int r = libusb_init(&context);
-	if (r < 0) {
-		return EFEX_ERR_USB_INIT;
+	struct sunxi_scanned_device_t *result = NULL;
+	if (ret == EFEX_ERR_SUCCESS) {
+		result = malloc(sizeof(*result) * libusb_shared.count);
+		if (!result)
+			ret = EFEX_ERR_MEMORY;
 	}
+	if (ret == EFEX_ERR_SUCCESS) {
+		for (size_t i = 0; i < libusb_shared.count; i++) {
+			result[i].bus = (uint8_t) libusb_shared.devices[i].bus_id;
+			result[i].port = libusb_shared.devices[i].port;
+			result[i].vid = libusb_shared.devices[i].vid;
+			result[i].pid = libusb_shared.devices[i].pid;
+		}
+		*devices = result;
+		*count = libusb_shared.count;
+	}
+	sunxi_efex_mutex_unlock(&libusb_shared.lock);
+	return ret;
+}
 
-	const ssize_t device_count = libusb_get_device_list(context, &list);
-	if (device_count < 0) {
-		libusb_exit(context);
-		return EFEX_ERR_USB_DEVICE_NOT_FOUND;
+static int libusb_hotplug_snapshot(struct sunxi_hotplug_device_t **devices, size_t *count) {
+	if (!devices || !count) {
+		return EFEX_ERR_NULL_PTR;
 	}
 
-	size_t found_count = 0;
-	for (ssize_t i = 0; i < device_count; i++) {
-		libusb_device *device = list[i];
-		struct libusb_device_descriptor desc;
-		if (libusb_get_device_descriptor(device, &desc) != 0) {
-			continue;
-		}
-		if (desc.idVendor == SUNXI_USB_VENDOR && desc.idProduct == SUNXI_USB_PRODUCT) {
-			found_count++;
+	*devices = NULL;
+	*count = 0;
+
+	sunxi_efex_mutex_lock(&libusb_shared.lock);
+	int ret = libusb_shared_pump(0);
+	if (ret == EFEX_ERR_SUCCESS && libusb_shared.count > 0) {
+		struct sunxi_hotplug_device_t *result = calloc(libusb_shared.count, sizeof(*result));
+		if (result) {
+			for (size_t i = 0; i < libusb_shared.count; i++) {
+				result[i] = libusb_shared.devices[i];
+				result[i].device_path = libusb_shared.devices[i].device_path
+				                                ? strdup(libusb_shared.devices[i].device_path)
+				                                : NULL;
+			}
+			*devices = result;
+			*count = libusb_shared.count;
+		} else {
+			ret = EFEX_ERR_MEMORY;
 		}
 	}
+	sunxi_efex_mutex_unlock(&libusb_shared.lock);
+	return ret;
+}
 
-	if (found_count == 0) {
-		libusb_free_device_list(list, 1);
-		libusb_exit(context);
-		return EFEX_ERR_SUCCESS;
+static int libusb_hotplug_poll(struct sunxi_hotplug_event_t **events, size_t *count, const int timeout_ms) {
+	if (!events || !count) {
+		return EFEX_ERR_NULL_PTR;
 	}
 
-	struct sunxi_hotplug_device_t *result = (struct sunxi_hotplug_device_t *)malloc(
-		sizeof(struct sunxi_hotplug_device_t) * found_count);
-	if (!result) {
-		libusb_free_device_list(list, 1);
-		libusb_exit(context);
-		return EFEX_ERR_MEMORY;
+	*events = NULL;
+	*count = 0;
+	if (timeout_ms < 0) {
+		return EFEX_ERR_INVALID_PARAM;
 	}
-	memset(result, 0, sizeof(struct sunxi_hotplug_device_t) * found_count);
 
-	size_t idx = 0;
-	for (ssize_t i = 0; i < device_count && idx < found_count; i++) {
-		libusb_device *device = list[i];
-		struct libusb_device_descriptor desc;
-		if (libusb_get_device_descriptor(device, &desc) != 0) {
-			continue;
+	// Wait in short slices so snapshot callers on other threads are not held off for the whole timeout
+	int waited = 0;
+	int hotplug;
+	int ret;
+	do {
+		const int slice = timeout_ms - waited < 10 ? timeout_ms - waited : 10;
+
+		sunxi_efex_mutex_lock(&libusb_shared.lock);
+		if (!libusb_shared.events_enabled) {
+			// First poll: report what is already there as arrived
+			libusb_shared.events_enabled = 1;
+			for (size_t i = 0; i < libusb_shared.count; i++)
+				libusb_shared_queue_event(SUNXI_HOTPLUG_ARRIVED, &libusb_shared.devices[i]);
 		}
-		if (desc.idVendor == SUNXI_USB_VENDOR && desc.idProduct == SUNXI_USB_PRODUCT) {
-			result[idx].vid = desc.idVendor;
-			result[idx].pid = desc.idProduct;
-			result[idx].bus_id = libusb_get_bus_number(device);
-			result[idx].usb_device_id = libusb_get_device_address(device);
-			result[idx].port = libusb_get_port_number(device);
-			/* Synthesize a stable device_path from bus:port for libusb backend */
-			{
-				char buf[32];
-				snprintf(buf, sizeof(buf), "libusb:%u:%u",
-					(unsigned)result[idx].bus_id, (unsigned)result[idx].port);
-				result[idx].device_path = strdup(buf);
-			}
-			idx++;
+		ret = libusb_shared_pump(libusb_shared.event_count ? 0 : slice);
+		hotplug = libusb_shared.hotplug;
+		if (ret == EFEX_ERR_SUCCESS && libusb_shared.event_count > 0) {
+			*events = libusb_shared.events;
+			*count = libusb_shared.event_count;
+			libusb_shared.events = NULL;
+			libusb_shared.event_count = 0;
 		}
-	}
+		sunxi_efex_mutex_unlock(&libusb_shared.lock);
 
-	libusb_free_device_list(list, 1);
-	libusb_exit(context);
+		// Enumeration fallback does not block, so pace it like the hotplug wait would
+		if (!hotplug && *count == 0 && slice > 0)
+			sunxi_efex_sleep_ms((uint32_t) slice);
+		waited += slice;
+	} while (ret == EFEX_ERR_SUCCESS && *count == 0 && waited < timeout_ms);
 
-	*devices = result;
-	*count = found_count;
-	return EFEX_ERR_SUCCESS;
+	return ret;
+}
+
+static void libusb_shared_exit(void) {
+	sunxi_efex_mutex_lock(&libusb_shared.lock);
+	if (libusb_shared.context) {
+		if (libusb_shared.hotplug)
+			libusb_hotplug_deregister_callback(libusb_shared.context, libusb_shared.callback);
+		libusb_exit(libusb_shared.context);
+	}
+	sunxi_hotplug_free_snapshot(libusb_shared.devices, libusb_shared.count);
+	sunxi_hotplug_free_events(libusb_shared.events, libusb_shared.event_count);
+
+	libusb_shared.context = NULL;
+	libusb_shared.hotplug = 0;
+	libusb_shared.devices = NULL;
+	libusb_shared.count = 0;
+	libusb_shared.capacity = 0;
+	libusb_shared.events = NULL;
+	libusb_shared.event_count = 0;
+	libusb_shared.events_enabled = 0;
+	sunxi_efex_mutex_unlock(&libusb_shared.lock);
 }
 
 static int libusb_scan_device_at(struct sunxi_efex_ctx_t *ctx, uint8_t bus, uint8_t port) {
@@ -302,6 +697,25 @@ static int libusb_scan_device_at(struct sunxi_efex_ctx_t *ctx, uint8_t bus, uint
 	return EFEX_ERR_USB_DEVICE_NOT_FOUND;
 }
 
+static int libusb_bulk_clear_halt(void *handle, int ep) {
+	if (!handle) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	if (libusb_clear_halt((libusb_device_handle *) handle, (unsigned char) ep) != 0) {
+		return EFEX_ERR_USB_TRANSFER;
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+static void *libusb_dev_mem_alloc_buf(void *handle, size_t len) {
+	// Returns NULL on kernels without usbfs mmap support and on non-Linux platforms
+	return libusb_dev_mem_alloc((libusb_device_handle *) handle, len);
+}
+
+static void libusb_dev_mem_free_buf(void *handle, void *buf, size_t len) {
+	libusb_dev_mem_free((libusb_device_handle *) handle, (unsigned char *) buf, len);
+}
+
 static int libusb_backend_init(struct sunxi_efex_ctx_t *ctx) {
 	if (ctx && ctx->hdl) {
 		libusb_device_handle *libusb_hdl = (libusb_device_handle *) ctx->hdl;
@@ -364,4 +778,13 @@ const struct usb_backend_ops usb_libusb_ops = {
 	.hotplug_snapshot = libusb_hotplug_snapshot,
 	.init = libusb_backend_init,
 	.exit = libusb_backend_exit,
+	.bulk_send_async = libusb_bulk_send_async,
+	.bulk_recv_async = libusb_bulk_recv_async,
+	.bulk_chain_submit = libusb_bulk_chain_submit,
+	.bulk_chain_wait = libusb_bulk_chain_wait,
+	.dev_mem_alloc = libusb_dev_mem_alloc_buf,
+	.dev_mem_free = libusb_dev_mem_free_buf,
+	.clear_halt = libusb_bulk_clear_halt,
+	.hotplug_poll = libusb_hotplug_poll,
+	.shared_exit = libusb_shared_exit,
 };
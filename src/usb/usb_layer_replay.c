@@ -0,0 +1,260 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "efex-chunk.h"
+#include "efex-common.h"
+#include "efex-protocol.h"
+#include "efex-record.h"
+#include "efex-thread.h"
+#include "efex-usb.h"
+#include "ending.h"
+#include "usb_layer.h"
+
+#define REPLAY_EP_OUT (0x01)
+#define REPLAY_EP_IN (0x82)
+#define REPLAY_FILE_BUFFER (1024 * 1024)
+#define REPLAY_COMPARE_SIZE (64 * 1024)
+
+// The recording being served; a device open continues where the last one stopped
+static struct {
+	sunxi_efex_mutex_t lock;
+	FILE *fp;
+	enum sunxi_efex_replay_speed_t speed;
+	uint64_t index;      // transfers served so far
+	uint64_t busy_until; // end of the last transfer when replaying at recorded speed
+	int opened;
+	int failed;
+	char scratch[REPLAY_COMPARE_SIZE];
+} replay = {
+		.lock = SUNXI_EFEX_MUTEX_INIT,
+};
+
+int sunxi_usb_replay_configure(const char *path, const enum sunxi_efex_replay_speed_t speed) {
+	if (speed != SUNXI_EFEX_REPLAY_FAST && speed != SUNXI_EFEX_REPLAY_RECORDED) {
+		return EFEX_ERR_INVALID_PARAM;
+	}
+
+	FILE *fp = NULL;
+	struct sunxi_efex_record_file_t hdr;
+	if (path) {
+		fp = fopen(path, "rb");
+		if (!fp) {
+			return EFEX_ERR_FILE_OPEN;
+		}
+		if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || le32_to_cpu(hdr.magic) != SUNXI_EFEX_RECORD_MAGIC ||
+		    le16_to_cpu(hdr.version) != SUNXI_EFEX_RECORD_VERSION) {
+			fclose(fp);
+			return EFEX_ERR_FILE_READ;
+		}
+		setvbuf(fp, NULL, _IOFBF, REPLAY_FILE_BUFFER);
+	}
+
+	sunxi_efex_mutex_lock(&replay.lock);
+	if (replay.opened) {
+		sunxi_efex_mutex_unlock(&replay.lock);
+		if (fp)
+			fclose(fp);
+		return EFEX_ERR_DEVICE_BUSY;
+	}
+	if (replay.fp)
+		fclose(replay.fp);
+	replay.fp = fp;
+	replay.speed = speed;
+	replay.index = 0;
+	replay.busy_until = 0;
+	replay.failed = 0;
+	sunxi_efex_mutex_unlock(&replay.lock);
+	return EFEX_ERR_SUCCESS;
+}
+
+static int replay_diverged(const char *what, const struct sunxi_efex_record_xfer_t *x, const int ep,
+                           const ssize_t len) {
+	fprintf(stderr, "ERROR: Replay diverged at transfer %llu: %s (recorded ep=0x%02x len=%llu, got ep=0x%02x "
+	                "len=%lld)\r\n",
+	        (unsigned long long) replay.index, what, x ? x->ep : 0, x ? (unsigned long long) x->len : 0ULL,
+	        (unsigned) ep, (long long) len);
+	replay.failed = 1;
+	return EFEX_ERR_USB_TRANSFER;
+}
+
+// Next record of the stream, checked against the transfer the host makes
+static int replay_next(struct sunxi_efex_record_xfer_t *x, const int ep, const ssize_t len) {
+	if (replay.failed || !replay.fp) {
+		return EFEX_ERR_USB_TRANSFER;
+	}
+	if (fread(x, sizeof(*x), 1, replay.fp) != 1) {
+		return replay_diverged("recording ended", NULL, ep, len);
+	}
+	x->ts_us = le64_to_cpu(x->ts_us);
+	x->len = le64_to_cpu(x->len);
+	x->dur_us = le32_to_cpu(x->dur_us);
+	x->status = (int32_t) le32_to_cpu(x->status);
+	if ((x->ep & 0x80) != (ep & 0x80)) {
+		return replay_diverged("direction differs", x, ep, len);
+	}
+	if (len < 0 || x->len != (uint64_t) len) {
+		return replay_diverged("length differs", x, ep, len);
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+// Charged against a running deadline like the simulated backend, so sleep overshoot evens out
+static void replay_pace(const uint32_t dur_us) {
+	if (replay.speed != SUNXI_EFEX_REPLAY_RECORDED)
+		return;
+
+	const uint64_t now = sunxi_efex_time_us();
+	if (replay.busy_until + 2000 < now)
+		replay.busy_until = now;
+	replay.busy_until += dur_us;
+	if (replay.busy_until > now)
+		sunxi_efex_sleep_us(replay.busy_until - now);
+}
+
+static int replay_bulk_send(void *handle, int ep, const char *buf, ssize_t len, unsigned int timeout) {
+	(void) timeout;
+	if (!handle || !buf) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	struct sunxi_efex_record_xfer_t x;
+	int ret = replay_next(&x, ep, len);
+	if (ret != EFEX_ERR_SUCCESS) {
+		return ret;
+	}
+
+	if (x.data) {
+		for (size_t off = 0; off < (size_t) len;) {
+			const size_t n = (size_t) len - off < sizeof(replay.scratch) ? (size_t) len - off : sizeof(replay.scratch);
+			if (fread(replay.scratch, 1, n, replay.fp) != n) {
+				return replay_diverged("recording truncated", &x, ep, len);
+			}
+			if (memcmp(replay.scratch, buf + off, n) != 0) {
+				return replay_diverged("payload differs", &x, ep, len);
+			}
+			off += n;
+		}
+	}
+
+	replay_pace(x.dur_us);
+	replay.index++;
+	return x.status;
+}
+
+static int replay_bulk_recv(void *handle, int ep, char *buf, ssize_t len, unsigned int timeout) {
+	(void) timeout;
+	if (!handle || !buf) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	struct sunxi_efex_record_xfer_t x;
+	int ret = replay_next(&x, ep, len);
+	if (ret != EFEX_ERR_SUCCESS) {
+		return ret;
+	}
+
+	if (x.data && fread(buf, 1, (size_t) len, replay.fp) != (size_t) len) {
+		return replay_diverged("recording truncated", &x, ep, len);
+	}
+
+	replay_pace(x.dur_us);
+	replay.index++;
+	return x.status;
+}
+
+static int replay_scan_device_at(struct sunxi_efex_ctx_t *ctx, uint8_t bus, uint8_t port) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	if (bus != 0 || port != 1) {
+		return EFEX_ERR_USB_DEVICE_NOT_FOUND;
+	}
+
+	int ret = EFEX_ERR_SUCCESS;
+	sunxi_efex_mutex_lock(&replay.lock);
+	if (!replay.fp || replay.failed) {
+		ret = EFEX_ERR_USB_DEVICE_NOT_FOUND;
+	} else if (replay.opened) {
+		ret = EFEX_ERR_DEVICE_BUSY;
+	} else {
+		replay.opened = 1;
+		ctx->hdl = &replay;
+	}
+	sunxi_efex_mutex_unlock(&replay.lock);
+	return ret;
+}
+
+static int replay_scan_device(struct sunxi_efex_ctx_t *ctx) {
+	return replay_scan_device_at(ctx, 0, 1);
+}
+
+static int replay_scan_devices(struct sunxi_scanned_device_t **devices, size_t *count) {
+	if (!devices || !count) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	*devices = NULL;
+	*count = 0;
+	if (!replay.fp) {
+		return EFEX_ERR_USB_DEVICE_NOT_FOUND;
+	}
+
+	struct sunxi_scanned_device_t *result = calloc(1, sizeof(*result));
+	if (!result) {
+		return EFEX_ERR_MEMORY;
+	}
+	result->bus = 0;
+	result->port = 1;
+	result->vid = SUNXI_USB_VENDOR;
+	result->pid = SUNXI_USB_PRODUCT;
+	*devices = result;
+	*count = 1;
+	return EFEX_ERR_SUCCESS;
+}
+
+static int replay_backend_init(struct sunxi_efex_ctx_t *ctx) {
+	if (!ctx || !ctx->hdl) {
+		return EFEX_ERR_USB_INIT;
+	}
+	ctx->epout = REPLAY_EP_OUT;
+	ctx->epin = REPLAY_EP_IN;
+	return EFEX_ERR_SUCCESS;
+}
+
+static int replay_backend_exit(struct sunxi_efex_ctx_t *ctx) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	if (ctx->hdl) {
+		sunxi_efex_mutex_lock(&replay.lock);
+		replay.opened = 0;
+		sunxi_efex_mutex_unlock(&replay.lock);
+		ctx->hdl = NULL;
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+// Recovery sends nothing the recording could have seen
+static int replay_clear_halt(void *handle, int ep) {
+	(void) ep;
+	return handle ? EFEX_ERR_SUCCESS : EFEX_ERR_NULL_PTR;
+}
+
+static void replay_shared_exit(void) {
+	sunxi_usb_replay_configure(NULL, SUNXI_EFEX_REPLAY_FAST);
+}
+
+const struct usb_backend_ops usb_replay_ops = {
+	.bulk_send = replay_bulk_send,
+	.bulk_recv = replay_bulk_recv,
+	.scan_device = replay_scan_device,
+	.scan_device_at = replay_scan_device_at,
+	.scan_devices = replay_scan_devices,
+	.init = replay_backend_init,
+	.exit = replay_backend_exit,
+	.clear_halt = replay_clear_halt,
+	.shared_exit = replay_shared_exit,
+};
@@ -0,0 +1,245 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "efex-chunk.h"
+#include "efex-common.h"
+#include "efex-protocol.h"
+#include "efex-sim.h"
+#include "efex-thread.h"
+#include "efex-usb.h"
+#include "usb_layer.h"
+
+#define SIM_EP_OUT (0x01)
+#define SIM_EP_IN (0x82)
+
+// Devices the backend presents, one device with the defaults until configured
+static struct {
+	sunxi_efex_mutex_t lock;
+	int configured;
+	struct sunxi_efex_sim_config_t config;
+	char *flash_path;
+	unsigned int devices;
+} sim_shared = {
+		.lock = SUNXI_EFEX_MUTEX_INIT,
+};
+
+struct sim_handle_t {
+	struct sunxi_efex_sim_t *sim;
+	uint32_t latency_us;
+	uint64_t bandwidth;
+	uint64_t busy_until; // when the simulated bus is done with what was queued so far
+};
+
+int sunxi_usb_sim_configure(const struct sunxi_efex_sim_config_t *config, const unsigned int devices) {
+	char *flash_path = NULL;
+	if (config && config->flash_path) {
+		flash_path = strdup(config->flash_path);
+		if (!flash_path)
+			return EFEX_ERR_MEMORY;
+	}
+
+	sunxi_efex_mutex_lock(&sim_shared.lock);
+	if (config)
+		sim_shared.config = *config;
+	else
+		sunxi_efex_sim_config_init(&sim_shared.config);
+	free(sim_shared.flash_path);
+	sim_shared.flash_path = flash_path;
+	sim_shared.config.flash_path = flash_path;
+	sim_shared.devices = devices;
+	sim_shared.configured = 1;
+	sunxi_efex_mutex_unlock(&sim_shared.lock);
+	return EFEX_ERR_SUCCESS;
+}
+
+static unsigned int sim_device_count(void) {
+	if (!sim_shared.configured) {
+		sunxi_efex_sim_config_init(&sim_shared.config);
+		sim_shared.devices = 1;
+		sim_shared.configured = 1;
+	}
+	return sim_shared.devices;
+}
+
+// Latency and bandwidth are charged against a running deadline, so short sleeps that overshoot
+// are made up by the transfers that follow
+static void sim_pace(struct sim_handle_t *h, const size_t len) {
+	if (h->latency_us == 0 && h->bandwidth == 0)
+		return;
+
+	const uint64_t cost = h->latency_us + (h->bandwidth ? (uint64_t) len * 1000000ULL / h->bandwidth : 0);
+	const uint64_t now = sunxi_efex_time_us();
+	// Idle time is not credited to later transfers
+	if (h->busy_until + 2000 < now)
+		h->busy_until = now;
+	h->busy_until += cost;
+	if (h->busy_until > now)
+		sunxi_efex_sleep_us(h->busy_until - now);
+}
+
+static int sim_bulk_send(void *handle, int ep, const char *buf, ssize_t len, unsigned int timeout) {
+	(void) ep;
+	(void) timeout;
+	if (!handle || !buf) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	struct sim_handle_t *h = handle;
+	sim_pace(h, (size_t) len);
+	return sunxi_efex_sim_out(h->sim, buf, (size_t) len);
+}
+
+static int sim_bulk_recv(void *handle, int ep, char *buf, ssize_t len, unsigned int timeout) {
+	(void) ep;
+	(void) timeout;
+	if (!handle || !buf) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	struct sim_handle_t *h = handle;
+	sim_pace(h, (size_t) len);
+	return sunxi_efex_sim_in(h->sim, buf, (size_t) len);
+}
+
+static int sim_scan_device_at(struct sunxi_efex_ctx_t *ctx, uint8_t bus, uint8_t port) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	sunxi_efex_mutex_lock(&sim_shared.lock);
+	if (bus != 0 || port == 0 || port > sim_device_count()) {
+		sunxi_efex_mutex_unlock(&sim_shared.lock);
+		return EFEX_ERR_USB_DEVICE_NOT_FOUND;
+	}
+
+	struct sim_handle_t *h = calloc(1, sizeof(*h));
+	int ret = h ? sunxi_efex_sim_create(&sim_shared.config, &h->sim) : EFEX_ERR_MEMORY;
+	if (ret == EFEX_ERR_SUCCESS) {
+		h->latency_us = sim_shared.config.latency_us;
+		h->bandwidth = sim_shared.config.bandwidth;
+		ctx->hdl = h;
+	} else {
+		free(h);
+	}
+	sunxi_efex_mutex_unlock(&sim_shared.lock);
+	return ret;
+}
+
+static int sim_scan_device(struct sunxi_efex_ctx_t *ctx) {
+	return sim_scan_device_at(ctx, 0, 1);
+}
+
+static int sim_scan_devices(struct sunxi_scanned_device_t **devices, size_t *count) {
+	if (!devices || !count) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	*devices = NULL;
+	*count = 0;
+
+	sunxi_efex_mutex_lock(&sim_shared.lock);
+	const unsigned int n = sim_device_count();
+	sunxi_efex_mutex_unlock(&sim_shared.lock);
+	if (n == 0) {
+		return EFEX_ERR_USB_DEVICE_NOT_FOUND;
+	}
+
+	struct sunxi_scanned_device_t *result = calloc(n, sizeof(*result));
+	if (!result) {
+		return EFEX_ERR_MEMORY;
+	}
+	for (unsigned int i = 0; i < n; i++) {
+		result[i].bus = 0;
+		result[i].port = (uint8_t) (i + 1);
+		result[i].vid = SUNXI_USB_VENDOR;
+		result[i].pid = SUNXI_USB_PRODUCT;
+	}
+	*devices = result;
+	*count = n;
+	return EFEX_ERR_SUCCESS;
+}
+
+static int sim_hotplug_snapshot(struct sunxi_hotplug_device_t **devices, size_t *count) {
+	if (!devices || !count) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	*devices = NULL;
+	*count = 0;
+
+	sunxi_efex_mutex_lock(&sim_shared.lock);
+	const unsigned int n = sim_device_count();
+	sunxi_efex_mutex_unlock(&sim_shared.lock);
+	if (n == 0) {
+		return EFEX_ERR_SUCCESS;
+	}
+
+	struct sunxi_hotplug_device_t *result = calloc(n, sizeof(*result));
+	if (!result) {
+		return EFEX_ERR_MEMORY;
+	}
+	for (unsigned int i = 0; i < n; i++) {
+		result[i].vid = SUNXI_USB_VENDOR;
+		result[i].pid = SUNXI_USB_PRODUCT;
+		result[i].bus_id = 0;
+		result[i].usb_device_id = i + 1;
+		result[i].port = (uint8_t) (i + 1);
+	}
+	*devices = result;
+	*count = n;
+	return EFEX_ERR_SUCCESS;
+}
+
+static int sim_backend_init(struct sunxi_efex_ctx_t *ctx) {
+	if (!ctx || !ctx->hdl) {
+		return EFEX_ERR_USB_INIT;
+	}
+	ctx->epout = SIM_EP_OUT;
+	ctx->epin = SIM_EP_IN;
+	return EFEX_ERR_SUCCESS;
+}
+
+static int sim_backend_exit(struct sunxi_efex_ctx_t *ctx) {
+	if (!ctx) {
+		return EFEX_ERR_NULL_PTR;
+	}
+
+	struct sim_handle_t *h = ctx->hdl;
+	if (h) {
+		sunxi_efex_sim_destroy(h->sim);
+		free(h);
+		ctx->hdl = NULL;
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+static int sim_clear_halt(void *handle, int ep) {
+	(void) ep;
+	if (!handle) {
+		return EFEX_ERR_NULL_PTR;
+	}
+	sunxi_efex_sim_reset(((struct sim_handle_t *) handle)->sim);
+	return EFEX_ERR_SUCCESS;
+}
+
+static void sim_shared_exit(void) {
+	sunxi_efex_mutex_lock(&sim_shared.lock);
+	free(sim_shared.flash_path);
+	sim_shared.flash_path = NULL;
+	sim_shared.configured = 0;
+	sunxi_efex_mutex_unlock(&sim_shared.lock);
+}
+
+const struct usb_backend_ops usb_sim_ops = {
+	.bulk_send = sim_bulk_send,
+	.bulk_recv = sim_bulk_recv,
+	.scan_device = sim_scan_device,
+	.scan_device_at = sim_scan_device_at,
+	.scan_devices = sim_scan_devices,
+	.hotplug_snapshot = sim_hotplug_snapshot,
+	.init = sim_backend_init,
+	.exit = sim_backend_exit,
+	.clear_halt = sim_clear_halt,
+	.shared_exit = sim_shared_exit,
+};
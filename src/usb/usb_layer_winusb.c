@@ -98,7 +98,8 @@ static int try_read_port_number(HDEVINFO device_info_set, PSP_DEVINFO_DATA dev_i
 	return try_read_dword_property(device_info_set, dev_info_data, SPDRP_ADDRESS, port_nr) && *port_nr <= 0xff;
 }
 
-static int winusb_bulk_send(void *handle, int ep, const char *buf, ssize_t len) {
+// The driver IOCTLs complete synchronously without a timeout, so timeout is not used here
+static int winusb_bulk_send(void *handle, int ep, const char *buf, ssize_t len, unsigned int timeout) {
 	if (!handle || !buf || len <= 0) {
 		return EFEX_ERR_NULL_PTR;
 	}
@@ -110,8 +111,6 @@ static int winusb_bulk_send(void *handle, int ep, const char *buf, ssize_t len)
 	while (len > 0) {
 		const size_t chunk = len <= max_chunk ? len : max_chunk;
 
-		sunxi_usb_hex_dump(buf, chunk, "SEND");
-
 		const DWORD dwIoControlCode = CTL_CODE(FILE_DEVICE_UNKNOWN, 0x0807, METHOD_OUT_DIRECT, FILE_ANY_ACCESS);
 
 		BOOL const result =
@@ -127,7 +126,7 @@ static int winusb_bulk_send(void *handle, int ep, const char *buf, ssize_t len)
 	return EFEX_ERR_SUCCESS;
 }
 
-static int winusb_bulk_recv(void *handle, int ep, char *buf, const ssize_t len) {
+static int winusb_bulk_recv(void *handle, int ep, char *buf, const ssize_t len, unsigned int timeout) {
 	if (!handle || !buf || len <= 0) {
 		return EFEX_ERR_NULL_PTR;
 	}
@@ -144,8 +143,6 @@ static int winusb_bulk_recv(void *handle, int ep, char *buf, const ssize_t len)
 		return EFEX_ERR_USB_TRANSFER;
 	}
 
-	sunxi_usb_hex_dump(buf, (size_t) bytes_received, "RECV");
-
 	return EFEX_ERR_SUCCESS;
 }
 
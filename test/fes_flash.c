@@ -15,6 +15,7 @@
 
 #define DEFAULT_BUFFER_SIZE 4096
 #define DEFAULT_ADDRESS 0x40000000
+#define ERASE_CHUNK_SIZE (4 * 1024 * 1024)
 #define WORK_MODE_USB_PRODUCT 0x10
 #define	EFEX_CRC32_VALID_FLAG (0x6a617603)
 #define MBR_VERSION 0x00000200
@@ -146,40 +147,14 @@ int init_device_fes(struct sunxi_efex_ctx_t *ctx, const char *fex_file, const ch
 
 	// Process FEX file
 	if (fex_file) {
-		FILE *fp = fopen(fex_file, "rb");
-		if (!fp) {
-			fprintf(stderr, "ERROR: %s: %s\r\n", sunxi_efex_strerror(EFEX_ERR_FILE_OPEN), fex_file);
-			return EFEX_ERR_FILE_OPEN;
-		}
-
-		// Get file size
-		fseek(fp, 0, SEEK_END);
-		const long file_size = ftell(fp);
-		fseek(fp, 0, SEEK_SET);
-
-		if (file_size <= 0) {
-			fprintf(stderr, "ERROR: %s: %s\r\n", sunxi_efex_strerror(EFEX_ERR_FILE_SIZE), fex_file);
-			fclose(fp);
-			return EFEX_ERR_FILE_SIZE;
-		}
-
-		// Allocate buffer for file content
-		char *buffer = malloc(file_size);
-		if (!buffer) {
-			fprintf(stderr, "ERROR: %s\r\n", sunxi_efex_strerror(EFEX_ERR_MEMORY));
-			fclose(fp);
-			return EFEX_ERR_MEMORY;
-		}
-
-		// Read file content
-		const size_t bytes_read = fread(buffer, 1, file_size, fp);
-		fclose(fp);
-
-		if (bytes_read != (size_t) file_size) {
-			fprintf(stderr, "ERROR: %s\r\n", sunxi_efex_strerror(EFEX_ERR_FILE_READ));
-			free(buffer);
-			return EFEX_ERR_FILE_READ;
+		struct sunxi_efex_image_t img;
+		ret = sunxi_efex_image_open(&img, fex_file);
+		if (ret != EFEX_ERR_SUCCESS) {
+			fprintf(stderr, "ERROR: %s: %s\r\n", sunxi_efex_strerror(ret), fex_file);
+			return ret;
 		}
+		char *buffer = img.data;
+		const long file_size = (long) img.size;
 
 		const struct boot_file_head_t *fex_head = (const struct boot_file_head_t *) buffer;
 
@@ -193,7 +168,7 @@ int init_device_fes(struct sunxi_efex_ctx_t *ctx, const char *fex_file, const ch
 		                           sizeof(struct dram_param_info_t));
 		if (ret != EFEX_ERR_SUCCESS) {
 			fprintf(stderr, "ERROR: %s\n", sunxi_efex_strerror(ret));
-			free(buffer);
+			sunxi_efex_image_close(&img);
 			return ret;
 		}
 
@@ -201,13 +176,13 @@ int init_device_fes(struct sunxi_efex_ctx_t *ctx, const char *fex_file, const ch
 		ret = sunxi_efex_fel_write(ctx, fex_head->run_addr, buffer, (ssize_t) file_size);
 		if (ret != EFEX_ERR_SUCCESS) {
 			fprintf(stderr, "ERROR: %s\n", sunxi_efex_strerror(ret));
-			free(buffer);
+			sunxi_efex_image_close(&img);
 			return ret;
 		}
 		ret = sunxi_efex_fel_exec(ctx, fex_head->run_addr);
 		if (ret != EFEX_ERR_SUCCESS) {
 			fprintf(stderr, "ERROR: %s\n", sunxi_efex_strerror(ret));
-			free(buffer);
+			sunxi_efex_image_close(&img);
 			return ret;
 		}
 
@@ -216,7 +191,7 @@ int init_device_fes(struct sunxi_efex_ctx_t *ctx, const char *fex_file, const ch
 		ret = sunxi_efex_fel_read(ctx, fex_head->ret_addr, (char *) &dram_param_info, sizeof(struct dram_param_info_t));
 		if (ret != EFEX_ERR_SUCCESS) {
 			fprintf(stderr, "ERROR: %s\n", sunxi_efex_strerror(ret));
-			free(buffer);
+			sunxi_efex_image_close(&img);
 			return ret;
 		}
 
@@ -227,50 +202,25 @@ int init_device_fes(struct sunxi_efex_ctx_t *ctx, const char *fex_file, const ch
 		}
 
 		if (dram_param_info.dram_init_flag == 1) {
-			free(buffer);
+			sunxi_efex_image_close(&img);
 			printf("DRAM init failed\n");
 			return -1;
 		}
-		free(buffer);
+		sunxi_efex_image_close(&img);
 		printf("FEX file download completed successfully\n");
 	}
 
 	// Process U-Boot file
 	if (uboot_file) {
-		FILE *fp = fopen(uboot_file, "rb");
-		if (!fp) {
-			fprintf(stderr, "ERROR: %s: %s\r\n", sunxi_efex_strerror(EFEX_ERR_FILE_OPEN), uboot_file);
-			return EFEX_ERR_FILE_OPEN;
-		}
-
-		// Get file size
-		fseek(fp, 0, SEEK_END);
-		const long file_size = ftell(fp);
-		fseek(fp, 0, SEEK_SET);
-
-		if (file_size <= 0) {
-			fprintf(stderr, "ERROR: %s: %s\r\n", sunxi_efex_strerror(EFEX_ERR_FILE_SIZE), uboot_file);
-			fclose(fp);
-			return EFEX_ERR_FILE_SIZE;
-		}
-
-		// Allocate buffer for file content
-		char *buffer = malloc(file_size);
-		if (!buffer) {
-			fprintf(stderr, "ERROR: %s\r\n", sunxi_efex_strerror(EFEX_ERR_MEMORY));
-			fclose(fp);
-			return EFEX_ERR_MEMORY;
-		}
-
-		// Read file content
-		const size_t bytes_read = fread(buffer, 1, file_size, fp);
-		fclose(fp);
-
-		if (bytes_read != (size_t) file_size) {
-			fprintf(stderr, "ERROR: %s\r\n", sunxi_efex_strerror(EFEX_ERR_FILE_READ));
-			free(buffer);
-			return EFEX_ERR_FILE_READ;
+		// The work mode patch lands in a private copy of the first page, not in the file
+		struct sunxi_efex_image_t img;
+		ret = sunxi_efex_image_open(&img, uboot_file);
+		if (ret != EFEX_ERR_SUCCESS) {
+			fprintf(stderr, "ERROR: %s: %s\r\n", sunxi_efex_strerror(ret), uboot_file);
+			return ret;
 		}
+		char *buffer = img.data;
+		const long file_size = (long) img.size;
 
 		struct uboot_head_t *uboot_head = (struct uboot_head_t *) buffer;
 		uboot_head->uboot_data.work_mode = WORK_MODE_USB_PRODUCT;
@@ -280,18 +230,18 @@ int init_device_fes(struct sunxi_efex_ctx_t *ctx, const char *fex_file, const ch
 		ret = sunxi_efex_fel_write(ctx, uboot_head->uboot_head.run_addr, buffer, (ssize_t) file_size);
 		if (ret != EFEX_ERR_SUCCESS) {
 			fprintf(stderr, "ERROR: %s\n", sunxi_efex_strerror(ret));
-			free(buffer);
+			sunxi_efex_image_close(&img);
 			sunxi_usb_exit(ctx);
 			return ret;
 		}
 		ret = sunxi_efex_fel_exec(ctx, uboot_head->uboot_head.run_addr);
 		if (ret != EFEX_ERR_SUCCESS) {
 			fprintf(stderr, "ERROR: %s\n", sunxi_efex_strerror(ret));
-			free(buffer);
+			sunxi_efex_image_close(&img);
 			sunxi_usb_exit(ctx);
 			return ret;
 		}
-		free(buffer);
+		sunxi_efex_image_close(&img);
 
 		printf("U-Boot file download completed successfully\n");
 	}
@@ -397,9 +347,7 @@ int download_raw_file(const struct sunxi_efex_ctx_t *ctx, const char *firmware_f
                       const enum sunxi_fes_data_type_t type) {
 	int ret = 0;
 	char *full_firmware_path = NULL;
-	FILE *fp = NULL;
-	char *buffer = NULL;
-	long file_size = 0;
+	struct sunxi_efex_image_t img;
 
 	// Ensure firmware file has .fex extension
 	const char *fex_ext = ".fex";
@@ -427,63 +375,43 @@ int download_raw_file(const struct sunxi_efex_ctx_t *ctx, const char *firmware_f
 
 	printf("Downloading raw file: %s\n", full_firmware_path);
 
-	// Open firmware file
-	fp = fopen(full_firmware_path, "rb");
-	if (!fp) {
-		fprintf(stderr, "ERROR: %s: %s\r\n", sunxi_efex_strerror(EFEX_ERR_FILE_OPEN), full_firmware_path);
-		free(full_firmware_path);
-		return EFEX_ERR_FILE_OPEN;
-	}
-
-	// Get file size
-	fseek(fp, 0, SEEK_END);
-	file_size = ftell(fp);
-	fseek(fp, 0, SEEK_SET);
-
-	if (file_size <= 0) {
-		fprintf(stderr, "ERROR: %s: %s\r\n", sunxi_efex_strerror(EFEX_ERR_FILE_SIZE), full_firmware_path);
-		fclose(fp);
-		free(full_firmware_path);
-		return EFEX_ERR_FILE_SIZE;
-	}
-
-	// Allocate buffer for file content
-	buffer = (char *) malloc(file_size);
-	if (!buffer) {
-		fprintf(stderr, "ERROR: %s\r\n", sunxi_efex_strerror(EFEX_ERR_MEMORY));
-		fclose(fp);
-		free(full_firmware_path);
-		return EFEX_ERR_MEMORY;
-	}
-
-	// Read file content
-	const size_t bytes_read = fread(buffer, 1, file_size, fp);
-	fclose(fp);
-
-	if (bytes_read != (size_t) file_size) {
-		fprintf(stderr, "ERROR: %s\r\n", sunxi_efex_strerror(EFEX_ERR_FILE_READ));
-		free(buffer);
+	ret = sunxi_efex_image_open(&img, full_firmware_path);
+	if (ret != EFEX_ERR_SUCCESS) {
+		fprintf(stderr, "ERROR: %s: %s\r\n", sunxi_efex_strerror(ret), full_firmware_path);
 		free(full_firmware_path);
-		return EFEX_ERR_FILE_READ;
+		return ret;
 	}
 
 	// Download raw data using download_raw function
-	printf("Downloading %ld bytes raw data to device...\n", file_size);
-	ret = download_raw(ctx, buffer, file_size, type);
+	printf("Downloading %llu bytes raw data to device...\n", (unsigned long long) img.size);
+	ret = download_raw(ctx, img.data, (size_t) img.size, type);
 
 	// Free allocated resources
-	free(buffer);
+	sunxi_efex_image_close(&img);
 	free(full_firmware_path);
 
 	return ret;
 }
 
+// Streams a partition image from its file, or zeros when there is no file
+static ssize_t fes_flash_read(void *user, char *buf, const size_t len) {
+	FILE *fp = user;
+	if (!fp) {
+		memset(buf, 0, len);
+		return (ssize_t) len;
+	}
+	const size_t n = fread(buf, 1, len, fp);
+	if (n == 0 && ferror(fp)) {
+		return EFEX_ERR_FILE_READ;
+	}
+	return (ssize_t) n;
+}
+
 int download_firmware(const struct sunxi_efex_ctx_t *ctx, const char *firmware_file, const uint64_t address,
                       uint64_t file_size, const int erase_flag) {
 	int ret = 0;
 	char *full_firmware_path = NULL;
 	FILE *fp = NULL;
-	char *buffer = NULL;
 
 	// Ensure firmware file has .fex extension
 	const char *fex_ext = ".fex";
@@ -525,42 +453,45 @@ int download_firmware(const struct sunxi_efex_ctx_t *ctx, const char *firmware_f
 			goto cleanup;
 		}
 	} else {
-		printf("WARNING: File %s not found, using %lx zero-filled buffer\n", full_firmware_path, file_size);
+		printf("WARNING: File %s not found, sending %lx bytes of zeros\n", full_firmware_path, file_size);
 	}
 
-	// Allocate buffer for file content
-	buffer = malloc(file_size);
-	if (!buffer) {
-		fprintf(stderr, "ERROR: %s\r\n", sunxi_efex_strerror(EFEX_ERR_MEMORY));
-		goto cleanup;
+	// Android sparse images are expanded as they go out, what lands on flash is the expanded size
+	struct sunxi_efex_simg_t simg = {0};
+	char simg_header[28];
+	// A file with the sparse magic is never flashed raw, a header that does not parse is an error
+	if (fp && fread(simg_header, 1, sizeof(simg_header), fp) == sizeof(simg_header) &&
+	    sunxi_efex_simg_check(simg_header, sizeof(simg_header))) {
+		ret = sunxi_efex_simg_open(&simg, simg_header, sizeof(simg_header));
+		if (ret != EFEX_ERR_SUCCESS) {
+			fprintf(stderr, "ERROR: %s: %s\r\n", sunxi_efex_strerror(ret), full_firmware_path);
+			goto cleanup;
+		}
+		file_size = sunxi_efex_simg_size(&simg);
 	}
-
-	// Initialize buffer with zeros
-	memset(buffer, 0, file_size);
-
-	// If file exists, read its content (will overwrite part of the zero-filled buffer)
 	if (fp) {
-		const size_t bytes_read = fread(buffer, 1, file_size, fp);
-		if (bytes_read != (size_t) file_size) {
-			fprintf(stderr, "WARNING: Read %zu bytes, expected %lx bytes from %s\n",
-			        bytes_read, file_size, full_firmware_path);
-			// Continue with whatever was read, buffer is already zero-filled
-		}
+		fseek(fp, 0, SEEK_SET);
 	}
 
 	// If erase_flag is set, first download all 0xFF data
 	if (erase_flag) {
-		char *ff_buffer = malloc(file_size);
+		// One chunk of 0xFF is sent repeatedly rather than a buffer the size of the partition
+		const uint64_t ff_chunk = ERASE_CHUNK_SIZE < file_size ? ERASE_CHUNK_SIZE : file_size;
+		char *ff_buffer = malloc(ff_chunk);
 		if (!ff_buffer) {
 			fprintf(stderr, "ERROR: Failed to allocate buffer for erase operation\r\n");
 			goto cleanup;
 		}
 
 		// Fill buffer with 0xFF (all F's)
-		memset(ff_buffer, 0xFF, file_size);
+		memset(ff_buffer, 0xFF, ff_chunk);
 
 		printf("Erasing area with 0xFF data...\n");
-		ret = sunxi_efex_fes_down(ctx, ff_buffer, (ssize_t) file_size, (uint32_t) address, 0);
+		for (uint64_t off = 0; off < file_size && ret == EFEX_ERR_SUCCESS; off += ff_chunk) {
+			const uint64_t n = file_size - off < ff_chunk ? file_size - off : ff_chunk;
+			// Flash addresses count 512-byte sectors
+			ret = sunxi_efex_fes_down(ctx, ff_buffer, (ssize_t) n, (uint32_t) (address + off / 512), 0);
+		}
 		free(ff_buffer); // Free the erase buffer
 
 		if (ret != EFEX_ERR_SUCCESS) {
@@ -572,19 +503,46 @@ int download_firmware(const struct sunxi_efex_ctx_t *ctx, const char *firmware_f
 	// Download actual firmware data
 	printf("Downloading %lx bytes firmware %s to address 0x%016llx...\n",
 	       file_size, full_firmware_path, (unsigned long long) address);
-	ret = sunxi_efex_fes_down(ctx, buffer, (ssize_t) file_size, (uint32_t) address, 0);
+	uint32_t crc = 0;
+	int crc_valid = 1;
+	if (fp && (simg.blk_sz || erase_flag)) {
+		// Once erased the flash reads 0xFF, runs of it in the image need not be sent again
+		const enum sunxi_efex_sparse_fill_t blank = erase_flag ? SUNXI_EFEX_SPARSE_ERASED : SUNXI_EFEX_SPARSE_DATA;
+		struct sunxi_efex_image_t img;
+		uint64_t skipped = 0;
+		ret = sunxi_efex_image_open(&img, full_firmware_path);
+		if (ret == EFEX_ERR_SUCCESS) {
+			if (simg.blk_sz) {
+				ret = sunxi_efex_fes_down_simg(ctx, img.data, img.size, (uint32_t) address, 0, blank, &crc, &skipped);
+			} else {
+				ret = sunxi_efex_fes_down_sparse(ctx, img.data, img.size, (uint32_t) address, 0, blank, &crc, &skipped);
+			}
+			sunxi_efex_image_close(&img);
+		}
+		if (ret == EFEX_ERR_SUCCESS && skipped) {
+			printf("Skipped %llu bytes the flash already holds\n", (unsigned long long) skipped);
+		}
+		// DONT_CARE blocks keep whatever was on flash unless it was erased
+		crc_valid = erase_flag || !skipped;
+	} else {
+		// The image is read as it goes out, only a few chunks of it are in memory at a time
+		ret = sunxi_efex_fes_down_stream(ctx, fes_flash_read, fp, file_size, (uint32_t) address, 0, &crc);
+	}
 	if (ret != EFEX_ERR_SUCCESS) {
 		fprintf(stderr, "ERROR: %s\r\n", sunxi_efex_strerror(ret));
 		goto cleanup;
 	}
 
-	// Verify download status
+	// Verify download status against the CRC kept while downloading
 	const struct sunxi_fes_verify_resp_t verify_resp = {0};
 	ret = sunxi_efex_fes_verify_value(ctx, (uint32_t) address, (ssize_t) file_size, &verify_resp);
 	if (ret != EFEX_ERR_SUCCESS) {
 		printf("Firmware verification failed: %s\n", sunxi_efex_strerror(ret));
+	} else if (verify_resp.flag == EFEX_CRC32_VALID_FLAG && crc_valid && (uint32_t) verify_resp.media_crc != crc) {
+		printf("Firmware CRC mismatch: device 0x%08x, host 0x%08x\n", (uint32_t) verify_resp.media_crc, crc);
+		ret = EFEX_ERR_CRC_MISMATCH;
 	} else if (verify_resp.flag == EFEX_CRC32_VALID_FLAG) {
-		printf("Firmware download successful\n");
+		printf("Firmware download successful, CRC32 0x%08x\n", crc);
 	} else {
 		printf("Firmware verification status: 0x%02x\n", verify_resp.flag);
 	}
@@ -594,9 +552,6 @@ cleanup:
 	if (fp) {
 		fclose(fp);
 	}
-	if (buffer) {
-		free(buffer);
-	}
 	if (full_firmware_path) {
 		free(full_firmware_path);
 	}
@@ -607,7 +562,6 @@ int download_raw_image(const struct sunxi_efex_ctx_t *ctx, const char *firmware_
 	int ret = 0;
 	char *full_firmware_path = NULL;
 	FILE *fp = NULL;
-	char *buffer = NULL;
 	long file_size = 0;
 	
 	// Ensure firmware file has .fex extension
@@ -656,70 +610,54 @@ int download_raw_image(const struct sunxi_efex_ctx_t *ctx, const char *firmware_
 		return EFEX_ERR_FILE_SIZE;
 	}
 
-	// Allocate buffer for file content
-	buffer = (char *) malloc(file_size);
-	if (!buffer) {
-		fprintf(stderr, "ERROR: %s\r\n", sunxi_efex_strerror(EFEX_ERR_MEMORY));
-		fclose(fp);
-		free(full_firmware_path);
-		return EFEX_ERR_MEMORY;
-	}
-
-	// Read file content
-	const size_t bytes_read = fread(buffer, 1, file_size, fp);
-	fclose(fp);
-
-	if (bytes_read != (size_t) file_size) {
-		fprintf(stderr, "ERROR: %s\r\n", sunxi_efex_strerror(EFEX_ERR_FILE_READ));
-		free(buffer);
-		free(full_firmware_path);
-		return EFEX_ERR_FILE_READ;
-	}
-
 	// Send full image size first
 	printf("Sending full image size: %ld bytes\n", file_size);
 	ret = sunxi_efex_fes_down(ctx, (const char *) &file_size, sizeof(file_size), 0, SUNXI_EFEX_FULLIMG_SIZE_TAG);
 	if (ret != EFEX_ERR_SUCCESS) {
 		fprintf(stderr, "ERROR: Failed to send full image size: %s\r\n", sunxi_efex_strerror(ret));
-		free(buffer);
+		fclose(fp);
 		free(full_firmware_path);
 		return ret;
 	}
 
 	// Download raw image data
 	printf("Downloading %ld bytes raw image data to device...\n", file_size);
-	ret = sunxi_efex_fes_down(ctx, buffer, (ssize_t) file_size, 0, 0);
+	uint32_t crc = 0;
+	ret = sunxi_efex_fes_down_stream(ctx, fes_flash_read, fp, (uint64_t) file_size, 0, 0, &crc);
+	fclose(fp);
 	if (ret != EFEX_ERR_SUCCESS) {
 		fprintf(stderr, "ERROR: Failed to download raw image: %s\r\n", sunxi_efex_strerror(ret));
-		free(buffer);
 		free(full_firmware_path);
 		return ret;
 	}
 
-	// Verify download status
+	// Verify download status against the CRC kept while downloading
 	const struct sunxi_fes_verify_resp_t verify_resp = {0};
 	ret = sunxi_efex_fes_verify_value(ctx, 0, file_size, &verify_resp);
 	if (ret != EFEX_ERR_SUCCESS) {
 		printf("Raw image verification failed: %s\n", sunxi_efex_strerror(ret));
+	} else if (verify_resp.flag == EFEX_CRC32_VALID_FLAG && (uint32_t) verify_resp.media_crc != crc) {
+		printf("Raw image CRC mismatch: device 0x%08x, host 0x%08x\n", (uint32_t) verify_resp.media_crc, crc);
+		ret = EFEX_ERR_CRC_MISMATCH;
 	} else if (verify_resp.flag == EFEX_CRC32_VALID_FLAG) {
-		printf("Raw image download successful\n");
+		printf("Raw image download successful, CRC32 0x%08x\n", crc);
 	} else {
 		printf("Raw image verification status: 0x%02x\n", verify_resp.flag);
 	}
 
 	// Free allocated resources
-	free(buffer);
 	free(full_firmware_path);
 	
 	return ret;
 }
 
-int main(const int argc, char *argv[]) {
+static int flash_device(struct sunxi_efex_recorder_t *rec) {
 	struct sunxi_efex_ctx_t ctx = {0};
 	int ret = 0;
 	const int erase_all = 1;
 	const int full_image = 1;
 
+	sunxi_efex_record_attach(&ctx, rec);
 	ret = sunxi_scan_usb_device(&ctx);
 	if (ret != EFEX_ERR_SUCCESS) {
 		fprintf(stderr, "ERROR: %s\r\n", sunxi_efex_strerror(ret));
@@ -841,3 +779,33 @@ int main(const int argc, char *argv[]) {
 
 	return 0;
 }
+
+// fes_flash [-R recording | -P recording]: record the session, or replay one without the board
+int main(const int argc, char *argv[]) {
+	struct sunxi_efex_recorder_t *rec = NULL;
+	int ret;
+
+	if (argc > 2 && strcmp(argv[1], "-R") == 0) {
+		ret = sunxi_efex_record_open(argv[2], 0, &rec);
+		if (ret != EFEX_ERR_SUCCESS) {
+			fprintf(stderr, "ERROR: %s: %s\r\n", sunxi_efex_strerror(ret), argv[2]);
+			return ret;
+		}
+	} else if (argc > 2 && strcmp(argv[1], "-P") == 0) {
+		ret = sunxi_usb_replay_configure(argv[2], SUNXI_EFEX_REPLAY_FAST);
+		if (ret == EFEX_ERR_SUCCESS)
+			ret = sunxi_efex_set_usb_backend(USB_BACKEND_REPLAY);
+		if (ret != EFEX_ERR_SUCCESS) {
+			fprintf(stderr, "ERROR: %s: %s\r\n", sunxi_efex_strerror(ret), argv[2]);
+			return ret;
+		}
+	}
+
+	ret = flash_device(rec);
+	if (rec) {
+		const int close_ret = sunxi_efex_record_close(rec);
+		if (close_ret != EFEX_ERR_SUCCESS)
+			fprintf(stderr, "ERROR: Recording incomplete: %s\r\n", sunxi_efex_strerror(close_ret));
+	}
+	return ret;
+}
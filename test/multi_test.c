@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "efex-common.h"
+#include "efex-thread.h"
+#include "libefex.h"
+
+#define MULTI_TEST_ROUNDS 256
+
+struct multi_test_board {
+	struct sunxi_scanned_device_t dev;
+	sunxi_efex_thread_t thread;
+	int ret;
+};
+
+// One context per thread: every board is opened, checked and closed by its own thread only
+static void *multi_test_worker(void *arg) {
+	struct multi_test_board *board = arg;
+	struct sunxi_efex_ctx_t ctx = {0};
+
+	board->ret = sunxi_scan_usb_device_at(&ctx, board->dev.bus, board->dev.port);
+	if (board->ret != EFEX_ERR_SUCCESS)
+		return NULL;
+	board->ret = sunxi_usb_init(&ctx);
+	if (board->ret == EFEX_ERR_SUCCESS)
+		board->ret = sunxi_efex_init(&ctx);
+	if (board->ret != EFEX_ERR_SUCCESS || ctx.resp.mode != DEVICE_MODE_FEL) {
+		sunxi_usb_exit(&ctx);
+		return NULL;
+	}
+
+	// A pattern unique to the board, so crossed transfers between contexts show up as mismatches
+	for (uint32_t i = 0; i < MULTI_TEST_ROUNDS && board->ret == EFEX_ERR_SUCCESS; i++) {
+		const uint32_t write_val = ((uint32_t) board->dev.bus << 24) | ((uint32_t) board->dev.port << 16) | i;
+		uint32_t read_val = 0;
+
+		board->ret = sunxi_efex_fel_write(&ctx, ctx.resp.data_start_address, (const char *) &write_val,
+		                                  sizeof(write_val));
+		if (board->ret == EFEX_ERR_SUCCESS)
+			board->ret = sunxi_efex_fel_read(&ctx, ctx.resp.data_start_address, (char *) &read_val,
+			                                 sizeof(read_val));
+		if (board->ret == EFEX_ERR_SUCCESS && read_val != write_val) {
+			fprintf(stderr, "%u:%u: round %u wrote 0x%08x, read 0x%08x\n", board->dev.bus, board->dev.port, i,
+			        write_val, read_val);
+			board->ret = EFEX_ERR_INVALID_RESPONSE;
+		}
+	}
+
+	sunxi_usb_exit(&ctx);
+	return NULL;
+}
+
+int main() {
+	struct sunxi_scanned_device_t *devices = NULL;
+	size_t count = 0;
+
+	int ret = sunxi_scan_usb_devices(&devices, &count);
+	if (ret != EFEX_ERR_SUCCESS) {
+		fprintf(stderr, "ERROR: %s\r\n", sunxi_efex_strerror(ret));
+		return ret;
+	}
+
+	struct multi_test_board *boards = calloc(count, sizeof(*boards));
+	if (!boards) {
+		free(devices);
+		return EFEX_ERR_MEMORY;
+	}
+
+	printf("Testing %zu device(s) in parallel\n", count);
+	for (size_t i = 0; i < count; i++) {
+		boards[i].dev = devices[i];
+		if (sunxi_efex_thread_create(&boards[i].thread, multi_test_worker, &boards[i]) != 0) {
+			fprintf(stderr, "ERROR: Failed to start thread for %u:%u\r\n", devices[i].bus, devices[i].port);
+			count = i;
+			break;
+		}
+	}
+
+	ret = EFEX_ERR_SUCCESS;
+	for (size_t i = 0; i < count; i++) {
+		sunxi_efex_thread_join(boards[i].thread);
+		printf("%u:%u: %s\n", boards[i].dev.bus, boards[i].dev.port, sunxi_efex_strerror(boards[i].ret));
+		if (boards[i].ret != EFEX_ERR_SUCCESS)
+			ret = boards[i].ret;
+	}
+
+	free(boards);
+	free(devices);
+	sunxi_usb_shared_exit();
+	return ret;
+}
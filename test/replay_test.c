@@ -0,0 +1,112 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "efex-common.h"
+#include "libefex.h"
+
+#define REPLAY_TEST_SIZE (8 * 1024 * 1024)
+#define REPLAY_TEST_FILE "replay_test.efxr"
+
+static void replay_test_fill(char *buf, const size_t len, uint32_t seed) {
+	for (size_t i = 0; i < len; i++) {
+		seed = seed * 1103515245 + 12345;
+		buf[i] = (char) (seed >> 16);
+	}
+}
+
+// One FEL session: write the pattern, read it back, leaving the result in in
+static int replay_test_session(struct sunxi_efex_ctx_t *ctx, const char *out, char *in, uint64_t *usec) {
+	int ret = sunxi_scan_usb_device(ctx);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_usb_init(ctx);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_init(ctx);
+
+	const uint64_t start = sunxi_efex_time_us();
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_fel_write(ctx, ctx->resp.data_start_address, out, REPLAY_TEST_SIZE);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_fel_read(ctx, ctx->resp.data_start_address, in, REPLAY_TEST_SIZE);
+	*usec = sunxi_efex_time_us() - start;
+
+	sunxi_usb_exit(ctx);
+	return ret;
+}
+
+int main(const int argc, char *argv[]) {
+	const char *path = argc > 1 ? argv[1] : REPLAY_TEST_FILE;
+	struct sunxi_efex_sim_config_t config;
+	struct sunxi_efex_recorder_t *rec = NULL;
+	uint64_t usec = 0;
+
+	char *out = malloc(REPLAY_TEST_SIZE);
+	char *in = malloc(REPLAY_TEST_SIZE);
+	if (!out || !in) {
+		free(out);
+		free(in);
+		return EFEX_ERR_MEMORY;
+	}
+	replay_test_fill(out, REPLAY_TEST_SIZE, 1);
+
+	// Record a session against a simulated device with a slow link
+	sunxi_efex_sim_config_init(&config);
+	config.latency_us = 100;
+	config.bandwidth = 40 * 1024 * 1024;
+	struct sunxi_efex_ctx_t ctx = {0};
+	int ret = sunxi_usb_sim_configure(&config, 1);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_usb_set_backend(&ctx, USB_BACKEND_SIM);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_record_open(path, 0, &rec);
+	if (ret == EFEX_ERR_SUCCESS) {
+		sunxi_efex_record_attach(&ctx, rec);
+		ret = replay_test_session(&ctx, out, in, &usec);
+		sunxi_efex_record_attach(&ctx, NULL);
+		const int close_ret = sunxi_efex_record_close(rec);
+		if (ret == EFEX_ERR_SUCCESS)
+			ret = close_ret;
+	}
+	if (ret != EFEX_ERR_SUCCESS) {
+		fprintf(stderr, "ERROR: Recording failed: %s\r\n", sunxi_efex_strerror(ret));
+		goto out;
+	}
+	printf("Recorded:          %8.3f ms\n", (double) usec / 1000.0);
+
+	// The same session replayed at both speeds must see the same data
+	static const enum sunxi_efex_replay_speed_t speeds[] = {SUNXI_EFEX_REPLAY_FAST, SUNXI_EFEX_REPLAY_RECORDED};
+	for (size_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]) && ret == EFEX_ERR_SUCCESS; i++) {
+		struct sunxi_efex_ctx_t replay_ctx = {0};
+		memset(in, 0, REPLAY_TEST_SIZE);
+		ret = sunxi_usb_replay_configure(path, speeds[i]);
+		if (ret == EFEX_ERR_SUCCESS)
+			ret = sunxi_usb_set_backend(&replay_ctx, USB_BACKEND_REPLAY);
+		if (ret == EFEX_ERR_SUCCESS)
+			ret = replay_test_session(&replay_ctx, out, in, &usec);
+		if (ret == EFEX_ERR_SUCCESS && memcmp(out, in, REPLAY_TEST_SIZE) != 0)
+			ret = EFEX_ERR_INVALID_RESPONSE;
+		printf("Replayed (%s): %8.3f ms, %s\n", speeds[i] == SUNXI_EFEX_REPLAY_FAST ? "fast" : "real",
+		       (double) usec / 1000.0, sunxi_efex_strerror(ret));
+	}
+
+	// A session that sends something else must be caught
+	if (ret == EFEX_ERR_SUCCESS) {
+		struct sunxi_efex_ctx_t replay_ctx = {0};
+		out[REPLAY_TEST_SIZE / 2] ^= 1;
+		ret = sunxi_usb_replay_configure(path, SUNXI_EFEX_REPLAY_FAST);
+		if (ret == EFEX_ERR_SUCCESS)
+			ret = sunxi_usb_set_backend(&replay_ctx, USB_BACKEND_REPLAY);
+		if (ret == EFEX_ERR_SUCCESS) {
+			ret = replay_test_session(&replay_ctx, out, in, &usec) == EFEX_ERR_SUCCESS ? EFEX_ERR_VERIFICATION
+			                                                                           : EFEX_ERR_SUCCESS;
+		}
+		printf("Divergence check:  %s\n", sunxi_efex_strerror(ret));
+	}
+
+out:
+	sunxi_usb_replay_configure(NULL, SUNXI_EFEX_REPLAY_FAST);
+	free(out);
+	free(in);
+	return ret;
+}
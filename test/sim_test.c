@@ -0,0 +1,1093 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "efex-common.h"
+#include "ending.h"
+#include "libefex.h"
+
+#define SIM_TEST_FEL_SIZE (4 * 1024 * 1024)
+#define SIM_TEST_FES_SIZE (32 * 1024 * 1024)
+#define SIM_TEST_FES_SECTOR 2048
+#define SIM_TEST_BATCH 64
+#define SIM_TEST_FILL_ADDR 0x40000000
+#define SIM_TEST_FILL_SIZE (64 * 1024 * 1024)
+#define SIM_TEST_IMAGE "sim_test.img"
+
+static uint32_t sim_test_crc32(const uint8_t *p, size_t len) {
+	uint32_t crc = 0xffffffff;
+	while (len--) {
+		crc ^= *p++;
+		for (int i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+	}
+	return ~crc;
+}
+
+static void sim_test_fill(char *buf, const size_t len, uint32_t seed) {
+	for (size_t i = 0; i < len; i++) {
+		seed = seed * 1103515245 + 12345;
+		buf[i] = (char) (seed >> 16);
+	}
+}
+
+static void sim_test_rate(const char *what, const size_t len, const uint64_t usec) {
+	printf("%-10s %8zu KiB in %8.3f ms, %8.2f MiB/s\n", what, len / 1024, (double) usec / 1000.0,
+	       usec ? (double) len / (1024.0 * 1024.0) / ((double) usec / 1e6) : 0.0);
+}
+
+// Stands in for the FES payload once armed: running it brings the device up in FES mode
+// What the exec hook knows of the device under test
+struct sim_test_device {
+	int fes_armed;    // the next exec starts the pretend FES firmware
+	uint32_t corrupt; // CRC32 runs still to find a flipped byte, as if the write had gone wrong
+};
+
+enum sim_test_payload_t {
+	SIM_TEST_READL,
+	SIM_TEST_WRITEL,
+	SIM_TEST_READL_BATCH,
+	SIM_TEST_WRITEL_BATCH,
+	SIM_TEST_SEQ,
+	SIM_TEST_FILL,
+	SIM_TEST_COPY,
+	SIM_TEST_CRC32,
+};
+
+// The ARMv7 payloads, told apart by the four words after their common cache maintenance prologue
+static const struct {
+	uint32_t sig[4];
+	uint32_t words; // code length, the parameters follow it
+	enum sim_test_payload_t type;
+} sim_test_payloads_arm[] = {
+		{{0xe59f000c, 0xe28f100c, 0xe5902000, 0xe5812000}, 12, SIM_TEST_READL},
+		{{0xe59f0008, 0xe59f1008, 0xe5801000, 0xe12fff1e}, 11, SIM_TEST_WRITEL},
+		{{0xe28f001c, 0xe4901004, 0xe0802101, 0xe2511001}, 16, SIM_TEST_READL_BATCH},
+		{{0xe28f0018, 0xe4901004, 0xe2511001, 0x412fff1e}, 15, SIM_TEST_WRITEL_BATCH},
+		{{0xe92d41f0, 0xe28f008c, 0xe4901004, 0xe0802001}, 45, SIM_TEST_SEQ},
+		{{0xe92d41f0, 0xe28f3068, 0xe8930007, 0xe3520000}, 36, SIM_TEST_FILL},
+		{{0xe92d41f0, 0xe28f3068, 0xe8930007, 0xe0203001}, 36, SIM_TEST_COPY},
+		{{0xe92d4010, 0xe28f3f4d, 0xe8930007, 0xe28fc0ec}, 87, SIM_TEST_CRC32},
+};
+
+static uint32_t sim_test_rd32(const struct sunxi_efex_sim_t *sim, const uint32_t addr) {
+	uint32_t v;
+	sunxi_efex_sim_mem_read(sim, addr, &v, sizeof(v));
+	return le32_to_cpu(v);
+}
+
+static int sim_test_wr32(struct sunxi_efex_sim_t *sim, const uint32_t addr, const uint32_t value) {
+	const uint32_t v = cpu_to_le32(value);
+	return sunxi_efex_sim_mem_write(sim, addr, &v, sizeof(v));
+}
+
+// Runs a register sequence: size word, five-word operations up to END, then the completed count and the reads
+static int sim_test_seq(struct sunxi_efex_sim_t *sim, const uint32_t p, const uint32_t size) {
+	const uint32_t done_at = p + 4 + size;
+	uint32_t read_at = done_at + 4;
+	uint32_t done = 0;
+	int ret = 0;
+	for (uint32_t op = p + 4; op + 20 <= done_at && ret == 0; op += 20, done++) {
+		const uint32_t code = sim_test_rd32(sim, op), reg = sim_test_rd32(sim, op + 4);
+		const uint32_t a0 = sim_test_rd32(sim, op + 8), a1 = sim_test_rd32(sim, op + 12);
+		if (code == SUNXI_EFEX_SEQ_WRITE) {
+			ret = sim_test_wr32(sim, reg, a0);
+		} else if (code == SUNXI_EFEX_SEQ_READ) {
+			ret = sim_test_wr32(sim, read_at, sim_test_rd32(sim, reg));
+			read_at += 4;
+		} else if (code == SUNXI_EFEX_SEQ_MODIFY) {
+			ret = sim_test_wr32(sim, reg, (sim_test_rd32(sim, reg) & ~a0) | a1);
+		} else if (code == SUNXI_EFEX_SEQ_POLL) {
+			// Nothing else changes memory here, so a poll either matches at once or runs out of tries
+			if ((sim_test_rd32(sim, reg) & a0) != a1)
+				break;
+		} else if (code != SUNXI_EFEX_SEQ_DELAY) {
+			break;
+		}
+	}
+	return ret ? ret : sim_test_wr32(sim, done_at, done);
+}
+
+// Fills or copies device memory a page at a time; the callers never pass overlapping ranges
+static int sim_test_mem(struct sunxi_efex_sim_t *sim, const enum sim_test_payload_t type, const uint32_t dst,
+                        const uint32_t arg, const uint32_t len) {
+	static uint8_t page[64 * 1024];
+	int ret = 0;
+	if (type == SIM_TEST_FILL)
+		memset(page, arg & 0xff, sizeof(page));
+	for (uint32_t done = 0; done < len && ret == 0;) {
+		const uint32_t n = len - done < sizeof(page) ? len - done : (uint32_t) sizeof(page);
+		if (type == SIM_TEST_COPY)
+			sunxi_efex_sim_mem_read(sim, arg + done, page, n);
+		ret = sunxi_efex_sim_mem_write(sim, dst + done, page, n);
+		done += n;
+	}
+	return ret;
+}
+
+// Continues a CRC32 over device memory, parameters address, length and CRC so far, then the result
+static int sim_test_crc(struct sunxi_efex_sim_t *sim, struct sim_test_device *dev, const uint32_t p) {
+	static uint8_t page[64 * 1024];
+	const uint32_t addr = sim_test_rd32(sim, p), len = sim_test_rd32(sim, p + 4);
+	uint32_t crc = sim_test_rd32(sim, p + 8);
+	if (dev->corrupt && len) {
+		dev->corrupt--;
+		sunxi_efex_sim_mem_read(sim, addr, page, 1);
+		page[0] ^= 0x10;
+		sunxi_efex_sim_mem_write(sim, addr, page, 1);
+	}
+	for (uint32_t done = 0; done < len;) {
+		const uint32_t n = len - done < sizeof(page) ? len - done : (uint32_t) sizeof(page);
+		sunxi_efex_sim_mem_read(sim, addr + done, page, n);
+		crc = sunxi_efex_crc32(crc, page, n);
+		done += n;
+	}
+	return sim_test_wr32(sim, p + 12, crc);
+}
+
+// Does what the payload at addr would do on the device, unknown code does nothing
+static int sim_test_emulate(struct sunxi_efex_sim_t *sim, struct sim_test_device *dev, const uint32_t addr) {
+	uint32_t sig[4];
+	for (uint32_t i = 0; i < 4; i++)
+		sig[i] = sim_test_rd32(sim, addr + (7 + i) * 4);
+
+	for (size_t k = 0; k < sizeof(sim_test_payloads_arm) / sizeof(sim_test_payloads_arm[0]); k++) {
+		if (memcmp(sig, sim_test_payloads_arm[k].sig, sizeof(sig)) != 0)
+			continue;
+		const uint32_t p = addr + sim_test_payloads_arm[k].words * 4;
+		const uint32_t n = sim_test_rd32(sim, p);
+		int ret = 0;
+		switch (sim_test_payloads_arm[k].type) {
+			case SIM_TEST_READL:
+				return sim_test_wr32(sim, p + 4, sim_test_rd32(sim, n));
+			case SIM_TEST_WRITEL:
+				return sim_test_wr32(sim, n, sim_test_rd32(sim, p + 4));
+			case SIM_TEST_READL_BATCH:
+				for (uint32_t i = 0; i < n && ret == 0; i++) {
+					const uint32_t reg = sim_test_rd32(sim, p + 4 + i * 4);
+					ret = sim_test_wr32(sim, p + 4 + (n + i) * 4, sim_test_rd32(sim, reg));
+				}
+				return ret;
+			case SIM_TEST_WRITEL_BATCH:
+				for (uint32_t i = 0; i < n && ret == 0; i++)
+					ret = sim_test_wr32(sim, sim_test_rd32(sim, p + 4 + i * 8), sim_test_rd32(sim, p + 8 + i * 8));
+				return ret;
+			case SIM_TEST_SEQ:
+				return sim_test_seq(sim, p, n);
+			case SIM_TEST_FILL:
+			case SIM_TEST_COPY:
+				return sim_test_mem(sim, sim_test_payloads_arm[k].type, n, sim_test_rd32(sim, p + 4),
+				                    sim_test_rd32(sim, p + 8));
+			case SIM_TEST_CRC32:
+				return sim_test_crc(sim, dev, p);
+		}
+	}
+	return 0;
+}
+
+static int sim_test_exec(struct sunxi_efex_sim_t *sim, const uint32_t addr, void *arg) {
+	struct sim_test_device *dev = arg;
+	if (dev->fes_armed) {
+		sunxi_efex_sim_set_mode(sim, DEVICE_MODE_SRV);
+		return 0;
+	}
+	return sim_test_emulate(sim, dev, addr);
+}
+
+static int sim_test_fel(const struct sunxi_efex_ctx_t *ctx, char *out, char *in) {
+	sim_test_fill(out, SIM_TEST_FEL_SIZE, 1);
+	memset(in, 0, SIM_TEST_FEL_SIZE);
+
+	uint64_t start = sunxi_efex_time_us();
+	int ret = sunxi_efex_fel_write(ctx, ctx->resp.data_start_address, out, SIM_TEST_FEL_SIZE);
+	if (ret != EFEX_ERR_SUCCESS)
+		return ret;
+	sim_test_rate("FEL write", SIM_TEST_FEL_SIZE, sunxi_efex_time_us() - start);
+
+	start = sunxi_efex_time_us();
+	ret = sunxi_efex_fel_read(ctx, ctx->resp.data_start_address, in, SIM_TEST_FEL_SIZE);
+	if (ret != EFEX_ERR_SUCCESS)
+		return ret;
+	sim_test_rate("FEL read", SIM_TEST_FEL_SIZE, sunxi_efex_time_us() - start);
+
+	if (memcmp(out, in, SIM_TEST_FEL_SIZE) != 0) {
+		fprintf(stderr, "ERROR: FEL read back differs from what was written\r\n");
+		return EFEX_ERR_INVALID_RESPONSE;
+	}
+
+	// No payloads selected yet, so the verified write reads everything back
+	sunxi_efex_fel_set_verify((struct sunxi_efex_ctx_t *) ctx, 1);
+	start = sunxi_efex_time_us();
+	ret = sunxi_efex_fel_write(ctx, ctx->resp.data_start_address, out, SIM_TEST_FEL_SIZE);
+	sunxi_efex_fel_set_verify((struct sunxi_efex_ctx_t *) ctx, 0);
+	if (ret != EFEX_ERR_SUCCESS)
+		return ret;
+	sim_test_rate("FEL verify", SIM_TEST_FEL_SIZE, sunxi_efex_time_us() - start);
+	return EFEX_ERR_SUCCESS;
+}
+
+static int sim_test_fes(const struct sunxi_efex_ctx_t *ctx, char *out, char *in) {
+	sim_test_fill(out, SIM_TEST_FES_SIZE, 2);
+	memset(in, 0, SIM_TEST_FES_SIZE);
+
+	uint64_t start = sunxi_efex_time_us();
+	uint32_t down_crc = 0;
+	int ret = sunxi_efex_fes_down_crc(ctx, out, SIM_TEST_FES_SIZE, SIM_TEST_FES_SECTOR, SUNXI_EFEX_TAG_NONE, &down_crc);
+	if (ret != EFEX_ERR_SUCCESS)
+		return ret;
+	sim_test_rate("FES down", SIM_TEST_FES_SIZE, sunxi_efex_time_us() - start);
+
+	start = sunxi_efex_time_us();
+	ret = sunxi_efex_fes_up(ctx, in, SIM_TEST_FES_SIZE, SIM_TEST_FES_SECTOR, SUNXI_EFEX_TAG_NONE);
+	if (ret != EFEX_ERR_SUCCESS)
+		return ret;
+	sim_test_rate("FES up", SIM_TEST_FES_SIZE, sunxi_efex_time_us() - start);
+
+	if (memcmp(out, in, SIM_TEST_FES_SIZE) != 0) {
+		fprintf(stderr, "ERROR: FES upload differs from what was downloaded\r\n");
+		return EFEX_ERR_INVALID_RESPONSE;
+	}
+
+	struct sunxi_fes_verify_resp_t verify = {0};
+	ret = sunxi_efex_fes_verify_value(ctx, SIM_TEST_FES_SECTOR, SIM_TEST_FES_SIZE, &verify);
+	if (ret != EFEX_ERR_SUCCESS)
+		return ret;
+	const uint32_t crc = sim_test_crc32((const uint8_t *) out, SIM_TEST_FES_SIZE);
+	if (sunxi_efex_crc32(0, out, SIM_TEST_FES_SIZE) != crc || down_crc != crc) {
+		fprintf(stderr, "ERROR: Host CRC32 differs from the reference\r\n");
+		return EFEX_ERR_CRC_MISMATCH;
+	}
+	if (verify.flag != SUNXI_EFEX_SIM_VERIFY_FLAG || (uint32_t) verify.media_crc != crc) {
+		fprintf(stderr, "ERROR: Verify returned flag 0x%08x crc 0x%08x, expected 0x%08x\r\n", verify.flag,
+		        (uint32_t) verify.media_crc, crc);
+		return EFEX_ERR_INVALID_RESPONSE;
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+struct sim_test_source {
+	char *buf;
+	size_t len;
+	size_t pos;
+};
+
+// Hands out the buffer in odd-sized pieces, the way a pipe or a decompressor would
+static ssize_t sim_test_read(void *user, char *buf, size_t len) {
+	struct sim_test_source *src = user;
+	if (len > 100000)
+		len = 100000;
+	if (len > src->len - src->pos)
+		len = src->len - src->pos;
+	memcpy(buf, src->buf + src->pos, len);
+	src->pos += len;
+	return (ssize_t) len;
+}
+
+static int sim_test_fes_stream(const struct sunxi_efex_ctx_t *ctx, char *out, char *in) {
+	sim_test_fill(out, SIM_TEST_FES_SIZE, 3);
+	memset(in, 0, SIM_TEST_FES_SIZE);
+
+	struct sim_test_source src = {.buf = out, .len = SIM_TEST_FES_SIZE};
+	uint64_t start = sunxi_efex_time_us();
+	uint32_t crc = 0;
+	int ret = sunxi_efex_fes_down_stream(ctx, sim_test_read, &src, SIM_TEST_FES_SIZE, SIM_TEST_FES_SECTOR,
+	                                     SUNXI_EFEX_TAG_NONE, &crc);
+	if (ret != EFEX_ERR_SUCCESS)
+		return ret;
+	sim_test_rate("FES stream", SIM_TEST_FES_SIZE, sunxi_efex_time_us() - start);
+
+	ret = sunxi_efex_fes_up(ctx, in, SIM_TEST_FES_SIZE, SIM_TEST_FES_SECTOR, SUNXI_EFEX_TAG_NONE);
+	if (ret != EFEX_ERR_SUCCESS)
+		return ret;
+	if (memcmp(out, in, SIM_TEST_FES_SIZE) != 0 || crc != sunxi_efex_crc32(0, out, SIM_TEST_FES_SIZE)) {
+		fprintf(stderr, "ERROR: Streamed download differs from its source\r\n");
+		return EFEX_ERR_INVALID_RESPONSE;
+	}
+
+	// Data that ends before the announced length fails the download
+	src.pos = 0;
+	src.len = SIM_TEST_FES_SIZE / 2;
+	ret = sunxi_efex_fes_down_stream(ctx, sim_test_read, &src, SIM_TEST_FES_SIZE, SIM_TEST_FES_SECTOR,
+	                                 SUNXI_EFEX_TAG_NONE, NULL);
+	if (ret != EFEX_ERR_FILE_READ) {
+		fprintf(stderr, "ERROR: Short stream returned %s\r\n", sunxi_efex_strerror(ret));
+		return EFEX_ERR_INVALID_RESPONSE;
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+static int sim_test_write(void *user, const char *buf, size_t len) {
+	struct sim_test_source *dst = user;
+	if (len > dst->len - dst->pos)
+		return EFEX_ERR_FILE_WRITE;
+	memcpy(dst->buf + dst->pos, buf, len);
+	dst->pos += len;
+	return EFEX_ERR_SUCCESS;
+}
+
+// Uploads through the write-behind ring, into memory and into a file bypassing the page cache
+static int sim_test_fes_up_stream(const struct sunxi_efex_ctx_t *ctx, const char *out, char *in) {
+	memset(in, 0, SIM_TEST_FES_SIZE);
+
+	struct sim_test_source dst = {.buf = in, .len = SIM_TEST_FES_SIZE};
+	uint64_t start = sunxi_efex_time_us();
+	uint32_t crc = 0;
+	int ret = sunxi_efex_fes_up_stream(ctx, sim_test_write, &dst, SIM_TEST_FES_SIZE, SIM_TEST_FES_SECTOR,
+	                                   SUNXI_EFEX_TAG_NONE, &crc);
+	if (ret != EFEX_ERR_SUCCESS)
+		return ret;
+	sim_test_rate("Up stream", SIM_TEST_FES_SIZE, sunxi_efex_time_us() - start);
+	if (dst.pos != SIM_TEST_FES_SIZE || memcmp(out, in, SIM_TEST_FES_SIZE) != 0 ||
+	    crc != sunxi_efex_crc32(0, out, SIM_TEST_FES_SIZE)) {
+		fprintf(stderr, "ERROR: Streamed upload differs from what was downloaded\r\n");
+		return EFEX_ERR_INVALID_RESPONSE;
+	}
+
+	// A writer that fails ends the upload with its error
+	dst.pos = 0;
+	dst.len = SIM_TEST_FES_SIZE / 2;
+	ret = sunxi_efex_fes_up_stream(ctx, sim_test_write, &dst, SIM_TEST_FES_SIZE, SIM_TEST_FES_SECTOR,
+	                               SUNXI_EFEX_TAG_NONE, NULL);
+	if (ret != EFEX_ERR_FILE_WRITE) {
+		fprintf(stderr, "ERROR: Failing writer returned %s\r\n", sunxi_efex_strerror(ret));
+		return EFEX_ERR_INVALID_RESPONSE;
+	}
+
+	// An odd length leaves an unaligned tail for the direct file sink
+	const size_t len = SIM_TEST_FES_SIZE - 1000;
+	struct sunxi_efex_file_sink_t sink;
+	ret = sunxi_efex_file_sink_open(&sink, SIM_TEST_IMAGE, 1);
+	if (ret != EFEX_ERR_SUCCESS)
+		return ret;
+	start = sunxi_efex_time_us();
+	ret = sunxi_efex_fes_up_stream(ctx, sunxi_efex_file_sink_write, &sink, len, SIM_TEST_FES_SECTOR,
+	                               SUNXI_EFEX_TAG_NONE, NULL);
+	const int close_ret = sunxi_efex_file_sink_close(&sink);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = close_ret;
+	if (ret == EFEX_ERR_SUCCESS)
+		sim_test_rate("Up file", len, sunxi_efex_time_us() - start);
+
+	struct sunxi_efex_image_t img = {0};
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_image_open(&img, SIM_TEST_IMAGE);
+	if (ret == EFEX_ERR_SUCCESS && (img.size != len || memcmp(img.data, out, len) != 0)) {
+		fprintf(stderr, "ERROR: Upload file differs from what was downloaded\r\n");
+		ret = EFEX_ERR_INVALID_RESPONSE;
+	}
+	sunxi_efex_image_close(&img);
+	remove(SIM_TEST_IMAGE);
+	return ret;
+}
+
+// Writes 0xFF over the test area, as an erase would
+static int sim_test_erase(const struct sunxi_efex_ctx_t *ctx, char *buf) {
+	memset(buf, 0xff, SIM_TEST_FES_SIZE);
+	return sunxi_efex_fes_down(ctx, buf, SIM_TEST_FES_SIZE, SIM_TEST_FES_SECTOR, SUNXI_EFEX_TAG_NONE);
+}
+
+// Checks the test area holds expect, by upload and by the device's CRC
+static int sim_test_check(const struct sunxi_efex_ctx_t *ctx, const char *expect, char *in, const uint32_t crc,
+                          const char *what) {
+	int ret = sunxi_efex_fes_up(ctx, in, SIM_TEST_FES_SIZE, SIM_TEST_FES_SECTOR, SUNXI_EFEX_TAG_NONE);
+	if (ret != EFEX_ERR_SUCCESS)
+		return ret;
+	struct sunxi_fes_verify_resp_t verify = {0};
+	ret = sunxi_efex_fes_verify_value(ctx, SIM_TEST_FES_SECTOR, SIM_TEST_FES_SIZE, &verify);
+	if (ret != EFEX_ERR_SUCCESS)
+		return ret;
+	if (memcmp(expect, in, SIM_TEST_FES_SIZE) != 0 ||
+	    crc != sim_test_crc32((const uint8_t *) expect, SIM_TEST_FES_SIZE) || (uint32_t) verify.media_crc != crc) {
+		fprintf(stderr, "ERROR: %s download differs from its source\r\n", what);
+		return EFEX_ERR_INVALID_RESPONSE;
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+// Data with erased holes, long ones are skipped on an erased target; zeros and short holes still go out
+static int sim_test_fes_sparse(const struct sunxi_efex_ctx_t *ctx, char *out, char *in) {
+	const size_t mib = 1024 * 1024;
+	int ret = sim_test_erase(ctx, out);
+	if (ret != EFEX_ERR_SUCCESS)
+		return ret;
+
+	sim_test_fill(out, SIM_TEST_FES_SIZE, 5);
+	for (size_t off = mib; off < SIM_TEST_FES_SIZE; off += 4 * mib)
+		memset(out + off, 0xff, 2 * mib);
+	memset(out + mib / 2, 0xff, 8192);
+	memset(out + 3 * mib, 0x00, mib);
+	if (sunxi_efex_sparse_classify(out + mib, mib) != SUNXI_EFEX_SPARSE_ERASED ||
+	    sunxi_efex_sparse_classify(out + 3 * mib, mib - 100) != SUNXI_EFEX_SPARSE_ZERO ||
+	    sunxi_efex_sparse_classify(out, 300) != SUNXI_EFEX_SPARSE_DATA) {
+		fprintf(stderr, "ERROR: Blocks classified wrong\r\n");
+		return EFEX_ERR_INVALID_RESPONSE;
+	}
+
+	const uint64_t start = sunxi_efex_time_us();
+	uint32_t crc = 0;
+	uint64_t skipped = 0;
+	ret = sunxi_efex_fes_down_sparse(ctx, out, SIM_TEST_FES_SIZE, SIM_TEST_FES_SECTOR, SUNXI_EFEX_TAG_NONE,
+	                                 SUNXI_EFEX_SPARSE_ERASED, &crc, &skipped);
+	if (ret != EFEX_ERR_SUCCESS)
+		return ret;
+	sim_test_rate("FES sparse", SIM_TEST_FES_SIZE, sunxi_efex_time_us() - start);
+	if (skipped != SIM_TEST_FES_SIZE / 2) {
+		fprintf(stderr, "ERROR: Sparse download skipped %llu bytes\r\n", (unsigned long long) skipped);
+		return EFEX_ERR_INVALID_RESPONSE;
+	}
+	return sim_test_check(ctx, out, in, crc, "Sparse");
+}
+
+static char *sim_test_simg_chunk(char *p, const uint16_t type, const uint32_t blocks, const void *body,
+                                 const uint32_t len) {
+	const uint8_t hdr[12] = {type & 0xff, type >> 8, 0, 0, blocks & 0xff, (blocks >> 8) & 0xff, (blocks >> 16) & 0xff,
+	                         blocks >> 24, (12 + len) & 0xff, ((12 + len) >> 8) & 0xff, ((12 + len) >> 16) & 0xff,
+	                         (12 + len) >> 24};
+	memcpy(p, hdr, sizeof(hdr));
+	if (len)
+		memcpy(p + sizeof(hdr), body, len);
+	return p + sizeof(hdr) + len;
+}
+
+// An Android sparse image of every chunk type, built in memory and expanded into the test area
+static int sim_test_fes_simg(const struct sunxi_efex_ctx_t *ctx, char *out, char *in) {
+	const uint32_t blk = 4096;
+	const uint32_t mib_blks = 1024 * 1024 / blk;
+	char *simg = malloc(SIM_TEST_FES_SIZE);
+	if (!simg)
+		return EFEX_ERR_MEMORY;
+	int ret = sim_test_erase(ctx, out);
+
+	// Expected contents: data, erased, a pattern, DONT_CARE left erased, data up to the end
+	const uint8_t pattern[4] = {0x12, 0x34, 0x56, 0x78};
+	const uint8_t erased[4] = {0xff, 0xff, 0xff, 0xff};
+	sim_test_fill(out, 8 * mib_blks * blk, 6);
+	for (size_t i = 10 * mib_blks * blk; i < 11 * mib_blks * blk; i += 4)
+		memcpy(out + i, pattern, 4);
+	sim_test_fill(out + 24 * mib_blks * blk, 8 * mib_blks * blk, 7);
+	const uint32_t crc_at = sim_test_crc32((const uint8_t *) out, 11 * mib_blks * blk);
+
+	const uint8_t header[28] = {0x3a, 0xff, 0x26, 0xed, 1, 0, 0, 0, 28, 0, 12, 0, 0x00, 0x10, 0, 0,
+	                            0x00, 0x20, 0, 0, 6, 0, 0, 0};
+	char *p = simg;
+	memcpy(p, header, sizeof(header));
+	p += sizeof(header);
+	p = sim_test_simg_chunk(p, SUNXI_EFEX_SIMG_RAW, 8 * mib_blks, out, 8 * mib_blks * blk);
+	p = sim_test_simg_chunk(p, SUNXI_EFEX_SIMG_FILL, 2 * mib_blks, erased, 4);
+	p = sim_test_simg_chunk(p, SUNXI_EFEX_SIMG_FILL, mib_blks, pattern, 4);
+	const uint8_t crc_body[4] = {crc_at & 0xff, (crc_at >> 8) & 0xff, (crc_at >> 16) & 0xff, crc_at >> 24};
+	p = sim_test_simg_chunk(p, SUNXI_EFEX_SIMG_CRC32, 0, crc_body, 4);
+	p = sim_test_simg_chunk(p, SUNXI_EFEX_SIMG_DONT_CARE, 13 * mib_blks, NULL, 0);
+	p = sim_test_simg_chunk(p, SUNXI_EFEX_SIMG_RAW, 8 * mib_blks, out + 24 * mib_blks * blk, 8 * mib_blks * blk);
+	const uint64_t size = (uint64_t) (p - simg);
+
+	uint32_t crc = 0;
+	uint64_t skipped = 0;
+	if (ret == EFEX_ERR_SUCCESS) {
+		const uint64_t start = sunxi_efex_time_us();
+		ret = sunxi_efex_fes_down_simg(ctx, simg, size, SIM_TEST_FES_SECTOR, SUNXI_EFEX_TAG_NONE,
+		                               SUNXI_EFEX_SPARSE_ERASED, &crc, &skipped);
+		if (ret == EFEX_ERR_SUCCESS)
+			sim_test_rate("FES simg", SIM_TEST_FES_SIZE, sunxi_efex_time_us() - start);
+	}
+	if (ret == EFEX_ERR_SUCCESS && skipped != 15 * mib_blks * blk) {
+		fprintf(stderr, "ERROR: Sparse image skipped %llu bytes\r\n", (unsigned long long) skipped);
+		ret = EFEX_ERR_INVALID_RESPONSE;
+	}
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sim_test_check(ctx, out, in, crc, "Sparse image");
+
+	// A wrong CRC32 chunk and a truncated file are both caught
+	if (ret == EFEX_ERR_SUCCESS) {
+		simg[28 + 12 + 8 * mib_blks * blk + 2 * 16 + 12] ^= 1;
+		ret = sunxi_efex_fes_down_simg(ctx, simg, size, SIM_TEST_FES_SECTOR, SUNXI_EFEX_TAG_NONE,
+		                               SUNXI_EFEX_SPARSE_ERASED, &crc, NULL);
+		ret = ret == EFEX_ERR_CRC_MISMATCH ? EFEX_ERR_SUCCESS : EFEX_ERR_INVALID_RESPONSE;
+	}
+	if (ret == EFEX_ERR_SUCCESS) {
+		ret = sunxi_efex_fes_down_simg(ctx, simg, size - 1, SIM_TEST_FES_SECTOR, SUNXI_EFEX_TAG_NONE,
+		                               SUNXI_EFEX_SPARSE_ERASED, NULL, NULL);
+		ret = ret == EFEX_ERR_FILE_FORMAT ? EFEX_ERR_SUCCESS : EFEX_ERR_INVALID_RESPONSE;
+		if (ret != EFEX_ERR_SUCCESS)
+			fprintf(stderr, "ERROR: Corrupt sparse image not detected\r\n");
+	}
+	free(simg);
+	return ret;
+}
+
+// The sparse image sink and reader agree on the header and chunk layout, byte order included
+static int sim_test_simg_roundtrip(char *out) {
+	const uint32_t blk = SUNXI_EFEX_SPARSE_BLOCK;
+	const uint8_t magic[4] = {0x3a, 0xff, 0x26, 0xed};
+	const uint8_t pattern[4] = {0x12, 0x34, 0x56, 0x78};
+	sim_test_fill(out, 2 * blk, 9);
+	memset(out + 2 * blk, 0xff, 3 * blk);
+	for (uint32_t i = 5 * blk; i < 6 * blk; i += 4)
+		memcpy(out + i, pattern, 4);
+	sim_test_fill(out + 6 * blk, 100, 10);
+
+	struct sunxi_efex_sparse_sink_t sink;
+	int ret = sunxi_efex_sparse_sink_open(&sink, SIM_TEST_IMAGE, SUNXI_EFEX_SPARSE_SIMG, NULL);
+	if (ret != EFEX_ERR_SUCCESS)
+		return ret;
+	ret = sunxi_efex_sparse_sink_write(&sink, out, 6 * blk + 100);
+	const int close_ret = sunxi_efex_sparse_sink_close(&sink);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = close_ret;
+
+	// Data, erased, the pattern and the padded partial block
+	static const uint16_t types[] = {SUNXI_EFEX_SIMG_RAW, SUNXI_EFEX_SIMG_FILL, SUNXI_EFEX_SIMG_FILL,
+	                                 SUNXI_EFEX_SIMG_RAW};
+	static const uint32_t starts[] = {0, 2, 5, 6, 7};
+	struct sunxi_efex_image_t img = {0};
+	struct sunxi_efex_simg_t simg;
+	struct sunxi_efex_simg_chunk_t chunk;
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_image_open(&img, SIM_TEST_IMAGE);
+	if (ret == EFEX_ERR_SUCCESS && (img.size < 4 || memcmp(img.data, magic, 4) != 0))
+		ret = EFEX_ERR_FILE_FORMAT;
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_simg_open(&simg, img.data, img.size);
+	if (ret == EFEX_ERR_SUCCESS && (simg.blk_sz != blk || simg.total_blks != 7 || simg.total_chunks != 4))
+		ret = EFEX_ERR_FILE_FORMAT;
+	for (uint32_t i = 0; ret == EFEX_ERR_SUCCESS && i < 4; i++) {
+		const uint64_t off = (uint64_t) starts[i] * blk;
+		if (sunxi_efex_simg_next(&simg, &chunk) != 1 || chunk.type != types[i] || chunk.offset != off ||
+		    chunk.len != (uint64_t) (starts[i + 1] - starts[i]) * blk)
+			ret = EFEX_ERR_FILE_FORMAT;
+		else if (chunk.type == SUNXI_EFEX_SIMG_RAW && memcmp(chunk.data, out + off, i ? 100 : 2 * blk) != 0)
+			ret = EFEX_ERR_FILE_FORMAT;
+		else if (chunk.type == SUNXI_EFEX_SIMG_FILL && memcmp(&chunk.value, out + off, 4) != 0)
+			ret = EFEX_ERR_FILE_FORMAT;
+	}
+	if (ret == EFEX_ERR_SUCCESS && sunxi_efex_simg_next(&simg, &chunk) != 0)
+		ret = EFEX_ERR_FILE_FORMAT;
+	if (ret != EFEX_ERR_SUCCESS)
+		fprintf(stderr, "ERROR: Sparse image does not read back as written: %s\r\n", sunxi_efex_strerror(ret));
+	sunxi_efex_image_close(&img);
+	remove(SIM_TEST_IMAGE);
+	return ret;
+}
+
+// Dumps through both sparse sinks and reads the files back
+static int sim_test_fes_dump(const struct sunxi_efex_ctx_t *ctx, char *out, char *in) {
+	const size_t mib = 1024 * 1024;
+	const size_t len = SIM_TEST_FES_SIZE - 1000;
+	static const char *const map = SIM_TEST_IMAGE ".map";
+
+	// On top of the sparse image test: zeros for holes, and data up to an unaligned end
+	memset(out + 12 * mib, 0, 8 * mib);
+	int ret = sunxi_efex_fes_down(ctx, out, SIM_TEST_FES_SIZE, SIM_TEST_FES_SECTOR, SUNXI_EFEX_TAG_NONE);
+
+	static const enum sunxi_efex_sparse_format_t formats[] = {SUNXI_EFEX_SPARSE_HOLES, SUNXI_EFEX_SPARSE_SIMG};
+	for (size_t f = 0; f < 2 && ret == EFEX_ERR_SUCCESS; f++) {
+		struct sunxi_efex_sparse_sink_t sink;
+		ret = sunxi_efex_sparse_sink_open(&sink, SIM_TEST_IMAGE, formats[f], map);
+		if (ret != EFEX_ERR_SUCCESS)
+			break;
+		const uint64_t start = sunxi_efex_time_us();
+		ret = sunxi_efex_fes_up_stream(ctx, sunxi_efex_sparse_sink_write, &sink, len, SIM_TEST_FES_SECTOR,
+		                               SUNXI_EFEX_TAG_NONE, NULL);
+		const int close_ret = sunxi_efex_sparse_sink_close(&sink);
+		if (ret == EFEX_ERR_SUCCESS)
+			ret = close_ret;
+		if (ret == EFEX_ERR_SUCCESS)
+			sim_test_rate(f ? "Up simg" : "Up holes", len, sunxi_efex_time_us() - start);
+
+		// All but the zeros, or two RAW and five FILL chunks; either way seven runs in the map
+		const uint64_t expect = f ? 28 + 2 * 12 + 16 * mib + 5 * 16 : len - 8 * mib;
+		const uint32_t runs = 7;
+		if (ret == EFEX_ERR_SUCCESS && (sink.written != expect || (f && sink.chunks != runs))) {
+			fprintf(stderr, "ERROR: Sparse dump stored %llu bytes\r\n", (unsigned long long) sink.written);
+			ret = EFEX_ERR_INVALID_RESPONSE;
+		}
+		// The runs follow each other and cover the partial last block too
+		FILE *fp = ret == EFEX_ERR_SUCCESS ? fopen(map, "r") : NULL;
+		if (fp) {
+			char line[64];
+			uint32_t lines = 0, next = 0, first, count;
+			while (fgets(line, sizeof(line), fp) && sscanf(line, "%u %u", &first, &count) == 2 && first == next) {
+				next += count;
+				lines++;
+			}
+			fclose(fp);
+			if (lines != runs || next != (len + SUNXI_EFEX_SPARSE_BLOCK - 1) / SUNXI_EFEX_SPARSE_BLOCK) {
+				fprintf(stderr, "ERROR: Block map has %u runs over %u blocks\r\n", lines, next);
+				ret = EFEX_ERR_INVALID_RESPONSE;
+			}
+		}
+
+		struct sunxi_efex_image_t img = {0};
+		if (ret == EFEX_ERR_SUCCESS)
+			ret = sunxi_efex_image_open(&img, SIM_TEST_IMAGE);
+		if (ret == EFEX_ERR_SUCCESS && !f) {
+			if (img.size != len || memcmp(img.data, out, len) != 0)
+				ret = EFEX_ERR_INVALID_RESPONSE;
+		} else if (ret == EFEX_ERR_SUCCESS) {
+			// Expanded by hand, the partial last block comes back padded with zeros
+			struct sunxi_efex_simg_t simg;
+			struct sunxi_efex_simg_chunk_t chunk;
+			memset(in, 0, SIM_TEST_FES_SIZE);
+			ret = sunxi_efex_simg_open(&simg, img.data, img.size);
+			int more = ret == EFEX_ERR_SUCCESS;
+			while (more == 1 && (more = sunxi_efex_simg_next(&simg, &chunk)) == 1) {
+				if (chunk.type == SUNXI_EFEX_SIMG_RAW)
+					memcpy(in + chunk.offset, chunk.data, chunk.len);
+				for (uint64_t i = 0; chunk.type == SUNXI_EFEX_SIMG_FILL && i < chunk.len; i += 4)
+					memcpy(in + chunk.offset + i, &chunk.value, 4);
+			}
+			if (ret == EFEX_ERR_SUCCESS && (more != 0 || sunxi_efex_simg_size(&simg) != SIM_TEST_FES_SIZE ||
+			                                memcmp(in, out, len) != 0))
+				ret = EFEX_ERR_INVALID_RESPONSE;
+		}
+		if (ret == EFEX_ERR_INVALID_RESPONSE)
+			fprintf(stderr, "ERROR: Sparse dump differs from what was downloaded\r\n");
+		sunxi_efex_image_close(&img);
+		remove(SIM_TEST_IMAGE);
+		remove(map);
+	}
+	return ret;
+}
+
+// Blank images still end the tagged transfer; a blank tail too short to skip goes out with the data
+static int sim_test_fes_blank(const struct sunxi_efex_ctx_t *ctx, char *out, char *in) {
+	const uint32_t len = 1024 * 1024;
+	struct sunxi_fes_verify_resp_t verify = {0};
+	uint64_t skipped = 0;
+
+	// All erased: a single block carries the finish tag
+	memset(out, 0xff, len);
+	int ret = sunxi_efex_fes_down_sparse(ctx, out, len, 0, SUNXI_EFEX_BOOT0_TAG, SUNXI_EFEX_SPARSE_ERASED, NULL,
+	                                     &skipped);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_fes_verify_status(ctx, SUNXI_EFEX_BOOT0_TAG, &verify);
+	if (ret == EFEX_ERR_SUCCESS && (verify.media_crc != 0 || skipped != len - SUNXI_EFEX_SPARSE_BLOCK)) {
+		fprintf(stderr, "ERROR: Blank sparse download not finished, %llu bytes skipped\r\n",
+		        (unsigned long long) skipped);
+		ret = EFEX_ERR_INVALID_RESPONSE;
+	}
+
+	// A sparse image of a single DONT_CARE chunk, likewise
+	const uint32_t blocks = len / SUNXI_EFEX_SPARSE_BLOCK;
+	const uint8_t header[28] = {0x3a, 0xff, 0x26, 0xed, 1, 0, 0, 0, 28, 0, 12, 0, 0x00, 0x10, 0, 0,
+	                            blocks & 0xff, blocks >> 8, 0, 0, 1, 0, 0, 0};
+	memcpy(in, header, sizeof(header));
+	const uint64_t size = (uint64_t) (sim_test_simg_chunk(in + sizeof(header), SUNXI_EFEX_SIMG_DONT_CARE, blocks,
+	                                                      NULL, 0) - in);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_fes_down_simg(ctx, in, size, 0, SUNXI_EFEX_BOOT1_TAG, SUNXI_EFEX_SPARSE_ERASED, NULL, NULL);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_fes_verify_status(ctx, SUNXI_EFEX_BOOT1_TAG, &verify);
+	if (ret == EFEX_ERR_SUCCESS && verify.media_crc != 0) {
+		fprintf(stderr, "ERROR: Blank sparse image not finished\r\n");
+		ret = EFEX_ERR_INVALID_RESPONSE;
+	}
+
+	// An erased tail below SUNXI_EFEX_SPARSE_MIN_SKIP is not skipped
+	sim_test_fill(out, len, 8);
+	memset(out + len - 8192, 0xff, 8192);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_fes_down_sparse(ctx, out, len, SIM_TEST_FES_SECTOR, SUNXI_EFEX_TAG_NONE,
+		                                 SUNXI_EFEX_SPARSE_ERASED, NULL, &skipped);
+	if (ret == EFEX_ERR_SUCCESS && skipped != 0) {
+		fprintf(stderr, "ERROR: Short blank tail skipped\r\n");
+		ret = EFEX_ERR_INVALID_RESPONSE;
+	}
+	return ret;
+}
+
+// Downloads straight from a mapped file; patching the mapping must leave the file alone
+static int sim_test_image(const struct sunxi_efex_ctx_t *ctx, char *out, char *in) {
+	sim_test_fill(out, SIM_TEST_FES_SIZE, 4);
+	memset(in, 0, SIM_TEST_FES_SIZE);
+
+	FILE *fp = fopen(SIM_TEST_IMAGE, "wb");
+	if (!fp)
+		return EFEX_ERR_FILE_OPEN;
+	const size_t written = fwrite(out, 1, SIM_TEST_FES_SIZE, fp);
+	fclose(fp);
+	if (written != SIM_TEST_FES_SIZE) {
+		remove(SIM_TEST_IMAGE);
+		return EFEX_ERR_FILE_WRITE;
+	}
+
+	struct sunxi_efex_image_t img;
+	int ret = sunxi_efex_image_open(&img, SIM_TEST_IMAGE);
+	if (ret == EFEX_ERR_SUCCESS && img.size != SIM_TEST_FES_SIZE)
+		ret = EFEX_ERR_FILE_SIZE;
+	if (ret == EFEX_ERR_SUCCESS) {
+		const uint64_t start = sunxi_efex_time_us();
+		ret = sunxi_efex_fes_down(ctx, img.data, (ssize_t) img.size, SIM_TEST_FES_SECTOR, SUNXI_EFEX_TAG_NONE);
+		if (ret == EFEX_ERR_SUCCESS)
+			sim_test_rate(img.mapped ? "FES mmap" : "FES image", SIM_TEST_FES_SIZE, sunxi_efex_time_us() - start);
+	}
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_fes_up(ctx, in, SIM_TEST_FES_SIZE, SIM_TEST_FES_SECTOR, SUNXI_EFEX_TAG_NONE);
+	if (ret == EFEX_ERR_SUCCESS && memcmp(out, in, SIM_TEST_FES_SIZE) != 0) {
+		fprintf(stderr, "ERROR: Image download differs from the file\r\n");
+		ret = EFEX_ERR_INVALID_RESPONSE;
+	}
+	if (ret == EFEX_ERR_SUCCESS)
+		img.data[0] = (char) ~out[0];
+	sunxi_efex_image_close(&img);
+
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_image_open(&img, SIM_TEST_IMAGE);
+	if (ret == EFEX_ERR_SUCCESS) {
+		if (img.data[0] != out[0]) {
+			fprintf(stderr, "ERROR: Writing to the image changed the file\r\n");
+			ret = EFEX_ERR_INVALID_RESPONSE;
+		}
+		sunxi_efex_image_close(&img);
+	}
+	remove(SIM_TEST_IMAGE);
+	return ret;
+}
+
+// memset and memcpy change device memory as asked, unaligned ends included
+static int sim_test_fel_mem(const struct sunxi_efex_ctx_t *ctx, char *out, char *in) {
+	const uint32_t len = 256 * 1024;
+	const uint32_t src = SIM_TEST_FILL_ADDR + SIM_TEST_FILL_SIZE;
+	const uint32_t dst = src + len;
+
+	// Both ends of the fill done by the payload test
+	int ret = sunxi_efex_fel_read(ctx, SIM_TEST_FILL_ADDR, in, len);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_fel_read(ctx, SIM_TEST_FILL_ADDR + SIM_TEST_FILL_SIZE - len, in + len, len);
+	memset(out, 0xa5, 2 * len);
+	if (ret == EFEX_ERR_SUCCESS && memcmp(in, out, 2 * len) != 0) {
+		fprintf(stderr, "ERROR: memset left other contents behind\r\n");
+		return EFEX_ERR_VERIFICATION;
+	}
+
+	sim_test_fill(out, len, 8);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_fel_write(ctx, src, out, len);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_fel_write(ctx, dst, out, len);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_fel_memset(ctx, src + 3, 0x3c, len / 2 - 5);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_fel_memcpy(ctx, dst + 1, src + 2, len - 7);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_fel_read(ctx, src, in, 2 * len);
+	if (ret != EFEX_ERR_SUCCESS)
+		return ret;
+
+	// The expected memory, built the same way on the host
+	memcpy(out + len, out, len);
+	memset(out + 3, 0x3c, len / 2 - 5);
+	memmove(out + len + 1, out + 2, len - 7);
+	if (memcmp(in, out, 2 * len) != 0) {
+		fprintf(stderr, "ERROR: memset or memcpy result differs\r\n");
+		return EFEX_ERR_VERIFICATION;
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+// Register sequences run as programmed, and one whose poll runs out of tries stops there
+static int sim_test_seq_run(const struct sunxi_efex_ctx_t *ctx) {
+	const uint32_t reg = ctx->resp.data_start_address + 0x2000;
+	struct sunxi_efex_seq_t seq;
+	uint32_t reads[3];
+	size_t done = 0;
+
+	sunxi_efex_seq_init(&seq);
+	sunxi_efex_seq_write(&seq, reg, 0x12345678);
+	sunxi_efex_seq_read(&seq, reg);
+	sunxi_efex_seq_modify(&seq, reg, 0xff00, 0x0a00);
+	sunxi_efex_seq_read(&seq, reg);
+	sunxi_efex_seq_poll(&seq, reg, 0xffff, 0x0a78, 4);
+	sunxi_efex_seq_delay(&seq, 100);
+	sunxi_efex_seq_write(&seq, reg + 4, 0xfeed);
+	sunxi_efex_seq_read(&seq, reg + 4);
+	int ret = sunxi_efex_fel_seq_run(ctx, &seq, reads, &done);
+	if (ret != EFEX_ERR_SUCCESS)
+		return ret;
+	if (done != seq.count || reads[0] != 0x12345678 || reads[1] != 0x12340a78 || reads[2] != 0xfeed) {
+		fprintf(stderr, "ERROR: Sequence completed %zu operations, read 0x%08x 0x%08x 0x%08x\r\n", done, reads[0],
+		        reads[1], reads[2]);
+		return EFEX_ERR_VERIFICATION;
+	}
+
+	// The write after the poll that gives up must not happen
+	sunxi_efex_seq_init(&seq);
+	sunxi_efex_seq_write(&seq, reg, 1);
+	sunxi_efex_seq_read(&seq, reg);
+	sunxi_efex_seq_poll(&seq, reg, 0xff, 2, 3);
+	sunxi_efex_seq_write(&seq, reg, 3);
+	sunxi_efex_seq_read(&seq, reg);
+	reads[1] = 0xdeadbeef;
+	ret = sunxi_efex_fel_seq_run(ctx, &seq, reads, &done);
+	uint32_t val = 0;
+	if (ret == EFEX_ERR_DEVICE_NOT_READY)
+		ret = sunxi_efex_fel_payloads_readl(ctx, reg, &val);
+	else if (ret == EFEX_ERR_SUCCESS)
+		ret = EFEX_ERR_VERIFICATION;
+	if (ret == EFEX_ERR_SUCCESS && (done != 2 || reads[0] != 1 || reads[1] != 0xdeadbeef || val != 1)) {
+		fprintf(stderr, "ERROR: Timed out sequence completed %zu operations, left 0x%08x\r\n", done, val);
+		ret = EFEX_ERR_VERIFICATION;
+	}
+	return ret;
+}
+
+// Microseconds a chunk takes on a link that slows down sharply above its best size
+static uint64_t sim_test_link_usec(const uint32_t size, const uint32_t best) {
+	uint64_t usec = size / 400 + 50;
+	if (size > best)
+		usec += (uint64_t) size / 100 * (size / best);
+	return usec;
+}
+
+// Feeds the tuner with a modelled link and returns the size it ends up at
+static uint32_t sim_test_tune(struct sunxi_efex_ctx_t *ctx, const uint32_t best) {
+	for (int i = 0; i < 4096; i++) {
+		const uint32_t size = sunxi_efex_chunk_size(ctx, SUNXI_EFEX_CHUNK_FES_UP);
+		sunxi_efex_chunk_update(ctx, SUNXI_EFEX_CHUNK_FES_UP, size, sim_test_link_usec(size, best));
+	}
+	return sunxi_efex_chunk_size(ctx, SUNXI_EFEX_CHUNK_FES_UP);
+}
+
+// The tuner has to find sizes below its start as well as above, and follow a link that degrades
+static int sim_test_chunk_tune(struct sunxi_efex_ctx_t *ctx) {
+	const uint32_t kib = 1024;
+	int ret = sunxi_efex_set_chunk_auto(ctx, 1);
+	if (ret != EFEX_ERR_SUCCESS)
+		return ret;
+	const uint32_t down = sim_test_tune(ctx, 32 * kib);
+
+	ctx->chunk_limit = 1024 * kib;
+	ret = sunxi_efex_set_chunk_auto(ctx, 1);
+	const uint32_t up = sim_test_tune(ctx, 256 * kib);
+	const uint32_t degraded = sim_test_tune(ctx, 16 * kib);
+	ctx->chunk_limit = 0;
+	sunxi_efex_set_chunk_auto(ctx, 0);
+
+	printf("Chunk tune %u KiB below the start, %u KiB above, %u KiB degraded\n", down / kib, up / kib,
+	       degraded / kib);
+	if (ret == EFEX_ERR_SUCCESS && (down != 32 * kib || up != 256 * kib || degraded != 16 * kib)) {
+		fprintf(stderr, "ERROR: Chunk tuner missed the best size\r\n");
+		ret = EFEX_ERR_INVALID_RESPONSE;
+	}
+	return ret;
+}
+
+static uint64_t sim_test_bytes(const struct sunxi_efex_ctx_t *ctx, const int dir) {
+	struct sunxi_efex_stats_t stats;
+	uint64_t bytes = 0;
+	if (sunxi_efex_stats_get(ctx, &stats) == EFEX_ERR_SUCCESS) {
+		for (size_t i = 0; i < SUNXI_EFEX_STATS_CMDS && stats.cmds[i].cmd; i++)
+			bytes += stats.cmds[i].bytes[dir];
+	}
+	return bytes;
+}
+
+// Payload code is uploaded once; later calls only rewrite the parameters until something writes over it
+static int sim_test_payloads(struct sunxi_efex_ctx_t *ctx) {
+	const uint32_t addr = ctx->resp.data_start_address + 0x1000;
+	uint64_t bytes[3];
+	uint32_t val = 0;
+
+	int ret = sunxi_efex_fel_payloads_select(ctx, ARCH_ARM32);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_stats_enable(ctx, 1);
+	for (int i = 0; i < 3 && ret == EFEX_ERR_SUCCESS; i++) {
+		if (i == 2)
+			ret = sunxi_efex_fel_write(ctx, ctx->resp.data_start_address, (const char *) &val, sizeof(val));
+		sunxi_efex_stats_reset(ctx);
+		if (ret == EFEX_ERR_SUCCESS)
+			ret = sunxi_efex_fel_payloads_writel(ctx, 0x5a5a5a5a, addr);
+		bytes[i] = sim_test_bytes(ctx, SUNXI_EFEX_DIR_OUT);
+	}
+
+	// A payload store over resident code drops it as well, here writel overwriting itself
+	uint32_t entry = 0;
+	for (uint32_t i = 0; i <= SUNXI_EFEX_PAYLOAD_SLOTS && !entry; i++) {
+		if (sunxi_efex_fel_payloads_resident(ctx, ctx->resp.data_start_address + i * SUNXI_EFEX_PAYLOAD_SLOT_SIZE))
+			entry = ctx->resp.data_start_address + i * SUNXI_EFEX_PAYLOAD_SLOT_SIZE;
+	}
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_fel_payloads_writel(ctx, 0, entry);
+	sunxi_efex_stats_reset(ctx);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_fel_payloads_writel(ctx, 0x5a5a5a5a, addr);
+	const uint64_t stored = sim_test_bytes(ctx, SUNXI_EFEX_DIR_OUT);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_fel_payloads_readl(ctx, addr, &val);
+
+	if (ret == EFEX_ERR_SUCCESS && val != 0x5a5a5a5a) {
+		fprintf(stderr, "ERROR: readl returned 0x%08x after writel\r\n", val);
+		ret = EFEX_ERR_VERIFICATION;
+	}
+
+	// A batch goes out as one payload run, not one per register; the registers are every other word
+	uint32_t addrs[SIM_TEST_BATCH], vals[SIM_TEST_BATCH], expect[SIM_TEST_BATCH], mem[2 * SIM_TEST_BATCH];
+	for (size_t i = 0; i < SIM_TEST_BATCH; i++) {
+		addrs[i] = addr + (uint32_t) i * 8;
+		expect[i] = 0xc0de0000 + (uint32_t) i * 3;
+	}
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_fel_payloads_writel_batch(ctx, addrs, expect, SIM_TEST_BATCH);
+	sunxi_efex_stats_reset(ctx);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_fel_payloads_readl_batch(ctx, addrs, vals, SIM_TEST_BATCH);
+	const uint64_t batch = sim_test_bytes(ctx, SUNXI_EFEX_DIR_OUT);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_fel_read(ctx, addr, (char *) mem, sizeof(mem));
+	for (size_t i = 0; i < SIM_TEST_BATCH && ret == EFEX_ERR_SUCCESS; i++) {
+		if (vals[i] != expect[i] || le32_to_cpu(mem[2 * i]) != expect[i]) {
+			fprintf(stderr, "ERROR: Batched register %zu reads 0x%08x\r\n", i, vals[i]);
+			ret = EFEX_ERR_VERIFICATION;
+		}
+	}
+
+	// Clearing memory sends the fill payload, not the fill data
+	sunxi_efex_stats_reset(ctx);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_fel_memset(ctx, SIM_TEST_FILL_ADDR, 0xa5, SIM_TEST_FILL_SIZE);
+	const uint64_t fill = sim_test_bytes(ctx, SUNXI_EFEX_DIR_OUT);
+	sunxi_efex_stats_enable(ctx, 0);
+	if (ret != EFEX_ERR_SUCCESS)
+		return ret;
+
+	printf("writel     %llu bytes out cold, %llu resident, %llu after overwrite\n", (unsigned long long) bytes[0],
+	       (unsigned long long) bytes[1], (unsigned long long) bytes[2]);
+	printf("readl x%d  %llu bytes out batched\n", SIM_TEST_BATCH, (unsigned long long) batch);
+	printf("memset     %llu bytes out for %d MiB\n", (unsigned long long) fill, SIM_TEST_FILL_SIZE >> 20);
+	if (bytes[1] >= bytes[0] || bytes[2] != bytes[0] || !entry || stored != bytes[0]) {
+		fprintf(stderr, "ERROR: Payload was not kept resident or not invalidated\r\n");
+		return EFEX_ERR_VERIFICATION;
+	}
+	if (batch >= bytes[1] * SIM_TEST_BATCH) {
+		fprintf(stderr, "ERROR: Batch was not sent as one payload run\r\n");
+		return EFEX_ERR_VERIFICATION;
+	}
+	if (fill >= SIM_TEST_FILL_SIZE / 1024) {
+		fprintf(stderr, "ERROR: Fill data was sent over USB\r\n");
+		return EFEX_ERR_VERIFICATION;
+	}
+	return EFEX_ERR_SUCCESS;
+}
+
+// Verified writes over the payload area check with the device CRC, and catch data that went wrong
+static int sim_test_fel_verify(const struct sunxi_efex_ctx_t *ctx, char *out, char *in, struct sim_test_device *dev) {
+	sim_test_fill(out, SIM_TEST_FEL_SIZE, 9);
+	sunxi_efex_fel_set_verify((struct sunxi_efex_ctx_t *) ctx, 1);
+	sunxi_efex_stats_enable((struct sunxi_efex_ctx_t *) ctx, 1);
+	const uint64_t start = sunxi_efex_time_us();
+	int ret = sunxi_efex_fel_write(ctx, ctx->resp.data_start_address, out, SIM_TEST_FEL_SIZE);
+	const uint64_t usec = sunxi_efex_time_us() - start;
+	const uint64_t bytes_in = sim_test_bytes(ctx, SUNXI_EFEX_DIR_IN);
+	sunxi_efex_stats_enable((struct sunxi_efex_ctx_t *) ctx, 0);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_fel_read(ctx, ctx->resp.data_start_address, in, SIM_TEST_FEL_SIZE);
+	if (ret == EFEX_ERR_SUCCESS && (memcmp(in, out, SIM_TEST_FEL_SIZE) != 0 || bytes_in >= SIM_TEST_FEL_SIZE / 2)) {
+		fprintf(stderr, "ERROR: CRC verified write left other data or read %llu bytes back\r\n",
+		        (unsigned long long) bytes_in);
+		ret = EFEX_ERR_VERIFICATION;
+	}
+	if (ret == EFEX_ERR_SUCCESS)
+		sim_test_rate("FEL CRC", SIM_TEST_FEL_SIZE, usec);
+
+	if (ret == EFEX_ERR_SUCCESS) {
+		dev->corrupt = 1;
+		ret = sunxi_efex_fel_write(ctx, ctx->resp.data_start_address, out, SIM_TEST_FEL_SIZE);
+		dev->corrupt = 0;
+		if (ret == EFEX_ERR_CRC_MISMATCH) {
+			ret = EFEX_ERR_SUCCESS;
+		} else {
+			fprintf(stderr, "ERROR: Corrupted write returned %s\r\n", sunxi_efex_strerror(ret));
+			ret = EFEX_ERR_VERIFICATION;
+		}
+	}
+	sunxi_efex_fel_set_verify((struct sunxi_efex_ctx_t *) ctx, 0);
+	return ret;
+}
+
+int main(const int argc, char *argv[]) {
+	struct sunxi_efex_sim_config_t config;
+	struct sunxi_efex_ctx_t ctx = {0};
+	struct sim_test_device device = {0};
+
+	// Optional link model: sim_test [latency_us [bytes_per_second]]
+	sunxi_efex_sim_config_init(&config);
+	if (argc > 1)
+		config.latency_us = (uint32_t) strtoul(argv[1], NULL, 0);
+	if (argc > 2)
+		config.bandwidth = strtoull(argv[2], NULL, 0);
+	config.on_exec = sim_test_exec;
+	config.arg = &device;
+
+	char *out = malloc(SIM_TEST_FES_SIZE);
+	char *in = malloc(SIM_TEST_FES_SIZE);
+	if (!out || !in) {
+		free(out);
+		free(in);
+		return EFEX_ERR_MEMORY;
+	}
+
+	int ret = sunxi_usb_sim_configure(&config, 1);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_usb_set_backend(&ctx, USB_BACKEND_SIM);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_scan_usb_device(&ctx);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_usb_init(&ctx);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_init(&ctx);
+	if (ret != EFEX_ERR_SUCCESS) {
+		fprintf(stderr, "ERROR: %s\r\n", sunxi_efex_strerror(ret));
+		free(out);
+		free(in);
+		return ret;
+	}
+
+	printf("Simulated device: mode 0x%04x, chip ID 0x%08x\n", ctx.resp.mode, ctx.resp.id);
+	ret = sim_test_simg_roundtrip(out);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sim_test_fel(&ctx, out, in);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sim_test_payloads(&ctx);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sim_test_fel_mem(&ctx, out, in);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sim_test_seq_run(&ctx);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sim_test_fel_verify(&ctx, out, in, &device);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sim_test_chunk_tune(&ctx);
+
+	// Run the pretend payload and pick the device up again in FES mode
+	device.fes_armed = 1;
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_fel_exec(&ctx, ctx.resp.data_start_address);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sunxi_efex_init(&ctx);
+	if (ret == EFEX_ERR_SUCCESS && ctx.resp.mode != DEVICE_MODE_SRV) {
+		fprintf(stderr, "ERROR: Device did not switch to FES mode\r\n");
+		ret = EFEX_ERR_INVALID_DEVICE_MODE;
+	}
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sim_test_fes(&ctx, out, in);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sim_test_fes_stream(&ctx, out, in);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sim_test_image(&ctx, out, in);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sim_test_fes_up_stream(&ctx, out, in);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sim_test_fes_sparse(&ctx, out, in);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sim_test_fes_simg(&ctx, out, in);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sim_test_fes_dump(&ctx, out, in);
+	if (ret == EFEX_ERR_SUCCESS)
+		ret = sim_test_fes_blank(&ctx, out, in);
+
+	printf("Result: %s\n", sunxi_efex_strerror(ret));
+	sunxi_usb_exit(&ctx);
+	free(out);
+	free(in);
+	return ret;
+}